@@ -0,0 +1,110 @@
+cmake_minimum_required(VERSION 3.13)
+
+##
+# pdcalc_binary_check.cmake
+#
+# This CMake module is intended to be run in script mode as a CTest test. It
+# runs pdcalc on the inputs with text output and with binary output, converts
+# the binary output to text with pdcalc_read, and checks that both texts are
+# identical. The script fails if any step fails.
+#
+# CMake variables consumed that should be externally defined are:
+#
+#   PDCALC              Path to pdcalc
+#   PDCALC_READ         Path to pdcalc_read
+#   PDCALC_WORK_DIR     Directory to write the outputs to
+#   PDCALC_INPUTS       Semicolon-separated pdcalc input files
+#
+# Optional CMake variables consumed are:
+#
+#   PDCALC_ARGS         Semicolon-separated pdcalc arguments for both runs
+#   PDCALC_BINARY_ARGS  Semicolon-separated pdcalc arguments for the binary
+#                       output run only, e.g. --output-locations
+#   PDCALC_READ_ARGS    Semicolon-separated pdcalc_read arguments
+#   PDCALC_FAILS        True if pdcalc is expected to exit with an error, e.g.
+#                       with --keep-going on a program with failing statements
+#   PDCALC_READ_ONLY    True to skip the text output run and write the
+#                       pdcalc_read output to stdout instead of comparing it,
+#                       e.g. to check the output with a regular expression
+#
+
+##
+# Helper function to check that a variable is defined and not the empty string.
+#
+# Arguments:
+#   var     Variable name
+function(check_path_var var)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+    if(${var} STREQUAL "")
+        message(FATAL_ERROR "${var} is the empty string")
+    endif()
+endfunction()
+
+##
+# Helper function to run pdcalc and check its exit status.
+#
+# Arguments:
+#   output      File to write stdout to
+#   ARGN        pdcalc arguments
+function(run_pdcalc output)
+    execute_process(
+        COMMAND ${PDCALC} ${ARGN} ${PDCALC_INPUTS}
+        OUTPUT_FILE ${output}
+        RESULT_VARIABLE _res
+    )
+    if(PDCALC_FAILS)
+        if(NOT _res)
+            message(FATAL_ERROR "pdcalc succeeded but was expected to fail")
+        endif()
+    elseif(_res)
+        message(FATAL_ERROR "pdcalc failed: ${_res}")
+    endif()
+endfunction()
+
+# run only in script mode
+if(CMAKE_SCRIPT_MODE_FILE)
+    # check variables
+    check_path_var(PDCALC)
+    check_path_var(PDCALC_READ)
+    check_path_var(PDCALC_WORK_DIR)
+    check_path_var(PDCALC_INPUTS)
+    file(MAKE_DIRECTORY ${PDCALC_WORK_DIR})
+    # run pdcalc with binary output
+    set(_binary ${PDCALC_WORK_DIR}/output.bin)
+    run_pdcalc(
+        ${_binary}
+            ${PDCALC_ARGS} --output-format=binary ${PDCALC_BINARY_ARGS}
+    )
+    # convert to text, writing to stdout if not comparing
+    if(PDCALC_READ_ONLY)
+        execute_process(
+            COMMAND ${PDCALC_READ} ${PDCALC_READ_ARGS} ${_binary}
+            RESULT_VARIABLE _res
+        )
+        if(_res)
+            message(FATAL_ERROR "pdcalc_read failed: ${_res}")
+        endif()
+        return()
+    endif()
+    set(_read ${PDCALC_WORK_DIR}/read.txt)
+    execute_process(
+        COMMAND ${PDCALC_READ} ${PDCALC_READ_ARGS} ${_binary}
+        OUTPUT_FILE ${_read}
+        RESULT_VARIABLE _res
+    )
+    if(_res)
+        message(FATAL_ERROR "pdcalc_read failed: ${_res}")
+    endif()
+    # run pdcalc with text output and compare
+    set(_text ${PDCALC_WORK_DIR}/output.txt)
+    run_pdcalc(${_text} ${PDCALC_ARGS})
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${_text} ${_read}
+        RESULT_VARIABLE _res
+    )
+    if(_res)
+        message(FATAL_ERROR "${_read} differs from ${_text}")
+    endif()
+endif()
@@ -0,0 +1,84 @@
+cmake_minimum_required(VERSION 3.13)
+
+##
+# pdcalc_gen_check.cmake
+#
+# This CMake module is intended to be run in script mode as a CTest test. It
+# generates a program with pdcalc_gen unless one is given, runs pdcalc on the
+# program, and checks the pdcalc output against the program's expected results
+# with pdcalc_gen --check. The script fails if any step fails.
+#
+# CMake variables consumed that should be externally defined are:
+#
+#   PDCALC              Path to pdcalc
+#   PDCALC_GEN          Path to pdcalc_gen
+#   PDCALC_WORK_DIR     Directory to write the program and output to
+#
+# Optional CMake variables consumed are:
+#
+#   PDCALC_PROGRAM      Existing program to check instead of generating one
+#   PDCALC_GEN_ARGS     Semicolon-separated pdcalc_gen generator arguments
+#   PDCALC_ARGS         Semicolon-separated pdcalc arguments
+#   PDCALC_CHECK_ARGS   Semicolon-separated pdcalc_gen --check arguments
+#   PDCALC_FAILS        True if pdcalc is expected to exit with an error, e.g.
+#                       with --keep-going on a program with failing statements
+#
+
+##
+# Helper function to check that a variable is defined and not the empty string.
+#
+# Arguments:
+#   var     Variable name
+function(check_path_var var)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+    if(${var} STREQUAL "")
+        message(FATAL_ERROR "${var} is the empty string")
+    endif()
+endfunction()
+
+# run only in script mode
+if(CMAKE_SCRIPT_MODE_FILE)
+    # check variables
+    check_path_var(PDCALC)
+    check_path_var(PDCALC_GEN)
+    check_path_var(PDCALC_WORK_DIR)
+    file(MAKE_DIRECTORY ${PDCALC_WORK_DIR})
+    # generate program if not given
+    if(NOT PDCALC_PROGRAM)
+        set(PDCALC_PROGRAM ${PDCALC_WORK_DIR}/program.in)
+        execute_process(
+            COMMAND ${PDCALC_GEN} ${PDCALC_GEN_ARGS}
+            OUTPUT_FILE ${PDCALC_PROGRAM}
+            RESULT_VARIABLE _res
+        )
+        if(_res)
+            message(FATAL_ERROR "pdcalc_gen failed: ${_res}")
+        endif()
+    endif()
+    # run pdcalc on the program
+    set(_output ${PDCALC_WORK_DIR}/output.txt)
+    execute_process(
+        COMMAND ${PDCALC} ${PDCALC_ARGS} ${PDCALC_PROGRAM}
+        OUTPUT_FILE ${_output}
+        RESULT_VARIABLE _res
+    )
+    if(PDCALC_FAILS)
+        if(NOT _res)
+            message(FATAL_ERROR "pdcalc succeeded but was expected to fail")
+        endif()
+    elseif(_res)
+        message(FATAL_ERROR "pdcalc failed: ${_res}")
+    endif()
+    # check the output
+    execute_process(
+        COMMAND
+            ${PDCALC_GEN} --check=${PDCALC_PROGRAM} ${PDCALC_CHECK_ARGS}
+                ${_output}
+        RESULT_VARIABLE _res
+    )
+    if(_res)
+        message(FATAL_ERROR "pdcalc_gen --check failed: ${_res}")
+    endif()
+endif()
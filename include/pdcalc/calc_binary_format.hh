@@ -0,0 +1,323 @@
+/**
+ * @file calc_binary_format.hh
+ * @author Derek Huang
+ * @brief C++ header for the pdcalc binary result and columnar data formats
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_BINARY_FORMAT_HH_
+#define PDCALC_CALC_BINARY_FORMAT_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace pdcalc {
+
+/**
+ * Type tag of a binary result record.
+ *
+ * The tag of a result is the index of its type in `calc_symbol::value_type`.
+ * A statement that failed when continuing past failed statements has the
+ * `error` tag, a zero value, the line the error starts on, and the statement
+ * index. A statement that failed to parse is not part of its input, so its
+ * statement index is the one of the next statement.
+ */
+enum class calc_binary_tag : std::uint8_t {
+  bool_value,
+  long_value,
+  double_value,
+  error
+};
+
+/**
+ * Binary result output header.
+ *
+ * Binary output is this header followed by one fixed-size record for each
+ * statement result or error, in the same order as the text output, up to the
+ * end of the output. All integers are little-endian.
+ *
+ * The header is 16 bytes: the 8-byte magic `pdcalcRB`, the 4-byte version,
+ * and the 4-byte flags. Records are laid out as follows:
+ *
+ * | Offset | Size | Contents                                             |
+ * | ------ | ---- | ---------------------------------------------------- |
+ * | 0      | 8    | value bits, `long` as 64 bits and `bool` as 0 or 1   |
+ * | 8      | 1    | type tag                                             |
+ * | 9      | 3    | zero                                                 |
+ * | 12     | 4    | line the statement starts on, zero without locations |
+ * | 16     | 8    | statement index in its input, only with locations    |
+ *
+ * Records are 16 bytes, or 24 bytes if `calc_binary_locations` is set in the
+ * flags. Both are multiples of 8 so that a memory-mapped output can be read
+ * in place with each value 8-byte aligned, and the number of records is the
+ * size after the header divided by the record size.
+ */
+struct calc_binary_header {
+  std::uint32_t version;  // format version
+  std::uint32_t flags;    // format flags
+};
+
+/**
+ * Binary result record.
+ */
+struct calc_binary_record {
+  calc_binary_tag tag;      // type tag
+  std::uint64_t bits;       // value bits
+  std::uint32_t line;       // line the statement starts on
+  std::uint64_t statement;  // statement index in its input
+};
+
+/**
+ * Magic bytes starting binary output.
+ */
+inline constexpr std::string_view calc_binary_magic{"pdcalcRB", 8};
+
+/**
+ * Binary format version.
+ */
+inline constexpr std::uint32_t calc_binary_version = 1;
+
+/**
+ * Flag set if records hold the statement index and line.
+ */
+inline constexpr std::uint32_t calc_binary_locations = 1;
+
+/**
+ * Size of the header in bytes.
+ */
+inline constexpr std::size_t calc_binary_header_size = 16;
+
+/**
+ * Return the size of each record in bytes.
+ *
+ * @param flags Format flags
+ */
+constexpr std::size_t calc_binary_record_size(std::uint32_t flags) noexcept
+{
+  return (flags & calc_binary_locations) ? 24 : 16;
+}
+
+/**
+ * Encode a header.
+ *
+ * @param data Buffer of at least `calc_binary_header_size` bytes
+ * @param flags Format flags
+ */
+inline void calc_binary_encode(char* data, std::uint32_t flags) noexcept
+{
+  std::memcpy(data, calc_binary_magic.data(), calc_binary_magic.size());
+  for (std::size_t i = 0; i < 4; i++) {
+    data[8 + i] = static_cast<char>(calc_binary_version >> (8 * i));
+    data[12 + i] = static_cast<char>(flags >> (8 * i));
+  }
+}
+
+/**
+ * Encode a record.
+ *
+ * @param data Buffer of at least `calc_binary_record_size(flags)` bytes
+ * @param record Record, where the location is ignored without locations
+ * @param flags Format flags
+ */
+inline void calc_binary_encode(
+  char* data, const calc_binary_record& record, std::uint32_t flags) noexcept
+{
+  auto locations = (flags & calc_binary_locations) != 0;
+  std::memset(data, 0, calc_binary_record_size(flags));
+  for (std::size_t i = 0; i < 8; i++)
+    data[i] = static_cast<char>(record.bits >> (8 * i));
+  data[8] = static_cast<char>(record.tag);
+  if (!locations)
+    return;
+  for (std::size_t i = 0; i < 4; i++)
+    data[12 + i] = static_cast<char>(record.line >> (8 * i));
+  for (std::size_t i = 0; i < 8; i++)
+    data[16 + i] = static_cast<char>(record.statement >> (8 * i));
+}
+
+/**
+ * Read an unsigned little-endian integer.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param data First byte of the integer
+ */
+template <typename T>
+inline T calc_binary_get(const char* data) noexcept
+{
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    value |= static_cast<T>(static_cast<unsigned char>(data[i])) << (8 * i);
+  return value;
+}
+
+/**
+ * Return the header at the start of a buffer if it has the magic bytes.
+ *
+ * The version is not checked so that the caller can report it.
+ *
+ * @param data Buffer starting at the header
+ */
+inline std::optional<calc_binary_header> calc_binary_peek(
+  std::string_view data) noexcept
+{
+  if (
+    data.size() < calc_binary_header_size ||
+    data.substr(0, calc_binary_magic.size()) != calc_binary_magic
+  )
+    return {};
+  return calc_binary_header{
+    calc_binary_get<std::uint32_t>(data.data() + 8),
+    calc_binary_get<std::uint32_t>(data.data() + 12)
+  };
+}
+
+/**
+ * Decode a record.
+ *
+ * The location is zero without locations.
+ *
+ * @param data Buffer of at least `calc_binary_record_size(flags)` bytes
+ * @param flags Format flags
+ */
+inline calc_binary_record calc_binary_decode(
+  const char* data, std::uint32_t flags) noexcept
+{
+  calc_binary_record record{
+    static_cast<calc_binary_tag>(data[8]),
+    calc_binary_get<std::uint64_t>(data),
+    0,
+    0
+  };
+  if (flags & calc_binary_locations) {
+    record.line = calc_binary_get<std::uint32_t>(data + 12);
+    record.statement = calc_binary_get<std::uint64_t>(data + 16);
+  }
+  return record;
+}
+
+/**
+ * Return the bits of a `double` value.
+ *
+ * @param value Value
+ */
+inline std::uint64_t calc_binary_bits(double value) noexcept
+{
+  static_assert(sizeof(double) == sizeof(std::uint64_t));
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  return bits;
+}
+
+/**
+ * Return the `double` value of some bits.
+ *
+ * @param bits Value bits
+ */
+inline double calc_binary_double(std::uint64_t bits) noexcept
+{
+  double value;
+  std::memcpy(&value, &bits, sizeof value);
+  return value;
+}
+
+/**
+ * Binary columnar data header.
+ *
+ * Columnar data is used for the input and output columns of `pdcalc --expr`.
+ * It is this header followed by any number of chunks of rows, up to the end
+ * of the data, so that it can be written and read one chunk at a time. All
+ * integers are little-endian.
+ *
+ * The header is the 8-byte magic `pdcalcCF`, the 4-byte version, and the
+ * 4-byte number of columns, followed by a descriptor for each column: the
+ * 1-byte type tag, 3 zero bytes, the 4-byte name size, and the name padded
+ * with zero bytes to a multiple of 8. Each chunk is the 8-byte number of rows
+ * followed by the values of each column in descriptor order, where each
+ * value is 1 byte for `bool` and 8 bytes for `long`, stored as 64 bits, and
+ * `double`. The values of each column are padded with zero bytes to a
+ * multiple of 8 so that all values are 8-byte aligned.
+ */
+struct calc_column_header {
+  std::uint32_t version;    // format version
+  std::uint32_t n_columns;  // number of columns
+};
+
+/**
+ * Magic bytes starting columnar data.
+ */
+inline constexpr std::string_view calc_column_magic{"pdcalcCF", 8};
+
+/**
+ * Columnar data format version.
+ */
+inline constexpr std::uint32_t calc_column_version = 1;
+
+/**
+ * Size of the columnar data header before the column descriptors in bytes.
+ */
+inline constexpr std::size_t calc_column_header_size = 16;
+
+/**
+ * Return a size rounded up to a multiple of 8.
+ *
+ * @param size Size in bytes
+ */
+constexpr std::size_t calc_column_padded(std::size_t size) noexcept
+{
+  return (size + 7) & ~std::size_t{7};
+}
+
+/**
+ * Return the size of a column value in bytes.
+ *
+ * @param tag Column type tag, which must not be `error`
+ */
+constexpr std::size_t calc_column_value_size(calc_binary_tag tag) noexcept
+{
+  return (tag == calc_binary_tag::bool_value) ? 1 : 8;
+}
+
+/**
+ * Encode a columnar data header.
+ *
+ * @param data Buffer of at least `calc_column_header_size` bytes
+ * @param n_columns Number of columns
+ */
+inline void calc_column_encode(char* data, std::uint32_t n_columns) noexcept
+{
+  std::memcpy(data, calc_column_magic.data(), calc_column_magic.size());
+  for (std::size_t i = 0; i < 4; i++) {
+    data[8 + i] = static_cast<char>(calc_column_version >> (8 * i));
+    data[12 + i] = static_cast<char>(n_columns >> (8 * i));
+  }
+}
+
+/**
+ * Return the columnar data header at the start of a buffer if it has the
+ * magic bytes.
+ *
+ * The version is not checked so that the caller can report it.
+ *
+ * @param data Buffer starting at the header
+ */
+inline std::optional<calc_column_header> calc_column_peek(
+  std::string_view data) noexcept
+{
+  if (
+    data.size() < calc_column_header_size ||
+    data.substr(0, calc_column_magic.size()) != calc_column_magic
+  )
+    return {};
+  return calc_column_header{
+    calc_binary_get<std::uint32_t>(data.data() + 8),
+    calc_binary_get<std::uint32_t>(data.data() + 12)
+  };
+}
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_BINARY_FORMAT_HH_
@@ -8,9 +8,18 @@
 #ifndef PDCALC_CALC_PARSER_HH_
 #define PDCALC_CALC_PARSER_HH_
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
+#include "pdcalc/calc_symbol.hh"
 #include "pdcalc/dllexport.h"
 
 #include <iostream>
@@ -27,11 +36,479 @@ namespace pdcalc {
 // forward declaration for implementation class
 class calc_parser_impl;
 
+/**
+ * In-memory input source.
+ *
+ * The text is only read during parsing and does not need to be null-terminated.
+ */
+struct calc_source {
+  std::string_view text;  // input text
+  std::string_view name;  // name used for the input in error locations
+};
+
+/**
+ * Input column of symbol values with one value per row.
+ *
+ * The alternatives are in the same order as those of `calc_symbol::value_type`
+ * and the column type must match the symbol type the program was compiled
+ * with. The data is only read during evaluation.
+ */
+struct calc_input_column {
+  std::string_view name;                                       // symbol name
+  std::variant<const bool*, const long*, const double*> data;  // row values
+};
+
+/**
+ * Output column receiving the value of a symbol for each row.
+ *
+ * The column type must match the type of the symbol at the end of the program.
+ */
+struct calc_output_column {
+  std::string_view name;                     // symbol name
+  std::variant<bool*, long*, double*> data;  // row values
+};
+
+/**
+ * Location of a statement or an error in its input.
+ *
+ * Lines and columns are those of parser error locations, so columns count
+ * bytes. The end column is just past the end, e.g. just past the semicolon
+ * ending a statement.
+ */
+struct calc_location {
+  std::string_view input;      // input name
+  std::uint32_t begin_line;    // first line
+  std::uint32_t begin_column;  // first column
+  std::uint32_t end_line;      // last line
+  std::uint32_t end_column;    // column past the end
+};
+
+/**
+ * Write a location as it prefixes error messages, e.g. `in:1.5-9`.
+ *
+ * As with parser locations, the last column is written instead of the column
+ * past the end, and only if the location spans more than one column.
+ *
+ * @param out Stream to write to
+ * @param loc Location to write
+ */
+inline std::ostream& operator<<(std::ostream& out, const calc_location& loc)
+{
+  auto end_column = loc.end_column ? loc.end_column - 1 : 0;
+  out << loc.input << ':' << loc.begin_line << '.' << loc.begin_column;
+  if (loc.begin_line < loc.end_line)
+    out << '-' << loc.end_line << '.' << end_column;
+  else if (loc.begin_column < end_column)
+    out << '-' << end_column;
+  return out;
+}
+
+/**
+ * Error of a statement that failed to parse or evaluate.
+ *
+ * Evaluation errors are located at the failing operation if it is known and
+ * otherwise at the statement, while syntax errors are located at the token
+ * they were found at.
+ */
+struct calc_error {
+  calc_location location;  // error location
+  std::string message;     // error message without the location
+};
+
+/**
+ * Write an error as the parser formats its last error.
+ *
+ * @param out Stream to write to
+ * @param error Error to write
+ */
+inline std::ostream& operator<<(std::ostream& out, const calc_error& error)
+{
+  return out << error.location << ": " << error.message;
+}
+
+/**
+ * Receiver of the results of evaluated statements.
+ *
+ * A parser passes the value of each statement that prints a result to its
+ * visitor as it is evaluated, without formatting it. By default, the visitor
+ * is the one writing each result as text to the parser sink, e.g. `<long> 5`.
+ * Results of `load` and `recompute` are returned as `calc_result` instead.
+ */
+class PDCALC_API calc_result_visitor {
+public:
+  /**
+   * Dtor.
+   */
+  virtual ~calc_result_visitor();
+
+  /**
+   * Receive the result of a statement.
+   *
+   * @param statement Statement index in program order
+   * @param location Statement location
+   * @param value Result value
+   */
+  virtual void visit(
+    std::size_t statement,
+    const calc_location& location,
+    const calc_symbol::value_type& value) = 0;
+
+  /**
+   * Receive the error of a statement that failed.
+   *
+   * This is only called when the parser continues after failed statements.
+   * Statements that failed to parse are not part of the program, so they have
+   * the index the next statement in program order will have. The default does
+   * nothing.
+   *
+   * @param statement Statement index in program order
+   * @param location Error location, as for `calc_error`
+   * @param message Error message without the location
+   */
+  virtual void visit_error(
+    std::size_t /*statement*/,
+    const calc_location& /*location*/,
+    std::string_view /*message*/)
+  {}
+
+  /**
+   * Handle the end of a parse or run.
+   *
+   * This is also called before each checkpoint is written. Visitors that
+   * buffer results should complete them here. The default does nothing.
+   */
+  virtual void flush() {}
+};
+
+/**
+ * Token read by a lexer, as passed to a `calc_token_visitor`.
+ *
+ * The location is that used by the parser, so columns count bytes and the end
+ * column is just past the token.
+ */
+struct calc_token {
+  int kind;  // parser symbol kind, 0 for the end of input
+  // literal value or identifier name, empty for other tokens
+  std::variant<std::monostate, bool, long, double, std::string_view> value;
+  calc_location location;  // token location
+};
+
+/**
+ * Receiver of the tokens read by `calc_parser::lex`.
+ *
+ * Identifier names and the input name are only valid during the call.
+ */
+class PDCALC_API calc_token_visitor {
+public:
+  /**
+   * Dtor.
+   */
+  virtual ~calc_token_visitor();
+
+  /**
+   * Receive the next token.
+   *
+   * @param token Token
+   */
+  virtual void visit(const calc_token& token) = 0;
+};
+
+/**
+ * Result of a statement evaluated by `calc_parser::load` or `recompute`.
+ */
+struct calc_result {
+  std::size_t statement;          // statement index in program order
+  std::string_view name;          // assigned symbol, empty for print statements
+  calc_symbol::value_type value;  // printed or assigned value
+};
+
+/**
+ * Position reached in a sequence of evaluated inputs.
+ *
+ * Lines and columns are those of parser error locations, so columns count
+ * bytes. The position is just past the last statement evaluated, or the start
+ * of the next input once an input has been evaluated completely.
+ */
+struct calc_position {
+  std::uint64_t input = 0;   // number of inputs completely evaluated
+  std::uint32_t line = 1;    // line in the current input
+  std::uint32_t column = 1;  // column in the current input
+};
+
+/**
+ * Return the byte offset of the line and column of a position in a text.
+ *
+ * This is where parsing should resume in the text of the input the position
+ * is in. Offsets past the end of the text are clamped to its size.
+ *
+ * @param text Input text
+ * @param position Position in the input
+ */
+inline std::size_t calc_position_offset(
+  std::string_view text, const calc_position& position) noexcept
+{
+  std::size_t offset = 0;
+  for (std::uint32_t line = 1; line < position.line; line++) {
+    offset = text.find('\n', offset);
+    if (offset == std::string_view::npos)
+      return text.size();
+    offset++;
+  }
+  return std::min<std::size_t>(offset + position.column - 1, text.size());
+}
+
+/**
+ * How input files are read by the lexer.
+ */
+enum class calc_input_mode {
+  // read through stdio buffering
+  stdio,
+  // scan a private memory mapping of the file in place. inputs that cannot be
+  // mapped, e.g. `stdin`, pipes, or empty files, are read through stdio
+  mmap
+};
+
+/**
+ * Which lexer turns input into tokens.
+ */
+enum class calc_lexer {
+  // Flex-generated lexer matching one byte at a time
+  flex,
+  // hand-written scanner that skips blanks, newlines, and comments with SIMD
+  // instructions where available. it gives the same tokens and locations as
+  // `flex` but does not support lexer tracing. unless mapped, input files are
+  // read fully into memory before scanning
+  simd
+};
+
+/**
+ * How compiled statements are evaluated.
+ */
+enum class calc_backend {
+  // run bytecode compiled from the program on a register VM
+  vm,
+  // walk the program expression trees
+  tree,
+  // run native code compiled from the VM bytecode. only available on x86-64
+  // platforms using the System V ABI, falling back to `vm` elsewhere
+  jit
+};
+
+/**
+ * When buffered statement output is written to the sink.
+ *
+ * Whatever the policy, all buffered output is written and the sink flushed
+ * when a parse, compile, or run ends, whether or not it succeeds.
+ */
+enum class calc_flush_policy {
+  // write and flush after every statement, like writing `std::endl`
+  statement,
+  // write and flush once at least `flush_bytes` bytes are buffered
+  bytes,
+  // write and flush only when the input ends
+  end
+};
+
+/**
+ * How `double` statement results are formatted.
+ */
+enum class calc_double_format {
+  // general format with the sink precision, as written by `operator<<`
+  general,
+  // shortest representation that reads back as the same value
+  shortest
+};
+
+/**
+ * Phase of a parse, compile, or run that time is measured for.
+ */
+enum class calc_phase {
+  // opening, mapping, reading, copying, and closing input outside the lexer.
+  // files read through stdio by the Flex lexer are read while lexing
+  io,
+  // turning input into tokens
+  lex,
+  // parsing tokens and compiling and optimizing statements
+  parse,
+  // evaluating statements
+  eval,
+  // formatting statement results and writing them to the sink
+  output
+};
+
+/**
+ * Builtin function.
+ */
+enum class calc_builtin {
+  exp,
+  log,
+  log2,
+  log10,
+  sqrt,
+  sin,
+  cos,
+  tan,
+  max,
+  min
+};
+
+/**
+ * Return the name of a phase.
+ *
+ * @param phase Phase
+ */
+constexpr std::string_view calc_phase_name(calc_phase phase) noexcept
+{
+  constexpr std::string_view names[] = {"io", "lex", "parse", "eval", "output"};
+  return names[static_cast<std::size_t>(phase)];
+}
+
+/**
+ * Return the name of a builtin function as written in the input.
+ *
+ * @param builtin Builtin function
+ */
+constexpr std::string_view calc_builtin_name(calc_builtin builtin) noexcept
+{
+  constexpr std::string_view names[] = {
+    "exp", "log", "log2", "log10", "sqrt", "sin", "cos", "tan", "max", "min"
+  };
+  return names[static_cast<std::size_t>(builtin)];
+}
+
+/**
+ * Performance counters accumulated over parses, compiles, and runs.
+ *
+ * Statement and builtin call counts are of the statements as compiled, with
+ * builtin calls counted as written before any optimization. Statements of
+ * inputs evaluated from the statement cache are counted as if compiled again.
+ * Symbol lookups and inserts are those made by the lexer when typing
+ * identifiers, when checking statement cache entries, and by statement
+ * evaluation. Column runs are timed but not otherwise counted.
+ *
+ * Times are exclusive, e.g. time spent lexing is not counted as parse time,
+ * and CPU time is that of the calling thread. As the wall clock is read
+ * around every token and statement result, timing adds its own overhead. The
+ * slower thread CPU clock is only read around each input, so the CPU time of
+ * an input is split between its phases by their wall time.
+ */
+struct calc_stats {
+  static constexpr std::size_t n_phases = 5;
+  static constexpr std::size_t n_builtins = 10;
+  static constexpr std::size_t n_types = std::variant_size_v<
+    calc_symbol::value_type
+  >;
+
+  // input bytes consumed by the lexer
+  std::uint64_t bytes_read;
+  // tokens returned by the lexer, not including end of input
+  std::uint64_t tokens;
+  // print and assignment statements by value type, indexed in the order of
+  // the `calc_symbol::value_type` alternatives
+  std::uint64_t prints[n_types];
+  std::uint64_t assignments[n_types];
+  // symbol table lookups and inserts, including replacing a value
+  std::uint64_t symbol_lookups;
+  std::uint64_t symbol_inserts;
+  // builtin function calls indexed by `calc_builtin`
+  std::uint64_t builtin_calls[n_builtins];
+  // in-memory inputs evaluated from and compiled into the statement cache
+  std::uint64_t cache_hits;
+  std::uint64_t cache_misses;
+  // wall and thread CPU time indexed by `calc_phase`
+  std::chrono::nanoseconds wall_time[n_phases];
+  std::chrono::nanoseconds cpu_time[n_phases];
+
+  /**
+   * Return the number of print and assignment statements.
+   */
+  std::uint64_t statements() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < n_types; i++)
+      total += prints[i] + assignments[i];
+    return total;
+  }
+
+  /**
+   * Return the number of calls to a builtin function.
+   *
+   * @param builtin Builtin function
+   */
+  auto calls(calc_builtin builtin) const noexcept
+  {
+    return builtin_calls[static_cast<std::size_t>(builtin)];
+  }
+
+  /**
+   * Return the wall time spent in a phase.
+   *
+   * @param phase Phase
+   */
+  auto wall(calc_phase phase) const noexcept
+  {
+    return wall_time[static_cast<std::size_t>(phase)];
+  }
+
+  /**
+   * Return the thread CPU time spent in a phase.
+   *
+   * @param phase Phase
+   */
+  auto cpu(calc_phase phase) const noexcept
+  {
+    return cpu_time[static_cast<std::size_t>(phase)];
+  }
+
+  /**
+   * Add the counters of another instance, e.g. from another parser.
+   *
+   * @param other Counters to add
+   * @returns `*this` to allow method chaining
+   */
+  calc_stats& operator+=(const calc_stats& other) noexcept
+  {
+    bytes_read += other.bytes_read;
+    tokens += other.tokens;
+    for (std::size_t i = 0; i < n_types; i++) {
+      prints[i] += other.prints[i];
+      assignments[i] += other.assignments[i];
+    }
+    symbol_lookups += other.symbol_lookups;
+    symbol_inserts += other.symbol_inserts;
+    for (std::size_t i = 0; i < n_builtins; i++)
+      builtin_calls[i] += other.builtin_calls[i];
+    cache_hits += other.cache_hits;
+    cache_misses += other.cache_misses;
+    for (std::size_t i = 0; i < n_phases; i++) {
+      wall_time[i] += other.wall_time[i];
+      cpu_time[i] += other.cpu_time[i];
+    }
+    return *this;
+  }
+};
+
 /**
  * `pdcalc` infix calculator parse driver.
  *
  * Encapsulates the Flex/Bison generated lexer + parser and driver
  * implementation in an ABI-stable representation.
+ *
+ * Input is compiled into a program that is retained after parsing, so the
+ * last parsed or compiled input can be evaluated again with `run` without
+ * being lexed and parsed again, e.g. after changing symbol values.
+ *
+ * Independent instances can be used concurrently from different threads as
+ * each instance has its own lexer state and symbol table. A single instance
+ * must not be used from multiple threads at the same time, and writes to a
+ * sink shared between instances must be synchronized by the caller.
+ *
+ * All memory used by an instance, including the instance implementation
+ * itself, is allocated from the memory resource it was constructed with,
+ * except for the `std::string` values of `calc_symbol` identifiers, of
+ * `last_error`, and of `errors` that do not fit in the small string buffer,
+ * the `errors` vector, and the Bison parser stack. The memory resource must
+ * outlive the instance.
  */
 class PDCALC_API calc_parser {
 public:
@@ -42,6 +519,15 @@ public:
    */
   calc_parser(std::ostream& sink = std::cout);
 
+  /**
+   * Ctor.
+   *
+   * @param sink Stream to write all non-error output to
+   * @param resource Memory resource to allocate from, which must outlive the
+   *  parser and is not required to be thread-safe
+   */
+  calc_parser(std::ostream& sink, std::pmr::memory_resource* resource);
+
   /**
    * Dtor.
    */
@@ -57,6 +543,24 @@ public:
    */
   std::ostream& sink() const noexcept;
 
+  /**
+   * Return the visitor receiving statement results.
+   */
+  calc_result_visitor& visitor() const noexcept;
+
+  /**
+   * Set the visitor receiving statement results.
+   *
+   * The default visitor writes results as text to the sink, according to the
+   * flush policy and double format, and is restored by passing `nullptr`.
+   * Any buffered sink output is written before the visitor is replaced. The
+   * visitor is not owned and must outlive its use by the parser.
+   *
+   * @param visitor Visitor to use, `nullptr` to write results to the sink
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& visitor(calc_result_visitor* visitor);
+
   /**
    * Parse input from `stdin`.
    *
@@ -105,6 +609,383 @@ public:
     bool trace_lexer,
     bool trace_parser);
 
+  /**
+   * Parse the specified in-memory input.
+   *
+   * The Flex lexer copies the input text into a lexer buffer before parsing.
+   * To avoid the copy, use `parse_buffer` with a buffer that has the required
+   * padding or use the `simd` lexer, which scans the text in place.
+   *
+   * @param source Input text and name
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse(const calc_source& source, bool enable_trace = false)
+  {
+    return parse(source, enable_trace, enable_trace);
+  }
+
+  /**
+   * Parse the specified in-memory input.
+   *
+   * The Flex lexer copies the input text into a lexer buffer before parsing.
+   * To avoid the copy, use `parse_buffer` with a buffer that has the required
+   * padding or use the `simd` lexer, which scans the text in place.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse(const calc_source& source, bool trace_lexer, bool trace_parser);
+
+  /**
+   * Parse a batch of in-memory inputs in order.
+   *
+   * All inputs share the same symbol table and parsing stops on first error.
+   *
+   * @param sources Pointer to first of `n_sources` inputs
+   * @param n_sources Number of inputs
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse(
+    const calc_source* sources,
+    std::size_t n_sources,
+    bool enable_trace = false)
+  {
+    return parse(sources, n_sources, enable_trace, enable_trace);
+  }
+
+  /**
+   * Parse a batch of in-memory inputs in order.
+   *
+   * All inputs share the same symbol table and parsing stops on first error.
+   *
+   * @param sources Pointer to first of `n_sources` inputs
+   * @param n_sources Number of inputs
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse(
+    const calc_source* sources,
+    std::size_t n_sources,
+    bool trace_lexer,
+    bool trace_parser);
+
+  /**
+   * Number of null bytes required at the end of a `parse_buffer` buffer.
+   */
+  static constexpr std::size_t buffer_padding = 2;
+
+  /**
+   * Parse the specified writable in-memory buffer without copying.
+   *
+   * The last `buffer_padding` bytes of the buffer must be null and are not
+   * part of the input. The lexer scans the buffer in place and may modify its
+   * contents during parsing, so it should be treated as scratch space.
+   *
+   * @param buffer Buffer of `size` bytes ending with `buffer_padding` nulls
+   * @param size Buffer size, including the padding
+   * @param name Name used for the input in error locations
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_buffer(
+    char* buffer,
+    std::size_t size,
+    std::string_view name,
+    bool enable_trace = false)
+  {
+    return parse_buffer(buffer, size, name, enable_trace, enable_trace);
+  }
+
+  /**
+   * Parse the specified writable in-memory buffer without copying.
+   *
+   * The last `buffer_padding` bytes of the buffer must be null and are not
+   * part of the input. The lexer scans the buffer in place and may modify its
+   * contents during parsing, so it should be treated as scratch space.
+   *
+   * @param buffer Buffer of `size` bytes ending with `buffer_padding` nulls
+   * @param size Buffer size, including the padding
+   * @param name Name used for the input in error locations
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_buffer(
+    char* buffer,
+    std::size_t size,
+    std::string_view name,
+    bool trace_lexer,
+    bool trace_parser);
+
+  /**
+   * Compile the specified input file without evaluating it.
+   *
+   * Identifier types are determined from the current symbols and from the
+   * assignments in the input. Symbols do not need to have values until the
+   * program is evaluated with `run`.
+   *
+   * @param input_file File to read input from, empty or "-" for `stdin`
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(
+    const std::filesystem::path& input_file, bool enable_trace = false)
+  {
+    return compile(input_file, enable_trace, enable_trace);
+  }
+
+  /**
+   * Compile the specified input file without evaluating it.
+   *
+   * @param input_file File to read input from, empty or "-" for `stdin`
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(
+    const std::filesystem::path& input_file,
+    bool trace_lexer,
+    bool trace_parser);
+
+  /**
+   * Compile the specified in-memory input without evaluating it.
+   *
+   * @param source Input text and name
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(const calc_source& source, bool enable_trace = false)
+  {
+    return compile(source, enable_trace, enable_trace);
+  }
+
+  /**
+   * Compile the specified in-memory input without evaluating it.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(const calc_source& source, bool trace_lexer, bool trace_parser);
+
+  /**
+   * Evaluate the program from the last parse or compile.
+   *
+   * Statements are evaluated in order against the current symbols, writing
+   * output to the sink, and evaluation stops on the first error.
+   *
+   * @returns `true` on success, `false` on failure
+   */
+  bool run();
+
+  /**
+   * Evaluate the program from the last parse or compile over columns of rows.
+   *
+   * Each row is evaluated as if the input column values were bound to their
+   * symbols before running the program, with the values of the output column
+   * symbols after the program written to the output columns. Symbols without
+   * an input column are read from the current symbols. Since identifier types
+   * are fixed when compiling, input column symbols must be added with values
+   * of the column types before the program is compiled.
+   *
+   * Rows are evaluated in blocks, one operation at a time over each block, so
+   * that the element-wise loops can be vectorized. Only the statements needed
+   * for the output columns are evaluated, nothing is written to the sink, and
+   * the current symbols are not modified.
+   *
+   * @param inputs Pointer to first of `n_inputs` input columns
+   * @param n_inputs Number of input columns
+   * @param outputs Pointer to first of `n_outputs` output columns
+   * @param n_outputs Number of output columns
+   * @param n_rows Number of rows in each column
+   * @returns `true` on success, `false` on failure
+   */
+  bool run_columns(
+    const calc_input_column* inputs,
+    std::size_t n_inputs,
+    const calc_output_column* outputs,
+    std::size_t n_outputs,
+    std::size_t n_rows);
+
+  /**
+   * Assign the value of a single-expression program to a symbol.
+   *
+   * The program from the last compile must be exactly one statement printing
+   * an expression, ignoring empty statements. It is changed to assign the
+   * value to the symbol instead, e.g. so that `run_columns` can write the
+   * value of an expression to an output column.
+   *
+   * @param iden Symbol identifier
+   * @returns `true` on success, `false` if the program is not a single
+   *  expression
+   */
+  bool assign_result(std::string_view iden);
+
+  /**
+   * Compile and evaluate in-memory input for later recomputation.
+   *
+   * The input text is copied and the symbols each statement reads and writes
+   * are recorded. The statements are then evaluated in order, appending the
+   * value each statement prints or assigns to `results` instead of writing to
+   * the sink. Evaluation stops on the first error.
+   *
+   * After rebinding symbols with `add_symbol`, `recompute` evaluates only the
+   * statements depending on them. Any other parse or compile discards the
+   * loaded program.
+   *
+   * @param source Input text and name
+   * @param results Vector to append the statement results to
+   * @returns `true` on success, `false` on failure
+   */
+  bool load(const calc_source& source, std::vector<calc_result>& results);
+
+  /**
+   * Evaluate the statements of the loaded program affected by rebinding.
+   *
+   * Statements are evaluated in order if they read a symbol rebound with
+   * `add_symbol` since the last load or recompute, read a symbol assigned a
+   * different value by a statement evaluated before them, or assign a
+   * rebound symbol, as they would overwrite it when running the program. The
+   * value each evaluated statement prints or assigns is appended to `results`
+   * instead of being written to the sink. The results, symbol values, and
+   * errors are those of running the whole program again.
+   *
+   * If a symbol the program reads as input is rebound with a different type,
+   * the program is first compiled again from the loaded text. This fails if
+   * the statements do not compile with the new type, e.g. using a `double`
+   * symbol as an operand of `%`. After a failure, the next recompute
+   * evaluates all statements.
+   *
+   * @param results Vector to append the statement results to
+   * @returns `true` on success, `false` on failure
+   */
+  bool recompute(std::vector<calc_result>& results);
+
+  /**
+   * Add a symbol, replacing the value of any existing symbol.
+   *
+   * @param iden Symbol identifier
+   * @param value Symbol value
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& add_symbol(std::string_view iden, calc_symbol::value_type value);
+
+  /**
+   * Get a pointer to the symbol if it exists and return `nullptr` otherwise.
+   *
+   * The pointer remains valid for the lifetime of the parser. Adding the
+   * symbol again or evaluating a statement assigning to the symbol updates
+   * the value it points to in place.
+   *
+   * @param iden Symbol identifier
+   */
+  const calc_symbol* get_symbol(std::string_view iden) const;
+
+  /**
+   * Return the type a symbol has after the program from the last parse or
+   * compile.
+   *
+   * This is the type of the last statement of the program assigning to the
+   * symbol, or the type of the current symbol if no statement assigns to it.
+   * As identifier types are fixed when compiling, this is the type of the
+   * output column `run_columns` requires for the symbol.
+   *
+   * @param iden Symbol identifier
+   * @returns Index of the type in `calc_symbol::value_type`, or
+   *  `std::variant_npos` if the symbol is neither assigned nor defined
+   */
+  std::size_t symbol_type(std::string_view iden) const;
+
+  /**
+   * Return the identifier that caused the syntax error of the last parse or
+   * compile by being read before it was assigned.
+   *
+   * An identifier that is neither a symbol nor assigned earlier in the input
+   * can only be assigned, so reading it is a syntax error. This lets callers
+   * that bind symbols for the input, e.g. from columns, report what is missing.
+   *
+   * @returns Identifier, empty if there was no such syntax error
+   */
+  std::string_view unbound_symbol() const noexcept;
+
+  /**
+   * Write a snapshot of all symbols and the input position to a file.
+   *
+   * The snapshot is a compact binary file that replaces any existing file
+   * only once it is completely written.
+   *
+   * @param path Snapshot file path
+   * @returns `true` on success, `false` on failure
+   */
+  bool save_snapshot(const std::filesystem::path& path);
+
+  /**
+   * Add the symbols of a snapshot and resume from its input position.
+   *
+   * The snapshot is memory-mapped where possible and is rejected as a whole
+   * if it is truncated or corrupt. Symbols are added with `add_symbol` so
+   * existing symbols not in the snapshot are kept. The input position is set
+   * as with `position`.
+   *
+   * @param path Snapshot file path
+   * @returns `true` on success, `false` on failure
+   */
+  bool restore_snapshot(const std::filesystem::path& path);
+
+  /**
+   * Return the input position reached.
+   *
+   * Each input successfully parsed counts as one input and during a parse the
+   * position is updated after each statement is evaluated. Inputs that are
+   * only compiled, run, or loaded do not change the position.
+   */
+  calc_position position() const noexcept;
+
+  /**
+   * Set the input position, e.g. to resume an interrupted run.
+   *
+   * Error locations of the next parse start from the position line and
+   * column, so it should be given the remainder of the input text from
+   * `calc_position_offset`. Later parses start from line 1 again.
+   *
+   * @param position Input position
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& position(const calc_position& position) noexcept;
+
+  /**
+   * Return the file checkpoints are written to, empty if not checkpointing.
+   */
+  const std::filesystem::path& checkpoint_path() const noexcept;
+
+  /**
+   * Return the number of statements evaluated between checkpoints.
+   */
+  std::uint64_t checkpoint_interval() const noexcept;
+
+  /**
+   * Set where and how often checkpoints are written during parsing.
+   *
+   * A checkpoint is a snapshot written as with `save_snapshot` after every
+   * `interval` statements evaluated while parsing and after each input is
+   * successfully parsed. Buffered output is written and the sink flushed
+   * before each checkpoint so that the output up to its position is complete.
+   * Failing to write a checkpoint fails the parse.
+   *
+   * @param path Checkpoint file path, empty to disable checkpoints
+   * @param interval Statements between checkpoints, zero for only at the end
+   *  of each input
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& checkpoint(
+    const std::filesystem::path& path, std::uint64_t interval);
+
   /**
    * Parse input from `stdin`.
    *
@@ -157,11 +1038,285 @@ public:
     return parse(input_file, trace_lexer, trace_parser);
   }
 
+  /**
+   * Parse the specified in-memory input.
+   *
+   * @param source Input text and name
+   * @param enable_trace `true` to enable lexer and parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  auto operator()(const calc_source& source, bool enable_trace = false)
+  {
+    return parse(source, enable_trace);
+  }
+
+  /**
+   * Parse the specified in-memory input.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  auto operator()(
+    const calc_source& source, bool trace_lexer, bool trace_parser)
+  {
+    return parse(source, trace_lexer, trace_parser);
+  }
+
+  /**
+   * Return how input files are read by the lexer.
+   */
+  calc_input_mode input_mode() const noexcept;
+
+  /**
+   * Set how input files are read by the lexer.
+   *
+   * The default is `calc_input_mode::stdio`. Only file inputs are affected.
+   *
+   * @param mode Input mode
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& input_mode(calc_input_mode mode) noexcept;
+
+  /**
+   * Return which lexer turns input into tokens.
+   */
+  calc_lexer lexer() const noexcept;
+
+  /**
+   * Set which lexer turns input into tokens.
+   *
+   * The default is `calc_lexer::flex`. Results and errors are the same for
+   * all lexers.
+   *
+   * @param lexer Lexer
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& lexer(calc_lexer lexer) noexcept;
+
+  /**
+   * Return how compiled statements are evaluated.
+   */
+  calc_backend backend() const noexcept;
+
+  /**
+   * Set how compiled statements are evaluated.
+   *
+   * The default is `calc_backend::vm`. All backends give the same results.
+   *
+   * @param backend Evaluation backend
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& backend(calc_backend backend) noexcept;
+
+  /**
+   * Return `true` if statements are optimized as they are compiled.
+   */
+  bool optimize() const noexcept;
+
+  /**
+   * Set whether statements are optimized as they are compiled.
+   *
+   * The default is `true`. Optimization folds constants, simplifies
+   * arithmetic, and eliminates common subexpressions without changing any
+   * results or errors. Only statements compiled afterwards are affected.
+   *
+   * @param enable `true` to optimize statements
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& optimize(bool enable) noexcept;
+
+  /**
+   * Return `true` if parsing continues after a statement fails.
+   */
+  bool keep_going() const noexcept;
+
+  /**
+   * Set whether parsing continues after a statement fails.
+   *
+   * The default is `false`, which stops parsing at the first error. When
+   * enabled, a statement with a lexer or syntax error is skipped up to the
+   * next `;` and a statement that fails to evaluate is skipped, writing
+   * `<error>` to the sink in place of any result. Each error is collected in
+   * `errors` and the rest of the input is parsed as usual. The parse still
+   * returns `false` if any statement failed. Only inputs that are evaluated
+   * as they are parsed are recovered, not inputs compiled with `load`.
+   *
+   * @param enable `true` to continue parsing after a statement fails
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& keep_going(bool enable) noexcept;
+
+  /**
+   * Return when buffered statement output is written to the sink.
+   */
+  calc_flush_policy flush_policy() const noexcept;
+
+  /**
+   * Set when buffered statement output is written to the sink.
+   *
+   * The default is `calc_flush_policy::statement`, which writes every result
+   * to the sink as soon as it is evaluated. The other policies write fewer,
+   * larger chunks and flush the sink less often.
+   *
+   * @param policy Flush policy
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& flush_policy(calc_flush_policy policy) noexcept;
+
+  /**
+   * Return the buffered byte count written at once with `bytes` flush policy.
+   */
+  std::size_t flush_bytes() const noexcept;
+
+  /**
+   * Set the buffered byte count written at once with `bytes` flush policy.
+   *
+   * The default is 65536. Also sets the flush policy to `bytes`.
+   *
+   * @param n_bytes Number of bytes, where zero writes every statement
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& flush_bytes(std::size_t n_bytes) noexcept;
+
+  /**
+   * Return how `double` statement results are formatted.
+   */
+  calc_double_format double_format() const noexcept;
+
+  /**
+   * Set how `double` statement results are formatted.
+   *
+   * The default is `calc_double_format::general`, which uses the precision of
+   * the sink so output is the same as writing the value to the sink.
+   *
+   * @param format Double format
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& double_format(calc_double_format format) noexcept;
+
+  /**
+   * Return the maximum number of inputs kept in the statement cache.
+   */
+  std::size_t cache_capacity() const noexcept;
+
+  /**
+   * Set the maximum number of inputs kept in the statement cache.
+   *
+   * The default is zero, which disables the cache. The cache maps the text of
+   * in-memory inputs parsed with `parse`, with comments and any whitespace
+   * not separating tokens removed, to their compiled programs. Parsing text
+   * found in the cache evaluates its program without lexing or parsing, as
+   * long as each symbol the program reads before assigning it has the same
+   * type as when it was compiled. Otherwise, the text is compiled again and
+   * replaces the entry. The least recently used entry is evicted when the
+   * cache is full.
+   *
+   * Results, errors, and their locations are the same with or without the
+   * cache. Inputs over 64 KiB, inputs parsed with tracing, and inputs resumed
+   * from a position are not cached. Changing whether statements are optimized
+   * empties the cache.
+   *
+   * @param capacity Maximum number of cached inputs, zero to disable
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& cache_capacity(std::size_t capacity);
+
+  /**
+   * Return the memory resource all memory is allocated from.
+   */
+  std::pmr::memory_resource* memory_resource() const noexcept;
+
+  /**
+   * Return `true` if each parse or compile allocates from an arena.
+   */
+  bool arena() const noexcept;
+
+  /**
+   * Set whether each parse or compile allocates from an arena.
+   *
+   * The default is `false`. When enabled, the compiled program and all other
+   * per-parse state is allocated from a monotonic arena on top of the memory
+   * resource that is never freed piecemeal and is instead released all at
+   * once when the next parse or compile starts. Takes effect from the next
+   * parse or compile.
+   *
+   * @param enable `true` to allocate each parse from an arena
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& arena(bool enable) noexcept;
+
+  /**
+   * Return `true` if performance counters are collected.
+   */
+  bool stats_enabled() const noexcept;
+
+  /**
+   * Set whether performance counters are collected.
+   *
+   * The default is `false`, in which case collection costs no more than a
+   * branch per token and statement. Counters are kept when collection is
+   * disabled and accumulate again when it is enabled.
+   *
+   * @param enable `true` to collect performance counters
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& stats(bool enable) noexcept;
+
+  /**
+   * Return the performance counters collected so far.
+   */
+  const calc_stats& stats() const noexcept;
+
+  /**
+   * Reset all performance counters to zero.
+   *
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser& reset_stats() noexcept;
+
+  /**
+   * Read the tokens of an in-memory input without parsing it.
+   *
+   * This runs the selected lexer exactly as parsing does, including typing
+   * identifiers by the current symbols, so the lexers can be checked against
+   * each other and timed on their own. The program from the last parse or
+   * compile is discarded.
+   *
+   * @param source Input text and name
+   * @param visitor Visitor receiving each token, ending with the end of input
+   * @returns `true` on success, `false` on a lexer error
+   */
+  bool lex(const calc_source& source, calc_token_visitor& visitor);
+
+  /**
+   * Write each statement of the program from the last parse or compile.
+   *
+   * Each statement expression is written as an S-expression prefixed with the
+   * statement location, followed by the optimized expression on the next line
+   * if optimization changed the expression.
+   *
+   * @param out Stream to write to
+   */
+  void dump_program(std::ostream& out) const;
+
   /**
    * Return the last error encountered by the parser.
    */
   const std::string& last_error() const noexcept;
 
+  /**
+   * Return the errors of the statements that failed in the last parse.
+   *
+   * Errors are in input order and are only collected when `keep_going` is
+   * enabled. The last error, formatted with its location, is also the
+   * `last_error` unless the parse failed for another reason, e.g. the input
+   * could not be read. Input names view the parser's copy of the name, which
+   * is valid until the next parse.
+   */
+  const std::vector<calc_error>& errors() const noexcept;
+
 private:
   // if requested, use raw instead of STL unique_ptr to support PIMPL
 #if defined(PDCALC_RAW_PIMPL)
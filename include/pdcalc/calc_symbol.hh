@@ -61,6 +61,13 @@ public:
    */
   const auto& value() const noexcept { return value_; }
 
+  /**
+   * Replace the variant value for the symbol.
+   *
+   * @param value New symbol value
+   */
+  void value(value_type value) noexcept { value_ = std::move(value); }
+
   /**
    * Get a pointer to the held alternative if contained otherwise `nullptr`.
    *
@@ -30,6 +30,12 @@
 #endif  // PDCALC_CPLUSPLUS > 202302L
 #endif  // __cplusplus
 
+// GNU labels as values extension used for computed goto dispatch. this is
+// supported by GCC and Clang but not by MSVC
+#if defined(__GNUC__) || defined(__clang__)
+#define PDCALC_HAS_COMPUTED_GOTO 1
+#endif  // !defined(__GNUC__) && !defined(__clang__)
+
 // always defined if this header is included
 #ifndef PDCALC_HAS_CC17
 #define PDCALC_HAS_CC17 0
@@ -43,5 +49,8 @@
 #ifndef PDCALC_HAS_CC26
 #define PDCALC_HAS_CC26 0
 #endif  // PDCALC_HAS_CC26
+#ifndef PDCALC_HAS_COMPUTED_GOTO
+#define PDCALC_HAS_COMPUTED_GOTO 0
+#endif  // PDCALC_HAS_COMPUTED_GOTO
 
 #endif  // PDCALC_FEATURES_H_
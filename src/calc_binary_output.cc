@@ -0,0 +1,86 @@
+/**
+ * @file calc_binary_output.cc
+ * @author Derek Huang
+ * @brief C++ source for the pdcalc binary result writer
+ * @copyright MIT License
+ */
+
+#include "calc_binary_output.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <ostream>
+#include <string_view>
+#include <variant>
+
+#include "pdcalc/calc_binary_format.hh"
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+
+namespace pdcalc {
+
+void calc_binary_output::write_header(std::ostream& sink, std::uint32_t flags)
+{
+  char header[calc_binary_header_size];
+  calc_binary_encode(header, flags);
+  sink.write(header, sizeof header);
+}
+
+void calc_binary_output::visit(
+  std::size_t statement,
+  const calc_location& location,
+  const calc_symbol::value_type& value)
+{
+  calc_binary_record record{
+    static_cast<calc_binary_tag>(value.index()),
+    0,
+    location.begin_line,
+    statement
+  };
+  if (auto b = std::get_if<bool>(&value))
+    record.bits = *b;
+  else if (auto l = std::get_if<long>(&value))
+    record.bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(*l));
+  else
+    record.bits = calc_binary_bits(std::get<double>(value));
+  append(record);
+}
+
+void calc_binary_output::visit_error(
+  std::size_t statement,
+  const calc_location& location,
+  std::string_view message)
+{
+  (void) message;
+  append({calc_binary_tag::error, 0, location.begin_line, statement});
+}
+
+void calc_binary_output::flush()
+{
+  if (!buffer_.empty()) {
+    sink_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+  sink_.flush();
+}
+
+void calc_binary_output::append(const calc_binary_record& record)
+{
+  auto offset = buffer_.size();
+  buffer_.resize(offset + calc_binary_record_size(flags_));
+  calc_binary_encode(buffer_.data() + offset, record, flags_);
+  switch (flush_policy_) {
+    case calc_flush_policy::statement:
+      flush();
+      break;
+    case calc_flush_policy::bytes:
+      if (buffer_.size() >= flush_bytes_)
+        flush();
+      break;
+    case calc_flush_policy::end:
+      break;
+  }
+}
+
+}  // namespace pdcalc
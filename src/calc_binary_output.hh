@@ -0,0 +1,127 @@
+/**
+ * @file calc_binary_output.hh
+ * @author Derek Huang
+ * @brief C++ header for the pdcalc binary result writer
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_BINARY_OUTPUT_HH_
+#define PDCALC_CALC_BINARY_OUTPUT_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "pdcalc/calc_binary_format.hh"
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+
+namespace pdcalc {
+
+/**
+ * Buffered writer of statement results as binary records.
+ *
+ * Records are laid out as described in `calc_binary_format.hh` and buffered
+ * until written according to the flush policy, like the text output of a
+ * parser. Only records are written, so that the output of several writers
+ * can follow a single header written with `write_header`.
+ */
+class calc_binary_output final : public calc_result_visitor {
+public:
+  /**
+   * Default number of buffered bytes written at once with `bytes` policy.
+   */
+  static constexpr std::size_t default_flush_bytes = 1 << 16;
+
+  /**
+   * Ctor.
+   *
+   * @param sink Stream to write to
+   * @param flags Format flags
+   */
+  calc_binary_output(std::ostream& sink, std::uint32_t flags) noexcept
+    : sink_{sink}, flags_{flags}
+  {}
+
+  /**
+   * Write a header to a stream.
+   *
+   * @param sink Stream to write to
+   * @param flags Format flags
+   */
+  static void write_header(std::ostream& sink, std::uint32_t flags);
+
+  /**
+   * Return the format flags.
+   */
+  auto flags() const noexcept { return flags_; }
+
+  /**
+   * Set when buffered output is written to the sink.
+   *
+   * @param policy Flush policy
+   */
+  void flush_policy(calc_flush_policy policy) noexcept
+  {
+    flush_policy_ = policy;
+  }
+
+  /**
+   * Set the number of buffered bytes written at once with `bytes` policy.
+   *
+   * @param n_bytes Number of bytes, where zero writes every statement
+   */
+  void flush_bytes(std::size_t n_bytes) noexcept { flush_bytes_ = n_bytes; }
+
+  /**
+   * Write a statement result.
+   *
+   * @param statement Statement index in program order
+   * @param location Statement location
+   * @param value Result value
+   */
+  void visit(
+    std::size_t statement,
+    const calc_location& location,
+    const calc_symbol::value_type& value) override;
+
+  /**
+   * Write the record of a statement that failed.
+   *
+   * The record has the `error` tag, a zero value, the line the error starts
+   * on, and the statement index.
+   *
+   * @param statement Statement index in program order
+   * @param location Error location
+   * @param message Error message without the location
+   */
+  void visit_error(
+    std::size_t statement,
+    const calc_location& location,
+    std::string_view message) override;
+
+  /**
+   * Write any buffered output to the sink and flush the sink.
+   */
+  void flush() override;
+
+private:
+  std::ostream& sink_;                            // stream to write to
+  std::uint32_t flags_;                           // format flags
+  std::string buffer_;                            // buffered records
+  calc_flush_policy flush_policy_{};              // when to write to sink
+  std::size_t flush_bytes_{default_flush_bytes};  // bytes buffered to write
+
+  /**
+   * Append a record, writing buffered output if required by the policy.
+   *
+   * @param record Record
+   */
+  void append(const calc_binary_record& record);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_BINARY_OUTPUT_HH_
@@ -0,0 +1,382 @@
+/**
+ * @file calc_bytecode.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator register VM bytecode
+ * @copyright MIT License
+ */
+
+#include "calc_bytecode.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return opcode for a unary or binary operation on the given operand type.
+ *
+ * @param op Node operation
+ * @param type Operand type
+ */
+calc_opcode operation_opcode(calc_op op, calc_value_type type)
+{
+  // opcode indexed by operand type, i.e. bool, long, double
+  auto typed = [type](calc_opcode b, calc_opcode l, calc_opcode d)
+  {
+    switch (type) {
+      case calc_value_type::boolean:
+        return b;
+      case calc_value_type::integral:
+        return l;
+      default:
+        return d;
+    }
+  };
+  switch (op) {
+    // unary operations. note bool alternatives are never selected
+    case calc_op::to_double:
+      return calc_opcode::to_double;
+    case calc_op::negate:
+      return typed(calc_opcode::neg_l, calc_opcode::neg_l, calc_opcode::neg_d);
+    case calc_op::bit_not:
+      return calc_opcode::bit_not_l;
+    case calc_op::logical_not:
+      return calc_opcode::not_b;
+    case calc_op::exp:
+      return calc_opcode::exp_d;
+    case calc_op::log:
+      return calc_opcode::log_d;
+    case calc_op::log2:
+      return calc_opcode::log2_d;
+    case calc_op::log10:
+      return calc_opcode::log10_d;
+    case calc_op::sqrt:
+      return calc_opcode::sqrt_d;
+    case calc_op::sin:
+      return calc_opcode::sin_d;
+    case calc_op::cos:
+      return calc_opcode::cos_d;
+    case calc_op::tan:
+      return calc_opcode::tan_d;
+    // binary arithmetic operations
+    case calc_op::add:
+      return typed(calc_opcode::add_l, calc_opcode::add_l, calc_opcode::add_d);
+    case calc_op::subtract:
+      return typed(calc_opcode::sub_l, calc_opcode::sub_l, calc_opcode::sub_d);
+    case calc_op::multiply:
+      return typed(calc_opcode::mul_l, calc_opcode::mul_l, calc_opcode::mul_d);
+    case calc_op::divide:
+      return typed(calc_opcode::div_l, calc_opcode::div_l, calc_opcode::div_d);
+    case calc_op::modulo:
+      return calc_opcode::mod_l;
+    case calc_op::bit_and:
+      return calc_opcode::and_l;
+    case calc_op::bit_xor:
+      return calc_opcode::xor_l;
+    case calc_op::bit_or:
+      return calc_opcode::or_l;
+    case calc_op::lshift:
+      return calc_opcode::shl_l;
+    case calc_op::rshift:
+      return calc_opcode::shr_l;
+    case calc_op::max:
+      return typed(calc_opcode::max_l, calc_opcode::max_l, calc_opcode::max_d);
+    case calc_op::min:
+      return typed(calc_opcode::min_l, calc_opcode::min_l, calc_opcode::min_d);
+    // binary comparison + logical operations
+    case calc_op::equal:
+      return typed(calc_opcode::eq_b, calc_opcode::eq_l, calc_opcode::eq_d);
+    case calc_op::not_equal:
+      return typed(calc_opcode::ne_b, calc_opcode::ne_l, calc_opcode::ne_d);
+    case calc_op::less:
+      return typed(calc_opcode::lt_l, calc_opcode::lt_l, calc_opcode::lt_d);
+    case calc_op::greater:
+      return typed(calc_opcode::gt_l, calc_opcode::gt_l, calc_opcode::gt_d);
+    case calc_op::less_equal:
+      return typed(calc_opcode::le_l, calc_opcode::le_l, calc_opcode::le_d);
+    case calc_op::greater_equal:
+      return typed(calc_opcode::ge_l, calc_opcode::ge_l, calc_opcode::ge_d);
+    case calc_op::logical_and:
+      return calc_opcode::and_b;
+    case calc_op::logical_or:
+      return calc_opcode::or_b;
+    default:
+      throw std::logic_error{"Expression node has no VM opcode"};
+  }
+}
+
+}  // namespace
+
+/**
+ * Compile the statements of the program not yet compiled.
+ *
+ * Statements whose expressions need more registers than an instruction can
+ * address are left without any instructions.
+ *
+ * @param program Program to compile
+ */
+void calc_bytecode::compile(const calc_program& program)
+{
+  const auto& statements = program.statements();
+  for (auto i = offsets_.size(); i < statements.size(); i++) {
+    const auto& stmt = statements[i];
+    auto begin = code_.size();
+    offsets_.push_back(static_cast<std::uint32_t>(begin));
+    // shared node registers follow the stack registers
+    shared_.clear();
+    std::pmr::unordered_map<std::uint32_t, std::uint32_t> depths{
+      code_.get_allocator().resource()
+    };
+    next_shared_ = share(program, stmt.root, depths);
+    // statement value is always in register 0 as the root is never shared
+    auto n_registers = n_registers_;
+    if (!compile(program, stmt.root)) {
+      code_.resize(begin);
+      while (divisions_.size() && divisions_.back().first >= begin)
+        divisions_.pop_back();
+      n_registers_ = n_registers;
+      continue;
+    }
+    auto type = program.nodes()[stmt.root].type;
+    if (stmt.kind == calc_statement_kind::print) {
+      switch (type) {
+        case calc_value_type::boolean:
+          emit(calc_opcode::print_b, 0, 0);
+          break;
+        case calc_value_type::integral:
+          emit(calc_opcode::print_l, 0, 0);
+          break;
+        case calc_value_type::floating:
+          emit(calc_opcode::print_d, 0, 0);
+          break;
+      }
+    }
+    else {
+      switch (type) {
+        case calc_value_type::boolean:
+          emit(calc_opcode::store_b, 0, 0, stmt.name);
+          break;
+        case calc_value_type::integral:
+          emit(calc_opcode::store_l, 0, 0, stmt.name);
+          break;
+        case calc_value_type::floating:
+          emit(calc_opcode::store_d, 0, 0, stmt.name);
+          break;
+      }
+    }
+  }
+}
+
+/**
+ * Return the index of the node a division instruction was compiled from.
+ *
+ * @param offset Division instruction offset
+ */
+std::uint32_t calc_bytecode::division_node(std::uint32_t offset) const noexcept
+{
+  auto it = std::lower_bound(
+    divisions_.begin(),
+    divisions_.end(),
+    offset,
+    [](const auto& division, auto value) { return division.first < value; }
+  );
+  return it->second;
+}
+
+/**
+ * Find the nodes of an expression used more than once.
+ *
+ * The number of stack registers needed is computed as if no node was shared
+ * so it is an upper bound regardless of which use computes a shared node.
+ *
+ * Nodes are visited in the same order as a recursive walk, left operands
+ * first, but with an explicit stack so long expressions cannot overflow the
+ * call stack.
+ *
+ * @param program Program containing the expression
+ * @param index Expression root node index
+ * @param depths Stack registers needed by each node visited so far
+ * @returns Number of stack registers needed to compile the expression
+ */
+std::uint32_t calc_bytecode::share(
+  const calc_program& program,
+  std::uint32_t index,
+  std::pmr::unordered_map<std::uint32_t, std::uint32_t>& depths)
+{
+  const auto& nodes = program.nodes();
+  frames_.clear();
+  frames_.push_back({index, 0, 0, 0});
+  while (frames_.size()) {
+    auto& top = frames_.back();
+    const auto& node = nodes[top.index];
+    // a node visited before is shared
+    if (!top.operands && depths.count(top.index)) {
+      shared_.emplace(top.index, no_register);
+      frames_.pop_back();
+      continue;
+    }
+    // push operands right first so that the left operand is visited first
+    if (!top.operands && !calc_is_leaf(node.op)) {
+      top.operands = 1;
+      if (calc_is_binary(node.op))
+        frames_.push_back({node.right, 0, 0, 0});
+      frames_.push_back({node.left, 0, 0, 0});
+      continue;
+    }
+    std::uint32_t depth = 1;
+    if (calc_is_binary(node.op))
+      depth = std::max(depths[node.left], depths[node.right] + 1);
+    else if (!calc_is_leaf(node.op))
+      depth = depths[node.left];
+    depths.emplace(top.index, depth);
+    frames_.pop_back();
+  }
+  return depths[index];
+}
+
+/**
+ * Compile an expression into stack register 0.
+ *
+ * Each operand is compiled into the destination stack register of its node,
+ * with the second operand of a binary operation in the register after it, so
+ * the registers used are bounded by the expression depth. As with `share`,
+ * nodes are visited with an explicit stack instead of recursion.
+ *
+ * @param program Program containing the expression
+ * @param index Expression root node index, which must not be shared
+ * @returns `true` on success, `false` if too many registers are needed
+ */
+bool calc_bytecode::compile(const calc_program& program, std::uint32_t index)
+{
+  // registers are 16-bit. the stack registers are bounded by the expression
+  // depth and shared node registers by the number of nodes
+  constexpr std::uint32_t max_registers =
+    std::numeric_limits<std::uint16_t>::max();
+  if (next_shared_ >= max_registers)
+    return false;
+  const auto& nodes = program.nodes();
+  frames_.clear();
+  values_.clear();
+  frames_.push_back({index, 0, 0, 0});
+  while (frames_.size()) {
+    auto& top = frames_.back();
+    const auto& node = nodes[top.index];
+    // first visit. shared nodes are computed into their own register on
+    // first use. the stack registers from dst on are still used for their
+    // operands
+    if (!top.operands) {
+      auto shared = shared_.find(top.index);
+      top.out = top.dst;
+      if (shared != shared_.end()) {
+        if (shared->second != no_register) {
+          values_.push_back(shared->second);
+          frames_.pop_back();
+          continue;
+        }
+        top.out = shared->second = next_shared_++;
+      }
+      if (std::max(top.dst, top.out) + 1 >= max_registers)
+        return false;
+      n_registers_ = std::max(n_registers_, std::max(top.dst, top.out) + 1);
+    }
+    switch (node.op) {
+      // leaves
+      case calc_op::literal:
+        switch (node.type) {
+          case calc_value_type::boolean:
+            emit(calc_opcode::const_b, top.out, node.left, node.right);
+            break;
+          case calc_value_type::integral:
+            emit(calc_opcode::const_l, top.out, node.left, node.right);
+            break;
+          case calc_value_type::floating:
+            emit(calc_opcode::const_d, top.out, node.left, node.right);
+            break;
+        }
+        break;
+      case calc_op::symbol:
+        switch (node.type) {
+          case calc_value_type::boolean:
+            emit(calc_opcode::load_b, top.out, node.left);
+            break;
+          case calc_value_type::integral:
+            emit(calc_opcode::load_l, top.out, node.left);
+            break;
+          case calc_value_type::floating:
+            emit(calc_opcode::load_d, top.out, node.left);
+            break;
+        }
+        break;
+      // unary operations are done in place unless the operand is shared
+      case calc_op::to_double:
+      case calc_op::negate:
+      case calc_op::bit_not:
+      case calc_op::logical_not:
+      case calc_op::exp:
+      case calc_op::log:
+      case calc_op::log2:
+      case calc_op::log10:
+      case calc_op::sqrt:
+      case calc_op::sin:
+      case calc_op::cos:
+      case calc_op::tan: {
+        if (!top.operands++) {
+          frames_.push_back({node.left, top.dst, 0, 0});
+          continue;
+        }
+        auto a = values_.back();
+        values_.pop_back();
+        emit(operation_opcode(node.op, nodes[node.left].type), top.out, a);
+        break;
+      }
+      // binary operations use the next register for the second operand
+      default: {
+        if (top.operands < 2) {
+          auto right = top.operands++ == 1;
+          auto dst = top.dst + right;
+          frames_.push_back({right ? node.right : node.left, dst, 0, 0});
+          continue;
+        }
+        auto b = values_.back();
+        values_.pop_back();
+        auto a = values_.back();
+        values_.pop_back();
+        // divisions can fail, so their nodes are kept for error reporting
+        if (node.op == calc_op::divide)
+          divisions_.emplace_back(
+            static_cast<std::uint32_t>(code_.size()), top.index
+          );
+        emit(operation_opcode(node.op, nodes[node.left].type), top.out, a, b);
+        break;
+      }
+    }
+    // node value is the operand value of the node using it
+    values_.push_back(top.out);
+    frames_.pop_back();
+  }
+  return true;
+}
+
+/**
+ * Append an instruction.
+ *
+ * @param op Opcode
+ * @param dst Destination register
+ * @param a First operand
+ * @param b Second operand
+ */
+void calc_bytecode::emit(
+  calc_opcode op, std::uint32_t dst, std::uint32_t a, std::uint32_t b)
+{
+  code_.push_back({op, static_cast<std::uint16_t>(dst), a, b});
+}
+
+}  // namespace pdcalc
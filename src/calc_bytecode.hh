@@ -0,0 +1,247 @@
+/**
+ * @file calc_bytecode.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator register VM bytecode
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_BYTECODE_HH_
+#define PDCALC_CALC_BYTECODE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "calc_program.hh"
+
+/**
+ * X-macro list of all the VM opcodes.
+ *
+ * Opcodes are typed, with suffix `_b`, `_l`, `_d` for operations on `bool`,
+ * `long`, and `double` registers respectively. Operand fields are documented
+ * using `dst` for the destination register and `a`, `b` for the two operand
+ * fields of `calc_instruction`.
+ *
+ * The list is used to define both the `calc_opcode` enumerators and the
+ * computed goto dispatch table, which must be in the same order.
+ *
+ * @param X Macro taking the opcode name
+ */
+#define PDCALC_VM_OPCODES(X) \
+  /* dst = literal with value bits a (low), b (high) */ \
+  X(const_b) X(const_l) X(const_d) \
+  /* dst = value of symbol with name index a */ \
+  X(load_b) X(load_l) X(load_d) \
+  /* dst = (double) a */ \
+  X(to_double) \
+  /* dst = op a */ \
+  X(neg_l) X(neg_d) X(bit_not_l) X(not_b) \
+  X(exp_d) X(log_d) X(log2_d) X(log10_d) X(sqrt_d) \
+  X(sin_d) X(cos_d) X(tan_d) \
+  /* dst = a op b */ \
+  X(add_l) X(sub_l) X(mul_l) X(div_l) X(mod_l) \
+  X(and_l) X(xor_l) X(or_l) X(shl_l) X(shr_l) X(max_l) X(min_l) \
+  X(add_d) X(sub_d) X(mul_d) X(div_d) X(max_d) X(min_d) \
+  X(eq_b) X(ne_b) X(and_b) X(or_b) \
+  X(eq_l) X(ne_l) X(lt_l) X(gt_l) X(le_l) X(ge_l) \
+  X(eq_d) X(ne_d) X(lt_d) X(gt_d) X(le_d) X(ge_d) \
+  /* print register a + end statement */ \
+  X(print_b) X(print_l) X(print_d) \
+  /* assign register a to symbol with name index b + end statement */ \
+  X(store_b) X(store_l) X(store_d)
+
+namespace pdcalc {
+
+/**
+ * VM opcode.
+ */
+enum class calc_opcode : std::uint8_t {
+#define PDCALC_VM_OPCODE_ENUMERATOR(name) name,
+  PDCALC_VM_OPCODES(PDCALC_VM_OPCODE_ENUMERATOR)
+#undef PDCALC_VM_OPCODE_ENUMERATOR
+};
+
+/**
+ * VM instruction.
+ *
+ * Every statement compiles into a sequence of instructions ending with a print
+ * or store instruction, which also ends execution of the statement.
+ */
+struct calc_instruction {
+  calc_opcode op;       // opcode
+  std::uint16_t dst;    // destination register
+  std::uint32_t a;      // first operand register, name index, or value bits
+  std::uint32_t b;      // second operand register, name index, or value bits
+};
+
+/**
+ * VM register.
+ *
+ * Registers are untyped as the opcodes determine the register types.
+ */
+union calc_register {
+  bool b;
+  long l;
+  double d;
+};
+
+/**
+ * Bytecode compiled from a `calc_program` for the register VM.
+ *
+ * Registers are allocated in stack order while compiling each expression
+ * tree, so the register count is bounded by the expression depth. Nodes used
+ * more than once by an optimized expression are instead given registers past
+ * the stack registers of the statement. These are computed on first use, in
+ * the same order as the unoptimized expression, and read by any later uses.
+ */
+class calc_bytecode {
+public:
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate the bytecode from
+   */
+  explicit calc_bytecode(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : code_{resource},
+      offsets_{resource},
+      divisions_{resource},
+      shared_{resource},
+      frames_{resource},
+      values_{resource}
+  {}
+
+  /**
+   * Clear all compiled code.
+   */
+  void clear() noexcept
+  {
+    code_.clear();
+    offsets_.clear();
+    divisions_.clear();
+    n_registers_ = 0;
+  }
+
+  /**
+   * Return the instructions.
+   */
+  const auto& code() const noexcept { return code_; }
+
+  /**
+   * Return the number of compiled statements.
+   */
+  auto size() const noexcept { return offsets_.size(); }
+
+  /**
+   * Return the offset of the first instruction of a compiled statement.
+   *
+   * @param index Statement index
+   */
+  auto offset(std::size_t index) const noexcept { return offsets_[index]; }
+
+  /**
+   * Return `true` if a statement has instructions.
+   *
+   * Statements whose expressions need more registers than an instruction can
+   * address have none and must be evaluated by walking their expressions.
+   *
+   * @param index Statement index
+   */
+  bool compiled(std::size_t index) const noexcept
+  {
+    auto end = (index + 1 < offsets_.size()) ?
+      offsets_[index + 1] : static_cast<std::uint32_t>(code_.size());
+    return offsets_[index] != end;
+  }
+
+  /**
+   * Return the index of the node a division instruction was compiled from.
+   *
+   * Used to report division by zero errors with the operands as written.
+   *
+   * @param offset Division instruction offset
+   */
+  std::uint32_t division_node(std::uint32_t offset) const noexcept;
+
+  /**
+   * Return the number of registers needed to run the compiled statements.
+   */
+  auto n_registers() const noexcept { return n_registers_; }
+
+  /**
+   * Compile the statements of the program not yet compiled.
+   *
+   * @param program Program to compile. Must be the same program that any
+   *  previously compiled statements were compiled from.
+   */
+  void compile(const calc_program& program);
+
+private:
+  static constexpr auto no_register = std::numeric_limits<std::uint32_t>::max();
+
+  std::pmr::vector<calc_instruction> code_;  // instructions
+  std::pmr::vector<std::uint32_t> offsets_;  // statement start offsets
+  // division instruction offsets with their node indices, in offset order
+  std::pmr::vector<std::pair<std::uint32_t, std::uint32_t>> divisions_;
+  std::uint32_t n_registers_{};              // number of registers needed
+  // registers of the statement nodes used more than once or `no_register`
+  std::pmr::unordered_map<std::uint32_t, std::uint32_t> shared_;
+  std::uint32_t next_shared_{};              // next shared node register
+
+  /**
+   * Expression node being visited without recursion.
+   */
+  struct frame {
+    std::uint32_t index;     // node index
+    std::uint32_t dst;       // destination stack register
+    std::uint32_t out;       // register the value is computed into
+    std::uint32_t operands;  // number of operands visited
+  };
+
+  std::pmr::vector<frame> frames_;           // nodes being visited
+  std::pmr::vector<std::uint32_t> values_;   // values of visited operands
+
+  /**
+   * Find the nodes of an expression used more than once.
+   *
+   * @param program Program containing the expression
+   * @param index Expression root node index
+   * @param depths Stack registers needed by each node visited so far
+   * @returns Number of stack registers needed to compile the expression
+   */
+  std::uint32_t share(
+    const calc_program& program,
+    std::uint32_t index,
+    std::pmr::unordered_map<std::uint32_t, std::uint32_t>& depths);
+
+  /**
+   * Compile an expression into stack register 0.
+   *
+   * @param program Program containing the expression
+   * @param index Expression root node index, which must not be shared
+   * @returns `true` on success, `false` if too many registers are needed
+   */
+  bool compile(const calc_program& program, std::uint32_t index);
+
+  /**
+   * Append an instruction.
+   *
+   * @param op Opcode
+   * @param dst Destination register
+   * @param a First operand
+   * @param b Second operand
+   */
+  void emit(
+    calc_opcode op,
+    std::uint32_t dst,
+    std::uint32_t a = 0,
+    std::uint32_t b = 0);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_BYTECODE_HH_
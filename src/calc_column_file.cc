@@ -0,0 +1,777 @@
+/**
+ * @file calc_column_file.cc
+ * @author Derek Huang
+ * @brief C++ source for pdcalc columnar data file reading and writing
+ * @copyright MIT License
+ */
+
+#include "calc_column_file.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "pdcalc/calc_binary_format.hh"
+#include "pdcalc/calc_parser.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Largest column name size in bytes.
+ */
+constexpr std::uint32_t max_name_size = 1 << 16;
+
+/**
+ * Remove leading and trailing blanks from a CSV field.
+ *
+ * @param field Field text
+ */
+std::string_view trim(std::string_view field) noexcept
+{
+  constexpr std::string_view blanks{" \t\r"};
+  auto first = field.find_first_not_of(blanks);
+  if (first == field.npos)
+    return {};
+  return field.substr(first, field.find_last_not_of(blanks) + 1 - first);
+}
+
+/**
+ * Split a CSV line into its trimmed fields.
+ *
+ * Fields cannot be quoted, as column names are identifiers and values are
+ * numbers or booleans.
+ *
+ * @param line Line text
+ * @param fields Vector to write the fields to
+ */
+void split(std::string_view line, std::vector<std::string_view>& fields)
+{
+  fields.clear();
+  while (true) {
+    auto end = line.find(',');
+    fields.push_back(trim(line.substr(0, end)));
+    if (end == line.npos)
+      return;
+    line.remove_prefix(end + 1);
+  }
+}
+
+/**
+ * Parse a CSV `bool` value.
+ *
+ * @param field Field text
+ * @param value Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_value(std::string_view field, bool& value) noexcept
+{
+  if (field == "true")
+    value = true;
+  else if (field == "false")
+    value = false;
+  else
+    return false;
+  return true;
+}
+
+/**
+ * Parse a CSV `long` value.
+ *
+ * @param field Field text
+ * @param value Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_value(std::string_view field, long& value) noexcept
+{
+  auto last = field.data() + field.size();
+  auto [end, ec] = std::from_chars(field.data(), last, value);
+  return ec == std::errc{} && end == last;
+}
+
+/**
+ * Parse a CSV `double` value.
+ *
+ * `strtod` is used so that `inf` and `nan`, as written by pdcalc, are read.
+ *
+ * @param field Field text
+ * @param value Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_value(std::string_view field, double& value)
+{
+  if (field.empty())
+    return false;
+  // strtod needs a null-terminated string. copy to the stack if possible
+  char chars[64];
+  std::string text;
+  const char* first = chars;
+  if (field.size() < sizeof chars) {
+    field.copy(chars, field.size());
+    chars[field.size()] = '\0';
+  }
+  else {
+    text.assign(field);
+    first = text.c_str();
+  }
+  char* end;
+  value = std::strtod(first, &end);
+  return end == first + field.size();
+}
+
+/**
+ * Return the type tag of the first CSV value of a column.
+ *
+ * @param field Field text
+ * @param integers `true` if integers are `long` values instead of `double`
+ * @returns Type tag, `error` if the field is not a value
+ */
+calc_binary_tag value_type(std::string_view field, bool integers)
+{
+  bool b;
+  long l;
+  double d;
+  if (parse_value(field, b))
+    return calc_binary_tag::bool_value;
+  if (integers && parse_value(field, l))
+    return calc_binary_tag::long_value;
+  if (parse_value(field, d))
+    return calc_binary_tag::double_value;
+  return calc_binary_tag::error;
+}
+
+/**
+ * Return the type name of a column type tag as written by pdcalc.
+ *
+ * @param type Column type tag
+ */
+constexpr const char* type_name(calc_binary_tag type) noexcept
+{
+  switch (type) {
+    case calc_binary_tag::bool_value:
+      return "bool";
+    case calc_binary_tag::long_value:
+      return "long";
+    default:
+      return "double";
+  }
+}
+
+/**
+ * Append an unsigned integer in little-endian byte order.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param out String to append to
+ * @param value Value
+ */
+template <typename T>
+void put(std::string& out, T value)
+{
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+/**
+ * Append a value formatted with `std::to_chars` to a buffer.
+ *
+ * @tparam F Callable taking `(char* first, char* last)` and returning the
+ *  `std::to_chars_result` from formatting the value into `[first, last)`
+ *
+ * @param buffer Buffer to append to
+ * @param format Callable formatting the value
+ */
+template <typename F>
+void append_chars(std::string& buffer, F format)
+{
+  // large enough for any 64-bit integer or double with 6 or 17 digits
+  char chars[64];
+  auto [ptr, ec] = format(chars, chars + sizeof chars);
+  if (ec == std::errc{})
+    buffer.append(chars, static_cast<std::size_t>(ptr - chars));
+}
+
+}  // namespace
+
+/**
+ * Return the format of a columnar data file from its path.
+ *
+ * @param path File path
+ */
+calc_column_format calc_column_format_of(std::string_view path) noexcept
+{
+  constexpr std::string_view csv_ext{".csv"};
+  if (
+    path == "-" ||
+    (
+      path.size() >= csv_ext.size() &&
+      path.substr(path.size() - csv_ext.size()) == csv_ext
+    )
+  )
+    return calc_column_format::csv;
+  return calc_column_format::binary;
+}
+
+/**
+ * Ctor.
+ *
+ * @param name Column name
+ * @param type Column type tag, which must not be `error`
+ */
+calc_column::calc_column(std::string name, calc_binary_tag type)
+  : name_{std::move(name)}, type_{type}
+{
+  switch (type_) {
+    case calc_binary_tag::bool_value:
+      data_.emplace<std::unique_ptr<bool[]>>();
+      break;
+    case calc_binary_tag::long_value:
+      data_.emplace<std::unique_ptr<long[]>>();
+      break;
+    default:
+      data_.emplace<std::unique_ptr<double[]>>();
+      break;
+  }
+}
+
+/**
+ * Make room for a number of rows, discarding the values if reallocating.
+ *
+ * @param n_rows Number of rows
+ */
+void calc_column::reserve(std::size_t n_rows)
+{
+  if (n_rows <= capacity_)
+    return;
+  std::visit(
+    [n_rows](auto& data)
+    {
+      using value_type = std::remove_extent_t<
+        typename std::decay_t<decltype(data)>::element_type
+      >;
+      data = std::make_unique<value_type[]>(n_rows);
+    },
+    data_
+  );
+  capacity_ = n_rows;
+}
+
+/**
+ * Return the input column reading the values.
+ */
+calc_input_column calc_column::input() const noexcept
+{
+  return {
+    name_,
+    std::visit(
+      [](const auto& data) -> decltype(calc_input_column::data)
+      {
+        return data.get();
+      },
+      data_
+    )
+  };
+}
+
+/**
+ * Return the output column writing the values.
+ */
+calc_output_column calc_column::output() const noexcept
+{
+  return {
+    name_,
+    std::visit(
+      [](const auto& data) -> decltype(calc_output_column::data)
+      {
+        return data.get();
+      },
+      data_
+    )
+  };
+}
+
+/**
+ * Open a file and read its columns.
+ *
+ * @param path File path, `-` for stdin
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::open(const std::string& path, std::string& error)
+{
+  format_ = calc_column_format_of(path);
+  columns_.clear();
+  chunk_rows_ = chunk_read_ = chunk_offset_ = next_offset_ = 0;
+  line_no_ = 0;
+  pending_ = false;
+  if (path == "-") {
+    name_ = "stdin";
+    in_ = &std::cin;
+  }
+  else {
+    name_ = path;
+    file_.open(path, std::ios::binary);
+    if (!file_) {
+      error = "Error opening " + path;
+      return false;
+    }
+    in_ = &file_;
+  }
+  if (format_ == calc_column_format::binary)
+    return open_binary(error);
+  return open_csv(error);
+}
+
+/**
+ * Read the next rows into the columns.
+ *
+ * @param max_rows Maximum number of rows to read
+ * @param n_rows Number of rows read, zero at the end of the file
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::read(
+  std::size_t max_rows, std::size_t& n_rows, std::string& error)
+{
+  for (auto& column : columns_)
+    column.reserve(max_rows);
+  if (format_ == calc_column_format::binary)
+    return read_binary(max_rows, n_rows, error);
+  // first row was read to get the column types
+  n_rows = 0;
+  if (pending_) {
+    pending_ = false;
+    if (!parse_row(n_rows++, error))
+      return false;
+  }
+  while (n_rows < max_rows && std::getline(*in_, buffer_)) {
+    line_no_++;
+    // skip blank lines
+    if (trim(buffer_).empty())
+      continue;
+    if (!parse_row(n_rows++, error))
+      return false;
+  }
+  if (in_->bad()) {
+    error = "Error reading " + name_;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Read the binary header and column descriptors.
+ *
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::open_binary(std::string& error)
+{
+  auto truncated = [this, &error]
+  {
+    error = name_ + " is truncated or corrupt";
+    return false;
+  };
+  buffer_.resize(calc_column_header_size);
+  in_->read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  auto header = calc_column_peek(
+    std::string_view{buffer_}.substr(0, static_cast<std::size_t>(in_->gcount()))
+  );
+  if (!header) {
+    error = name_ + " is not pdcalc columnar data";
+    return false;
+  }
+  if (header->version != calc_column_version) {
+    error = name_ + " has unsupported version " +
+      std::to_string(header->version);
+    return false;
+  }
+  next_offset_ = calc_column_header_size;
+  for (std::uint32_t i = 0; i < header->n_columns; i++) {
+    buffer_.resize(8);
+    if (!in_->read(buffer_.data(), 8))
+      return truncated();
+    auto type = static_cast<calc_binary_tag>(buffer_[0]);
+    auto name_size = calc_binary_get<std::uint32_t>(buffer_.data() + 4);
+    if (type > calc_binary_tag::double_value || name_size > max_name_size)
+      return truncated();
+    buffer_.resize(calc_column_padded(name_size));
+    auto size = static_cast<std::streamsize>(buffer_.size());
+    if (!in_->read(buffer_.data(), size))
+      return truncated();
+    buffer_.resize(name_size);
+    columns_.emplace_back(buffer_, type);
+    next_offset_ += 8 + calc_column_padded(name_size);
+  }
+  return true;
+}
+
+/**
+ * Read the CSV column names and the first row to get the column types.
+ *
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::open_csv(std::string& error)
+{
+  // column names
+  if (!std::getline(*in_, buffer_)) {
+    error = name_ + " has no column names";
+    return false;
+  }
+  line_no_++;
+  split(buffer_, fields_);
+  std::vector<std::string> names(fields_.begin(), fields_.end());
+  for (const auto& name : names) {
+    if (name.empty()) {
+      error = name_ + ":1: empty column name";
+      return false;
+    }
+  }
+  // first row, if any, gives the types. without rows all are double
+  while (std::getline(*in_, buffer_)) {
+    line_no_++;
+    if (!trim(buffer_).empty()) {
+      pending_ = true;
+      break;
+    }
+  }
+  if (in_->bad()) {
+    error = "Error reading " + name_;
+    return false;
+  }
+  if (pending_)
+    split(buffer_, fields_);
+  for (std::size_t i = 0; i < names.size(); i++) {
+    auto type = calc_binary_tag::double_value;
+    if (pending_ && i < fields_.size()) {
+      type = value_type(fields_[i], csv_integers_);
+      if (type == calc_binary_tag::error) {
+        error = location() + "column '" + names[i] + "' value '" +
+          std::string{fields_[i]} +
+          "' is not a bool, long, or double";
+        return false;
+      }
+    }
+    columns_.emplace_back(std::move(names[i]), type);
+  }
+  return true;
+}
+
+/**
+ * Read the next rows of binary chunks into the columns.
+ *
+ * @param max_rows Maximum number of rows to read
+ * @param n_rows Number of rows read, zero at the end of the file
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::read_binary(
+  std::size_t max_rows, std::size_t& n_rows, std::string& error)
+{
+  auto truncated = [this, &error]
+  {
+    error = name_ + " is truncated or corrupt";
+    return false;
+  };
+  n_rows = 0;
+  // go to the next nonempty chunk if the current one has been read
+  while (chunk_read_ == chunk_rows_) {
+    in_->clear();
+    in_->seekg(static_cast<std::streamoff>(next_offset_));
+    char size[8];
+    in_->read(size, sizeof size);
+    if (!in_->gcount() && in_->eof())
+      return true;
+    if (!*in_)
+      return truncated();
+    chunk_rows_ = calc_binary_get<std::uint64_t>(size);
+    chunk_read_ = 0;
+    // guard against overflow of the chunk size
+    if (chunk_rows_ > (std::numeric_limits<std::uint64_t>::max() >> 8))
+      return truncated();
+    chunk_offset_ = next_offset_ + sizeof size;
+    next_offset_ = chunk_offset_;
+    for (const auto& column : columns_)
+      next_offset_ += calc_column_padded(
+        chunk_rows_ * calc_column_value_size(column.type())
+      );
+  }
+  // read the next rows of each column in the chunk
+  n_rows = static_cast<std::size_t>(
+    std::min<std::uint64_t>(max_rows, chunk_rows_ - chunk_read_)
+  );
+  auto offset = chunk_offset_;
+  for (const auto& column : columns_) {
+    auto value_size = calc_column_value_size(column.type());
+    in_->seekg(static_cast<std::streamoff>(offset + chunk_read_ * value_size));
+    buffer_.resize(n_rows * value_size);
+    auto size = static_cast<std::streamsize>(buffer_.size());
+    if (!in_->read(buffer_.data(), size))
+      return truncated();
+    auto data = buffer_.data();
+    switch (column.type()) {
+      case calc_binary_tag::bool_value: {
+        auto values = column.data<bool>();
+        for (std::size_t i = 0; i < n_rows; i++)
+          values[i] = data[i] != 0;
+        break;
+      }
+      case calc_binary_tag::long_value: {
+        auto values = column.data<long>();
+        for (std::size_t i = 0; i < n_rows; i++)
+          values[i] = static_cast<long>(
+            static_cast<std::int64_t>(
+              calc_binary_get<std::uint64_t>(data + 8 * i)
+            )
+          );
+        break;
+      }
+      default: {
+        auto values = column.data<double>();
+        for (std::size_t i = 0; i < n_rows; i++)
+          values[i] =
+            calc_binary_double(calc_binary_get<std::uint64_t>(data + 8 * i));
+        break;
+      }
+    }
+    offset += calc_column_padded(chunk_rows_ * value_size);
+  }
+  chunk_read_ += n_rows;
+  return true;
+}
+
+/**
+ * Parse the CSV line in the buffer into a row of the columns.
+ *
+ * @param row Row index
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_reader::parse_row(std::size_t row, std::string& error)
+{
+  split(buffer_, fields_);
+  if (fields_.size() != columns_.size()) {
+    error = location() + "expected " + std::to_string(columns_.size()) +
+      " values, got " + std::to_string(fields_.size());
+    return false;
+  }
+  for (std::size_t i = 0; i < columns_.size(); i++) {
+    const auto& column = columns_[i];
+    auto parsed = false;
+    switch (column.type()) {
+      case calc_binary_tag::bool_value:
+        parsed = parse_value(fields_[i], column.data<bool>()[row]);
+        break;
+      case calc_binary_tag::long_value:
+        parsed = parse_value(fields_[i], column.data<long>()[row]);
+        break;
+      default:
+        parsed = parse_value(fields_[i], column.data<double>()[row]);
+        break;
+    }
+    if (!parsed) {
+      error = location() + "column '" + column.name() + "' value '" +
+        std::string{fields_[i]} + "' is not a " + type_name(column.type());
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Return the file name and CSV line number prefixing CSV error messages.
+ */
+std::string calc_column_reader::location() const
+{
+  return name_ + ":" + std::to_string(line_no_) + ": ";
+}
+
+/**
+ * Create a file and write its columns.
+ *
+ * @param path File path, `-` for stdout
+ * @param columns Columns to write
+ * @param double_format Format of CSV `double` values
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_writer::open(
+  const std::string& path,
+  const std::vector<calc_column>& columns,
+  calc_double_format double_format,
+  std::string& error)
+{
+  format_ = calc_column_format_of(path);
+  double_format_ = double_format;
+  if (path == "-") {
+    name_ = "stdout";
+    out_ = &std::cout;
+  }
+  else {
+    name_ = path;
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+      error = "Error opening " + path;
+      return false;
+    }
+    out_ = &file_;
+  }
+  buffer_.clear();
+  if (format_ == calc_column_format::csv) {
+    for (std::size_t i = 0; i < columns.size(); i++) {
+      buffer_ += i ? "," : "";
+      buffer_ += columns[i].name();
+    }
+    buffer_ += '\n';
+    return write_buffer(error);
+  }
+  buffer_.resize(calc_column_header_size);
+  calc_column_encode(
+    buffer_.data(), static_cast<std::uint32_t>(columns.size())
+  );
+  for (const auto& column : columns) {
+    buffer_.push_back(static_cast<char>(column.type()));
+    buffer_.append(3, '\0');
+    put(buffer_, static_cast<std::uint32_t>(column.name().size()));
+    buffer_ += column.name();
+    buffer_.resize(calc_column_padded(buffer_.size()));
+  }
+  return write_buffer(error);
+}
+
+/**
+ * Write rows of the columns.
+ *
+ * @param columns Columns given to `open`
+ * @param n_rows Number of rows
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_writer::write(
+  const std::vector<calc_column>& columns,
+  std::size_t n_rows,
+  std::string& error)
+{
+  buffer_.clear();
+  // binary chunk with each column padded so the next is aligned
+  if (format_ == calc_column_format::binary) {
+    put(buffer_, static_cast<std::uint64_t>(n_rows));
+    for (const auto& column : columns) {
+      switch (column.type()) {
+        case calc_binary_tag::bool_value: {
+          auto values = column.data<bool>();
+          for (std::size_t i = 0; i < n_rows; i++)
+            buffer_.push_back(values[i] ? 1 : 0);
+          break;
+        }
+        case calc_binary_tag::long_value: {
+          auto values = column.data<long>();
+          for (std::size_t i = 0; i < n_rows; i++)
+            put(
+              buffer_,
+              static_cast<std::uint64_t>(static_cast<std::int64_t>(values[i]))
+            );
+          break;
+        }
+        default: {
+          auto values = column.data<double>();
+          for (std::size_t i = 0; i < n_rows; i++)
+            put(buffer_, calc_binary_bits(values[i]));
+          break;
+        }
+      }
+      buffer_.resize(calc_column_padded(buffer_.size()));
+    }
+    return write_buffer(error);
+  }
+  // CSV rows formatted as pdcalc writes results
+  for (std::size_t i = 0; i < n_rows; i++) {
+    for (std::size_t j = 0; j < columns.size(); j++) {
+      if (j)
+        buffer_ += ',';
+      const auto& column = columns[j];
+      switch (column.type()) {
+        case calc_binary_tag::bool_value:
+          buffer_ += column.data<bool>()[i] ? "true" : "false";
+          break;
+        case calc_binary_tag::long_value:
+          append_chars(
+            buffer_,
+            [value = column.data<long>()[i]](char* first, char* last)
+            {
+              return std::to_chars(first, last, value);
+            }
+          );
+          break;
+        default:
+          append_chars(
+            buffer_,
+            [this, value = column.data<double>()[i]](char* first, char* last)
+            {
+              if (double_format_ == calc_double_format::shortest)
+                return std::to_chars(first, last, value);
+              return std::to_chars(
+                first, last, value, std::chars_format::general, 6
+              );
+            }
+          );
+          break;
+      }
+    }
+    buffer_ += '\n';
+  }
+  return write_buffer(error);
+}
+
+/**
+ * Flush and close the file.
+ *
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_writer::close(std::string& error)
+{
+  out_->flush();
+  if (out_ == &file_)
+    file_.close();
+  if (!*out_) {
+    error = "Error writing " + name_;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Write the buffer to the stream.
+ *
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_column_writer::write_buffer(std::string& error)
+{
+  if (
+    !out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()))
+  ) {
+    error = "Error writing " + name_;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace pdcalc
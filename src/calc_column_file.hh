@@ -0,0 +1,284 @@
+/**
+ * @file calc_column_file.hh
+ * @author Derek Huang
+ * @brief C++ header for pdcalc columnar data file reading and writing
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_COLUMN_FILE_HH_
+#define PDCALC_CALC_COLUMN_FILE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "pdcalc/calc_binary_format.hh"
+#include "pdcalc/calc_parser.hh"
+
+namespace pdcalc {
+
+/**
+ * Format of a columnar data file.
+ */
+enum class calc_column_format {
+  // binary columnar data as described in calc_binary_format.hh
+  binary,
+  // comma-separated values with a first line of column names
+  csv
+};
+
+/**
+ * Return the format of a columnar data file from its path.
+ *
+ * Paths ending in `.csv` and `-`, used for stdin and stdout, are CSV and all
+ * other paths are binary.
+ *
+ * @param path File path
+ */
+calc_column_format calc_column_format_of(std::string_view path) noexcept;
+
+/**
+ * Named column of values for a chunk of rows.
+ */
+class calc_column {
+public:
+  /**
+   * Ctor.
+   *
+   * @param name Column name
+   * @param type Column type tag, which must not be `error`
+   */
+  calc_column(std::string name, calc_binary_tag type);
+
+  /**
+   * Return the column name.
+   */
+  const auto& name() const noexcept { return name_; }
+
+  /**
+   * Return the column type tag.
+   */
+  auto type() const noexcept { return type_; }
+
+  /**
+   * Make room for a number of rows, discarding the values if reallocating.
+   *
+   * @param n_rows Number of rows
+   */
+  void reserve(std::size_t n_rows);
+
+  /**
+   * Return pointer to the first value.
+   *
+   * @tparam T Value type, which must be the column type
+   */
+  template <typename T>
+  T* data() const noexcept
+  {
+    return std::get<std::unique_ptr<T[]>>(data_).get();
+  }
+
+  /**
+   * Return the input column reading the values.
+   */
+  calc_input_column input() const noexcept;
+
+  /**
+   * Return the output column writing the values.
+   */
+  calc_output_column output() const noexcept;
+
+private:
+  std::string name_;        // column name
+  calc_binary_tag type_;    // column type tag
+  std::size_t capacity_{};  // number of rows with room for values
+  // values of the column type
+  std::variant<
+    std::unique_ptr<bool[]>,
+    std::unique_ptr<long[]>,
+    std::unique_ptr<double[]>
+  > data_;
+};
+
+/**
+ * Reader of a columnar data file in chunks of rows.
+ *
+ * Only one chunk of rows is held at a time, so memory use only depends on the
+ * chunk size and number of columns. The column types of a CSV file are those
+ * of the values of its first row: `true` or `false` for `bool` and any number
+ * for `double`, as a column of integers may have decimals in later rows.
+ * Integers can be read as `long` instead with `csv_integers`.
+ */
+class calc_column_reader {
+public:
+  /**
+   * Open a file and read its columns.
+   *
+   * @param path File path, `-` for stdin
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool open(const std::string& path, std::string& error);
+
+  /**
+   * Return `true` if CSV columns of integers are read as `long`.
+   */
+  bool csv_integers() const noexcept { return csv_integers_; }
+
+  /**
+   * Set whether CSV columns of integers are read as `long`.
+   *
+   * If enabled, a column whose first value is an integer is a `long` column
+   * and a later value that is not an integer is an error. Takes effect on the
+   * next `open`.
+   *
+   * @param enable `true` to read integers as `long`, `false` for `double`
+   * @returns `*this` to allow method chaining
+   */
+  calc_column_reader& csv_integers(bool enable) noexcept
+  {
+    csv_integers_ = enable;
+    return *this;
+  }
+
+  /**
+   * Return the columns, holding the values of the last rows read.
+   */
+  const auto& columns() const noexcept { return columns_; }
+
+  /**
+   * Read the next rows into the columns.
+   *
+   * @param max_rows Maximum number of rows to read
+   * @param n_rows Number of rows read, zero at the end of the file
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool read(std::size_t max_rows, std::size_t& n_rows, std::string& error);
+
+private:
+  calc_column_format format_{};           // file format
+  std::string name_;                      // file name used in error messages
+  std::ifstream file_;                    // file if not stdin
+  std::istream* in_{};                    // stream read from
+  std::vector<calc_column> columns_;      // columns
+  std::string buffer_;                    // bytes read or line being parsed
+  std::vector<std::string_view> fields_;  // fields of the CSV line
+  std::uint64_t chunk_rows_{};            // rows in the current binary chunk
+  std::uint64_t chunk_read_{};            // rows of the chunk already read
+  std::uint64_t chunk_offset_{};          // file offset of the chunk values
+  std::uint64_t next_offset_{};           // file offset of the next chunk
+  std::uint64_t line_no_{};               // number of CSV lines read
+  bool pending_{};                        // first CSV row not yet read
+  bool csv_integers_{};                   // CSV integers read as long
+
+  /**
+   * Read the binary header and column descriptors.
+   *
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool open_binary(std::string& error);
+
+  /**
+   * Read the CSV column names and the first row to get the column types.
+   *
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool open_csv(std::string& error);
+
+  /**
+   * Read the next rows of binary chunks into the columns.
+   *
+   * @param max_rows Maximum number of rows to read
+   * @param n_rows Number of rows read, zero at the end of the file
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool read_binary(
+    std::size_t max_rows, std::size_t& n_rows, std::string& error);
+
+  /**
+   * Parse the CSV line in the buffer into a row of the columns.
+   *
+   * @param row Row index
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_row(std::size_t row, std::string& error);
+
+  /**
+   * Return the file name and CSV line number prefixing CSV error messages.
+   */
+  std::string location() const;
+};
+
+/**
+ * Writer of a columnar data file in chunks of rows.
+ */
+class calc_column_writer {
+public:
+  /**
+   * Create a file and write its columns.
+   *
+   * @param path File path, `-` for stdout
+   * @param columns Columns to write
+   * @param double_format Format of CSV `double` values
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool open(
+    const std::string& path,
+    const std::vector<calc_column>& columns,
+    calc_double_format double_format,
+    std::string& error);
+
+  /**
+   * Write rows of the columns.
+   *
+   * @param columns Columns given to `open`
+   * @param n_rows Number of rows
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool write(
+    const std::vector<calc_column>& columns,
+    std::size_t n_rows,
+    std::string& error);
+
+  /**
+   * Flush and close the file.
+   *
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool close(std::string& error);
+
+private:
+  calc_column_format format_{};         // file format
+  std::string name_;                    // file name used in error messages
+  std::ofstream file_;                  // file if not stdout
+  std::ostream* out_{};                 // stream written to
+  std::string buffer_;                  // bytes of the rows being written
+  calc_double_format double_format_{};  // format of CSV doubles
+
+  /**
+   * Write the buffer to the stream.
+   *
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool write_buffer(std::string& error);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_COLUMN_FILE_HH_
@@ -0,0 +1,633 @@
+/**
+ * @file calc_columns.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator columnar evaluation engine
+ * @copyright MIT License
+ */
+
+#include "calc_columns.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+#include "calc_program.hh"
+#include "calc_symbol_table.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return the size of a value of the given type.
+ *
+ * @param type Value type
+ */
+std::size_t value_size(calc_value_type type) noexcept
+{
+  switch (type) {
+    case calc_value_type::boolean:
+      return sizeof(bool);
+    case calc_value_type::integral:
+      return sizeof(long);
+    default:
+      return sizeof(double);
+  }
+}
+
+/**
+ * Return pointer to the value at the given row of a column.
+ *
+ * @param data Column data
+ * @param type Column value type
+ * @param row Row index
+ */
+template <typename T>
+T* row_data(T* data, calc_value_type type, std::size_t row) noexcept
+{
+  using byte_type = std::conditional_t<
+    std::is_const_v<T>, const unsigned char, unsigned char
+  >;
+  return static_cast<byte_type*>(data) + row * value_size(type);
+}
+
+}  // namespace
+
+/**
+ * Bind the program symbols to the columns and symbols.
+ *
+ * Statements are walked once in program order to resolve each symbol node to
+ * an input column or a value block and to assign value blocks to the other
+ * nodes. Value blocks are reference counted by the node values and symbol
+ * bindings using them so that a block is only reused once nothing later in the
+ * program reads it. Nodes used more than once hold one reference per use and
+ * nodes no statement uses, e.g. nodes replaced by optimization, are skipped.
+ * Literal and symbol table value blocks are pinned as they are filled once and
+ * read again by every block of rows.
+ *
+ * @param symbols Symbols read by the program that have no input column
+ * @param inputs Pointer to first of `n_inputs` input columns
+ * @param n_inputs Number of input columns
+ * @param outputs Pointer to first of `n_outputs` output columns
+ * @param n_outputs Number of output columns
+ */
+void calc_column_engine::bind(
+  const calc_symbol_table& symbols,
+  const calc_input_column* inputs,
+  std::size_t n_inputs,
+  const calc_output_column* outputs,
+  std::size_t n_outputs)
+{
+  const auto& nodes = program_.nodes();
+  const auto& names = program_.names();
+  const auto& statements = program_.statements();
+  // reset state
+  statement_ = no_statement;
+  blocks_.clear();
+  block_refs_.clear();
+  free_blocks_.clear();
+  node_blocks_.assign(nodes.size(), no_index);
+  views_.assign(nodes.size(), nullptr);
+  schedule_.clear();
+  columns_.clear();
+  column_nodes_.clear();
+  outputs_.clear();
+  // current binding of each symbol name
+  auto resource = blocks_.get_allocator().resource();
+  std::pmr::unordered_map<std::string_view, std::uint32_t> name_indices{
+    resource
+  };
+  for (std::uint32_t i = 0; i < names.size(); i++)
+    name_indices.emplace(names[i], i);
+  std::pmr::vector<binding> bindings(
+    names.size(),
+    {calc_value_type::boolean, false, no_index, no_node},
+    resource
+  );
+  // bind input columns of program symbols
+  for (std::size_t i = 0; i < n_inputs; i++) {
+    auto it = name_indices.find(inputs[i].name);
+    if (it == name_indices.end())
+      continue;
+    bindings[it->second] = {
+      static_cast<calc_value_type>(inputs[i].data.index()),
+      true,
+      static_cast<std::uint32_t>(columns_.size()),
+      no_node
+    };
+    columns_.push_back(
+      std::visit(
+        [](auto data) { return static_cast<const void*>(data); },
+        inputs[i].data
+      )
+    );
+  }
+  // fill a value block with a single value
+  auto fill_block = [this](std::uint32_t blk, auto value)
+  {
+    std::fill_n(data<decltype(value)>(blocks_[blk]), block_rows, value);
+  };
+  // input column of each symbol node + node producing each symbol node value
+  std::pmr::vector<std::uint32_t> node_columns(
+    nodes.size(), no_index, resource
+  );
+  std::pmr::vector<std::uint32_t> sources(nodes.size(), no_node, resource);
+  // uses of each node by the expression of its statement
+  std::pmr::vector<std::uint32_t> uses(nodes.size(), 0, resource);
+  // divisions also use the integral operands of their promoted operands so
+  // that division by zero errors can report their exact values
+  auto promoted = [&nodes](const calc_node& node, auto func)
+  {
+    if (node.op != calc_op::divide)
+      return;
+    for (auto operand : {node.left, node.right})
+      if (nodes[operand].op == calc_op::to_double)
+        func(nodes[operand].left);
+  };
+  // bind nodes of each statement. nodes of a statement are always after the
+  // nodes of the previous statement and end with the statement root
+  std::uint32_t first = 0;
+  for (statement_ = 0; statement_ < statements.size(); statement_++) {
+    const auto& stmt = statements[statement_];
+    uses[stmt.root] = 1;
+    for (auto i = stmt.root + 1; i-- > first; ) {
+      if (!uses[i] || calc_is_leaf(nodes[i].op))
+        continue;
+      uses[nodes[i].left]++;
+      if (calc_is_binary(nodes[i].op))
+        uses[nodes[i].right]++;
+      promoted(nodes[i], [&uses](auto source) { uses[source]++; });
+    }
+    for (auto i = first; i <= stmt.root; i++) {
+      if (!uses[i])
+        continue;
+      const auto& node = nodes[i];
+      switch (node.op) {
+        // filled once + pinned
+        case calc_op::literal: {
+          auto blk = node_blocks_[i] = acquire_block(true);
+          block_refs_[blk] += uses[i];
+          switch (node.type) {
+            case calc_value_type::boolean:
+              fill_block(blk, node.value<bool>());
+              break;
+            case calc_value_type::integral:
+              fill_block(blk, node.value<long>());
+              break;
+            case calc_value_type::floating:
+              fill_block(blk, node.value<double>());
+              break;
+          }
+          break;
+        }
+        // symbols without a binding are read from the symbol table
+        case calc_op::symbol: {
+          std::string_view iden = names[node.left];
+          auto& bound = bindings[node.left];
+          if (bound.index == no_index) {
+            auto sym = symbols.find(iden);
+            if (!sym)
+              throw calc_eval_error{
+                "Undefined symbol '" + std::string{iden} + "'"
+              };
+            // filled once + pinned
+            auto blk = acquire_block(true);
+            block_refs_[blk]++;
+            std::visit(
+              [&fill_block, blk](auto value) { fill_block(blk, value); },
+              sym->value()
+            );
+            bound = {
+              static_cast<calc_value_type>(sym->value().index()),
+              false,
+              blk,
+              no_node
+            };
+          }
+          // type can differ if the symbol was rebound since the program was
+          // compiled or if the column type is not the compiled type
+          if (bound.type != node.type) {
+            if (bound.column)
+              throw calc_eval_error{
+                "Column '" + std::string{iden} +
+                "' does not have the compiled symbol type"
+              };
+            throw calc_eval_error{
+              "Symbol '" + std::string{iden} + "' changed type since compile"
+            };
+          }
+          if (bound.column)
+            node_columns[i] = bound.index;
+          else {
+            node_blocks_[i] = bound.index;
+            block_refs_[bound.index] += uses[i];
+          }
+          sources[i] = bound.node;
+          break;
+        }
+        // operands are released after so they never share the result block
+        default:
+          node_blocks_[i] = acquire_block();
+          block_refs_[node_blocks_[i]] += uses[i] - 1;
+          release_block(node_blocks_[node.left]);
+          if (calc_is_binary(node.op))
+            release_block(node_blocks_[node.right]);
+          promoted(
+            node, [this](auto source) { release_block(node_blocks_[source]); }
+          );
+      }
+    }
+    first = stmt.root + 1;
+    // assignment takes the root value reference
+    if (stmt.kind == calc_statement_kind::assign) {
+      auto& bound = bindings[stmt.name];
+      if (!bound.column)
+        release_block(bound.index);
+      if (node_columns[stmt.root] != no_index)
+        bound = {
+          nodes[stmt.root].type, true, node_columns[stmt.root], stmt.root
+        };
+      else
+        bound = {
+          nodes[stmt.root].type, false, node_blocks_[stmt.root], stmt.root
+        };
+    }
+    else
+      release_block(node_blocks_[stmt.root]);
+  }
+  statement_ = no_statement;
+  // bind outputs to the final symbol bindings
+  for (std::size_t i = 0; i < n_outputs; i++) {
+    std::string iden{outputs[i].name};
+    auto it = name_indices.find(iden);
+    if (it == name_indices.end())
+      throw calc_eval_error{"Output column '" + iden + "' is not a symbol"};
+    const auto& bound = bindings[it->second];
+    if (outputs[i].data.index() != static_cast<std::size_t>(bound.type))
+      throw calc_eval_error{
+        "Output column '" + iden + "' does not have the symbol type"
+      };
+    outputs_.push_back(
+      {
+        bound,
+        std::visit(
+          [](auto data) { return static_cast<void*>(data); }, outputs[i].data
+        )
+      }
+    );
+  }
+  // only compute nodes the outputs depend on
+  std::pmr::vector<bool> live(nodes.size(), false, resource);
+  for (const auto& out : outputs_)
+    if (out.source.node != no_node)
+      live[out.source.node] = true;
+  for (auto i = nodes.size(); i--; ) {
+    if (!live[i])
+      continue;
+    const auto& node = nodes[i];
+    switch (node.op) {
+      case calc_op::literal:
+        break;
+      case calc_op::symbol:
+        if (sources[i] != no_node)
+          live[sources[i]] = true;
+        break;
+      default:
+        live[node.left] = true;
+        if (calc_is_binary(node.op))
+          live[node.right] = true;
+    }
+  }
+  // blocks no longer move so node value views can be set
+  for (std::uint32_t i = 0; i < nodes.size(); i++) {
+    if (!live[i])
+      continue;
+    if (node_blocks_[i] != no_index)
+      views_[i] = &blocks_[node_blocks_[i]];
+    if (node_columns[i] != no_index)
+      column_nodes_.emplace_back(i, node_columns[i]);
+    else if (nodes[i].op != calc_op::literal && nodes[i].op != calc_op::symbol)
+      schedule_.push_back(i);
+  }
+}
+
+/**
+ * Evaluate the program for each row, writing the output columns.
+ *
+ * @param n_rows Number of rows in each column
+ */
+void calc_column_engine::run(std::size_t n_rows)
+{
+  const auto& nodes = program_.nodes();
+  statement_ = no_statement;
+  for (std::size_t offset = 0; offset < n_rows; offset += block_rows) {
+    auto n = std::min(block_rows, n_rows - offset);
+    // symbol nodes read the input columns in place
+    for (auto [index, column] : column_nodes_)
+      views_[index] = row_data(columns_[column], nodes[index].type, offset);
+    // compute nodes + copy outputs
+    for (auto index : schedule_)
+      compute(index, n, offset);
+    for (const auto& out : outputs_) {
+      const auto& source = out.source;
+      const void* values = source.column ?
+        row_data(columns_[source.index], source.type, offset) :
+        &blocks_[source.index];
+      std::memcpy(
+        row_data(out.data, source.type, offset),
+        values,
+        n * value_size(source.type)
+      );
+    }
+  }
+}
+
+/**
+ * Return a value block index with a single reference.
+ *
+ * @param pinned `true` for a block that is filled once and never released
+ */
+std::uint32_t calc_column_engine::acquire_block(bool pinned)
+{
+  std::uint32_t index;
+  if (!pinned && free_blocks_.size()) {
+    index = free_blocks_.back();
+    free_blocks_.pop_back();
+  }
+  else {
+    index = static_cast<std::uint32_t>(blocks_.size());
+    blocks_.emplace_back();
+    block_refs_.push_back(0);
+  }
+  block_refs_[index] = 1;
+  return index;
+}
+
+/**
+ * Release a reference to a value block.
+ *
+ * @param index Value block index, ignored if `no_index`
+ */
+void calc_column_engine::release_block(std::uint32_t index)
+{
+  if (index != no_index && !--block_refs_[index])
+    free_blocks_.push_back(index);
+}
+
+/**
+ * Compute the values of a node for a block of rows.
+ *
+ * @param index Node index
+ * @param n_rows Number of rows in the block
+ * @param offset Index of the first row of the block
+ */
+void calc_column_engine::compute(
+  std::uint32_t index, std::size_t n_rows, std::size_t offset)
+{
+  const auto& nodes = program_.nodes();
+  const auto& node = nodes[index];
+  // operand type. binary operations always have operands of the same type
+  auto type = nodes[node.left].type;
+  // apply binary operation to integral or floating operands
+  auto numeric = [this, index, n_rows, type](auto op)
+  {
+    if (type == calc_value_type::integral)
+      binary<long>(index, n_rows, op);
+    else
+      binary<double>(index, n_rows, op);
+  };
+  // apply binary operation to operands of any type
+  auto any = [this, index, n_rows, type, numeric](auto op)
+  {
+    if (type == calc_value_type::boolean)
+      binary<bool>(index, n_rows, op);
+    else
+      numeric(op);
+  };
+  auto max = [](auto a, auto b) { return std::max(a, b); };
+  auto min = [](auto a, auto b) { return std::min(a, b); };
+  switch (node.op) {
+    case calc_op::to_double:
+      unary<long>(index, n_rows, [](long v) { return static_cast<double>(v); });
+      return;
+    case calc_op::negate:
+      if (type == calc_value_type::integral)
+        unary<long>(index, n_rows, std::negate<>{});
+      else
+        unary<double>(index, n_rows, std::negate<>{});
+      return;
+    case calc_op::bit_not:
+      unary<long>(index, n_rows, std::bit_not<>{});
+      return;
+    case calc_op::logical_not:
+      unary<bool>(index, n_rows, std::logical_not<>{});
+      return;
+    case calc_op::exp:
+      unary<double>(index, n_rows, [](double v) { return std::exp(v); });
+      return;
+    case calc_op::log:
+      unary<double>(index, n_rows, [](double v) { return std::log(v); });
+      return;
+    case calc_op::log2:
+      unary<double>(index, n_rows, [](double v) { return std::log2(v); });
+      return;
+    case calc_op::log10:
+      unary<double>(index, n_rows, [](double v) { return std::log10(v); });
+      return;
+    case calc_op::sqrt:
+      unary<double>(index, n_rows, [](double v) { return std::sqrt(v); });
+      return;
+    case calc_op::sin:
+      unary<double>(index, n_rows, [](double v) { return std::sin(v); });
+      return;
+    case calc_op::cos:
+      unary<double>(index, n_rows, [](double v) { return std::cos(v); });
+      return;
+    case calc_op::tan:
+      unary<double>(index, n_rows, [](double v) { return std::tan(v); });
+      return;
+    case calc_op::add:
+      numeric(std::plus<>{});
+      return;
+    case calc_op::subtract:
+      numeric(std::minus<>{});
+      return;
+    case calc_op::multiply:
+      numeric(std::multiplies<>{});
+      return;
+    case calc_op::divide:
+      if (type == calc_value_type::integral)
+        divide<long>(index, n_rows, offset);
+      else
+        divide<double>(index, n_rows, offset);
+      return;
+    case calc_op::modulo:
+      binary<long>(index, n_rows, std::modulus<>{});
+      return;
+    case calc_op::bit_and:
+      binary<long>(index, n_rows, std::bit_and<>{});
+      return;
+    case calc_op::bit_xor:
+      binary<long>(index, n_rows, std::bit_xor<>{});
+      return;
+    case calc_op::bit_or:
+      binary<long>(index, n_rows, std::bit_or<>{});
+      return;
+    case calc_op::lshift:
+      binary<long>(index, n_rows, [](long a, long b) { return a << b; });
+      return;
+    case calc_op::rshift:
+      binary<long>(index, n_rows, [](long a, long b) { return a >> b; });
+      return;
+    case calc_op::max:
+      numeric(max);
+      return;
+    case calc_op::min:
+      numeric(min);
+      return;
+    case calc_op::equal:
+      any(std::equal_to<>{});
+      return;
+    case calc_op::not_equal:
+      any(std::not_equal_to<>{});
+      return;
+    case calc_op::less:
+      numeric(std::less<>{});
+      return;
+    case calc_op::greater:
+      numeric(std::greater<>{});
+      return;
+    case calc_op::less_equal:
+      numeric(std::less_equal<>{});
+      return;
+    case calc_op::greater_equal:
+      numeric(std::greater_equal<>{});
+      return;
+    // as with the other backends both operands are always evaluated
+    case calc_op::logical_and:
+      binary<bool>(index, n_rows, std::logical_and<>{});
+      return;
+    case calc_op::logical_or:
+      binary<bool>(index, n_rows, std::logical_or<>{});
+      return;
+    // leaves are never scheduled
+    default:
+      return;
+  }
+}
+
+/**
+ * Compute a unary operation for a block of rows.
+ *
+ * @tparam T Operand type
+ *
+ * @param index Node index
+ * @param n_rows Number of rows in the block
+ * @param op Unary operation
+ */
+template <typename T, typename Op>
+void calc_column_engine::unary(std::uint32_t index, std::size_t n_rows, Op op)
+{
+  auto a = values<T>(program_.nodes()[index].left);
+  auto res = results<decltype(op(*a))>(index);
+  for (std::size_t i = 0; i < n_rows; i++)
+    res[i] = op(a[i]);
+}
+
+/**
+ * Compute a binary operation for a block of rows.
+ *
+ * @tparam T Operand type
+ *
+ * @param index Node index
+ * @param n_rows Number of rows in the block
+ * @param op Binary operation
+ */
+template <typename T, typename Op>
+void calc_column_engine::binary(std::uint32_t index, std::size_t n_rows, Op op)
+{
+  const auto& node = program_.nodes()[index];
+  auto a = values<T>(node.left);
+  auto b = values<T>(node.right);
+  auto res = results<decltype(op(*a, *b))>(index);
+  for (std::size_t i = 0; i < n_rows; i++)
+    res[i] = op(a[i], b[i]);
+}
+
+/**
+ * Compute a division for a block of rows.
+ *
+ * The divisors are checked for zero with a separate reduction first so that
+ * the division loop itself has no branches.
+ *
+ * @tparam T Operand type
+ *
+ * @param index Node index
+ * @param n_rows Number of rows in the block
+ * @param offset Index of the first row of the block
+ */
+template <typename T>
+void calc_column_engine::divide(
+  std::uint32_t index, std::size_t n_rows, std::size_t offset)
+{
+  const auto& nodes = program_.nodes();
+  const auto& node = nodes[index];
+  auto a = values<T>(node.left);
+  auto b = values<T>(node.right);
+  unsigned zero = 0;
+  for (std::size_t i = 0; i < n_rows; i++)
+    zero |= (b[i] == T{});
+  if (zero) {
+    auto row = static_cast<std::size_t>(std::find(b, b + n_rows, T{}) - b);
+    statement_ = node_statement(index);
+    auto format = [this, &nodes, row](std::uint32_t operand)
+    {
+      if (nodes[operand].op == calc_op::to_double)
+        return std::to_string(values<long>(nodes[operand].left)[row]);
+      return std::to_string(values<T>(operand)[row]);
+    };
+    auto error = calc_division_error(
+      format(node.left), format(node.right), index
+    );
+    throw calc_eval_error{
+      "Row " + std::to_string(offset + row) + ": " + error.what(), index
+    };
+  }
+  auto res = results<T>(index);
+  for (std::size_t i = 0; i < n_rows; i++)
+    res[i] = a[i] / b[i];
+}
+
+/**
+ * Return the index of the statement containing a node.
+ *
+ * @param index Node index
+ */
+std::size_t calc_column_engine::node_statement(
+  std::uint32_t index) const noexcept
+{
+  const auto& statements = program_.statements();
+  auto it = std::lower_bound(
+    statements.begin(),
+    statements.end(),
+    index,
+    [](const calc_statement& stmt, std::uint32_t index)
+    {
+      return stmt.root < index;
+    }
+  );
+  return static_cast<std::size_t>(it - statements.begin());
+}
+
+}  // namespace pdcalc
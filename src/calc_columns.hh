@@ -0,0 +1,265 @@
+/**
+ * @file calc_columns.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator columnar evaluation engine
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_COLUMNS_HH_
+#define PDCALC_CALC_COLUMNS_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+#include "calc_program.hh"
+#include "calc_symbol_table.hh"
+
+namespace pdcalc {
+
+/**
+ * Columnar evaluation engine for a compiled program.
+ *
+ * The program is evaluated over blocks of rows, one node at a time, with each
+ * node computing a whole block of values with a simple element-wise loop that
+ * the compiler can vectorize. Symbol references read input columns directly
+ * and other values live in fixed-size blocks that are reused once the values
+ * they hold are no longer needed, so memory use does not depend on the number
+ * of rows. All binding and type checking is done once by `bind`.
+ */
+class calc_column_engine {
+public:
+  /**
+   * Number of rows evaluated at a time.
+   */
+  static constexpr std::size_t block_rows = 1024;
+
+  /**
+   * Statement index used when an error is not from a statement.
+   */
+  static constexpr auto no_statement = std::numeric_limits<std::size_t>::max();
+
+  /**
+   * Ctor.
+   *
+   * @param program Program to evaluate, which must outlive the engine
+   * @param resource Resource to allocate the value blocks and state from
+   */
+  calc_column_engine(
+    const calc_program& program,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    noexcept
+    : program_{program},
+      blocks_{resource},
+      block_refs_{resource},
+      free_blocks_{resource},
+      node_blocks_{resource},
+      views_{resource},
+      schedule_{resource},
+      columns_{resource},
+      column_nodes_{resource},
+      outputs_{resource}
+  {}
+
+  /**
+   * Bind the program symbols to the columns and symbols.
+   *
+   * @param symbols Symbols read by the program that have no input column
+   * @param inputs Pointer to first of `n_inputs` input columns
+   * @param n_inputs Number of input columns
+   * @param outputs Pointer to first of `n_outputs` output columns
+   * @param n_outputs Number of output columns
+   *
+   * @throws calc_eval_error if a symbol is undefined or has the wrong type
+   */
+  void bind(
+    const calc_symbol_table& symbols,
+    const calc_input_column* inputs,
+    std::size_t n_inputs,
+    const calc_output_column* outputs,
+    std::size_t n_outputs);
+
+  /**
+   * Evaluate the program for each row, writing the output columns.
+   *
+   * @param n_rows Number of rows in each column
+   *
+   * @throws calc_eval_error on evaluation failure
+   */
+  void run(std::size_t n_rows);
+
+  /**
+   * Return the index of the statement the last error is from.
+   *
+   * If the error is not from a statement `no_statement` is returned.
+   */
+  auto statement() const noexcept { return statement_; }
+
+private:
+  /**
+   * Block of values of a single type.
+   */
+  union alignas(64) block {
+    bool b[block_rows];
+    long l[block_rows];
+    double d[block_rows];
+  };
+
+  /**
+   * Source of a symbol value.
+   */
+  struct binding {
+    calc_value_type type;  // value type
+    bool column;           // `true` if index is an input column index
+    std::uint32_t index;   // block or input column index
+    std::uint32_t node;    // node producing the value or `no_node`
+  };
+
+  /**
+   * Output column with the source of its values.
+   */
+  struct output {
+    binding source;  // value source
+    void* data;      // output values
+  };
+
+  static constexpr auto no_index = std::numeric_limits<std::uint32_t>::max();
+  static constexpr auto no_node = no_index;
+
+  const calc_program& program_;                  // program
+  std::size_t statement_{no_statement};          // statement of last error
+  std::pmr::vector<block> blocks_;               // value blocks
+  std::pmr::vector<std::uint32_t> block_refs_;   // value block references
+  std::pmr::vector<std::uint32_t> free_blocks_;  // unreferenced value blocks
+  std::pmr::vector<std::uint32_t> node_blocks_;  // node value blocks
+  std::pmr::vector<const void*> views_;          // node values for a block
+  std::pmr::vector<std::uint32_t> schedule_;     // nodes to compute in order
+  std::pmr::vector<const void*> columns_;        // input column data
+  // symbol nodes reading input columns with their column indices
+  std::pmr::vector<std::pair<std::uint32_t, std::uint32_t>> column_nodes_;
+  std::pmr::vector<output> outputs_;             // output columns
+
+  /**
+   * Return a value block index with a single reference.
+   *
+   * @param pinned `true` for a block that is filled once and never released.
+   *  These are always new blocks as the values of a reused block would be
+   *  overwritten by its previous users when the next block of rows is computed.
+   */
+  std::uint32_t acquire_block(bool pinned = false);
+
+  /**
+   * Release a reference to a value block.
+   *
+   * @param index Value block index, ignored if `no_index`
+   */
+  void release_block(std::uint32_t index);
+
+  /**
+   * Return the values stored in a value block.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param blk Value block
+   */
+  template <typename T>
+  static T* data(block& blk) noexcept
+  {
+    if constexpr (std::is_same_v<T, bool>)
+      return blk.b;
+    else if constexpr (std::is_same_v<T, long>)
+      return blk.l;
+    else
+      return blk.d;
+  }
+
+  /**
+   * Compute the values of a node for a block of rows.
+   *
+   * @param index Node index
+   * @param n_rows Number of rows in the block
+   * @param offset Index of the first row of the block
+   */
+  void compute(std::uint32_t index, std::size_t n_rows, std::size_t offset);
+
+  /**
+   * Return the values of an evaluated node.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param index Node index
+   */
+  template <typename T>
+  const T* values(std::uint32_t index) const noexcept
+  {
+    return static_cast<const T*>(views_[index]);
+  }
+
+  /**
+   * Return the output values of a node.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param index Node index
+   */
+  template <typename T>
+  T* results(std::uint32_t index) noexcept
+  {
+    return data<T>(blocks_[node_blocks_[index]]);
+  }
+
+  /**
+   * Compute a unary operation for a block of rows.
+   *
+   * @tparam T Operand type
+   *
+   * @param index Node index
+   * @param n_rows Number of rows in the block
+   * @param op Unary operation
+   */
+  template <typename T, typename Op>
+  void unary(std::uint32_t index, std::size_t n_rows, Op op);
+
+  /**
+   * Compute a binary operation for a block of rows.
+   *
+   * @tparam T Operand type
+   *
+   * @param index Node index
+   * @param n_rows Number of rows in the block
+   * @param op Binary operation
+   */
+  template <typename T, typename Op>
+  void binary(std::uint32_t index, std::size_t n_rows, Op op);
+
+  /**
+   * Compute a division for a block of rows.
+   *
+   * @tparam T Operand type
+   *
+   * @param index Node index
+   * @param n_rows Number of rows in the block
+   * @param offset Index of the first row of the block
+   *
+   * @throws calc_eval_error on division by zero
+   */
+  template <typename T>
+  void divide(std::uint32_t index, std::size_t n_rows, std::size_t offset);
+
+  /**
+   * Return the index of the statement containing a node.
+   *
+   * @param index Node index
+   */
+  std::size_t node_statement(std::uint32_t index) const noexcept;
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_COLUMNS_HH_
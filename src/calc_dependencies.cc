@@ -0,0 +1,52 @@
+/**
+ * @file calc_dependencies.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator statement dependency graph
+ * @copyright MIT License
+ */
+
+#include "calc_dependencies.hh"
+
+#include <cstdint>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+/**
+ * Record the symbols read by the next statement.
+ *
+ * The parser only builds trees and the nodes of a statement expression follow
+ * those of the previous statement, so the nodes from `first_node` up to the
+ * root of the expression as written are exactly that expression.
+ *
+ * @param program Program containing the statement
+ * @param first_node First node of the statement expression as written
+ */
+void calc_dependencies::add(
+  const calc_program& program, std::uint32_t first_node)
+{
+  auto index = static_cast<std::uint32_t>(read_ends_.size());
+  const auto& stmt = program.statements()[index];
+  const auto& nodes = program.nodes();
+  symbols_.resize(program.names().size(), {std::nullopt, false, 0});
+  for (auto i = first_node; i <= stmt.source; i++) {
+    const auto& node = nodes[i];
+    if (node.op != calc_op::symbol)
+      continue;
+    auto& sym = symbols_[node.left];
+    if (sym.last_read == index + 1)
+      continue;
+    sym.last_read = index + 1;
+    reads_.push_back(node.left);
+    // reads before any assignment are of the value the symbol has on input
+    if (!sym.assigned && !sym.input_type)
+      sym.input_type = node.type;
+  }
+  read_ends_.push_back(static_cast<std::uint32_t>(reads_.size()));
+  first_nodes_.push_back(first_node);
+  if (stmt.kind == calc_statement_kind::assign)
+    symbols_[stmt.name].assigned = true;
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,132 @@
+/**
+ * @file calc_dependencies.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator statement dependency graph
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_DEPENDENCIES_HH_
+#define PDCALC_CALC_DEPENDENCIES_HH_
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+/**
+ * Symbols read and written by each statement of a `calc_program`.
+ *
+ * Statements are recorded as they are compiled. Together with the statement
+ * order, this gives the dependency graph between statements: a statement
+ * depends on the last statement before it assigning each symbol it reads, or
+ * on the symbol table if there is none. The symbols a statement writes are
+ * given by the statement itself.
+ *
+ * The reads of a statement are those of its expression as written, which are
+ * a superset of those of the optimized expression.
+ */
+class calc_dependencies {
+public:
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate from
+   */
+  explicit calc_dependencies(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : reads_{resource},
+      read_ends_{resource},
+      first_nodes_{resource},
+      symbols_{resource}
+  {}
+
+  /**
+   * Remove all recorded statements.
+   */
+  void clear() noexcept
+  {
+    reads_.clear();
+    read_ends_.clear();
+    first_nodes_.clear();
+    symbols_.clear();
+  }
+
+  /**
+   * Return the number of recorded statements.
+   */
+  auto size() const noexcept { return read_ends_.size(); }
+
+  /**
+   * Record the symbols read by the next statement.
+   *
+   * Statements must be recorded in order as they are compiled, before the
+   * next statement is added to the program.
+   *
+   * @param program Program containing the statement
+   * @param first_node First node of the statement expression as written
+   */
+  void add(const calc_program& program, std::uint32_t first_node);
+
+  /**
+   * Return the range of name indices of the symbols a statement reads.
+   *
+   * Each symbol is listed once.
+   *
+   * @param index Statement index
+   */
+  std::pair<const std::uint32_t*, const std::uint32_t*>
+  reads(std::uint32_t index) const noexcept
+  {
+    auto first = index ? read_ends_[index - 1] : 0;
+    return {reads_.data() + first, reads_.data() + read_ends_[index]};
+  }
+
+  /**
+   * Return the first node of each statement expression as written.
+   */
+  const auto& first_nodes() const noexcept { return first_nodes_; }
+
+  /**
+   * Return the type the program expects a symbol to have before running.
+   *
+   * This is the compile-time type of the symbol where it is read before any
+   * statement assigns it. If there is no such read, the program does not
+   * depend on any value the symbol has before running.
+   *
+   * @param name Symbol name index
+   */
+  std::optional<calc_value_type> input_type(std::uint32_t name) const noexcept
+  {
+    if (name >= symbols_.size())
+      return {};
+    return symbols_[name].input_type;
+  }
+
+private:
+  /**
+   * Per-symbol state used while recording.
+   */
+  struct symbol_state {
+    std::optional<calc_value_type> input_type;  // type when read as input
+    bool assigned;                              // assigned by a statement
+    std::uint32_t last_read;                    // last statement read + 1
+  };
+
+  // name indices of the symbols read by all statements in order
+  std::pmr::vector<std::uint32_t> reads_;
+  // end offsets into reads_ of the reads of each statement
+  std::pmr::vector<std::uint32_t> read_ends_;
+  // first node of each statement expression as written
+  std::pmr::vector<std::uint32_t> first_nodes_;
+  // symbol state indexed by name index
+  std::pmr::vector<symbol_state> symbols_;
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_DEPENDENCIES_HH_
@@ -0,0 +1,131 @@
+/**
+ * @file calc_frame.hh
+ * @author Derek Huang
+ * @brief C++ header for the pdcalc server message framing
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_FRAME_HH_
+#define PDCALC_CALC_FRAME_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace pdcalc {
+
+/**
+ * Kind of a frame exchanged with the pdcalc server.
+ *
+ * Clients send `eval` frames holding program text. The server evaluates each
+ * with the session of the connection and replies with exactly one frame, in
+ * request order: `output` with the results on success, or `error` with the
+ * results of the statements before the error followed by the error message
+ * on its own line. If the server continues after failed statements, an
+ * `error` frame holds all the results followed by each error message.
+ */
+enum class calc_frame_kind : unsigned char {
+  eval = 'e',
+  output = 'o',
+  error = 'x'
+};
+
+/**
+ * Frame header.
+ *
+ * On the wire this is the payload size as a 4-byte big-endian integer
+ * followed by the one-byte kind and then the payload.
+ */
+struct calc_frame_header {
+  calc_frame_kind kind;  // frame kind
+  std::uint32_t size;    // payload size in bytes
+};
+
+/**
+ * Size of an encoded frame header in bytes.
+ */
+inline constexpr std::size_t calc_frame_header_size = 5;
+
+/**
+ * Largest request payload size accepted by the server.
+ */
+inline constexpr std::uint32_t calc_frame_max_size = 1U << 26;
+
+/**
+ * Encode a frame header.
+ *
+ * @param data Buffer of at least `calc_frame_header_size` bytes
+ * @param header Frame header
+ */
+inline void calc_frame_encode(char* data, calc_frame_header header) noexcept
+{
+  data[0] = static_cast<char>(header.size >> 24);
+  data[1] = static_cast<char>(header.size >> 16);
+  data[2] = static_cast<char>(header.size >> 8);
+  data[3] = static_cast<char>(header.size);
+  data[4] = static_cast<char>(header.kind);
+}
+
+/**
+ * Append a frame to a buffer.
+ *
+ * @param buffer Buffer to append to
+ * @param kind Frame kind
+ * @param payload Frame payload
+ */
+inline void calc_frame_append(
+  std::string& buffer, calc_frame_kind kind, std::string_view payload)
+{
+  char header[calc_frame_header_size];
+  auto size = static_cast<std::uint32_t>(payload.size());
+  calc_frame_encode(header, {kind, size});
+  buffer.append(header, sizeof header);
+  buffer.append(payload);
+}
+
+/**
+ * Decode a frame header from the start of a buffer.
+ *
+ * @param data Buffer of at least `calc_frame_header_size` bytes
+ */
+inline calc_frame_header calc_frame_decode(const char* data) noexcept
+{
+  auto byte = [data](std::size_t i)
+  {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(data[i]));
+  };
+  return {
+    static_cast<calc_frame_kind>(data[4]),
+    (byte(0) << 24) | (byte(1) << 16) | (byte(2) << 8) | byte(3)
+  };
+}
+
+/**
+ * Return the header of the first frame of a buffer if it is complete.
+ *
+ * Headers with a payload larger than `max_size` are returned as soon as the
+ * header is available so that the caller can reject them.
+ *
+ * @param buffer Buffer starting at a frame boundary
+ * @param max_size Largest payload size waited for
+ */
+inline std::optional<calc_frame_header> calc_frame_peek(
+  std::string_view buffer,
+  std::uint32_t max_size = calc_frame_max_size) noexcept
+{
+  if (buffer.size() < calc_frame_header_size)
+    return {};
+  auto header = calc_frame_decode(buffer.data());
+  if (
+    header.size <= max_size &&
+    buffer.size() - calc_frame_header_size < header.size
+  )
+    return {};
+  return header;
+}
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_FRAME_HH_
@@ -0,0 +1,672 @@
+/**
+ * @file calc_jit.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator x86-64 JIT compiler
+ * @copyright MIT License
+ */
+
+#include "calc_jit.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory_resource>
+#include <vector>
+
+#include "calc_bytecode.hh"
+
+#if PDCALC_HAS_X86_64_JIT
+#include <sys/mman.h>
+#endif  // PDCALC_HAS_X86_64_JIT
+
+namespace pdcalc {
+
+namespace {
+
+#if PDCALC_HAS_X86_64_JIT
+// addressable wrappers for the libm functions called from generated code
+double jit_exp(double x) { return std::exp(x); }
+double jit_log(double x) { return std::log(x); }
+double jit_log2(double x) { return std::log2(x); }
+double jit_log10(double x) { return std::log10(x); }
+double jit_sqrt(double x) { return std::sqrt(x); }
+double jit_sin(double x) { return std::sin(x); }
+double jit_cos(double x) { return std::cos(x); }
+double jit_tan(double x) { return std::tan(x); }
+
+/**
+ * Minimal x86-64 machine code emitter.
+ *
+ * Only the handful of instruction forms needed by the JIT are supported.
+ * Memory operands are always `[rbx + disp32]`, where `rbx` holds the VM
+ * register file address, or `[r12 + disp32]`, where `r12` holds the loaded
+ * symbol value slots address. Values are otherwise only kept in `rax`, `rcx`,
+ * `rdx`, and `xmm0` through `xmm2`, none of which live across instructions.
+ */
+class x86_64_emitter {
+public:
+  // general purpose register numbers
+  static constexpr std::uint8_t rax = 0;
+  static constexpr std::uint8_t rcx = 1;
+  static constexpr std::uint8_t rdx = 2;
+  // SSE register numbers
+  static constexpr std::uint8_t xmm0 = 0;
+  static constexpr std::uint8_t xmm1 = 1;
+
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate the code buffer from
+   */
+  explicit x86_64_emitter(std::pmr::memory_resource* resource) noexcept
+    : code_{resource}
+  {}
+
+  /**
+   * Return the emitted code.
+   */
+  const auto& code() const noexcept { return code_; }
+
+  /**
+   * Append bytes.
+   *
+   * @param bytes Bytes to append
+   */
+  void bytes(std::initializer_list<std::uint8_t> bytes)
+  {
+    code_.insert(code_.end(), bytes);
+  }
+
+  /**
+   * Append a little-endian 32-bit immediate.
+   *
+   * @param value Immediate value
+   */
+  void imm32(std::uint32_t value)
+  {
+    for (auto i = 0; i < 4; i++)
+      code_.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+
+  /**
+   * Append a little-endian 64-bit immediate.
+   *
+   * @param value Immediate value
+   */
+  void imm64(std::uint64_t value)
+  {
+    for (auto i = 0; i < 8; i++)
+      code_.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+
+  /**
+   * Append an instruction with a `[rbx + disp32]` VM register operand.
+   *
+   * @param opcode Prefixes and opcode bytes
+   * @param reg ModR/M reg field, either a register number or opcode extension
+   * @param index VM register index
+   */
+  void vm_register(
+    std::initializer_list<std::uint8_t> opcode,
+    std::uint8_t reg,
+    std::uint32_t index)
+  {
+    bytes(opcode);
+    // mod = 10 (disp32), rm = 011 (rbx)
+    code_.push_back(static_cast<std::uint8_t>(0x83 | (reg << 3)));
+    imm32(index * sizeof(calc_register));
+  }
+
+  /**
+   * Emit the function prologue.
+   *
+   * Saves `rbx` and `r12`, keeps the stack 16-byte aligned for calls, and
+   * moves the register file and slot addresses into `rbx` and `r12`.
+   */
+  void prologue()
+  {
+    bytes({0x53});                    // push rbx
+    bytes({0x41, 0x54});              // push r12
+    bytes({0x48, 0x83, 0xEC, 0x08});  // sub rsp, 8
+    bytes({0x48, 0x89, 0xFB});        // mov rbx, rdi
+    bytes({0x49, 0x89, 0xF4});        // mov r12, rsi
+  }
+
+  /**
+   * Emit a return of the given status.
+   *
+   * @param status Function return value
+   */
+  void ret(std::uint32_t status)
+  {
+    if (status) {
+      bytes({0xB8});                  // mov eax, status
+      imm32(status);
+    }
+    else
+      bytes({0x31, 0xC0});            // xor eax, eax
+    bytes({0x48, 0x83, 0xC4, 0x08});  // add rsp, 8
+    bytes({0x41, 0x5C});              // pop r12
+    bytes({0x5B});                    // pop rbx
+    bytes({0xC3});                    // ret
+  }
+
+  /**
+   * Size in bytes of a `ret` with a nonzero status.
+   */
+  static constexpr std::uint8_t error_ret_size = 13;
+
+  /**
+   * Load a 64-bit VM register into a general purpose register.
+   */
+  void load(std::uint8_t reg, std::uint32_t index)
+  {
+    vm_register({0x48, 0x8B}, reg, index);  // mov reg, [rbx + disp]
+  }
+
+  /**
+   * Store a general purpose register into a 64-bit VM register.
+   */
+  void store(std::uint32_t index, std::uint8_t reg)
+  {
+    vm_register({0x48, 0x89}, reg, index);  // mov [rbx + disp], reg
+  }
+
+  /**
+   * Zero-extend a bool VM register into a general purpose register.
+   */
+  void load_bool(std::uint8_t reg, std::uint32_t index)
+  {
+    vm_register({0x0F, 0xB6}, reg, index);  // movzx reg32, byte [rbx + disp]
+  }
+
+  /**
+   * Store the low byte of `rax` into a bool VM register.
+   */
+  void store_bool(std::uint32_t index)
+  {
+    vm_register({0x88}, rax, index);  // mov [rbx + disp], al
+  }
+
+  /**
+   * Load a double VM register into an SSE register.
+   */
+  void load_double(std::uint8_t reg, std::uint32_t index)
+  {
+    vm_register({0xF2, 0x0F, 0x10}, reg, index);  // movsd xmm, [rbx + disp]
+  }
+
+  /**
+   * Store an SSE register into a double VM register.
+   */
+  void store_double(std::uint32_t index, std::uint8_t reg)
+  {
+    vm_register({0xF2, 0x0F, 0x11}, reg, index);  // movsd [rbx + disp], xmm
+  }
+
+  /**
+   * Load a symbol value slot into `rax`.
+   *
+   * @param slot Slot index
+   */
+  void load_slot(std::uint32_t slot)
+  {
+    // mov rax, [r12 + disp32]. r12 as base needs a SIB byte
+    bytes({0x49, 0x8B, 0x84, 0x24});
+    imm32(slot * sizeof(calc_register));
+  }
+
+  /**
+   * Move a 64-bit immediate into `rax`.
+   */
+  void mov_rax(std::uint64_t value)
+  {
+    bytes({0x48, 0xB8});
+    imm64(value);
+  }
+
+  /**
+   * Call a `double(double)` function on `xmm0`.
+   */
+  void call(double (*func)(double))
+  {
+    mov_rax(reinterpret_cast<std::uintptr_t>(func));
+    bytes({0xFF, 0xD0});  // call rax
+  }
+
+private:
+  std::pmr::vector<unsigned char> code_;
+};
+
+/**
+ * Compile a statement into native code.
+ *
+ * @param emit Emitter to write code with
+ * @param code Bytecode instructions
+ * @param begin Index of the first statement instruction
+ * @param loads Load instruction indices to append to
+ */
+void compile_statement(
+  x86_64_emitter& emit,
+  const std::pmr::vector<calc_instruction>& code,
+  std::uint32_t begin,
+  std::pmr::vector<std::uint32_t>& loads)
+{
+  using x = x86_64_emitter;
+  // index of the first load of the statement
+  const auto first_load = loads.size();
+  emit.prologue();
+  for (auto i = begin; ; i++) {
+    const auto& ins = code[i];
+    // long binary operation on rax, rcx
+    auto long_binary = [&emit, &ins](std::initializer_list<std::uint8_t> op)
+    {
+      emit.load(x::rax, ins.a);
+      emit.load(x::rcx, ins.b);
+      emit.bytes(op);
+      emit.store(ins.dst, x::rax);
+    };
+    // long comparison setting al from the flags of cmp rax, rcx
+    auto long_compare = [&emit, &ins](std::uint8_t setcc)
+    {
+      emit.load(x::rax, ins.a);
+      emit.load(x::rcx, ins.b);
+      emit.bytes({0x48, 0x39, 0xC8});        // cmp rax, rcx
+      emit.bytes({0x0F, setcc, 0xC0});       // setcc al
+      emit.store_bool(ins.dst);
+    };
+    // bool binary operation on al, cl
+    auto bool_binary = [&emit, &ins](std::initializer_list<std::uint8_t> op)
+    {
+      emit.load_bool(x::rax, ins.a);
+      emit.load_bool(x::rcx, ins.b);
+      emit.bytes(op);
+      emit.store_bool(ins.dst);
+    };
+    // double binary operation on xmm0, xmm1
+    auto double_binary = [&emit, &ins](std::uint8_t op)
+    {
+      emit.load_double(x::xmm0, ins.a);
+      emit.load_double(x::xmm1, ins.b);
+      emit.bytes({0xF2, 0x0F, op, 0xC1});    // op xmm0, xmm1
+      emit.store_double(ins.dst, x::xmm0);
+    };
+    // double comparison. ucomisd sets ZF, PF, CF on unordered operands, so
+    // using "above" conditions makes comparisons with NaN false as in C++
+    auto double_compare = [&emit, &ins](
+      bool swap, std::initializer_list<std::uint8_t> setcc)
+    {
+      emit.load_double(x::xmm0, ins.a);
+      emit.load_double(x::xmm1, ins.b);
+      if (swap)
+        emit.bytes({0x66, 0x0F, 0x2E, 0xC8});  // ucomisd xmm1, xmm0
+      else
+        emit.bytes({0x66, 0x0F, 0x2E, 0xC1});  // ucomisd xmm0, xmm1
+      emit.bytes(setcc);
+      emit.store_bool(ins.dst);
+    };
+    // double math function call
+    auto math = [&emit, &ins](double (*func)(double))
+    {
+      emit.load_double(x::xmm0, ins.a);
+      emit.call(func);
+      emit.store_double(ins.dst, x::xmm0);
+    };
+    switch (ins.op) {
+      // literals + symbol loads
+      case calc_opcode::const_b:
+        emit.vm_register({0xC6}, 0, ins.dst);  // mov byte [rbx + disp], imm8
+        emit.bytes({static_cast<std::uint8_t>(ins.a & 0xFF)});
+        break;
+      case calc_opcode::const_l:
+      case calc_opcode::const_d:
+        emit.mov_rax((std::uint64_t{ins.b} << 32) | ins.a);
+        emit.store(ins.dst, x::rax);
+        break;
+      case calc_opcode::load_b:
+      case calc_opcode::load_l:
+      case calc_opcode::load_d:
+      {
+        // each symbol is only loaded into a slot once per statement
+        auto slot = first_load;
+        while (slot < loads.size() && code[loads[slot]].a != ins.a)
+          slot++;
+        if (slot == loads.size())
+          loads.push_back(i);
+        emit.load_slot(static_cast<std::uint32_t>(slot - first_load));
+        emit.store(ins.dst, x::rax);
+        break;
+      }
+      // unary operations
+      case calc_opcode::to_double:
+        emit.load(x::rax, ins.a);
+        emit.bytes({0xF2, 0x48, 0x0F, 0x2A, 0xC0});  // cvtsi2sd xmm0, rax
+        emit.store_double(ins.dst, x::xmm0);
+        break;
+      case calc_opcode::neg_l:
+        emit.load(x::rax, ins.a);
+        emit.bytes({0x48, 0xF7, 0xD8});              // neg rax
+        emit.store(ins.dst, x::rax);
+        break;
+      case calc_opcode::neg_d:
+        emit.load(x::rax, ins.a);
+        emit.bytes({0x48, 0x0F, 0xBA, 0xF8, 0x3F});  // btc rax, 63
+        emit.store(ins.dst, x::rax);
+        break;
+      case calc_opcode::bit_not_l:
+        emit.load(x::rax, ins.a);
+        emit.bytes({0x48, 0xF7, 0xD0});              // not rax
+        emit.store(ins.dst, x::rax);
+        break;
+      case calc_opcode::not_b:
+        emit.load_bool(x::rax, ins.a);
+        emit.bytes({0x34, 0x01});                    // xor al, 1
+        emit.store_bool(ins.dst);
+        break;
+      case calc_opcode::exp_d:
+        math(jit_exp);
+        break;
+      case calc_opcode::log_d:
+        math(jit_log);
+        break;
+      case calc_opcode::log2_d:
+        math(jit_log2);
+        break;
+      case calc_opcode::log10_d:
+        math(jit_log10);
+        break;
+      case calc_opcode::sqrt_d:
+        math(jit_sqrt);
+        break;
+      case calc_opcode::sin_d:
+        math(jit_sin);
+        break;
+      case calc_opcode::cos_d:
+        math(jit_cos);
+        break;
+      case calc_opcode::tan_d:
+        math(jit_tan);
+        break;
+      // integral arithmetic
+      case calc_opcode::add_l:
+        long_binary({0x48, 0x01, 0xC8});        // add rax, rcx
+        break;
+      case calc_opcode::sub_l:
+        long_binary({0x48, 0x29, 0xC8});        // sub rax, rcx
+        break;
+      case calc_opcode::mul_l:
+        long_binary({0x48, 0x0F, 0xAF, 0xC1});  // imul rax, rcx
+        break;
+      case calc_opcode::div_l:
+        emit.load(x::rax, ins.a);
+        emit.load(x::rcx, ins.b);
+        emit.bytes({0x48, 0x85, 0xC9});         // test rcx, rcx
+        emit.bytes({0x75, x::error_ret_size});  // jnz past error return
+        emit.ret(i + 1);
+        emit.bytes({0x48, 0x99});               // cqo
+        emit.bytes({0x48, 0xF7, 0xF9});         // idiv rcx
+        emit.store(ins.dst, x::rax);
+        break;
+      case calc_opcode::mod_l:
+        emit.load(x::rax, ins.a);
+        emit.load(x::rcx, ins.b);
+        emit.bytes({0x48, 0x99});               // cqo
+        emit.bytes({0x48, 0xF7, 0xF9});         // idiv rcx
+        emit.store(ins.dst, x::rdx);
+        break;
+      case calc_opcode::and_l:
+        long_binary({0x48, 0x21, 0xC8});        // and rax, rcx
+        break;
+      case calc_opcode::xor_l:
+        long_binary({0x48, 0x31, 0xC8});        // xor rax, rcx
+        break;
+      case calc_opcode::or_l:
+        long_binary({0x48, 0x09, 0xC8});        // or rax, rcx
+        break;
+      case calc_opcode::shl_l:
+        long_binary({0x48, 0xD3, 0xE0});        // shl rax, cl
+        break;
+      case calc_opcode::shr_l:
+        long_binary({0x48, 0xD3, 0xF8});        // sar rax, cl
+        break;
+      // std::max(a, b) is a < b ? b : a and std::min(a, b) is b < a ? b : a
+      case calc_opcode::max_l:
+        long_binary(
+          {
+            0x48, 0x39, 0xC8,                   // cmp rax, rcx
+            0x48, 0x0F, 0x4C, 0xC1              // cmovl rax, rcx
+          }
+        );
+        break;
+      case calc_opcode::min_l:
+        long_binary(
+          {
+            0x48, 0x39, 0xC8,                   // cmp rax, rcx
+            0x48, 0x0F, 0x4F, 0xC1              // cmovg rax, rcx
+          }
+        );
+        break;
+      // floating arithmetic
+      case calc_opcode::add_d:
+        double_binary(0x58);                    // addsd
+        break;
+      case calc_opcode::sub_d:
+        double_binary(0x5C);                    // subsd
+        break;
+      case calc_opcode::mul_d:
+        double_binary(0x59);                    // mulsd
+        break;
+      case calc_opcode::div_d:
+        emit.load_double(x::xmm0, ins.a);
+        emit.load_double(x::xmm1, ins.b);
+        emit.bytes({0x66, 0x0F, 0x57, 0xD2});   // xorpd xmm2, xmm2
+        emit.bytes({0x66, 0x0F, 0x2E, 0xCA});   // ucomisd xmm1, xmm2
+        // NaN and nonzero divisors skip the error return
+        emit.bytes({0x7A, x::error_ret_size + 2});  // jp past jne + return
+        emit.bytes({0x75, x::error_ret_size});      // jne past return
+        emit.ret(i + 1);
+        emit.bytes({0xF2, 0x0F, 0x5E, 0xC1});   // divsd xmm0, xmm1
+        emit.store_double(ins.dst, x::xmm0);
+        break;
+      // maxsd/minsd return the second operand when the first does not
+      // compare greater/less, so with swapped operands these match std::max
+      // and std::min including for NaN and signed zeros
+      case calc_opcode::max_d:
+      case calc_opcode::min_d:
+        emit.load_double(x::xmm0, ins.a);
+        emit.load_double(x::xmm1, ins.b);
+        emit.bytes(
+          {
+            0xF2,
+            0x0F,
+            static_cast<std::uint8_t>(
+              (ins.op == calc_opcode::max_d) ? 0x5F : 0x5D
+            ),
+            0xC8                                // maxsd/minsd xmm1, xmm0
+          }
+        );
+        emit.store_double(ins.dst, x::xmm1);
+        break;
+      // comparison + logical operations
+      case calc_opcode::eq_b:
+        bool_binary({0x38, 0xC8, 0x0F, 0x94, 0xC0});  // cmp al, cl; sete al
+        break;
+      case calc_opcode::ne_b:
+        bool_binary({0x38, 0xC8, 0x0F, 0x95, 0xC0});  // cmp al, cl; setne al
+        break;
+      case calc_opcode::and_b:
+        bool_binary({0x20, 0xC8});                    // and al, cl
+        break;
+      case calc_opcode::or_b:
+        bool_binary({0x08, 0xC8});                    // or al, cl
+        break;
+      case calc_opcode::eq_l:
+        long_compare(0x94);                     // sete
+        break;
+      case calc_opcode::ne_l:
+        long_compare(0x95);                     // setne
+        break;
+      case calc_opcode::lt_l:
+        long_compare(0x9C);                     // setl
+        break;
+      case calc_opcode::gt_l:
+        long_compare(0x9F);                     // setg
+        break;
+      case calc_opcode::le_l:
+        long_compare(0x9E);                     // setle
+        break;
+      case calc_opcode::ge_l:
+        long_compare(0x9D);                     // setge
+        break;
+      // equality must also check parity for unordered operands
+      case calc_opcode::eq_d:
+        double_compare(
+          false,
+          {
+            0x0F, 0x94, 0xC0,                   // sete al
+            0x0F, 0x9B, 0xC1,                   // setnp cl
+            0x20, 0xC8                          // and al, cl
+          }
+        );
+        break;
+      case calc_opcode::ne_d:
+        double_compare(
+          false,
+          {
+            0x0F, 0x95, 0xC0,                   // setne al
+            0x0F, 0x9A, 0xC1,                   // setp cl
+            0x08, 0xC8                          // or al, cl
+          }
+        );
+        break;
+      case calc_opcode::lt_d:
+        double_compare(true, {0x0F, 0x97, 0xC0});   // seta al
+        break;
+      case calc_opcode::gt_d:
+        double_compare(false, {0x0F, 0x97, 0xC0});  // seta al
+        break;
+      case calc_opcode::le_d:
+        double_compare(true, {0x0F, 0x93, 0xC0});   // setae al
+        break;
+      case calc_opcode::ge_d:
+        double_compare(false, {0x0F, 0x93, 0xC0});  // setae al
+        break;
+      // statement terminators are handled by the caller
+      default:
+        emit.ret(0);
+        return;
+    }
+  }
+}
+#endif  // PDCALC_HAS_X86_64_JIT
+
+}  // namespace
+
+/**
+ * Dtor.
+ */
+calc_jit::~calc_jit()
+{
+#if PDCALC_HAS_X86_64_JIT
+  for (const auto& mem : chunks_)
+    ::munmap(mem.data, mem.size);
+#endif  // PDCALC_HAS_X86_64_JIT
+}
+
+/**
+ * Discard all compiled statements.
+ */
+void calc_jit::clear() noexcept
+{
+  for (auto& mem : chunks_)
+    mem.used = 0;
+  functions_.clear();
+  loads_.clear();
+  load_offsets_.assign(1, 0);
+}
+
+/**
+ * Compile the bytecode statements not yet compiled.
+ *
+ * @param bytecode Bytecode to compile
+ * @returns `true` on success, `false` if native code is not available
+ */
+bool calc_jit::compile(const calc_bytecode& bytecode)
+{
+#if PDCALC_HAS_X86_64_JIT
+  for (auto i = functions_.size(); i < bytecode.size(); i++) {
+    // statements without instructions have no function either
+    if (!bytecode.compiled(i)) {
+      functions_.push_back(nullptr);
+      load_offsets_.push_back(static_cast<std::uint32_t>(loads_.size()));
+      continue;
+    }
+    x86_64_emitter emit{loads_.get_allocator().resource()};
+    compile_statement(emit, bytecode.code(), bytecode.offset(i), loads_);
+    auto func = install(emit.code());
+    if (!func) {
+      loads_.resize(load_offsets_.back());
+      return false;
+    }
+    functions_.push_back(reinterpret_cast<function_type>(func));
+    load_offsets_.push_back(static_cast<std::uint32_t>(loads_.size()));
+  }
+  return true;
+#else
+  (void) bytecode;
+  return false;
+#endif  // !PDCALC_HAS_X86_64_JIT
+}
+
+/**
+ * Copy code into executable memory and return its address.
+ *
+ * The chunk being written is made writable and then executable again, so a
+ * page is never both writable and executable.
+ *
+ * @param code Code bytes
+ * @returns Code address or `nullptr` on failure
+ */
+const void* calc_jit::install(const std::pmr::vector<unsigned char>& code)
+{
+#if PDCALC_HAS_X86_64_JIT
+  // minimum chunk size + function alignment
+  constexpr std::size_t chunk_size = 1 << 16;
+  constexpr std::size_t align = 16;
+  // find chunk with enough space, mapping a new one if needed
+  auto it = std::find_if(
+    chunks_.begin(),
+    chunks_.end(),
+    [&code](const chunk& mem) { return mem.size - mem.used >= code.size(); }
+  );
+  if (it == chunks_.end()) {
+    auto size = std::max(chunk_size, code.size());
+    auto data = ::mmap(
+      nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (data == MAP_FAILED)
+      return nullptr;
+    chunks_.push_back({static_cast<unsigned char*>(data), size, 0});
+    it = chunks_.end() - 1;
+  }
+  // write code + make executable
+  if (::mprotect(it->data, it->size, PROT_READ | PROT_WRITE))
+    return nullptr;
+  auto func = it->data + it->used;
+  std::memcpy(func, code.data(), code.size());
+  it->used = std::min(
+    it->size, (it->used + code.size() + align - 1) & ~(align - 1)
+  );
+  if (::mprotect(it->data, it->size, PROT_READ | PROT_EXEC))
+    return nullptr;
+  return func;
+#else
+  (void) code;
+  return nullptr;
+#endif  // !PDCALC_HAS_X86_64_JIT
+}
+
+}  // namespace pdcalc
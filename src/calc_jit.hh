@@ -0,0 +1,155 @@
+/**
+ * @file calc_jit.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator x86-64 JIT compiler
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_JIT_HH_
+#define PDCALC_CALC_JIT_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "calc_bytecode.hh"
+
+// native code generation is only implemented for the x86-64 System V ABI
+#if defined(__x86_64__) && !defined(_WIN32)
+#define PDCALC_HAS_X86_64_JIT 1
+#else
+#define PDCALC_HAS_X86_64_JIT 0
+#endif  // !defined(__x86_64__) || defined(_WIN32)
+
+namespace pdcalc {
+
+/**
+ * JIT compiler translating VM bytecode statements into native x86-64 code.
+ *
+ * Each statement is compiled into a function that evaluates the statement
+ * expression into register 0 of the VM register file using scalar SSE2 and
+ * integer instructions, calling out to libm for the math builtins. Printing
+ * or storing the result is left to the caller.
+ *
+ * Generated code never throws. Symbol values must be loaded by the caller
+ * into the slot array in the order given by `loads`, and division by zero is
+ * reported by returning the index of the failing instruction plus one.
+ *
+ * Code is written into private anonymous mappings that are only made
+ * executable once written, so no page is ever both writable and executable.
+ */
+class calc_jit {
+public:
+  /**
+   * Compiled statement function type.
+   *
+   * Takes the register file and the loaded symbol value slots, returning zero
+   * on success or the index of the failing instruction plus one.
+   */
+  using function_type = std::uint32_t (*)(calc_register*, const calc_register*);
+
+  /**
+   * `true` if native code can be generated on this platform.
+   */
+  static constexpr bool available = PDCALC_HAS_X86_64_JIT;
+
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate compiler state from
+   */
+  explicit calc_jit(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : chunks_{resource},
+      functions_{resource},
+      loads_{resource},
+      load_offsets_(1, 0, resource)
+  {}
+
+  /**
+   * Deleted copy ctor.
+   */
+  calc_jit(const calc_jit&) = delete;
+
+  /**
+   * Dtor.
+   *
+   * Unmaps all the generated code.
+   */
+  ~calc_jit();
+
+  /**
+   * Discard all compiled statements.
+   *
+   * Code memory is kept so it can be reused by the next compile.
+   */
+  void clear() noexcept;
+
+  /**
+   * Return the number of compiled statements.
+   */
+  auto size() const noexcept { return functions_.size(); }
+
+  /**
+   * Return the function for a compiled statement.
+   *
+   * @param index Statement index
+   */
+  auto function(std::size_t index) const noexcept { return functions_[index]; }
+
+  /**
+   * Return the load instruction indices of a compiled statement.
+   *
+   * There is one load instruction per distinct symbol read by the statement
+   * and the value of the `i`th load instruction must be stored in slot `i`.
+   *
+   * @param index Statement index
+   * @returns Pair of pointers to the first and past the last index
+   */
+  std::pair<const std::uint32_t*, const std::uint32_t*>
+  loads(std::size_t index) const noexcept
+  {
+    return {
+      loads_.data() + load_offsets_[index],
+      loads_.data() + load_offsets_[index + 1]
+    };
+  }
+
+  /**
+   * Compile the bytecode statements not yet compiled.
+   *
+   * @param bytecode Bytecode to compile. Must be the same bytecode that any
+   *  previously compiled statements were compiled from.
+   * @returns `true` on success, `false` if native code is not available
+   */
+  bool compile(const calc_bytecode& bytecode);
+
+private:
+  /**
+   * Mapped code memory.
+   */
+  struct chunk {
+    unsigned char* data;  // mapping address
+    std::size_t size;     // mapping size
+    std::size_t used;     // bytes used
+  };
+
+  std::pmr::vector<chunk> chunks_;                // code memory
+  std::pmr::vector<function_type> functions_;     // statement functions
+  std::pmr::vector<std::uint32_t> loads_;         // load instruction indices
+  std::pmr::vector<std::uint32_t> load_offsets_;  // statement load offsets
+
+  /**
+   * Copy code into executable memory and return its address.
+   *
+   * @param code Code bytes
+   * @returns Code address or `nullptr` on failure
+   */
+  const void* install(const std::pmr::vector<unsigned char>& code);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_JIT_HH_
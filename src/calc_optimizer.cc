@@ -0,0 +1,656 @@
+/**
+ * @file calc_optimizer.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator program optimizer
+ * @copyright MIT License
+ */
+
+#include "calc_optimizer.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return the integral value with the given two's complement bits.
+ *
+ * Folded integral arithmetic is done on unsigned values so that overflow
+ * wraps as it does when evaluated instead of being undefined at compile time.
+ *
+ * @param bits Value bits
+ */
+constexpr long wrap(unsigned long bits) noexcept
+{
+  return static_cast<long>(bits);
+}
+
+/**
+ * Return the exponent if the value is a positive power of two, else -1.
+ *
+ * @param value Integral value
+ */
+int log2_exact(long value) noexcept
+{
+  if (value <= 1 || (value & (value - 1)))
+    return -1;
+  int k = 0;
+  while (value >>= 1)
+    k++;
+  return k;
+}
+
+/**
+ * Return the value type corresponding to a C++ type.
+ *
+ * @tparam T `bool`, `long`, or `double`
+ */
+template <typename T>
+constexpr calc_value_type value_type() noexcept
+{
+  if constexpr (std::is_same_v<T, bool>)
+    return calc_value_type::boolean;
+  else if constexpr (std::is_same_v<T, long>)
+    return calc_value_type::integral;
+  else
+    return calc_value_type::floating;
+}
+
+}  // namespace
+
+/**
+ * Hash a node for value numbering.
+ *
+ * @param node Node to hash
+ */
+std::size_t calc_optimizer::node_hash::operator()(
+  const calc_node& node) const noexcept
+{
+  auto bits = (std::uint64_t{node.left} << 32) | node.right;
+  auto kind = (static_cast<std::uint64_t>(node.op) << 8) |
+    static_cast<std::uint64_t>(node.type);
+  // multiply by 2^64 / golden ratio to spread the operation bits
+  return std::hash<std::uint64_t>{}(bits ^ (kind * 0x9E3779B97F4A7C15));
+}
+
+/**
+ * Compare nodes for value numbering.
+ *
+ * @param a First node
+ * @param b Second node
+ */
+bool calc_optimizer::node_equal::operator()(
+  const calc_node& a, const calc_node& b) const noexcept
+{
+  return a.op == b.op && a.type == b.type && a.left == b.left &&
+    a.right == b.right;
+}
+
+/**
+ * Optimize the expression of a statement.
+ *
+ * @param program Program containing the statement
+ * @param statement Statement index
+ */
+void calc_optimizer::optimize(calc_program& program, std::uint32_t statement)
+{
+  // nodes are never shared between statements
+  values_.clear();
+  program.root(
+    statement, rewrite(program, program.statements()[statement].root)
+  );
+}
+
+/**
+ * Rebuild an expression node with its operands optimized.
+ *
+ * Promoted operands of a division are not folded so that division by zero
+ * errors still format them as integers.
+ *
+ * Nodes are rebuilt bottom-up with an explicit stack instead of recursion so
+ * that long expressions, e.g. a chain of additions, cannot overflow the call
+ * stack. Operands are rebuilt from left to right as before.
+ *
+ * @param program Program containing the expression
+ * @param index Node index
+ * @returns Index of the optimized node
+ */
+std::uint32_t calc_optimizer::rewrite(
+  calc_program& program, std::uint32_t index)
+{
+  frames_.clear();
+  rewritten_.clear();
+  // copy nodes as adding nodes can reallocate the program nodes
+  frames_.push_back({program.nodes()[index], index, 0, false});
+  while (frames_.size()) {
+    auto& top = frames_.back();
+    auto n_operands = calc_is_binary(top.node.op) ? 2u :
+      (calc_is_leaf(top.node.op) ? 0u : 1u);
+    if (top.operands < n_operands) {
+      auto operand = top.operands++ ? top.node.right : top.node.left;
+      const auto& operand_node = program.nodes()[operand];
+      auto promoted = top.node.op == calc_op::divide &&
+        operand_node.op == calc_op::to_double;
+      frames_.push_back({operand_node, operand, 0, promoted});
+      continue;
+    }
+    auto node = top.node;
+    if (n_operands == 2) {
+      node.right = rewritten_.back();
+      rewritten_.pop_back();
+    }
+    if (n_operands) {
+      node.left = rewritten_.back();
+      rewritten_.pop_back();
+    }
+    rewritten_.push_back(
+      (!n_operands || top.promoted) ?
+        make(program, node, top.index) : simplify(program, node, top.index)
+    );
+    frames_.pop_back();
+  }
+  return rewritten_.back();
+}
+
+/**
+ * Optimize an operation node with optimized operands.
+ *
+ * @param program Program containing the expression
+ * @param node Operation node
+ * @param hint Index of the original node or `no_node`
+ * @returns Index of the optimized node
+ */
+std::uint32_t calc_optimizer::simplify(
+  calc_program& program, const calc_node& node, std::uint32_t hint)
+{
+  if (auto index = fold(program, node); index != no_node)
+    return index;
+  if (auto index = reduce(program, node); index != no_node)
+    return index;
+  return make(program, node, hint);
+}
+
+/**
+ * Return the constant value of a node if it has one.
+ *
+ * @tparam T `bool`, `long`, or `double`
+ *
+ * @param program Program containing the node
+ * @param index Node index
+ */
+template <typename T>
+std::optional<T> calc_optimizer::constant(
+  const calc_program& program, std::uint32_t index) noexcept
+{
+  const auto& node = program.nodes()[index];
+  if (node.op == calc_op::literal && node.type == value_type<T>())
+    return node.value<T>();
+  if constexpr (std::is_same_v<T, double>) {
+    if (node.op == calc_op::to_double) {
+      const auto& operand = program.nodes()[node.left];
+      if (operand.op == calc_op::literal)
+        return static_cast<double>(operand.value<long>());
+    }
+  }
+  return {};
+}
+
+/**
+ * Fold an operation on constant operands into a literal.
+ *
+ * The operations are evaluated exactly as they are when the statement is
+ * evaluated so the folded values are identical.
+ *
+ * @param program Program containing the expression
+ * @param node Operation node
+ * @returns Index of the literal node or `no_node` if the operation cannot be
+ *  folded without changing its result
+ */
+std::uint32_t calc_optimizer::fold(calc_program& program, const calc_node& node)
+{
+  using unsigned_long = unsigned long;
+  auto type = program.nodes()[node.left].type;
+  // unary operations
+  if (!calc_is_binary(node.op)) {
+    switch (type) {
+      case calc_value_type::boolean: {
+        auto a = constant<bool>(program, node.left);
+        if (!a)
+          return no_node;
+        return literal(program, !*a);
+      }
+      case calc_value_type::integral: {
+        auto a = constant<long>(program, node.left);
+        if (!a)
+          return no_node;
+        switch (node.op) {
+          case calc_op::to_double:
+            return literal(program, static_cast<double>(*a));
+          case calc_op::negate:
+            return literal(program, wrap(0UL - unsigned_long(*a)));
+          case calc_op::bit_not:
+            return literal(program, ~*a);
+          default:
+            return no_node;
+        }
+      }
+      case calc_value_type::floating: {
+        auto a = constant<double>(program, node.left);
+        if (!a)
+          return no_node;
+        switch (node.op) {
+          case calc_op::negate:
+            return literal(program, -*a);
+          case calc_op::exp:
+            return literal(program, std::exp(*a));
+          case calc_op::log:
+            return literal(program, std::log(*a));
+          case calc_op::log2:
+            return literal(program, std::log2(*a));
+          case calc_op::log10:
+            return literal(program, std::log10(*a));
+          case calc_op::sqrt:
+            return literal(program, std::sqrt(*a));
+          case calc_op::sin:
+            return literal(program, std::sin(*a));
+          case calc_op::cos:
+            return literal(program, std::cos(*a));
+          case calc_op::tan:
+            return literal(program, std::tan(*a));
+          default:
+            return no_node;
+        }
+      }
+    }
+    return no_node;
+  }
+  // binary operations
+  switch (type) {
+    case calc_value_type::boolean: {
+      auto a = constant<bool>(program, node.left);
+      auto b = constant<bool>(program, node.right);
+      if (!a || !b)
+        return no_node;
+      switch (node.op) {
+        case calc_op::equal:
+          return literal(program, *a == *b);
+        case calc_op::not_equal:
+          return literal(program, *a != *b);
+        case calc_op::logical_and:
+          return literal(program, *a && *b);
+        case calc_op::logical_or:
+          return literal(program, *a || *b);
+        default:
+          return no_node;
+      }
+    }
+    case calc_value_type::integral: {
+      auto a = constant<long>(program, node.left);
+      auto b = constant<long>(program, node.right);
+      if (!a || !b)
+        return no_node;
+      // division by zero, the overflowing division, and shifts out of range
+      // are errors or undefined behavior so they are left as they are
+      auto divisible = *b && !(
+        *a == std::numeric_limits<long>::min() && *b == -1
+      );
+      auto shiftable = *b >= 0 && *b < std::numeric_limits<long>::digits;
+      switch (node.op) {
+        case calc_op::add:
+          return literal(program, wrap(unsigned_long(*a) + unsigned_long(*b)));
+        case calc_op::subtract:
+          return literal(program, wrap(unsigned_long(*a) - unsigned_long(*b)));
+        case calc_op::multiply:
+          return literal(program, wrap(unsigned_long(*a) * unsigned_long(*b)));
+        case calc_op::divide:
+          return divisible ? literal(program, *a / *b) : no_node;
+        case calc_op::modulo:
+          return divisible ? literal(program, *a % *b) : no_node;
+        case calc_op::bit_and:
+          return literal(program, *a & *b);
+        case calc_op::bit_xor:
+          return literal(program, *a ^ *b);
+        case calc_op::bit_or:
+          return literal(program, *a | *b);
+        case calc_op::lshift:
+          if (!shiftable)
+            return no_node;
+          return literal(program, wrap(unsigned_long(*a) << *b));
+        case calc_op::rshift:
+          return shiftable ? literal(program, *a >> *b) : no_node;
+        case calc_op::max:
+          return literal(program, std::max(*a, *b));
+        case calc_op::min:
+          return literal(program, std::min(*a, *b));
+        case calc_op::equal:
+          return literal(program, *a == *b);
+        case calc_op::not_equal:
+          return literal(program, *a != *b);
+        case calc_op::less:
+          return literal(program, *a < *b);
+        case calc_op::greater:
+          return literal(program, *a > *b);
+        case calc_op::less_equal:
+          return literal(program, *a <= *b);
+        case calc_op::greater_equal:
+          return literal(program, *a >= *b);
+        default:
+          return no_node;
+      }
+    }
+    case calc_value_type::floating: {
+      auto a = constant<double>(program, node.left);
+      auto b = constant<double>(program, node.right);
+      if (!a || !b)
+        return no_node;
+      switch (node.op) {
+        case calc_op::add:
+          return literal(program, *a + *b);
+        case calc_op::subtract:
+          return literal(program, *a - *b);
+        case calc_op::multiply:
+          return literal(program, *a * *b);
+        case calc_op::divide:
+          return *b ? literal(program, *a / *b) : no_node;
+        case calc_op::max:
+          return literal(program, std::max(*a, *b));
+        case calc_op::min:
+          return literal(program, std::min(*a, *b));
+        case calc_op::equal:
+          return literal(program, *a == *b);
+        case calc_op::not_equal:
+          return literal(program, *a != *b);
+        case calc_op::less:
+          return literal(program, *a < *b);
+        case calc_op::greater:
+          return literal(program, *a > *b);
+        case calc_op::less_equal:
+          return literal(program, *a <= *b);
+        case calc_op::greater_equal:
+          return literal(program, *a >= *b);
+        default:
+          return no_node;
+      }
+    }
+  }
+  return no_node;
+}
+
+/**
+ * Apply strength reduction and algebraic simplification to a node.
+ *
+ * Only rules that give identical results for every operand value, including
+ * NaN and signed zeros, are applied. Rules never drop an operand that could
+ * raise an error, e.g. `x * 0` is not simplified as `x` could be undefined.
+ *
+ * @param program Program containing the expression
+ * @param node Operation node
+ * @returns Index of the simplified node or `no_node` if no rule applies
+ */
+std::uint32_t calc_optimizer::reduce(
+  calc_program& program, const calc_node& node)
+{
+  // copy as adding nodes can reallocate the program nodes
+  auto operand = program.nodes()[node.left];
+  // -(-x), ~(~x), !(!x) are all x
+  if (!calc_is_binary(node.op)) {
+    switch (node.op) {
+      case calc_op::negate:
+      case calc_op::bit_not:
+      case calc_op::logical_not:
+        return (operand.op == node.op) ? operand.left : no_node;
+      default:
+        return no_node;
+    }
+  }
+  // simplify with constant operand values
+  auto simplify_with = [&, this](auto a, auto b) -> std::uint32_t
+  {
+    using T = typename decltype(a)::value_type;
+    // x * 2 is x + x
+    auto twice = [&, this](std::uint32_t x)
+    {
+      return simplify(
+        program, {calc_op::add, node.type, x, x}, no_node
+      );
+    };
+    switch (node.op) {
+      case calc_op::add:
+        if constexpr (std::is_same_v<T, long>) {
+          if (b == T{})
+            return node.left;
+          if (a == T{})
+            return node.right;
+        }
+        return no_node;
+      case calc_op::subtract:
+        // x - 0. is x for every x, including -0. and NaN
+        if (b == T{} && !std::signbit(static_cast<double>(*b)))
+          return node.left;
+        return no_node;
+      case calc_op::multiply:
+        if (b == T{1})
+          return node.left;
+        if (a == T{1})
+          return node.right;
+        if (b == T{2})
+          return twice(node.left);
+        if (a == T{2})
+          return twice(node.right);
+        return no_node;
+      case calc_op::divide:
+        if (!b)
+          return no_node;
+        if constexpr (std::is_same_v<T, long>) {
+          if (*b == 1)
+            return node.left;
+          // truncating division is only a shift for non-negative dividends
+          auto k = log2_exact(*b);
+          if (k > 0 && non_negative(program, node.left))
+            return simplify(
+              program,
+              {
+                calc_op::rshift,
+                node.type,
+                node.left,
+                literal(program, static_cast<long>(k))
+              },
+              no_node
+            );
+        }
+        else {
+          // multiplying by the reciprocal is exact for powers of two
+          int exponent;
+          auto recip = 1. / *b;
+          if (
+            std::isnormal(*b) && std::isnormal(recip) &&
+            std::frexp(*b, &exponent) == (*b < 0 ? -0.5 : 0.5)
+          )
+            return simplify(
+              program,
+              {
+                calc_op::multiply,
+                node.type,
+                node.left,
+                literal(program, recip)
+              },
+              no_node
+            );
+        }
+        return no_node;
+      default:
+        return no_node;
+    }
+  };
+  switch (operand.type) {
+    case calc_value_type::boolean: {
+      auto a = constant<bool>(program, node.left);
+      auto b = constant<bool>(program, node.right);
+      if (node.op == calc_op::logical_and) {
+        if (b == true)
+          return node.left;
+        if (a == true)
+          return node.right;
+      }
+      else if (node.op == calc_op::logical_or) {
+        if (b == false)
+          return node.left;
+        if (a == false)
+          return node.right;
+      }
+      return no_node;
+    }
+    case calc_value_type::integral: {
+      auto a = constant<long>(program, node.left);
+      auto b = constant<long>(program, node.right);
+      switch (node.op) {
+        case calc_op::modulo: {
+          // remainder is a mask for non-negative dividends
+          auto k = b ? log2_exact(*b) : -1;
+          if (k > 0 && non_negative(program, node.left))
+            return simplify(
+              program,
+              {
+                calc_op::bit_and,
+                node.type,
+                node.left,
+                literal(program, *b - 1)
+              },
+              no_node
+            );
+          return no_node;
+        }
+        case calc_op::bit_and:
+          if (b == -1L)
+            return node.left;
+          if (a == -1L)
+            return node.right;
+          return no_node;
+        case calc_op::bit_xor:
+        case calc_op::bit_or:
+          if (b == 0L)
+            return node.left;
+          if (a == 0L)
+            return node.right;
+          return no_node;
+        case calc_op::lshift:
+        case calc_op::rshift:
+          return (b == 0L) ? node.left : no_node;
+        default:
+          return simplify_with(a, b);
+      }
+    }
+    case calc_value_type::floating:
+      return simplify_with(
+        constant<double>(program, node.left),
+        constant<double>(program, node.right)
+      );
+  }
+  return no_node;
+}
+
+/**
+ * Return `true` if an integral node value can never be negative.
+ *
+ * The answer is `false` for expressions more than `max_sign_depth`
+ * operations deep, which only means a strength reduction is not applied.
+ *
+ * @param program Program containing the node
+ * @param index Node index
+ * @param depth Number of operations already looked through
+ */
+bool calc_optimizer::non_negative(
+  const calc_program& program, std::uint32_t index, unsigned depth)
+{
+  // give up on deep expressions rather than risk overflowing the call stack
+  if (depth++ > max_sign_depth)
+    return false;
+  const auto& node = program.nodes()[index];
+  switch (node.op) {
+    case calc_op::literal:
+      return node.value<long>() >= 0;
+    case calc_op::bit_and:
+    case calc_op::max:
+      return non_negative(program, node.left, depth) ||
+        non_negative(program, node.right, depth);
+    case calc_op::min:
+    case calc_op::divide:
+      return non_negative(program, node.left, depth) &&
+        non_negative(program, node.right, depth);
+    // remainder and shift results have the sign of the left operand
+    case calc_op::modulo:
+    case calc_op::rshift:
+      return non_negative(program, node.left, depth);
+    default:
+      return false;
+  }
+}
+
+/**
+ * Return the index of a node with the given value, adding it if necessary.
+ *
+ * @param program Program to add the node to
+ * @param node Node to find or add
+ * @param hint Index of the original node, reused if identical, or `no_node`
+ */
+std::uint32_t calc_optimizer::make(
+  calc_program& program, const calc_node& node, std::uint32_t hint)
+{
+  auto it = values_.find(node);
+  if (it != values_.end())
+    return it->second;
+  std::uint32_t index;
+  if (hint != no_node && node_equal{}(program.nodes()[hint], node))
+    index = hint;
+  else {
+    index = program.node(node.op, node.type, node.left, node.right);
+    // errors are still reported at the location of the original node
+    if (auto loc = (hint != no_node) ? program.node_location(hint) : nullptr) {
+      auto copy = *loc;
+      copy.node = index;
+      program.locate_node(copy);
+    }
+  }
+  values_.emplace(node, index);
+  return index;
+}
+
+/**
+ * Return the index of a literal node, adding it if necessary.
+ *
+ * @tparam T `bool`, `long`, or `double`
+ *
+ * @param program Program to add the node to
+ * @param value Literal value
+ */
+template <typename T>
+std::uint32_t calc_optimizer::literal(calc_program& program, T value)
+{
+  std::uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof value);
+  calc_node node{
+    calc_op::literal,
+    value_type<T>(),
+    static_cast<std::uint32_t>(bits),
+    static_cast<std::uint32_t>(bits >> 32)
+  };
+  auto it = values_.find(node);
+  if (it != values_.end())
+    return it->second;
+  auto index = program.literal(value);
+  values_.emplace(node, index);
+  return index;
+}
+
+}  // namespace pdcalc
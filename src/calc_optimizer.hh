@@ -0,0 +1,188 @@
+/**
+ * @file calc_optimizer.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator program optimizer
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_OPTIMIZER_HH_
+#define PDCALC_CALC_OPTIMIZER_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+/**
+ * Optimizer rewriting statement expressions of a `calc_program`.
+ *
+ * Each statement expression is rebuilt bottom-up with the following passes
+ * applied to each node as it is rebuilt:
+ *
+ * 1. Constant folding of operations on literals. Operations that fail or
+ *    have undefined behavior, e.g. division by zero, are left as they are so
+ *    the same error is raised when the statement is evaluated.
+ * 2. Strength reduction and algebraic simplification that are exact for all
+ *    operand values, e.g. `x * 2` becomes `x + x` and an integral division by
+ *    a power of two becomes a shift when the dividend cannot be negative.
+ * 3. Common subexpression elimination by value numbering, so that identical
+ *    subexpressions, e.g. repeated builtin calls, become a single node.
+ *
+ * No subexpression that could raise an error is ever removed, so optimized
+ * statements raise the same errors as the unoptimized statements. Nodes are
+ * only appended, with unchanged nodes reused, so the nodes of the expression
+ * as written are still available after optimization.
+ */
+class calc_optimizer {
+public:
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate optimizer state from
+   */
+  explicit calc_optimizer(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : values_{resource}, frames_{resource}, rewritten_{resource}
+  {}
+
+  /**
+   * Optimize the expression of a statement.
+   *
+   * This must be called before the next statement is added to the program.
+   *
+   * @param program Program containing the statement
+   * @param statement Statement index
+   */
+  void optimize(calc_program& program, std::uint32_t statement);
+
+private:
+  static constexpr auto no_node = std::numeric_limits<std::uint32_t>::max();
+  // operations non_negative looks through before giving up
+  static constexpr unsigned max_sign_depth = 64;
+
+  /**
+   * Hash for value numbering nodes.
+   */
+  struct node_hash {
+    std::size_t operator()(const calc_node& node) const noexcept;
+  };
+
+  /**
+   * Equality for value numbering nodes.
+   */
+  struct node_equal {
+    bool operator()(const calc_node& a, const calc_node& b) const noexcept;
+  };
+
+  // index of the node computing each value in the current statement
+  std::pmr::unordered_map<calc_node, std::uint32_t, node_hash, node_equal>
+    values_;
+
+  /**
+   * Expression node being rewritten without recursion.
+   */
+  struct frame {
+    calc_node node;          // node with the operands rewritten so far
+    std::uint32_t index;     // node index
+    std::uint32_t operands;  // number of operands visited
+    bool promoted;           // promoted division operand, not folded
+  };
+
+  std::pmr::vector<frame> frames_;             // nodes being rewritten
+  std::pmr::vector<std::uint32_t> rewritten_;  // rewritten operand indices
+
+  /**
+   * Rebuild an expression node with its operands optimized.
+   *
+   * @param program Program containing the expression
+   * @param index Node index
+   * @returns Index of the optimized node
+   */
+  std::uint32_t rewrite(calc_program& program, std::uint32_t index);
+
+  /**
+   * Optimize an operation node with optimized operands.
+   *
+   * @param program Program containing the expression
+   * @param node Operation node
+   * @param hint Index of the original node or `no_node`
+   * @returns Index of the optimized node
+   */
+  std::uint32_t simplify(
+    calc_program& program, const calc_node& node, std::uint32_t hint);
+
+  /**
+   * Return the constant value of a node if it has one.
+   *
+   * Promotions of integral literals are also constant.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param program Program containing the node
+   * @param index Node index
+   */
+  template <typename T>
+  static std::optional<T>
+  constant(const calc_program& program, std::uint32_t index) noexcept;
+
+  /**
+   * Fold an operation on constant operands into a literal.
+   *
+   * @param program Program containing the expression
+   * @param node Operation node
+   * @returns Index of the literal node or `no_node` if the operation cannot
+   *  be folded without changing its result
+   */
+  std::uint32_t fold(calc_program& program, const calc_node& node);
+
+  /**
+   * Apply strength reduction and algebraic simplification to a node.
+   *
+   * @param program Program containing the expression
+   * @param node Operation node
+   * @returns Index of the simplified node or `no_node` if no rule applies
+   */
+  std::uint32_t reduce(calc_program& program, const calc_node& node);
+
+  /**
+   * Return `true` if an integral node value can never be negative.
+   *
+   * @param program Program containing the node
+   * @param index Node index
+   * @param depth Number of operations already looked through
+   */
+  static bool non_negative(
+    const calc_program& program, std::uint32_t index, unsigned depth = 0);
+
+  /**
+   * Return the index of a node with the given value, adding it if necessary.
+   *
+   * @param program Program to add the node to
+   * @param node Node to find or add
+   * @param hint Index of the original node, reused if identical, or `no_node`
+   */
+  std::uint32_t make(
+    calc_program& program, const calc_node& node, std::uint32_t hint);
+
+  /**
+   * Return the index of a literal node, adding it if necessary.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param program Program to add the node to
+   * @param value Literal value
+   */
+  template <typename T>
+  std::uint32_t literal(calc_program& program, T value);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_OPTIMIZER_HH_
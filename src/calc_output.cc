@@ -0,0 +1,170 @@
+/**
+ * @file calc_output.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator buffered result output
+ * @copyright MIT License
+ */
+
+#include "calc_output.hh"
+
+#include <charconv>
+#include <cstddef>
+#include <ios>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Append a result line formatted with `std::to_chars` to a buffer.
+ *
+ * @tparam F Callable taking `(char* first, char* last)` and returning the
+ *  `std::to_chars_result` from formatting the value into `[first, last)`
+ *
+ * @param buffer Buffer to append to
+ * @param prefix Type prefix written before the value
+ * @param max_size Maximum number of characters the value can take
+ * @param format Callable formatting the value
+ */
+template <typename F>
+void append_line(
+  std::pmr::string& buffer,
+  std::string_view prefix,
+  std::size_t max_size,
+  F format)
+{
+  buffer += prefix;
+  // format in place in the buffer tail then trim to what was written
+  auto offset = buffer.size();
+  buffer.resize(offset + max_size);
+  auto first = buffer.data() + offset;
+  auto [ptr, ec] = format(first, first + max_size);
+  // max_size is always large enough for the value so this cannot fail
+  if (ec != std::errc{})
+    ptr = first;
+  buffer.resize(offset + static_cast<std::size_t>(ptr - first));
+  buffer += '\n';
+}
+
+}  // namespace
+
+void calc_output::print(bool value)
+{
+  buffer_ += value ? "<bool> true\n" : "<bool> false\n";
+  end_statement();
+}
+
+void calc_output::print(long value)
+{
+  // digits10 + 1 digits plus the sign
+  append_line(
+    buffer_,
+    "<long> ",
+    std::numeric_limits<long>::digits10 + 2,
+    [value](char* first, char* last)
+    {
+      return std::to_chars(first, last, value);
+    }
+  );
+  end_statement();
+}
+
+void calc_output::print(double value)
+{
+  // the general format is %g with the sink precision, as operator<< would
+  // write with default format flags, while the shortest format has at most
+  // max_digits10 digits. both have at most a sign, a decimal point, and a
+  // 5-character exponent, or up to 4 leading zeros instead of an exponent
+  constexpr std::size_t extra_size = 16;
+  if (double_format_ == calc_double_format::shortest)
+    append_line(
+      buffer_,
+      "<double> ",
+      std::numeric_limits<double>::max_digits10 + extra_size,
+      [value](char* first, char* last)
+      {
+        return std::to_chars(first, last, value);
+      }
+    );
+  else {
+    // as for %g, negative precision is 6 and zero precision is treated as one
+    auto precision = static_cast<int>(sink_.precision());
+    if (precision < 0)
+      precision = 6;
+    else if (precision == 0)
+      precision = 1;
+    append_line(
+      buffer_,
+      "<double> ",
+      static_cast<std::size_t>(precision) + extra_size,
+      [value, precision](char* first, char* last)
+      {
+        return std::to_chars(
+          first, last, value, std::chars_format::general, precision
+        );
+      }
+    );
+  }
+  end_statement();
+}
+
+void calc_output::print_error()
+{
+  buffer_ += "<error>\n";
+  end_statement();
+}
+
+void calc_output::visit(
+  std::size_t statement,
+  const calc_location& location,
+  const calc_symbol::value_type& value)
+{
+  (void) statement;
+  (void) location;
+  std::visit([this](auto v) { print(v); }, value);
+}
+
+void calc_output::visit_error(
+  std::size_t statement,
+  const calc_location& location,
+  std::string_view message)
+{
+  (void) statement;
+  (void) location;
+  (void) message;
+  print_error();
+}
+
+void calc_output::flush()
+{
+  if (!buffer_.empty()) {
+    sink_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+  sink_.flush();
+}
+
+void calc_output::end_statement()
+{
+  switch (flush_policy_) {
+    case calc_flush_policy::statement:
+      flush();
+      break;
+    case calc_flush_policy::bytes:
+      if (buffer_.size() >= flush_bytes_)
+        flush();
+      break;
+    case calc_flush_policy::end:
+      break;
+  }
+}
+
+}  // namespace pdcalc
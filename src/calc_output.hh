@@ -0,0 +1,170 @@
+/**
+ * @file calc_output.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator buffered result output
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_OUTPUT_HH_
+#define PDCALC_CALC_OUTPUT_HH_
+
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+
+namespace pdcalc {
+
+/**
+ * Buffered writer of statement results to the sink.
+ *
+ * This is the default result visitor of a parser, writing each result as its
+ * type in angle brackets followed by its value, e.g. `<long> 5`.
+ *
+ * Results are formatted with `std::to_chars` into a buffer that is written to
+ * the sink according to the flush policy, avoiding locale-aware stream
+ * formatting and flushing the sink after every statement. The text format is
+ * the same as writing the value to a default-formatted stream.
+ *
+ * `flush` must be called when a parse or run ends so that no output is left
+ * in the buffer, whatever the policy.
+ */
+class calc_output final : public calc_result_visitor {
+public:
+  /**
+   * Default number of buffered bytes written at once with `bytes` policy.
+   */
+  static constexpr std::size_t default_flush_bytes = 1 << 16;
+
+  /**
+   * Ctor.
+   *
+   * @param sink Stream to write to
+   * @param resource Resource to allocate the buffer from
+   */
+  calc_output(std::ostream& sink, std::pmr::memory_resource* resource)
+    : sink_{sink}, buffer_{resource}
+  {}
+
+  /**
+   * Return reference to the stream written to.
+   */
+  auto& sink() const noexcept { return sink_; }
+
+  /**
+   * Return when buffered output is written to the sink.
+   */
+  auto flush_policy() const noexcept { return flush_policy_; }
+
+  /**
+   * Set when buffered output is written to the sink.
+   *
+   * @param policy Flush policy
+   */
+  void flush_policy(calc_flush_policy policy) noexcept
+  {
+    flush_policy_ = policy;
+  }
+
+  /**
+   * Return the number of buffered bytes written at once with `bytes` policy.
+   */
+  auto flush_bytes() const noexcept { return flush_bytes_; }
+
+  /**
+   * Set the number of buffered bytes written at once with `bytes` policy.
+   *
+   * @param n_bytes Number of bytes, where zero writes every statement
+   */
+  void flush_bytes(std::size_t n_bytes) noexcept { flush_bytes_ = n_bytes; }
+
+  /**
+   * Return how double results are formatted.
+   */
+  auto double_format() const noexcept { return double_format_; }
+
+  /**
+   * Set how double results are formatted.
+   *
+   * @param format Double format
+   */
+  void double_format(calc_double_format format) noexcept
+  {
+    double_format_ = format;
+  }
+
+  /**
+   * Write a statement result.
+   *
+   * @param value Result value
+   */
+  void print(bool value);
+
+  /**
+   * Write a statement result.
+   *
+   * @param value Result value
+   */
+  void print(long value);
+
+  /**
+   * Write a statement result.
+   *
+   * @param value Result value
+   */
+  void print(double value);
+
+  /**
+   * Write the marker of a statement that failed.
+   */
+  void print_error();
+
+  /**
+   * Write a statement result.
+   *
+   * @param statement Statement index in program order
+   * @param location Statement location
+   * @param value Result value
+   */
+  void visit(
+    std::size_t statement,
+    const calc_location& location,
+    const calc_symbol::value_type& value) override;
+
+  /**
+   * Write the marker of a statement that failed.
+   *
+   * @param statement Statement index in program order
+   * @param location Error location
+   * @param message Error message without the location
+   */
+  void visit_error(
+    std::size_t statement,
+    const calc_location& location,
+    std::string_view message) override;
+
+  /**
+   * Write any buffered output to the sink and flush the sink.
+   */
+  void flush() override;
+
+private:
+  std::ostream& sink_;                            // stream to write to
+  std::pmr::string buffer_;                       // buffered output
+  calc_flush_policy flush_policy_{};              // when to write to sink
+  std::size_t flush_bytes_{default_flush_bytes};  // bytes buffered to write
+  calc_double_format double_format_{};            // double format
+
+  /**
+   * Write buffered output to the sink if required by the flush policy.
+   */
+  void end_statement();
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_OUTPUT_HH_
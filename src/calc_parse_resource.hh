@@ -0,0 +1,91 @@
+/**
+ * @file calc_parse_resource.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator per-parse memory resource
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_PARSE_RESOURCE_HH_
+#define PDCALC_CALC_PARSE_RESOURCE_HH_
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace pdcalc {
+
+/**
+ * Memory resource for state that only lives until the next parse.
+ *
+ * This covers the compiled program, its bytecode, and the lexer buffers.
+ * Allocations are forwarded to the upstream resource unless arena mode is
+ * enabled, in which case they are served by a monotonic arena on top of the
+ * upstream resource. Deallocation into the arena does nothing and the whole
+ * arena is released at once by `reset`, so a parse never returns memory to the
+ * upstream resource piece by piece.
+ */
+class calc_parse_resource : public std::pmr::memory_resource {
+public:
+  /**
+   * Ctor.
+   *
+   * @param upstream Resource to allocate from, also used by the arena
+   */
+  explicit calc_parse_resource(std::pmr::memory_resource* upstream) noexcept
+    : upstream_{upstream}, arena_{upstream}
+  {}
+
+  /**
+   * Return the upstream resource.
+   */
+  auto upstream() const noexcept { return upstream_; }
+
+  /**
+   * Return `true` if allocations are served by the arena.
+   */
+  bool arena() const noexcept { return arena_enabled_; }
+
+  /**
+   * Release the arena and set whether the arena is used from now on.
+   *
+   * No memory allocated through the resource may be in use when this is
+   * called, as memory allocated from the arena is invalidated and memory
+   * allocated from the upstream resource is no longer deallocated.
+   *
+   * @param enable `true` to serve allocations from the arena
+   */
+  void reset(bool enable) noexcept
+  {
+    arena_.release();
+    arena_enabled_ = enable;
+  }
+
+private:
+  std::pmr::memory_resource* upstream_;        // upstream resource
+  std::pmr::monotonic_buffer_resource arena_;  // per-parse arena
+  bool arena_enabled_{};                       // allocate from the arena
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    if (arena_enabled_)
+      return arena_.allocate(bytes, alignment);
+    return upstream_->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(
+    void* p, std::size_t bytes, std::size_t alignment) override
+  {
+    // arena memory is only released by reset
+    if (!arena_enabled_)
+      upstream_->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_PARSE_RESOURCE_HH_
@@ -7,21 +7,51 @@
 
 #include "pdcalc/calc_parser.hh"
 
+#include <cstddef>
 #include <filesystem>
+#include <memory_resource>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "pdcalc/calc_symbol.hh"
 #include "calc_parser_impl.hh"
 
 namespace pdcalc {
 
+/**
+ * Dtor.
+ */
+calc_result_visitor::~calc_result_visitor() = default;
+
+/**
+ * Dtor.
+ */
+calc_token_visitor::~calc_token_visitor() = default;
+
 /**
  * Ctor.
  *
  * @param sink Stream to write all non-error output to, default `std::cout`
  */
 calc_parser::calc_parser(std::ostream& sink)
-  : impl_{new calc_parser_impl{sink}}
+  : calc_parser{sink, std::pmr::get_default_resource()}
+{}
+
+/**
+ * Ctor.
+ *
+ * The implementation is itself allocated from the memory resource, which it
+ * records so that the unchanged `delete` in the dtor returns it there.
+ *
+ * @param sink Stream to write all non-error output to
+ * @param resource Memory resource to allocate from
+ */
+calc_parser::calc_parser(
+  std::ostream& sink, std::pmr::memory_resource* resource)
+  : impl_{new(resource) calc_parser_impl{sink, resource}}
 {}
 
 /**
@@ -43,6 +73,26 @@ std::ostream& calc_parser::sink() const noexcept
   return impl_->sink();
 }
 
+/**
+ * Return the visitor receiving statement results.
+ */
+calc_result_visitor& calc_parser::visitor() const noexcept
+{
+  return impl_->visitor();
+}
+
+/**
+ * Set the visitor receiving statement results.
+ *
+ * @param visitor Visitor to use, `nullptr` to write results to the sink
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::visitor(calc_result_visitor* visitor)
+{
+  impl_->visitor(visitor);
+  return *this;
+}
+
 /**
  * Parse the specified input file.
  *
@@ -57,6 +107,546 @@ bool calc_parser::parse(
   return impl_->parse(input_file, trace_lexer, trace_parser);
 }
 
+/**
+ * Parse the specified in-memory input.
+ *
+ * @param source Input text and name
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::parse(
+  const calc_source& source, bool trace_lexer, bool trace_parser)
+{
+  return impl_->parse(source, trace_lexer, trace_parser);
+}
+
+/**
+ * Parse a batch of in-memory inputs in order.
+ *
+ * @param sources Pointer to first of `n_sources` inputs
+ * @param n_sources Number of inputs
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::parse(
+  const calc_source* sources,
+  std::size_t n_sources,
+  bool trace_lexer,
+  bool trace_parser)
+{
+  for (std::size_t i = 0; i < n_sources; i++)
+    if (!impl_->parse(sources[i], trace_lexer, trace_parser))
+      return false;
+  return true;
+}
+
+/**
+ * Parse the specified writable in-memory buffer without copying.
+ *
+ * @param buffer Buffer of `size` bytes ending with `buffer_padding` nulls
+ * @param size Buffer size, including the padding
+ * @param name Name used for the input in error locations
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::parse_buffer(
+  char* buffer,
+  std::size_t size,
+  std::string_view name,
+  bool trace_lexer,
+  bool trace_parser)
+{
+  return impl_->parse_buffer(buffer, size, name, trace_lexer, trace_parser);
+}
+
+/**
+ * Compile the specified input file without evaluating it.
+ *
+ * @param input_file File to read input from, empty or "-" for `stdin`
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::compile(
+  const std::filesystem::path& input_file, bool trace_lexer, bool trace_parser)
+{
+  return impl_->compile(input_file, trace_lexer, trace_parser);
+}
+
+/**
+ * Compile the specified in-memory input without evaluating it.
+ *
+ * @param source Input text and name
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::compile(
+  const calc_source& source, bool trace_lexer, bool trace_parser)
+{
+  return impl_->compile(source, trace_lexer, trace_parser);
+}
+
+/**
+ * Evaluate the program from the last parse or compile.
+ *
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::run()
+{
+  return impl_->run();
+}
+
+/**
+ * Evaluate the program from the last parse or compile over columns of rows.
+ *
+ * @param inputs Pointer to first of `n_inputs` input columns
+ * @param n_inputs Number of input columns
+ * @param outputs Pointer to first of `n_outputs` output columns
+ * @param n_outputs Number of output columns
+ * @param n_rows Number of rows in each column
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::run_columns(
+  const calc_input_column* inputs,
+  std::size_t n_inputs,
+  const calc_output_column* outputs,
+  std::size_t n_outputs,
+  std::size_t n_rows)
+{
+  return impl_->run_columns(inputs, n_inputs, outputs, n_outputs, n_rows);
+}
+
+/**
+ * Assign the value of a single-expression program to a symbol.
+ *
+ * @param iden Symbol identifier
+ * @returns `true` on success, `false` if the program is not a single
+ *  expression
+ */
+bool calc_parser::assign_result(std::string_view iden)
+{
+  return impl_->assign_result(iden);
+}
+
+/**
+ * Compile and evaluate in-memory input for later recomputation.
+ *
+ * @param source Input text and name
+ * @param results Vector to append the statement results to
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::load(
+  const calc_source& source, std::vector<calc_result>& results)
+{
+  return impl_->load(source, results);
+}
+
+/**
+ * Evaluate the statements of the loaded program affected by rebinding.
+ *
+ * @param results Vector to append the statement results to
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::recompute(std::vector<calc_result>& results)
+{
+  return impl_->recompute(results);
+}
+
+/**
+ * Add a symbol, replacing the value of any existing symbol.
+ *
+ * @param iden Symbol identifier
+ * @param value Symbol value
+ * @returns `*this` to allow method chaining
+ */
+calc_parser&
+calc_parser::add_symbol(std::string_view iden, calc_symbol::value_type value)
+{
+  impl_->add_symbol(iden, std::move(value));
+  return *this;
+}
+
+/**
+ * Get a pointer to the symbol if it exists and return `nullptr` otherwise.
+ *
+ * @param iden Symbol identifier
+ */
+const calc_symbol* calc_parser::get_symbol(std::string_view iden) const
+{
+  return impl_->get_symbol(iden);
+}
+
+/**
+ * Return the type a symbol has after the program from the last parse or
+ * compile.
+ *
+ * @param iden Symbol identifier
+ * @returns Index of the type in `calc_symbol::value_type`, or
+ *  `std::variant_npos` if the symbol is neither assigned nor defined
+ */
+std::size_t calc_parser::symbol_type(std::string_view iden) const
+{
+  return impl_->symbol_type(iden);
+}
+
+/**
+ * Return the identifier that caused the syntax error of the last parse or
+ * compile by being read before it was assigned.
+ *
+ * @returns Identifier, empty if there was no such syntax error
+ */
+std::string_view calc_parser::unbound_symbol() const noexcept
+{
+  return impl_->unbound_symbol();
+}
+
+/**
+ * Write a snapshot of all symbols and the input position to a file.
+ *
+ * @param path Snapshot file path
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::save_snapshot(const std::filesystem::path& path)
+{
+  return impl_->save_snapshot(path);
+}
+
+/**
+ * Add the symbols of a snapshot and resume from its input position.
+ *
+ * @param path Snapshot file path
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser::restore_snapshot(const std::filesystem::path& path)
+{
+  return impl_->restore_snapshot(path);
+}
+
+/**
+ * Return the input position reached.
+ */
+calc_position calc_parser::position() const noexcept
+{
+  return impl_->position();
+}
+
+/**
+ * Set the input position, e.g. to resume an interrupted run.
+ *
+ * @param position Input position
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::position(const calc_position& position) noexcept
+{
+  impl_->position(position);
+  return *this;
+}
+
+/**
+ * Return the file checkpoints are written to, empty if not checkpointing.
+ */
+const std::filesystem::path& calc_parser::checkpoint_path() const noexcept
+{
+  return impl_->checkpoint_path();
+}
+
+/**
+ * Return the number of statements evaluated between checkpoints.
+ */
+std::uint64_t calc_parser::checkpoint_interval() const noexcept
+{
+  return impl_->checkpoint_interval();
+}
+
+/**
+ * Set where and how often checkpoints are written during parsing.
+ *
+ * @param path Checkpoint file path, empty to disable checkpoints
+ * @param interval Statements between checkpoints, zero for only at the end
+ *  of each input
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::checkpoint(
+  const std::filesystem::path& path, std::uint64_t interval)
+{
+  impl_->checkpoint(path, interval);
+  return *this;
+}
+
+/**
+ * Return how input files are read by the lexer.
+ */
+calc_input_mode calc_parser::input_mode() const noexcept
+{
+  return impl_->input_mode();
+}
+
+/**
+ * Set how input files are read by the lexer.
+ *
+ * @param mode Input mode
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::input_mode(calc_input_mode mode) noexcept
+{
+  impl_->input_mode(mode);
+  return *this;
+}
+
+/**
+ * Return which lexer turns input into tokens.
+ */
+calc_lexer calc_parser::lexer() const noexcept
+{
+  return impl_->lexer();
+}
+
+/**
+ * Set which lexer turns input into tokens.
+ *
+ * @param lexer Lexer
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::lexer(calc_lexer lexer) noexcept
+{
+  impl_->lexer(lexer);
+  return *this;
+}
+
+/**
+ * Return how compiled statements are evaluated.
+ */
+calc_backend calc_parser::backend() const noexcept
+{
+  return impl_->backend();
+}
+
+/**
+ * Set how compiled statements are evaluated.
+ *
+ * @param backend Evaluation backend
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::backend(calc_backend backend) noexcept
+{
+  impl_->backend(backend);
+  return *this;
+}
+
+/**
+ * Return `true` if statements are optimized as they are compiled.
+ */
+bool calc_parser::optimize() const noexcept
+{
+  return impl_->optimize();
+}
+
+/**
+ * Set whether statements are optimized as they are compiled.
+ *
+ * @param enable `true` to optimize statements
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::optimize(bool enable) noexcept
+{
+  impl_->optimize(enable);
+  return *this;
+}
+
+/**
+ * Return `true` if parsing continues after a statement fails.
+ */
+bool calc_parser::keep_going() const noexcept
+{
+  return impl_->keep_going();
+}
+
+/**
+ * Set whether parsing continues after a statement fails.
+ *
+ * @param enable `true` to continue parsing after a statement fails
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::keep_going(bool enable) noexcept
+{
+  impl_->keep_going(enable);
+  return *this;
+}
+
+/**
+ * Return when buffered statement output is written to the sink.
+ */
+calc_flush_policy calc_parser::flush_policy() const noexcept
+{
+  return impl_->output().flush_policy();
+}
+
+/**
+ * Set when buffered statement output is written to the sink.
+ *
+ * @param policy Flush policy
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::flush_policy(calc_flush_policy policy) noexcept
+{
+  impl_->output().flush_policy(policy);
+  return *this;
+}
+
+/**
+ * Return the buffered byte count written at once with `bytes` flush policy.
+ */
+std::size_t calc_parser::flush_bytes() const noexcept
+{
+  return impl_->output().flush_bytes();
+}
+
+/**
+ * Set the buffered byte count written at once with `bytes` flush policy.
+ *
+ * @param n_bytes Number of bytes, where zero writes every statement
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::flush_bytes(std::size_t n_bytes) noexcept
+{
+  impl_->output().flush_bytes(n_bytes);
+  impl_->output().flush_policy(calc_flush_policy::bytes);
+  return *this;
+}
+
+/**
+ * Return how `double` statement results are formatted.
+ */
+calc_double_format calc_parser::double_format() const noexcept
+{
+  return impl_->output().double_format();
+}
+
+/**
+ * Set how `double` statement results are formatted.
+ *
+ * @param format Double format
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::double_format(calc_double_format format) noexcept
+{
+  impl_->output().double_format(format);
+  return *this;
+}
+
+/**
+ * Return the maximum number of inputs kept in the statement cache.
+ */
+std::size_t calc_parser::cache_capacity() const noexcept
+{
+  return impl_->cache_capacity();
+}
+
+/**
+ * Set the maximum number of inputs kept in the statement cache.
+ *
+ * @param capacity Maximum number of cached inputs, zero to disable
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::cache_capacity(std::size_t capacity)
+{
+  impl_->cache_capacity(capacity);
+  return *this;
+}
+
+/**
+ * Return the memory resource all memory is allocated from.
+ */
+std::pmr::memory_resource* calc_parser::memory_resource() const noexcept
+{
+  return impl_->memory_resource();
+}
+
+/**
+ * Return `true` if each parse or compile allocates from an arena.
+ */
+bool calc_parser::arena() const noexcept
+{
+  return impl_->arena();
+}
+
+/**
+ * Set whether each parse or compile allocates from an arena.
+ *
+ * @param enable `true` to allocate each parse from an arena
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::arena(bool enable) noexcept
+{
+  impl_->arena(enable);
+  return *this;
+}
+
+/**
+ * Return `true` if performance counters are collected.
+ */
+bool calc_parser::stats_enabled() const noexcept
+{
+  return impl_->stats_enabled();
+}
+
+/**
+ * Set whether performance counters are collected.
+ *
+ * @param enable `true` to collect performance counters
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::stats(bool enable) noexcept
+{
+  impl_->stats(enable);
+  return *this;
+}
+
+/**
+ * Return the performance counters collected so far.
+ */
+const calc_stats& calc_parser::stats() const noexcept
+{
+  return impl_->stats();
+}
+
+/**
+ * Reset all performance counters to zero.
+ *
+ * @returns `*this` to allow method chaining
+ */
+calc_parser& calc_parser::reset_stats() noexcept
+{
+  impl_->reset_stats();
+  return *this;
+}
+
+/**
+ * Read the tokens of an in-memory input without parsing it.
+ *
+ * @param source Input text and name
+ * @param visitor Visitor receiving each token, ending with the end of input
+ * @returns `true` on success, `false` on a lexer error
+ */
+bool calc_parser::lex(const calc_source& source, calc_token_visitor& visitor)
+{
+  return impl_->lex(source, visitor);
+}
+
+/**
+ * Write each statement of the program from the last parse or compile.
+ *
+ * @param out Stream to write to
+ */
+void calc_parser::dump_program(std::ostream& out) const
+{
+  impl_->dump_program(out);
+}
+
 /**
  * Return a message describing the last error that occurred.
  *
@@ -67,4 +657,12 @@ const std::string& calc_parser::last_error() const noexcept
   return impl_->last_error();
 }
 
+/**
+ * Return the errors of the statements that failed in the last parse.
+ */
+const std::vector<calc_error>& calc_parser::errors() const noexcept
+{
+  return impl_->errors();
+}
+
 }  // namespace pdcalc
@@ -7,61 +7,1513 @@
 
 #include "calc_parser_impl.hh"    // includes parser.yy.h
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
+#include "pdcalc/calc_parser.hh"
 #include "pdcalc/calc_symbol.hh"
+#include "calc_columns.hh"
+#include "calc_output.hh"
+#include "calc_parse_resource.hh"
+#include "calc_program.hh"
+#include "calc_snapshot.hh"
+#include "calc_statement_cache.hh"
+#include "calc_symbol_table.hh"
+#include "calc_token.hh"
 
 namespace pdcalc {
 
+namespace {
+
+// calc_value_type enumerators are in the same order as the symbol value types
+static_assert(
+  std::is_same_v<
+    calc_symbol::value_type,
+    std::variant<bool, long, double>
+  >,
+  "calc_value_type must match the calc_symbol::value_type alternatives"
+);
+
+/**
+ * Return the location of a statement or a node.
+ *
+ * @tparam Span `calc_statement` or `calc_node_location`
+ *
+ * @param name Input name
+ * @param span Statement or node location
+ */
+template <typename Span>
+calc_location span_location(std::string_view name, const Span& span)
+{
+  return {
+    name, span.begin_line, span.begin_column, span.end_line, span.end_column
+  };
+}
+
+/**
+ * Return the location of a Bison location.
+ *
+ * @param name Input name
+ * @param loc Bison location
+ */
+calc_location parser_location(std::string_view name, const yy::location& loc)
+{
+  return {
+    name,
+    static_cast<std::uint32_t>(loc.begin.line),
+    static_cast<std::uint32_t>(loc.begin.column),
+    static_cast<std::uint32_t>(loc.end.line),
+    static_cast<std::uint32_t>(loc.end.column)
+  };
+}
+
+/**
+ * Header stored in front of a `calc_parser_impl` allocated from a resource.
+ */
+struct impl_header {
+  std::pmr::memory_resource* resource;  // resource allocated from
+  std::size_t size;                     // allocation size
+};
+
+/**
+ * Size of the header rounded up so the instance is suitably aligned.
+ */
+constexpr auto impl_header_size =
+  (sizeof(impl_header) + alignof(std::max_align_t) - 1) /
+  alignof(std::max_align_t) * alignof(std::max_align_t);
+
+}  // namespace
+
+/**
+ * Ctor.
+ *
+ * All parse state is allocated through the parse resource so that it can be
+ * allocated from a per-parse arena, while the symbols, the native code, and
+ * the scanner state are allocated directly from the given resource.
+ *
+ * @param sink Stream to write all non-error output to, default `std::cout`
+ * @param resource Resource to allocate from, default the default resource
+ */
+calc_parser_impl::calc_parser_impl(
+  std::ostream& sink, std::pmr::memory_resource* resource)
+  : sink_{sink},
+    resource_{resource},
+    output_{sink, resource},
+    visitor_{&output_},
+    parse_resource_{resource},
+    symbols_{resource},
+    input_text_{resource},
+    program_{&parse_resource_},
+    optimizer_{&parse_resource_},
+    bytecode_{&parse_resource_},
+    registers_{&parse_resource_},
+    jit_{resource},
+    slots_{&parse_resource_},
+    eval_nodes_{&parse_resource_},
+    eval_values_{&parse_resource_},
+    symbol_types_{&parse_resource_},
+    dependencies_{&parse_resource_},
+    load_text_{resource},
+    load_name_{resource},
+    load_values_{resource},
+    rebound_(resource),  // braces would make a one-element vector<bool>
+    cache_{resource},
+    cache_key_{resource}
+{}
+
 /**
- * Parse the specified input file.
+ * Allocate storage for an instance from a memory resource.
+ *
+ * @param size Instance size
+ * @param resource Resource to allocate from
+ */
+void* calc_parser_impl::operator new(
+  std::size_t size, std::pmr::memory_resource* resource)
+{
+  static_assert(alignof(calc_parser_impl) <= alignof(std::max_align_t));
+  auto block = static_cast<unsigned char*>(
+    resource->allocate(impl_header_size + size, alignof(std::max_align_t))
+  );
+  ::new(block) impl_header{resource, impl_header_size + size};
+  return block + impl_header_size;
+}
+
+/**
+ * Return storage to the memory resource it was allocated from.
+ *
+ * @param ptr Instance storage
+ */
+void calc_parser_impl::operator delete(
+  void* ptr, std::pmr::memory_resource* /*resource*/) noexcept
+{
+  operator delete(ptr);
+}
+
+/**
+ * Return storage to the memory resource it was allocated from.
+ *
+ * @param ptr Instance storage
+ */
+void calc_parser_impl::operator delete(void* ptr) noexcept
+{
+  if (!ptr)
+    return;
+  auto block = static_cast<unsigned char*>(ptr) - impl_header_size;
+  auto header = *std::launder(reinterpret_cast<impl_header*>(block));
+  header.resource->deallocate(block, header.size, alignof(std::max_align_t));
+}
+
+/**
+ * Parse or compile the specified input file.
  *
  * @param input_file File to read input from, empty or "-" for `stdin`
  * @param trace_lexer `true` to enable lexer tracing
  * @param trace_parser `true` to enable parser tracing
+ * @param execute `true` to evaluate each statement as it is compiled
  * @returns `true` on success, `false` on failure
  */
-bool calc_parser_impl::parse(
-  const std::filesystem::path& input_file, bool trace_lexer, bool trace_parser)
+bool calc_parser_impl::parse_file(
+  const std::filesystem::path& input_file,
+  bool trace_lexer,
+  bool trace_parser,
+  bool execute)
 {
-  // need file path as string
+  // need file path as string + reset last error
   auto path_string = input_file.string();
-  // initialize Bison parser location for location tracking + reset last error
-  location_.initialize(&path_string);
   last_error_ = "";
-  // perform Flex lexer setup, create Bison parser, set debug level, parse
-  if (!lex_setup(path_string, trace_lexer))
-    return false;
-  yy::parser parser{*this};
-  parser.set_debug_level(trace_parser);
-  auto status = parser.parse();
-  // perform Flex lexer cleanup + return
-  if (!lex_cleanup(path_string))
+  // perform lexer setup + parse
+  {
+    auto scope = phase_scope(calc_phase::io);
+    if (
+      (lexer_ == calc_lexer::simd) ?
+        !scan_setup(path_string) : !lex_setup(path_string, trace_lexer)
+    )
+      return false;
+  }
+  return parse_input(path_string, trace_parser, execute);
+}
+
+/**
+ * Parse or compile the specified in-memory input.
+ *
+ * @param source Input text and name
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @param execute `true` to evaluate each statement as it is compiled
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::parse_source(
+  const calc_source& source,
+  bool trace_lexer,
+  bool trace_parser,
+  bool execute)
+{
+  // need name as string + reset last error
+  std::string name{source.name};
+  last_error_ = "";
+  // evaluate from the statement cache if possible. resumed inputs are not
+  // cached as their statement locations do not start from the first line
+  auto cache = execute && cache_.capacity() && !trace_lexer &&
+    !trace_parser && !resume_ &&
+    source.text.size() <= calc_statement_cache::max_text_size;
+  if (cache) {
+    calc_statement_cache::normalize(source.text, cache_key_);
+    auto item = cache_.find(cache_key_);
+    if (item && cache_valid(*item)) {
+      if (counters_)
+        counters_->cache_hits++;
+      return parse_cached(*item, source);
+    }
+    if (counters_)
+      counters_->cache_misses++;
+  }
+  // perform lexer setup + parse. the hand-written scanner needs no copy
+  if (lexer_ == calc_lexer::simd) {
+    auto text = source.text.data();
+    text_scanner_.reset(text, text + source.text.size());
+  }
+  else {
+    auto scope = phase_scope(calc_phase::io);
+    if (!lex_setup_bytes(source.text, trace_lexer))
+      return false;
+  }
+  // the dependencies give the symbol types the cached program relies on
+  if (!cache)
+    return parse_input(name, trace_parser, execute);
+  record_dependencies_ = true;
+  auto success = parse_input(name, trace_parser, execute);
+  record_dependencies_ = false;
+  if (success)
+    cache_program(source.text);
+  return success;
+}
+
+/**
+ * Evaluate an in-memory input from its statement cache entry.
+ *
+ * The cached program is copied, with its statements moved onto the input text
+ * if it differs from the text the program was compiled from, and evaluated as
+ * if it had just been parsed. If an assignment fails, the rest of the input
+ * is parsed again as the program after it was compiled for the wrong type.
+ *
+ * @param item Cache entry for the input text
+ * @param source Input text and name
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::parse_cached(
+  const calc_statement_cache::entry& item, const calc_source& source)
+{
+  {
+    auto scope = phase_scope(calc_phase::parse);
+    reset_program(std::string{source.name});
+    execute_ = true;
+    errors_.clear();
+    recover_ = keep_going_;
+    skipping_ = false;
+    unbound_.reset();
+    program_.assign(source.name, item.program);
+    if (source.text != item.text)
+      calc_statement_cache::relocate(source.text, item, program_);
+    if (item.bytecode.size()) {
+      bytecode_ = item.bytecode;
+      if (registers_.size() < bytecode_.n_registers())
+        registers_.resize(bytecode_.n_registers());
+    }
+  }
+  auto n_statements = program_.statements().size();
+  std::uint32_t i = 0;
+  // statements also time their own evaluation and output. timing them within
+  // one scope reads the thread CPU time once instead of for every statement
+  {
+    auto scope = phase_scope(calc_phase::eval);
+    for (; i < n_statements; i++) {
+      if (counters_) {
+        first_node_ = item.first_nodes[i];
+        count_statement(i);
+      }
+      auto n_errors = errors_.size();
+      if (!evaluate_statement(i))
+        break;
+      // the statements after a failed assignment were compiled for the type
+      // the assignment would have given its symbol, so they are parsed again
+      const auto& stmt = program_.statements()[i];
+      if (
+        errors_.size() != n_errors &&
+        stmt.kind == calc_statement_kind::assign &&
+        i + 1 < n_statements
+      )
+        return parse_rest(source);
+    }
+  }
+  // write any results still buffered, including those before an error
+  {
+    auto scope = phase_scope(calc_phase::output);
+    visitor_->flush();
+  }
+  return i == n_statements && complete_input() && errors_.empty();
+}
+
+/**
+ * Parse the rest of an in-memory input from the position of the parser.
+ *
+ * The errors of the statements evaluated before the position are kept.
+ *
+ * @param source Input text and name
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::parse_rest(const calc_source& source)
+{
+  auto errors = std::move(errors_);
+  auto offset = calc_position_offset(source.text, position_);
+  resume_ = true;
+  auto success = parse_source(
+    {source.text.substr(offset), source.name}, false, false, true
+  );
+  errors.insert(errors.end(), errors_.begin(), errors_.end());
+  errors_ = std::move(errors);
+  // the input name was copied again by the parse
+  for (auto& error : errors_)
+    error.location.input = program_.name();
+  if (last_error_.empty()) {
+    std::stringstream ss;
+    ss << errors_.back();
+    last_error_ = ss.str();
+  }
+  return success && errors_.empty();
+}
+
+/**
+ * Return `true` if the symbols a cache entry reads have the same types.
+ *
+ * Symbols the program assigns before reading are typed by the assignment,
+ * so only the types of the symbols read on input need to be checked.
+ *
+ * @param item Cache entry
+ */
+bool calc_parser_impl::cache_valid(
+  const calc_statement_cache::entry& item) const
+{
+  const auto& names = item.program.names();
+  for (auto [name, type] : item.inputs) {
+    auto sym = find_symbol(names[name]);
+    if (!sym || sym->value().index() != static_cast<std::size_t>(type))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Add the program from the last parse to the statement cache.
+ *
+ * The bytecode is cached too if the whole program was compiled to bytecode.
+ *
+ * @param text Input text the program was compiled from
+ */
+void calc_parser_impl::cache_program(std::string_view text)
+{
+  auto& item = cache_.insert(cache_key_);
+  item.text.assign(text);
+  item.program.assign(program_.name(), program_);
+  if (!calc_statement_cache::record(text, item)) {
+    cache_.erase(cache_key_);
+    return;
+  }
+  const auto& names = program_.names();
+  for (std::uint32_t name = 0; name < names.size(); name++)
+    if (auto type = dependencies_.input_type(name))
+      item.inputs.emplace_back(name, *type);
+  const auto& first_nodes = dependencies_.first_nodes();
+  item.first_nodes.assign(first_nodes.begin(), first_nodes.end());
+  if (bytecode_.size() == program_.statements().size())
+    item.bytecode = bytecode_;
+}
+
+/**
+ * Parse the specified writable in-memory buffer without copying.
+ *
+ * @param buffer Buffer of `size` bytes ending with two null bytes
+ * @param size Buffer size, including the padding
+ * @param name Name used for the input in error locations
+ * @param trace_lexer `true` to enable lexer tracing
+ * @param trace_parser `true` to enable parser tracing
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::parse_buffer(
+  char* buffer,
+  std::size_t size,
+  std::string_view name,
+  bool trace_lexer,
+  bool trace_parser)
+{
+  // need name as string + reset last error
+  std::string name_string{name};
+  last_error_ = "";
+  // perform lexer setup + parse
+  {
+    auto scope = phase_scope(calc_phase::io);
+    if (
+      (lexer_ == calc_lexer::simd) ?
+        !scan_setup_buffer(buffer, size) :
+        !lex_setup_buffer(buffer, size, trace_lexer)
+    )
+      return false;
+  }
+  return parse_input(name_string, trace_parser, true);
+}
+
+/**
+ * Run the Bison parser on the input set up by a `lex_setup*` or `scan_setup*`
+ * function.
+ *
+ * @param input_name Input name, which is also used by the parser location
+ * @param trace_parser `true` to enable parser tracing
+ * @param execute `true` to evaluate each statement as it is compiled
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::parse_input(
+  const std::string& input_name, bool trace_parser, bool execute)
+{
+  int status;
+  {
+    auto scope = phase_scope(calc_phase::parse);
+    reset_program(input_name);
+    execute_ = execute;
+    errors_.clear();
+    recover_ = keep_going_ && execute;
+    skipping_ = false;
+    lexed_ = unknown_lexed_ = 0;
+    unbound_.reset();
+    // initialize Bison parser location for location tracking. this holds a
+    // pointer to the program's copy of the input name
+    location_.initialize(&program_.name());
+    // a resumed input continues from the line and column it was left at
+    if (execute && resume_) {
+      location_.begin.line = location_.end.line = position_.line;
+      location_.begin.column = location_.end.column = position_.column;
+      resume_ = false;
+    }
+    // create Bison parser, set debug level, parse
+    yy::parser parser{*this, scanner_};
+    parser.set_debug_level(trace_parser);
+    status = parser.parse();
+  }
+  // write any results still buffered, including those before an error
+  {
+    auto scope = phase_scope(calc_phase::output);
+    visitor_->flush();
+  }
+  // perform lexer cleanup
+  {
+    auto scope = phase_scope(calc_phase::io);
+    if (!lex_cleanup(input_name))
+      return false;
+  }
+  // last_error_ should already have been set if parsing is failing. when
+  // recovering, the input was completed even if some statements failed
+  if (status || (execute && !complete_input()))
     return false;
-  // last_error_ should already have been set if parsing is failing
-  return !status;
+  return errors_.empty();
+}
+
+/**
+ * Handle an input that was successfully evaluated.
+ *
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::complete_input()
+{
+  position_ = {position_.input + 1, 1, 1};
+  return checkpoint_path_.empty() || write_checkpoint();
+}
+
+/**
+ * Discard the program from the last parse or compile.
+ *
+ * @param input_name Input name used when reporting errors
+ */
+void calc_parser_impl::reset_program(const std::string& input_name)
+{
+  // replace all parse state before releasing the arena. state allocated from
+  // the upstream resource is also replaced before switching to the arena
+  if (arena_ || parse_resource_.arena()) {
+    program_ = calc_program{&parse_resource_};
+    optimizer_ = calc_optimizer{&parse_resource_};
+    bytecode_ = calc_bytecode{&parse_resource_};
+    registers_ = decltype(registers_){&parse_resource_};
+    slots_ = decltype(slots_){&parse_resource_};
+    eval_nodes_ = decltype(eval_nodes_){&parse_resource_};
+    eval_values_ = decltype(eval_values_){&parse_resource_};
+    symbol_types_ = decltype(symbol_types_){&parse_resource_};
+    dependencies_ = calc_dependencies{&parse_resource_};
+    parse_resource_.reset(arena_);
+  }
+  // discard previous program + its compile-time symbol types
+  program_.reset(input_name);
+  bytecode_.clear();
+  jit_.clear();
+  symbol_types_.clear();
+  first_node_ = 0;
+  dependencies_.clear();
+  loaded_ = load_stale_ = false;
 }
 
+/**
+ * Evaluate the program from the last parse or compile.
+ *
+ * Statements are evaluated in order and evaluation stops on the first error.
+ *
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::run()
+{
+  last_error_ = "";
+  auto n_statements = program_.statements().size();
+  std::uint32_t i = 0;
+  {
+    auto scope = phase_scope(calc_phase::eval);
+    while (i < n_statements && run_statement(i))
+      i++;
+  }
+  // write any results still buffered, including those before an error
+  auto scope = phase_scope(calc_phase::output);
+  visitor_->flush();
+  return i == n_statements;
+}
+
+/**
+ * Add a new symbol to the parser.
+ *
+ * If the symbol is used by the loaded program, it is marked as rebound so the
+ * next recompute evaluates the statements that depend on it.
+ *
+ * @param iden Symbol identifier
+ * @param value Symbol value
+ * @returns `*this` to allow method chaining
+ */
 calc_parser_impl&
 calc_parser_impl::add_symbol(std::string_view iden, symbol_value_type value)
 {
-  // new symbol to insert
-  calc_symbol sym{iden, std::move(value)};
-  // attempt insert. if failed (existing symbol), overwrite
-  auto [it, inserted] = symbols_.insert(sym);
-  if (!inserted) {
-    symbols_.erase(it);
-    symbols_.insert(std::move(sym));
+  symbols_.assign(iden, std::move(value));
+  if (loaded_) {
+    if (auto name = program_.find(iden)) {
+      rebound_.resize(program_.names().size());
+      rebound_[*name] = true;
+    }
   }
   return *this;
 }
 
 const calc_symbol* calc_parser_impl::get_symbol(std::string_view iden) const
 {
-  // lookup using dummy
-  auto it = symbols_.find(calc_symbol{iden});
-  return (it == symbols_.end()) ? nullptr : &*it;
+  return symbols_.find(iden);
+}
+
+/**
+ * Return the type a symbol has after the program from the last parse or
+ * compile.
+ *
+ * @param iden Symbol identifier
+ * @returns Index of the type in `calc_symbol::value_type`, or
+ *  `std::variant_npos` if the symbol is neither assigned nor defined
+ */
+std::size_t calc_parser_impl::symbol_type(std::string_view iden) const
+{
+  // the last statement assigning to the symbol determines its type
+  if (auto name = program_.find(iden)) {
+    const auto& statements = program_.statements();
+    for (auto it = statements.rbegin(); it != statements.rend(); it++) {
+      if (it->kind == calc_statement_kind::assign && it->name == *name)
+        return static_cast<std::size_t>(program_.nodes()[it->root].type);
+    }
+  }
+  if (auto sym = symbols_.find(iden))
+    return sym->value().index();
+  return std::variant_npos;
+}
+
+/**
+ * Write a snapshot of all symbols and the input position to a file.
+ *
+ * @param path Snapshot file path
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::save_snapshot(const std::filesystem::path& path)
+{
+  last_error_ = "";
+  return calc_snapshot::save(path, symbols_, position_, last_error_);
+}
+
+/**
+ * Add the symbols of a snapshot and resume from its input position.
+ *
+ * Symbols are added through `add_symbol` so that a loaded program sees them
+ * as rebound. The snapshot is closed before returning.
+ *
+ * @param path Snapshot file path
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::restore_snapshot(const std::filesystem::path& path)
+{
+  last_error_ = "";
+  calc_snapshot snapshot;
+  if (!snapshot.open(path, last_error_))
+    return false;
+  for (std::size_t i = 0; i < snapshot.size(); i++)
+    add_symbol(snapshot.iden(i), snapshot.value(i));
+  position(snapshot.position());
+  return true;
+}
+
+/**
+ * Compile and evaluate in-memory input for later recomputation.
+ *
+ * @param source Input text and name
+ * @param results Vector to append the statement results to
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::load(
+  const calc_source& source, std::vector<calc_result>& results)
+{
+  load_text_.assign(source.text);
+  load_name_.assign(source.name);
+  load_values_.clear();
+  rebound_.clear();
+  load_valid_ = false;
+  if (!compile_loaded())
+    return false;
+  return recompute(results);
+}
+
+/**
+ * Evaluate the statements of the loaded program affected by rebinding.
+ *
+ * The rebound flags start as the symbols rebound by the caller. As statements
+ * are evaluated in order, the flag of a symbol is updated by each assignment
+ * evaluated, being set only if the assigned value differs from the value the
+ * statement assigned the last time it was evaluated. So a statement is only
+ * evaluated when a symbol it reads, or a symbol it overwrites, differs from
+ * its value the last time the whole program was up to date.
+ *
+ * @param results Vector to append the statement results to
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::recompute(std::vector<calc_result>& results)
+{
+  last_error_ = "";
+  if (!loaded_ && !load_stale_) {
+    last_error_ = "No program loaded for recomputation";
+    return false;
+  }
+  // inputs rebound with another type need the program compiled again. the
+  // same text interns the same names in the same order, so the rebound flags
+  // and last assigned values still apply to the new program
+  if (load_stale_ || input_type_changed()) {
+    auto valid = load_valid_;
+    load_valid_ = false;
+    if (!compile_loaded())
+      return false;
+    load_valid_ = valid;
+  }
+  const auto& statements = program_.statements();
+  const auto& names = program_.names();
+  auto n_statements = static_cast<std::uint32_t>(statements.size());
+  load_values_.resize(n_statements);
+  rebound_.resize(names.size());
+  // if the last evaluation did not finish, everything is evaluated
+  auto evaluate_all = !load_valid_;
+  load_valid_ = false;
+  results_ = &results;
+  std::uint32_t i = 0;
+  auto scope = phase_scope(calc_phase::eval);
+  for (; i < n_statements; i++) {
+    const auto& stmt = statements[i];
+    if (!evaluate_all && !depends_on_rebound(i))
+      continue;
+    if (!run_statement(i))
+      break;
+    if (stmt.kind == calc_statement_kind::assign) {
+      const auto& value = symbols_.find(names[stmt.name])->value();
+      auto& last_value = load_values_[i];
+      rebound_[stmt.name] = !last_value || *last_value != value;
+      last_value = value;
+    }
+  }
+  results_ = nullptr;
+  std::fill(rebound_.begin(), rebound_.end(), false);
+  load_valid_ = (i == n_statements);
+  return load_valid_;
+}
+
+/**
+ * Compile the loaded text, recording the statement dependencies.
+ *
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::compile_loaded()
+{
+  record_dependencies_ = true;
+  auto success = parse_source({load_text_, load_name_}, false, false, false);
+  record_dependencies_ = false;
+  // keep the loaded text on failure so the next recompute compiles again
+  loaded_ = success;
+  load_stale_ = !success;
+  return success;
+}
+
+/**
+ * Return `true` if a rebound symbol has another type than the loaded program
+ * reads it as on input.
+ */
+bool calc_parser_impl::input_type_changed() const
+{
+  const auto& names = program_.names();
+  for (std::uint32_t name = 0; name < rebound_.size(); name++) {
+    if (!rebound_[name])
+      continue;
+    auto type = dependencies_.input_type(name);
+    auto sym = symbols_.find(names[name]);
+    if (type && sym && sym->value().index() != static_cast<std::size_t>(*type))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Return `true` if a statement reads or assigns a rebound symbol.
+ *
+ * @param index Statement index
+ */
+bool calc_parser_impl::depends_on_rebound(std::uint32_t index) const noexcept
+{
+  const auto& stmt = program_.statements()[index];
+  if (stmt.kind == calc_statement_kind::assign && rebound_[stmt.name])
+    return true;
+  auto [first, last] = dependencies_.reads(index);
+  return std::any_of(first, last, [this](auto name) { return rebound_[name]; });
+}
+
+/**
+ * Return pointer to the compile-time type of a symbol or `nullptr`.
+ *
+ * @param name Symbol name index
+ */
+const calc_value_type* calc_parser_impl::symbol_type(std::uint32_t name)
+{
+  // names are interned in order so a new name is always the next index
+  if (name == symbol_types_.size()) {
+    auto sym = find_symbol(program_.names()[name]);
+    if (sym)
+      symbol_types_.emplace_back(
+        static_cast<calc_value_type>(sym->value().index())
+      );
+    else
+      symbol_types_.emplace_back();
+  }
+  auto& type = symbol_types_[name];
+  return type ? &*type : nullptr;
+}
+
+/**
+ * Set the compile-time type of a symbol.
+ *
+ * @param name Symbol name index
+ * @param type Symbol type
+ */
+void calc_parser_impl::declare_symbol(std::uint32_t name, calc_value_type type)
+{
+  symbol_types_[name] = type;
+}
+
+/**
+ * Return the identifier token for the given identifier.
+ *
+ * @param iden Identifier text
+ */
+yy::parser::symbol_type calc_parser_impl::iden_token(std::string_view iden)
+{
+  auto name = program_.intern(iden);
+  auto type = symbol_type(name);
+  if (!type) {
+    unknown_lexed_ = lexed_;
+    unknown_name_ = name;
+    return yy::parser::make_UNKNOWN_IDEN(name, location_);
+  }
+  return make_iden_token(name, *type, location_);
+}
+
+/**
+ * Count a statement that was just compiled and its builtin calls.
+ *
+ * The parser only builds trees and the nodes of a statement expression follow
+ * those of the previous statement, including any nodes added when optimizing
+ * it. So the nodes from the first one after the previous statement up to the
+ * root of the expression as written are exactly that expression and each
+ * builtin call node is one call.
+ *
+ * @param index Statement index
+ */
+void calc_parser_impl::count_statement(std::uint32_t index) noexcept
+{
+  const auto& stmt = program_.statements()[index];
+  const auto& nodes = program_.nodes();
+  auto type = static_cast<std::size_t>(nodes[stmt.source].type);
+  if (stmt.kind == calc_statement_kind::print)
+    counters_->prints[type]++;
+  else
+    counters_->assignments[type]++;
+  for (auto i = first_node_; i <= stmt.source; i++)
+    if (auto builtin = calc_op_builtin(nodes[i].op))
+      counters_->builtin_calls[static_cast<std::size_t>(*builtin)]++;
+}
+
+/**
+ * Handle a statement that was just compiled.
+ *
+ * @param index Statement index
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::complete_statement(std::uint32_t index)
+{
+  if (optimize_)
+    optimizer_.optimize(program_, index);
+  if (counters_)
+    count_statement(index);
+  if (record_dependencies_)
+    dependencies_.add(program_, first_node_);
+  first_node_ = static_cast<std::uint32_t>(program_.nodes().size());
+  return !execute_ || evaluate_statement(index);
+}
+
+/**
+ * Evaluate a statement that was just compiled.
+ *
+ * @param index Statement index
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::evaluate_statement(std::uint32_t index)
+{
+  if (!run_statement(index) && !fail_statement(index))
+    return false;
+  // the position is just past the last statement evaluated
+  const auto& stmt = program_.statements()[index];
+  position_.line = stmt.end_line;
+  position_.column = stmt.end_column;
+  if (
+    checkpoint_interval_ &&
+    !checkpoint_path_.empty() &&
+    ++since_checkpoint_ >= checkpoint_interval_
+  )
+    return write_checkpoint();
+  return true;
+}
+
+/**
+ * Handle an error in the statement being parsed.
+ *
+ * @param loc Error location
+ * @param message Error message
+ */
+void calc_parser_impl::syntax_error(
+  const yy::location& loc, const std::string& message)
+{
+  if (skipping_)
+    return;
+  skipping_ = true;
+  std::stringstream ss;
+  ss << loc << ": " << message;
+  last_error_ = ss.str();
+  // an unknown identifier can only be followed by "=", so an error at or
+  // right after one is from reading it before it is assigned
+  if (!unbound_ && unknown_lexed_ && lexed_ - unknown_lexed_ <= 1)
+    unbound_ = unknown_name_;
+  if (recover_) {
+    errors_.push_back({parser_location(program_.name(), loc), message});
+    visitor_->visit_error(
+      program_.statements().size(), errors_.back().location, message
+    );
+  }
+}
+
+/**
+ * Handle the end of a statement skipped after a syntax error.
+ *
+ * The nodes of any expressions compiled before the error are not part of
+ * any statement, so the next statement starts after them.
+ *
+ * @param loc Location of the skipped statement
+ * @returns `true` if recovering, `false` to abort the parse
+ */
+bool calc_parser_impl::skip_statement(const yy::location& loc)
+{
+  skipping_ = false;
+  first_node_ = static_cast<std::uint32_t>(program_.nodes().size());
+  if (!recover_)
+    return false;
+  position_.line = static_cast<std::uint32_t>(loc.end.line);
+  position_.column = static_cast<std::uint32_t>(loc.end.column);
+  return true;
+}
+
+/**
+ * Handle a statement that failed to evaluate.
+ *
+ * @param index Statement index
+ * @returns `true` if recovering, `false` to abort the parse
+ */
+bool calc_parser_impl::fail_statement(std::uint32_t index)
+{
+  if (!recover_)
+    return false;
+  errors_.push_back(eval_error_);
+  visitor_->visit_error(index, eval_error_.location, eval_error_.message);
+  // the grammar typed the symbol of a failed assignment before evaluating it
+  const auto& stmt = program_.statements()[index];
+  if (
+    stmt.kind == calc_statement_kind::assign &&
+    stmt.name < symbol_types_.size()
+  ) {
+    auto sym = find_symbol(program_.names()[stmt.name]);
+    if (sym)
+      symbol_types_[stmt.name] =
+        static_cast<calc_value_type>(sym->value().index());
+    else
+      symbol_types_[stmt.name].reset();
+  }
+  return true;
+}
+
+/**
+ * Write buffered output and a checkpoint of the input position reached.
+ *
+ * The output is written first so that the output of every statement before
+ * the checkpoint position is complete once the checkpoint exists.
+ *
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::write_checkpoint()
+{
+  since_checkpoint_ = 0;
+  {
+    auto scope = phase_scope(calc_phase::output);
+    visitor_->flush();
+  }
+  auto scope = phase_scope(calc_phase::io);
+  return calc_snapshot::save(
+    checkpoint_path_, symbols_, position_, last_error_
+  );
+}
+
+/**
+ * Evaluate a statement with the current backend, writing any output to the
+ * sink.
+ *
+ * On error, the last error is set with the statement location.
+ *
+ * @param index Statement index
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::run_statement(std::uint32_t index)
+{
+  auto scope = phase_scope(calc_phase::eval);
+  result_statement_ = index;
+  try {
+    switch (backend_) {
+      case calc_backend::vm:
+        execute_bytecode(index);
+        break;
+      case calc_backend::tree:
+        execute(program_.statements()[index]);
+        break;
+      case calc_backend::jit:
+        execute_native(index);
+        break;
+    }
+    return true;
+  }
+  catch (const calc_eval_error& ex) {
+    statement_error(program_.statements()[index], ex);
+    return false;
+  }
+}
+
+/**
+ * Evaluate the program from the last parse or compile over columns of rows.
+ *
+ * @param inputs Pointer to first of `n_inputs` input columns
+ * @param n_inputs Number of input columns
+ * @param outputs Pointer to first of `n_outputs` output columns
+ * @param n_outputs Number of output columns
+ * @param n_rows Number of rows in each column
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_parser_impl::run_columns(
+  const calc_input_column* inputs,
+  std::size_t n_inputs,
+  const calc_output_column* outputs,
+  std::size_t n_outputs,
+  std::size_t n_rows)
+{
+  last_error_ = "";
+  auto scope = phase_scope(calc_phase::eval);
+  calc_column_engine engine{program_, resource_};
+  try {
+    engine.bind(symbols_, inputs, n_inputs, outputs, n_outputs);
+    engine.run(n_rows);
+    return true;
+  }
+  catch (const calc_eval_error& ex) {
+    if (engine.statement() == calc_column_engine::no_statement)
+      last_error_ = ex.what();
+    else
+      statement_error(program_.statements()[engine.statement()], ex);
+    return false;
+  }
+}
+
+/**
+ * Assign the value of a single-expression program to a symbol.
+ *
+ * @param iden Symbol identifier
+ * @returns `true` on success, `false` if the program is not a single
+ *  expression
+ */
+bool calc_parser_impl::assign_result(std::string_view iden)
+{
+  last_error_ = "";
+  const auto& statements = program_.statements();
+  if (
+    statements.size() != 1 ||
+    statements.front().kind != calc_statement_kind::print
+  ) {
+    last_error_ = program_.name() + ": Program is not a single expression";
+    return false;
+  }
+  program_.assign_statement(0, program_.intern(iden));
+  // statement is compiled again if the program is run
+  bytecode_.clear();
+  jit_.clear();
+  return true;
+}
+
+/**
+ * Return the location of a statement.
+ *
+ * @param stmt Statement to return the location of
+ */
+calc_location
+calc_parser_impl::statement_location(const calc_statement& stmt) const
+{
+  return span_location(program_.name(), stmt);
+}
+
+/**
+ * Set the last error to an evaluation error prefixed with its location.
+ *
+ * Errors are reported at the location of the failing node if it has one and
+ * otherwise at the location of the statement.
+ *
+ * @param stmt Statement the error is from
+ * @param error Evaluation error
+ */
+void calc_parser_impl::statement_error(
+  const calc_statement& stmt, const calc_eval_error& error)
+{
+  auto loc = error.node() ? program_.node_location(*error.node()) : nullptr;
+  eval_error_ = {
+    loc ? span_location(program_.name(), *loc) : statement_location(stmt),
+    error.what()
+  };
+  std::stringstream ss;
+  ss << eval_error_;
+  last_error_ = ss.str();
+}
+
+/**
+ * Read the tokens of an in-memory input without parsing it.
+ *
+ * Tokens are read through the same function the Bison parser calls, so they
+ * are counted and timed as when parsing.
+ *
+ * @param source Input text and name
+ * @param visitor Visitor receiving each token, ending with the end of input
+ * @returns `true` on success, `false` on a lexer error and sets `last_error_`
+ */
+bool calc_parser_impl::lex(
+  const calc_source& source, calc_token_visitor& visitor)
+{
+  std::string name{source.name};
+  last_error_ = "";
+  if (lexer_ == calc_lexer::simd) {
+    auto text = source.text.data();
+    text_scanner_.reset(text, text + source.text.size());
+  }
+  else {
+    auto scope = phase_scope(calc_phase::io);
+    if (!lex_setup_bytes(source.text, false))
+      return false;
+  }
+  auto success = true;
+  {
+    auto scope = phase_scope(calc_phase::lex);
+    reset_program(name);
+    skipping_ = recover_ = false;
+    lexed_ = unknown_lexed_ = 0;
+    location_.initialize(&program_.name());
+    try {
+      for (auto done = false; !done; ) {
+        auto token = ::PDCALC_YYLEX(*this, scanner_);
+        calc_token result{
+          static_cast<int>(token.kind()),
+          {},
+          parser_location(program_.name(), token.location)
+        };
+        switch (token.kind()) {
+          case yy::parser::symbol_kind::S_YYEOF:
+            done = true;
+            break;
+          case yy::parser::symbol_kind::S_FLOATING:
+            result.value = token.value.as<double>();
+            break;
+          case yy::parser::symbol_kind::S_INTEGRAL:
+            result.value = token.value.as<long>();
+            break;
+          case yy::parser::symbol_kind::S_TRUTH:
+            result.value = token.value.as<bool>();
+            break;
+          case yy::parser::symbol_kind::S_BOOL_IDEN:
+          case yy::parser::symbol_kind::S_LONG_IDEN:
+          case yy::parser::symbol_kind::S_DOUBLE_IDEN:
+          case yy::parser::symbol_kind::S_UNKNOWN_IDEN:
+            result.value = program_.names()[token.value.as<std::uint32_t>()];
+            break;
+          default:
+            break;
+        }
+        visitor.visit(result);
+      }
+    }
+    // lexer errors are reported as the parser reports them
+    catch (const yy::parser::syntax_error& ex) {
+      std::stringstream ss;
+      ss << ex.location << ": " << ex.what();
+      last_error_ = ss.str();
+      success = false;
+    }
+  }
+  auto scope = phase_scope(calc_phase::io);
+  return lex_cleanup(name) && success;
+}
+
+/**
+ * Write each statement of the program from the last parse or compile.
+ *
+ * @param out Stream to write to
+ */
+void calc_parser_impl::dump_program(std::ostream& out) const
+{
+  for (const auto& stmt : program_.statements()) {
+    out << statement_location(stmt) << ": ";
+    if (stmt.kind == calc_statement_kind::assign)
+      out << program_.names()[stmt.name] << " = ";
+    else
+      out << "print ";
+    program_.dump(out, stmt.source);
+    out << '\n';
+    if (stmt.root != stmt.source) {
+      out << "  => ";
+      program_.dump(out, stmt.root);
+      out << '\n';
+    }
+  }
+}
+
+/**
+ * Evaluate a statement by walking its expression tree, writing any output to
+ * the sink.
+ *
+ * The value is always computed before anything is written so that no partial
+ * output is written when evaluation fails.
+ *
+ * @param stmt Statement to evaluate
+ *
+ * @throws calc_eval_error on evaluation failure
+ */
+void calc_parser_impl::execute(const calc_statement& stmt)
+{
+  auto value = evaluate(stmt.root);
+  // print value prefixed with type
+  if (stmt.kind == calc_statement_kind::print) {
+    switch (program_.nodes()[stmt.root].type) {
+      case calc_value_type::boolean:
+        print_result(value.b);
+        break;
+      case calc_value_type::integral:
+        print_result(value.l);
+        break;
+      case calc_value_type::floating:
+        print_result(value.d);
+        break;
+    }
+    return;
+  }
+  // otherwise, assign (note: can result in type change)
+  const auto& iden = program_.names()[stmt.name];
+  switch (program_.nodes()[stmt.root].type) {
+    case calc_value_type::boolean:
+      store_symbol(iden, value.b);
+      break;
+    case calc_value_type::integral:
+      store_symbol(iden, value.l);
+      break;
+    case calc_value_type::floating:
+      store_symbol(iden, value.d);
+      break;
+  }
+}
+
+/**
+ * Evaluate an expression tree without recursion.
+ *
+ * Nodes are visited in post-order with an explicit stack, so the depth of an
+ * expression, e.g. a long chain of additions, is not limited by the call
+ * stack. Operands are evaluated from left to right onto a value stack, where
+ * they are replaced by the value of the node using them. Nodes used more than
+ * once by an optimized expression are evaluated on each use.
+ *
+ * @param root Expression root node index
+ * @returns Value of the expression root node type
+ *
+ * @throws calc_eval_error on evaluation failure
+ */
+calc_register calc_parser_impl::evaluate(std::uint32_t root)
+{
+  const auto& nodes = program_.nodes();
+  eval_nodes_.clear();
+  eval_values_.clear();
+  eval_nodes_.emplace_back(root, false);
+  while (eval_nodes_.size()) {
+    auto [index, expanded] = eval_nodes_.back();
+    const auto& node = nodes[index];
+    // push operands right first so that the left operand is evaluated first
+    if (!expanded && !calc_is_leaf(node.op)) {
+      eval_nodes_.back().second = true;
+      if (calc_is_binary(node.op))
+        eval_nodes_.emplace_back(node.right, false);
+      eval_nodes_.emplace_back(node.left, false);
+      continue;
+    }
+    eval_nodes_.pop_back();
+    // replace operand values with the node value
+    calc_register left{};
+    calc_register right{};
+    if (calc_is_binary(node.op)) {
+      right = eval_values_.back();
+      eval_values_.pop_back();
+    }
+    if (!calc_is_leaf(node.op)) {
+      left = eval_values_.back();
+      eval_values_.pop_back();
+    }
+    // divisors are checked here, where the node index is known
+    if (node.op == calc_op::divide) {
+      auto zero = (node.type == calc_value_type::integral) ?
+        !right.l : !right.d;
+      if (zero)
+        throw division_error(index, left, right);
+    }
+    calc_register value;
+    switch (node.type) {
+      case calc_value_type::boolean:
+        value.b = eval_bool(node, left, right);
+        break;
+      case calc_value_type::integral:
+        value.l = eval_long(node, left, right);
+        break;
+      case calc_value_type::floating:
+        value.d = eval_double(node, left, right);
+        break;
+    }
+    eval_values_.push_back(value);
+  }
+  return eval_values_.back();
+}
+
+/**
+ * Evaluate a boolean expression node from its operand values.
+ *
+ * Comparisons read their operands with the operand type. As before, both
+ * operands of logical operations are always evaluated.
+ *
+ * @param node Expression node
+ * @param left First operand value, unused for leaves
+ * @param right Second operand value, unused unless binary
+ */
+bool calc_parser_impl::eval_bool(
+  const calc_node& node, calc_register left, calc_register right) const
+{
+  // apply comparison to operands of the operand type
+  auto compare = [this, &node, left, right](auto op)
+  {
+    switch (program_.nodes()[node.left].type) {
+      case calc_value_type::boolean:
+        return op(left.b, right.b);
+      case calc_value_type::integral:
+        return op(left.l, right.l);
+      default:
+        return op(left.d, right.d);
+    }
+  };
+  switch (node.op) {
+    case calc_op::literal:
+      return node.value<bool>();
+    case calc_op::symbol:
+      return symbol_value<bool>(node.left);
+    case calc_op::logical_not:
+      return !left.b;
+    case calc_op::logical_and:
+      return left.b && right.b;
+    case calc_op::logical_or:
+      return left.b || right.b;
+    case calc_op::equal:
+      return compare(std::equal_to<>{});
+    case calc_op::not_equal:
+      return compare(std::not_equal_to<>{});
+    case calc_op::less:
+      return compare(std::less<>{});
+    case calc_op::greater:
+      return compare(std::greater<>{});
+    case calc_op::less_equal:
+      return compare(std::less_equal<>{});
+    case calc_op::greater_equal:
+      return compare(std::greater_equal<>{});
+    default:
+      throw calc_eval_error{"Invalid boolean expression node"};
+  }
+}
+
+/**
+ * Evaluate an integral expression node from its operand values.
+ *
+ * @param node Expression node
+ * @param left First operand value, unused for leaves
+ * @param right Second operand value, unused unless binary
+ */
+long calc_parser_impl::eval_long(
+  const calc_node& node, calc_register left, calc_register right) const
+{
+  switch (node.op) {
+    case calc_op::literal:
+      return node.value<long>();
+    case calc_op::symbol:
+      return symbol_value<long>(node.left);
+    case calc_op::negate:
+      return -left.l;
+    case calc_op::bit_not:
+      return ~left.l;
+    case calc_op::add:
+      return left.l + right.l;
+    case calc_op::subtract:
+      return left.l - right.l;
+    case calc_op::multiply:
+      return left.l * right.l;
+    case calc_op::divide:
+      return left.l / right.l;
+    case calc_op::modulo:
+      return left.l % right.l;
+    case calc_op::bit_and:
+      return left.l & right.l;
+    case calc_op::bit_xor:
+      return left.l ^ right.l;
+    case calc_op::bit_or:
+      return left.l | right.l;
+    case calc_op::lshift:
+      return left.l << right.l;
+    case calc_op::rshift:
+      return left.l >> right.l;
+    case calc_op::max:
+      return std::max(left.l, right.l);
+    case calc_op::min:
+      return std::min(left.l, right.l);
+    default:
+      throw calc_eval_error{"Invalid integral expression node"};
+  }
+}
+
+/**
+ * Evaluate a floating expression node from its operand values.
+ *
+ * @param node Expression node
+ * @param left First operand value, unused for leaves
+ * @param right Second operand value, unused unless binary
+ */
+double calc_parser_impl::eval_double(
+  const calc_node& node, calc_register left, calc_register right) const
+{
+  switch (node.op) {
+    case calc_op::literal:
+      return node.value<double>();
+    case calc_op::symbol:
+      return symbol_value<double>(node.left);
+    case calc_op::to_double:
+      return static_cast<double>(left.l);
+    case calc_op::negate:
+      return -left.d;
+    case calc_op::exp:
+      return std::exp(left.d);
+    case calc_op::log:
+      return std::log(left.d);
+    case calc_op::log2:
+      return std::log2(left.d);
+    case calc_op::log10:
+      return std::log10(left.d);
+    case calc_op::sqrt:
+      return std::sqrt(left.d);
+    case calc_op::sin:
+      return std::sin(left.d);
+    case calc_op::cos:
+      return std::cos(left.d);
+    case calc_op::tan:
+      return std::tan(left.d);
+    case calc_op::add:
+      return left.d + right.d;
+    case calc_op::subtract:
+      return left.d - right.d;
+    case calc_op::multiply:
+      return left.d * right.d;
+    case calc_op::divide:
+      return left.d / right.d;
+    case calc_op::max:
+      return std::max(left.d, right.d);
+    case calc_op::min:
+      return std::min(left.d, right.d);
+    default:
+      throw calc_eval_error{"Invalid floating expression node"};
+  }
+}
+
+/**
+ * Return the error for a division by zero.
+ *
+ * This is only called on failure, so evaluating promoted operands again does
+ * not slow down evaluation, and expressions have no side effects.
+ *
+ * @param index Division node index
+ * @param left First operand value
+ * @param right Second operand value
+ */
+calc_eval_error calc_parser_impl::division_error(
+  std::uint32_t index, calc_register left, calc_register right)
+{
+  const auto& nodes = program_.nodes();
+  const auto& node = nodes[index];
+  auto format = [this, &nodes, &node](auto operand, calc_register value)
+  {
+    if (node.type == calc_value_type::integral)
+      return std::to_string(value.l);
+    if (nodes[operand].op == calc_op::to_double)
+      return std::to_string(evaluate(nodes[operand].left).l);
+    return std::to_string(value.d);
+  };
+  auto a = format(node.left, left);
+  return calc_division_error(a, format(node.right, right), index);
+}
+
+/**
+ * Return the value of a symbol.
+ *
+ * @tparam T Expected symbol value type
+ *
+ * @param name Symbol name index
+ *
+ * @throws calc_eval_error if the symbol is undefined or has another type
+ */
+template <typename T>
+T calc_parser_impl::symbol_value(std::uint32_t name) const
+{
+  std::string_view iden = program_.names()[name];
+  auto sym = find_symbol(iden);
+  if (!sym)
+    throw calc_eval_error{"Undefined symbol '" + std::string{iden} + "'"};
+  // type can differ if the symbol was rebound since the program was compiled
+  auto value = sym->get_if<T>();
+  if (!value)
+    throw calc_eval_error{
+      "Symbol '" + std::string{iden} + "' changed type since compile"
+    };
+  return *value;
 }
 
 }  // namespace pdcalc
@@ -8,13 +8,32 @@
 #ifndef PDCALC_CALC_PARSER_IMPL_HH_
 #define PDCALC_CALC_PARSER_IMPL_HH_
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <unordered_set>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "pdcalc/calc_parser.hh"
 #include "pdcalc/calc_symbol.hh"
+#include "calc_bytecode.hh"
+#include "calc_dependencies.hh"
+#include "calc_jit.hh"
+#include "calc_optimizer.hh"
+#include "calc_output.hh"
+#include "calc_parse_resource.hh"
+#include "calc_program.hh"
+#include "calc_scanner.hh"
+#include "calc_statement_cache.hh"
+#include "calc_stats.hh"
+#include "calc_symbol_table.hh"
+#include "mapped_file.hh"
 
 /**
  * Forward declaration to satisfy the `yy::parser` definition.
@@ -46,34 +65,52 @@ class calc_parser_impl;
 #define PDCALC_YYLEX_RETURN yy::parser::symbol_type
 
 /**
- * `YY_DECL` function name.
+ * Lexer function name.
  *
- * Usually this can be left as `yylex` unless the Flex name prefix is changed.
+ * This is the name the Bison parser calls, which dispatches to the Flex lexer
+ * or to the hand-written scanner depending on how the input was set up.
  */
 #define PDCALC_YYLEX yylex
 
+/**
+ * `YY_DECL` function name.
+ *
+ * This is the name of the Flex lexer function, which must differ from the
+ * name the Bison parser calls as that dispatches to the Flex lexer.
+ */
+#define PDCALC_FLEX_YYLEX pdcalc_flex_yylex
+
 /**
  * `YY_DECL` function declaration arguments.
  *
- * Should be a comma-separated list of function arguments.
+ * Should be a comma-separated list of function arguments. Since the Flex lexer
+ * is reentrant, the last argument must be the scanner state named `yyscanner`
+ * as the generated lexer code refers to the scanner state by that name.
  */
-#define PDCALC_YYLEX_ARGS pdcalc::calc_parser_impl& driver
+#define PDCALC_YYLEX_ARGS pdcalc::calc_parser_impl& driver, yyscan_t yyscanner
 
 /**
- * Macro declaring `yylex` in the format the Bison parser expects.
+ * Macro declaring the Flex lexer in the format the Bison parser expects.
  *
  * The corresponding parser handles complete symbols and uses variant values.
  */
-#define YY_DECL PDCALC_YYLEX_RETURN PDCALC_YYLEX(PDCALC_YYLEX_ARGS)
+#define YY_DECL PDCALC_YYLEX_RETURN PDCALC_FLEX_YYLEX(PDCALC_YYLEX_ARGS)
 
 /**
- * `yylex` declaration compatible with C++ Bison parser.
+ * Flex lexer declaration compatible with C++ Bison parser.
  *
  * There is no need to make this `extern "C"` since the generated Flex lexer
  * is being compiled as C++, not as straight C code.
  */
 YY_DECL;
 
+/**
+ * `yylex` declaration called by the C++ Bison parser.
+ *
+ * If `yyscanner` is `nullptr` the hand-written scanner is used.
+ */
+PDCALC_YYLEX_RETURN PDCALC_YYLEX(PDCALC_YYLEX_ARGS);
+
 namespace pdcalc {
 
 /**
@@ -83,6 +120,15 @@ namespace pdcalc {
  * implementation class as there is no way to export the generated Flex/Bison
  * functions + classes without using CMake's `CMAKE_WINDOWS_EXPORT_ALL_SYMBOLS`.
  * Using PIMPL also provides a more stable ABI, which is a good thing.
+ *
+ * Each instance owns its own reentrant Flex scanner state during a parse, so
+ * independent instances can be used concurrently from different threads.
+ * Concurrent use of a single instance is not supported.
+ *
+ * The grammar compiles each statement into a `calc_program` that is retained
+ * after parsing. When parsing, each statement is evaluated as soon as it is
+ * reduced so output and errors are interleaved exactly as they are read. When
+ * compiling, statements are only recorded so they can be evaluated later.
  */
 class calc_parser_impl {
 public:
@@ -92,14 +138,80 @@ public:
    * Ctor.
    *
    * @param sink Stream to write all non-error output to, default `std::cout`
+   * @param resource Resource to allocate from, default the default resource
+   */
+  calc_parser_impl(
+    std::ostream& sink = std::cout,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+  /**
+   * Allocate storage for an instance from a memory resource.
+   *
+   * The resource is recorded in front of the instance so that a plain
+   * `delete`, e.g. from `std::unique_ptr`, returns the storage to it.
+   *
+   * @param size Instance size
+   * @param resource Resource to allocate from
+   */
+  static void* operator new(
+    std::size_t size, std::pmr::memory_resource* resource);
+
+  /**
+   * Return storage to the memory resource it was allocated from.
+   *
+   * This is only called if the ctor throws.
+   *
+   * @param ptr Instance storage
+   * @param resource Resource the storage was allocated from
    */
-  calc_parser_impl(std::ostream& sink = std::cout) : sink_{sink} {}
+  static void operator delete(
+    void* ptr, std::pmr::memory_resource* resource) noexcept;
+
+  /**
+   * Return storage to the memory resource it was allocated from.
+   *
+   * @param ptr Instance storage
+   */
+  static void operator delete(void* ptr) noexcept;
+
+  /**
+   * Return the memory resource all memory is allocated from.
+   */
+  auto memory_resource() const noexcept { return resource_; }
 
   /**
    * Return reference to stream all non-error output is written to.
    */
   auto& sink() const noexcept { return sink_; }
 
+  /**
+   * Return reference to the buffered writer of statement results.
+   */
+  auto& output() noexcept { return output_; }
+
+  /**
+   * Return const reference to the buffered writer of statement results.
+   */
+  const auto& output() const noexcept { return output_; }
+
+  /**
+   * Return the visitor receiving statement results.
+   */
+  auto& visitor() const noexcept { return *visitor_; }
+
+  /**
+   * Set the visitor receiving statement results.
+   *
+   * @param visitor Visitor to use, `nullptr` to write results to the sink
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& visitor(calc_result_visitor* visitor)
+  {
+    output_.flush();
+    visitor_ = visitor ? visitor : &output_;
+    return *this;
+  }
+
   /**
    * Parse the specified input file.
    *
@@ -111,15 +223,312 @@ public:
   bool parse(
     const std::filesystem::path& input_file,
     bool trace_lexer,
+    bool trace_parser)
+  {
+    return parse_file(input_file, trace_lexer, trace_parser, true);
+  }
+
+  /**
+   * Parse the specified in-memory input.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse(const calc_source& source, bool trace_lexer, bool trace_parser)
+  {
+    return parse_source(source, trace_lexer, trace_parser, true);
+  }
+
+  /**
+   * Compile the specified input file without evaluating it.
+   *
+   * @param input_file File to read input from, empty or "-" for `stdin`
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(
+    const std::filesystem::path& input_file,
+    bool trace_lexer,
+    bool trace_parser)
+  {
+    return parse_file(input_file, trace_lexer, trace_parser, false);
+  }
+
+  /**
+   * Compile the specified in-memory input without evaluating it.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile(const calc_source& source, bool trace_lexer, bool trace_parser)
+  {
+    return parse_source(source, trace_lexer, trace_parser, false);
+  }
+
+  /**
+   * Evaluate the program from the last parse or compile.
+   *
+   * @returns `true` on success, `false` on failure
+   */
+  bool run();
+
+  /**
+   * Evaluate the program from the last parse or compile over columns of rows.
+   *
+   * @param inputs Pointer to first of `n_inputs` input columns
+   * @param n_inputs Number of input columns
+   * @param outputs Pointer to first of `n_outputs` output columns
+   * @param n_outputs Number of output columns
+   * @param n_rows Number of rows in each column
+   * @returns `true` on success, `false` on failure
+   */
+  bool run_columns(
+    const calc_input_column* inputs,
+    std::size_t n_inputs,
+    const calc_output_column* outputs,
+    std::size_t n_outputs,
+    std::size_t n_rows);
+
+  /**
+   * Assign the value of a single-expression program to a symbol.
+   *
+   * @param iden Symbol identifier
+   * @returns `true` on success, `false` if the program is not a single
+   *  expression
+   */
+  bool assign_result(std::string_view iden);
+
+  /**
+   * Compile and evaluate in-memory input for later recomputation.
+   *
+   * @param source Input text and name
+   * @param results Vector to append the statement results to
+   * @returns `true` on success, `false` on failure
+   */
+  bool load(const calc_source& source, std::vector<calc_result>& results);
+
+  /**
+   * Evaluate the statements of the loaded program affected by rebinding.
+   *
+   * @param results Vector to append the statement results to
+   * @returns `true` on success, `false` on failure
+   */
+  bool recompute(std::vector<calc_result>& results);
+
+  /**
+   * Return the program from the last parse or compile.
+   */
+  const auto& program() const noexcept { return program_; }
+
+  /**
+   * Parse the specified writable in-memory buffer without copying.
+   *
+   * @param buffer Buffer of `size` bytes ending with two null bytes
+   * @param size Buffer size, including the padding
+   * @param name Name used for the input in error locations
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_buffer(
+    char* buffer,
+    std::size_t size,
+    std::string_view name,
+    bool trace_lexer,
     bool trace_parser);
 
-  // allow lexer to access to the parse driver members to update location +
+  // allow lexers to access to the parse driver members to update location +
   // error note we use (::PDCALC_YYLEX) to tell compiler PDCALC_YYLEX is in the
   // global namespace, not in the current enclosing pdcalc namespace
   friend PDCALC_YYLEX_RETURN (::PDCALC_YYLEX)(PDCALC_YYLEX_ARGS);
+  friend PDCALC_YYLEX_RETURN (::PDCALC_FLEX_YYLEX)(PDCALC_YYLEX_ARGS);
   // allow parser to access parse driver members to update location + error
   friend class yy::parser;
 
+  /**
+   * Return how input files are read by the lexer.
+   */
+  auto input_mode() const noexcept { return input_mode_; }
+
+  /**
+   * Set how input files are read by the lexer.
+   *
+   * @param mode Input mode
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& input_mode(calc_input_mode mode) noexcept
+  {
+    input_mode_ = mode;
+    return *this;
+  }
+
+  /**
+   * Return which lexer turns input into tokens.
+   */
+  auto lexer() const noexcept { return lexer_; }
+
+  /**
+   * Set which lexer turns input into tokens.
+   *
+   * @param lexer Lexer
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& lexer(calc_lexer lexer) noexcept
+  {
+    lexer_ = lexer;
+    return *this;
+  }
+
+  /**
+   * Return how compiled statements are evaluated.
+   */
+  auto backend() const noexcept { return backend_; }
+
+  /**
+   * Set how compiled statements are evaluated.
+   *
+   * @param backend Evaluation backend
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& backend(calc_backend backend) noexcept
+  {
+    backend_ = backend;
+    return *this;
+  }
+
+  /**
+   * Return `true` if statements are optimized as they are compiled.
+   */
+  auto optimize() const noexcept { return optimize_; }
+
+  /**
+   * Set whether statements are optimized as they are compiled.
+   *
+   * @param enable `true` to optimize statements
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& optimize(bool enable) noexcept
+  {
+    // cached programs were compiled with the previous setting
+    if (enable != optimize_)
+      cache_.clear();
+    optimize_ = enable;
+    return *this;
+  }
+
+  /**
+   * Return `true` if parsing continues after a statement fails.
+   */
+  auto keep_going() const noexcept { return keep_going_; }
+
+  /**
+   * Set whether parsing continues after a statement fails.
+   *
+   * @param enable `true` to continue parsing after a statement fails
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& keep_going(bool enable) noexcept
+  {
+    keep_going_ = enable;
+    return *this;
+  }
+
+  /**
+   * Return the maximum number of inputs kept in the statement cache.
+   */
+  auto cache_capacity() const noexcept { return cache_.capacity(); }
+
+  /**
+   * Set the maximum number of inputs kept in the statement cache.
+   *
+   * @param capacity Maximum number of cached inputs, zero to disable
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& cache_capacity(std::size_t capacity)
+  {
+    cache_.capacity(capacity);
+    return *this;
+  }
+
+  /**
+   * Return `true` if each parse allocates from an arena.
+   */
+  auto arena() const noexcept { return arena_; }
+
+  /**
+   * Set whether each parse allocates from an arena.
+   *
+   * The compiled program and its bytecode are allocated from an arena on top
+   * of the memory resource that is released all at once when the next parse
+   * starts. Takes effect from the next parse.
+   *
+   * @param enable `true` to allocate each parse from an arena
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& arena(bool enable) noexcept
+  {
+    arena_ = enable;
+    return *this;
+  }
+
+  /**
+   * Return `true` if performance counters are collected.
+   */
+  bool stats_enabled() const noexcept { return counters_ != nullptr; }
+
+  /**
+   * Set whether performance counters are collected.
+   *
+   * @param enable `true` to collect performance counters
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& stats(bool enable) noexcept
+  {
+    counters_ = enable ? &stats_ : nullptr;
+    return *this;
+  }
+
+  /**
+   * Return the performance counters collected so far.
+   */
+  const auto& stats() const noexcept { return stats_; }
+
+  /**
+   * Reset all performance counters to zero.
+   *
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& reset_stats() noexcept
+  {
+    stats_ = {};
+    return *this;
+  }
+
+  /**
+   * Read the tokens of an in-memory input without parsing it.
+   *
+   * @param source Input text and name
+   * @param visitor Visitor receiving each token, ending with the end of input
+   * @returns `true` on success, `false` on a lexer error
+   */
+  bool lex(const calc_source& source, calc_token_visitor& visitor);
+
+  /**
+   * Write each statement of the program from the last parse or compile.
+   *
+   * Statement expressions are written as S-expressions prefixed with the
+   * statement location. If the expression was optimized, the optimized
+   * expression is written on the following line.
+   *
+   * @param out Stream to write to
+   */
+  void dump_program(std::ostream& out) const;
+
   /**
    * Return a message describing the last error that occurred.
    *
@@ -128,14 +537,20 @@ public:
   const auto& last_error() const noexcept { return last_error_; }
 
   /**
-   * Get the set of all symbols currently stored.
+   * Return the errors of the statements that failed in the last parse.
+   */
+  const auto& errors() const noexcept { return errors_; }
+
+  /**
+   * Get the table of all symbols currently stored.
    */
   const auto& symbols() const noexcept { return symbols_; }
 
   /**
    * Add a new symbol to the parser.
    *
-   * If a symbol with the same identifier already exists its value is replaced.
+   * If a symbol with the same identifier already exists its value is replaced
+   * in place, so pointers to the symbol remain valid.
    *
    * @param iden Symbol identifier
    * @param value Symbol value
@@ -150,25 +565,659 @@ public:
    */
   const calc_symbol* get_symbol(std::string_view iden) const;
 
+  /**
+   * Return the type a symbol has after the program from the last parse or
+   * compile.
+   *
+   * @param iden Symbol identifier
+   * @returns Index of the type in `calc_symbol::value_type`, or
+   *  `std::variant_npos` if the symbol is neither assigned nor defined
+   */
+  std::size_t symbol_type(std::string_view iden) const;
+
+  /**
+   * Return the identifier read before being assigned that caused the syntax
+   * error of the last parse or compile.
+   *
+   * @returns Identifier, empty if there was no such syntax error
+   */
+  std::string_view unbound_symbol() const noexcept
+  {
+    return unbound_ ? std::string_view{program_.names()[*unbound_]} : "";
+  }
+
+  /**
+   * Write a snapshot of all symbols and the input position to a file.
+   *
+   * @param path Snapshot file path
+   * @returns `true` on success, `false` on failure
+   */
+  bool save_snapshot(const std::filesystem::path& path);
+
+  /**
+   * Add the symbols of a snapshot and resume from its input position.
+   *
+   * @param path Snapshot file path
+   * @returns `true` on success, `false` on failure
+   */
+  bool restore_snapshot(const std::filesystem::path& path);
+
+  /**
+   * Return the input position reached.
+   */
+  const auto& position() const noexcept { return position_; }
+
+  /**
+   * Set the input position that the next parse starts from.
+   *
+   * @param position Input position
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& position(const calc_position& position) noexcept
+  {
+    position_ = position;
+    resume_ = true;
+    return *this;
+  }
+
+  /**
+   * Return the file checkpoints are written to, empty if not checkpointing.
+   */
+  const auto& checkpoint_path() const noexcept { return checkpoint_path_; }
+
+  /**
+   * Return the number of statements evaluated between checkpoints.
+   */
+  auto checkpoint_interval() const noexcept { return checkpoint_interval_; }
+
+  /**
+   * Set where and how often checkpoints are written during parsing.
+   *
+   * @param path Checkpoint file path, empty to disable checkpoints
+   * @param interval Statements between checkpoints, zero for only at the end
+   *  of each input
+   * @returns `*this` to allow method chaining
+   */
+  calc_parser_impl& checkpoint(
+    const std::filesystem::path& path, std::uint64_t interval)
+  {
+    checkpoint_path_ = path;
+    checkpoint_interval_ = interval;
+    since_checkpoint_ = 0;
+    return *this;
+  }
+
 private:
-  yy::location location_;                    // Bison parser location
-  std::string last_error_;                   // text for last error
-  std::ostream& sink_;                       // stream to write output to
-  std::unordered_set<calc_symbol> symbols_;  // set of bound variables
+  yy::location location_;                      // Bison parser location
+  std::string last_error_;                     // text for last error
+  calc_error eval_error_;                      // last evaluation error
+  std::vector<calc_error> errors_;             // failed statement errors
+  bool keep_going_{};                          // continue after failures
+  bool recover_{};                             // recovering in this parse
+  bool skipping_{};                            // skipping a failed statement
+  std::size_t lexed_{};                        // tokens lexed in this parse
+  std::size_t unknown_lexed_{};                // lexed_ at last unknown iden
+  std::uint32_t unknown_name_{};               // name of last unknown iden
+  std::optional<std::uint32_t> unbound_;       // unknown iden syntax error
+  std::ostream& sink_;                         // stream to write output to
+  std::pmr::memory_resource* resource_;        // resource to allocate from
+  calc_output output_;                         // buffered statement results
+  calc_result_visitor* visitor_;               // receives statement results
+  calc_parse_resource parse_resource_;         // resource for parse state
+  bool arena_{};                               // allocate parses from arena
+  calc_symbol_table symbols_;                  // bound variables
+  yyscan_t scanner_{};                         // Flex scanner state
+  calc_input_mode input_mode_{};               // how input files are read
+  mapped_file input_map_;                      // mapped input file if any
+  calc_lexer lexer_{};                         // lexer to use for input
+  calc_scanner text_scanner_;                  // hand-written scanner state
+  // input file contents read for the hand-written scanner. the capacity is
+  // kept so that reading the next input file does not need to allocate
+  std::pmr::vector<char> input_text_;
+  calc_program program_;                       // last compiled program
+  bool execute_{true};                         // evaluate statements on reduce
+  bool optimize_{true};                        // optimize statements on reduce
+  calc_optimizer optimizer_;                   // statement optimizer
+  calc_backend backend_{};                     // statement evaluation backend
+  calc_bytecode bytecode_;                     // program compiled for the VM
+  std::pmr::vector<calc_register> registers_;  // VM registers
+  calc_jit jit_;                               // VM bytecode compiled natively
+  std::pmr::vector<calc_register> slots_;      // JIT loaded symbol values
+  // tree evaluator stack of nodes to visit, each marked once its operands
+  // are pushed, and stack of the operand values computed so far
+  std::pmr::vector<std::pair<std::uint32_t, bool>> eval_nodes_;
+  std::pmr::vector<calc_register> eval_values_;
+  // compile-time symbol types by name index used by the lexer to type
+  // identifiers. empty if the symbol is not yet bound
+  std::pmr::vector<std::optional<calc_value_type>> symbol_types_;
+  calc_stats stats_{};                         // performance counters
+  // performance counters to update or nullptr if not collecting. counters are
+  // updated through this pointer so const members can update them too
+  calc_stats* counters_{};
+  calc_phase_timer timer_;                     // times the counted phases
+  // first node of the next statement expression as written
+  std::uint32_t first_node_{};
+  calc_dependencies dependencies_;             // statement symbol reads
+  bool record_dependencies_{};                 // record reads on compile
+  std::pmr::string load_text_;                 // loaded input text
+  std::pmr::string load_name_;                 // loaded input name
+  bool loaded_{};                              // loaded program compiled
+  bool load_stale_{};                          // loaded text to recompile
+  bool load_valid_{};                          // all loaded statements ran
+  // value each loaded assignment statement last assigned, if evaluated
+  std::pmr::vector<std::optional<symbol_value_type>> load_values_;
+  // symbols rebound since the last recompute by name index
+  std::pmr::vector<bool> rebound_;
+  // results of loaded statements being evaluated or nullptr if not loading
+  std::vector<calc_result>* results_{};
+  std::uint32_t result_statement_{};           // statement being evaluated
+  calc_position position_;                     // input position reached
+  bool resume_{};                              // next parse starts at position
+  std::filesystem::path checkpoint_path_;      // checkpoint file if any
+  std::uint64_t checkpoint_interval_{};        // statements between checkpoints
+  std::uint64_t since_checkpoint_{};           // statements since checkpoint
+  calc_statement_cache cache_;                 // compiled in-memory inputs
+  std::pmr::string cache_key_;                 // normalized input text
+
+  /**
+   * Discard the program from the last parse or compile.
+   *
+   * If the last parse used an arena or the next parse will, all parse state
+   * is first replaced by empty state so the arena can be released at once.
+   *
+   * @param input_name Input name used when reporting errors
+   */
+  void reset_program(const std::string& input_name);
+
+  /**
+   * Create new Flex scanner state that is destroyed by `lex_cleanup`.
+   *
+   * @param enable_debug `true` to turn on lexer tracing
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool lex_init(bool enable_debug) noexcept;
 
   /**
    * Perform setup for the Flex lexer.
    *
+   * This creates new scanner state that is destroyed by `lex_cleanup`. If the
+   * input mode is `calc_input_mode::mmap` and the file can be mapped, the
+   * mapped file is scanned in place instead of being read through stdio.
+   *
    * @param input_file Input file to read. If empty or "-", `stdin` is used.
    * @param enable_debug `true` to turn on lexer tracing, default `false`
    * @returns `true` on success, `false` on failure and sets `last_error_`
    */
   bool lex_setup(const std::string& input_file, bool enable_debug) noexcept;
 
+  /**
+   * Perform setup for the Flex lexer to scan a copy of in-memory text.
+   *
+   * This creates new scanner state that is destroyed by `lex_cleanup`.
+   *
+   * @param text Input text to copy into the lexer buffer
+   * @param enable_debug `true` to turn on lexer tracing
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool lex_setup_bytes(std::string_view text, bool enable_debug) noexcept;
+
+  /**
+   * Perform setup for the Flex lexer to scan a padded buffer in place.
+   *
+   * This creates new scanner state that is destroyed by `lex_cleanup`.
+   *
+   * @param buffer Buffer of `size` bytes ending with two null bytes
+   * @param size Buffer size, including the padding
+   * @param enable_debug `true` to turn on lexer tracing
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool lex_setup_buffer(
+    char* buffer, std::size_t size, bool enable_debug) noexcept;
+
+  /**
+   * Perform setup for the hand-written scanner to scan an input file.
+   *
+   * If the input mode is `calc_input_mode::mmap` and the file can be mapped,
+   * the mapped file is scanned, otherwise the file is read into memory.
+   *
+   * @param input_file Input file to read. If empty or "-", `stdin` is used.
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool scan_setup(const std::string& input_file);
+
+  /**
+   * Perform setup for the hand-written scanner to scan a padded buffer.
+   *
+   * The buffer is checked for padding so errors are the same as for Flex.
+   *
+   * @param buffer Buffer of `size` bytes ending with two null bytes
+   * @param size Buffer size, including the padding
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool scan_setup_buffer(const char* buffer, std::size_t size) noexcept;
+
+  /**
+   * Return the next token from the hand-written scanner.
+   *
+   * This matches the Flex lexer rules and location updates exactly.
+   *
+   * @throws yy::parser::syntax_error on an unrecognized token or a literal
+   *  that is out of range
+   */
+  yy::parser::symbol_type scan();
+
+  /**
+   * Return the identifier token for the given identifier.
+   *
+   * The identifier is interned and typed from the compile-time symbol types,
+   * using the current location.
+   *
+   * @param iden Identifier text
+   */
+  yy::parser::symbol_type iden_token(std::string_view iden);
+
+  /**
+   * Parse or compile the specified input file.
+   *
+   * @param input_file File to read input from, empty or "-" for `stdin`
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @param execute `true` to evaluate each statement as it is compiled
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_file(
+    const std::filesystem::path& input_file,
+    bool trace_lexer,
+    bool trace_parser,
+    bool execute);
+
+  /**
+   * Parse or compile the specified in-memory input.
+   *
+   * @param source Input text and name
+   * @param trace_lexer `true` to enable lexer tracing
+   * @param trace_parser `true` to enable parser tracing
+   * @param execute `true` to evaluate each statement as it is compiled
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_source(
+    const calc_source& source,
+    bool trace_lexer,
+    bool trace_parser,
+    bool execute);
+
+  /**
+   * Evaluate an in-memory input from its statement cache entry.
+   *
+   * @param item Cache entry for the input text
+   * @param source Input text and name
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_cached(
+    const calc_statement_cache::entry& item, const calc_source& source);
+
+  /**
+   * Parse the rest of an in-memory input from the position of the parser.
+   *
+   * @param source Input text and name
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_rest(const calc_source& source);
+
+  /**
+   * Return `true` if the symbols a cache entry reads have the same types.
+   *
+   * @param item Cache entry
+   */
+  bool cache_valid(const calc_statement_cache::entry& item) const;
+
+  /**
+   * Add the program from the last parse to the statement cache.
+   *
+   * @param text Input text the program was compiled from
+   */
+  void cache_program(std::string_view text);
+
+  /**
+   * Run the Bison parser on the input set up by a `lex_setup*` function.
+   *
+   * The previous program is discarded. Flex lexer cleanup is always performed
+   * before returning.
+   *
+   * @param input_name Input name, which is also used by the parser location
+   * @param trace_parser `true` to enable parser tracing
+   * @param execute `true` to evaluate each statement as it is compiled
+   * @returns `true` on success, `false` on failure
+   */
+  bool parse_input(
+    const std::string& input_name, bool trace_parser, bool execute);
+
+  /**
+   * Return pointer to the compile-time type of a symbol or `nullptr`.
+   *
+   * The first time a name index is seen its type is taken from the symbol
+   * table, so names must be looked up in the order they were interned.
+   *
+   * @param name Symbol name index
+   */
+  const calc_value_type* symbol_type(std::uint32_t name);
+
+  /**
+   * Set the compile-time type of a symbol.
+   *
+   * This is called when an assignment statement is compiled so that the lexer
+   * can type the identifier correctly in the statements that follow.
+   *
+   * @param name Symbol name index
+   * @param type Symbol type
+   */
+  void declare_symbol(std::uint32_t name, calc_value_type type);
+
+  /**
+   * Return a pointer to the symbol if it exists and `nullptr` otherwise.
+   *
+   * Unlike `get_symbol`, this counts the lookup if collecting counters.
+   *
+   * @param iden Symbol identifier
+   */
+  const calc_symbol* find_symbol(std::string_view iden) const
+  {
+    if (counters_)
+      counters_->symbol_lookups++;
+    return symbols_.find(iden);
+  }
+
+  /**
+   * Add or replace a symbol from an evaluated assignment.
+   *
+   * Unlike `add_symbol`, this counts the insert if collecting counters and
+   * records the result when evaluating loaded statements.
+   *
+   * @param iden Symbol identifier
+   * @param value Symbol value
+   */
+  void store_symbol(std::string_view iden, symbol_value_type value)
+  {
+    if (counters_)
+      counters_->symbol_inserts++;
+    if (results_)
+      results_->push_back({result_statement_, iden, value});
+    symbols_.assign(iden, std::move(value));
+  }
+
+  /**
+   * Return a scope that is timed as the given phase if collecting counters.
+   *
+   * @param phase Phase
+   */
+  calc_phase_scope phase_scope(calc_phase phase) noexcept
+  {
+    return {counters_, timer_, phase};
+  }
+
+  /**
+   * Pass a statement result to the visitor.
+   *
+   * When evaluating loaded statements the result is recorded instead.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param value Statement result
+   */
+  template <typename T>
+  void print_result(T value)
+  {
+    if (results_) {
+      results_->push_back({result_statement_, {}, value});
+      return;
+    }
+    auto scope = phase_scope(calc_phase::output);
+    visitor_->visit(
+      result_statement_,
+      statement_location(program_.statements()[result_statement_]),
+      value
+    );
+  }
+
+  /**
+   * Compile the loaded text, recording the statement dependencies.
+   *
+   * @returns `true` on success, `false` on failure
+   */
+  bool compile_loaded();
+
+  /**
+   * Return `true` if a rebound symbol has another type than the loaded program
+   * reads it as on input.
+   */
+  bool input_type_changed() const;
+
+  /**
+   * Return `true` if a statement reads or assigns a rebound symbol.
+   *
+   * @param index Statement index
+   */
+  bool depends_on_rebound(std::uint32_t index) const noexcept;
+
+  /**
+   * Count a statement that was just compiled and its builtin calls.
+   *
+   * @param index Statement index
+   */
+  void count_statement(std::uint32_t index) noexcept;
+
+  /**
+   * Handle a statement that was just compiled.
+   *
+   * If enabled, the statement is optimized, and if statements are being
+   * evaluated as they are compiled, the statement is evaluated. Called from
+   * the parser semantic actions.
+   *
+   * @param index Statement index
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool complete_statement(std::uint32_t index);
+
+  /**
+   * Evaluate a statement that was just compiled.
+   *
+   * The input position is moved past the statement and a checkpoint is
+   * written if due.
+   *
+   * @param index Statement index
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool evaluate_statement(std::uint32_t index);
+
+  /**
+   * Handle an input that was successfully evaluated.
+   *
+   * The input position is moved to the start of the next input and a
+   * checkpoint is written if checkpointing.
+   *
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool complete_input();
+
+  /**
+   * Handle an error in the statement being parsed.
+   *
+   * Only the first error in a statement is handled. If recovering, the error
+   * is collected and marked in the output and the rest of the statement is
+   * skipped. Otherwise, the lexer returns end of input to stop the parse.
+   *
+   * @param loc Error location
+   * @param message Error message
+   */
+  void syntax_error(const yy::location& loc, const std::string& message);
+
+  /**
+   * Handle the end of a statement skipped after a syntax error.
+   *
+   * @param loc Location of the skipped statement
+   * @returns `true` if recovering, `false` to abort the parse
+   */
+  bool skip_statement(const yy::location& loc);
+
+  /**
+   * Handle a statement that failed to evaluate.
+   *
+   * If recovering, the error is collected and marked in the output. Any
+   * symbol the statement assigns gets back the compile-time type of its
+   * value, or none if it is undefined, so the statements that follow are
+   * compiled for the value the symbol still has.
+   *
+   * @param index Statement index
+   * @returns `true` if recovering, `false` to abort the parse
+   */
+  bool fail_statement(std::uint32_t index);
+
+  /**
+   * Write buffered output and a checkpoint of the input position reached.
+   *
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool write_checkpoint();
+
+  /**
+   * Evaluate a statement with the current backend, writing any output to the
+   * sink.
+   *
+   * @param index Statement index
+   * @returns `true` on success, `false` on failure and sets `last_error_`
+   */
+  bool run_statement(std::uint32_t index);
+
+  /**
+   * Return the location of a statement.
+   *
+   * @param stmt Statement to return the location of
+   */
+  calc_location statement_location(const calc_statement& stmt) const;
+
+  /**
+   * Set the last error to an evaluation error prefixed with its location.
+   *
+   * @param stmt Statement the error is from
+   * @param error Evaluation error
+   */
+  void statement_error(
+    const calc_statement& stmt, const calc_eval_error& error);
+
+  /**
+   * Evaluate a statement by walking its expression tree, writing any output to
+   * the sink.
+   *
+   * @param stmt Statement to evaluate
+   *
+   * @throws calc_eval_error on evaluation failure
+   */
+  void execute(const calc_statement& stmt);
+
+  /**
+   * Run a compiled statement on the register VM, writing any output to the
+   * sink.
+   *
+   * @param index Statement index, compiling the bytecode as needed
+   *
+   * @throws calc_eval_error on evaluation failure
+   */
+  void execute_bytecode(std::uint32_t index);
+
+  /**
+   * Run a compiled statement as native code, writing any output to the sink.
+   *
+   * Falls back to the register VM if native code cannot be generated, or to
+   * walking the expression tree if the statement has no bytecode.
+   *
+   * @param index Statement index, compiling the bytecode as needed
+   *
+   * @throws calc_eval_error on evaluation failure
+   */
+  void execute_native(std::uint32_t index);
+
+  /**
+   * Compile any new statements to bytecode and ensure enough VM registers.
+   */
+  void compile_bytecode();
+
+  /**
+   * Print or store the statement result in VM register 0.
+   *
+   * @param ins Print or store instruction ending the statement
+   */
+  void finish_bytecode(const calc_instruction& ins);
+
+  /**
+   * Evaluate an expression tree without recursion.
+   *
+   * @param root Expression root node index
+   * @returns Value of the expression root node type
+   *
+   * @throws calc_eval_error on evaluation failure
+   */
+  calc_register evaluate(std::uint32_t root);
+
+  /**
+   * Evaluate a boolean expression node from its operand values.
+   *
+   * @param node Expression node
+   * @param left First operand value, unused for leaves
+   * @param right Second operand value, unused unless binary
+   */
+  bool eval_bool(
+    const calc_node& node, calc_register left, calc_register right) const;
+
+  /**
+   * Evaluate an integral expression node from its operand values.
+   *
+   * @param node Expression node
+   * @param left First operand value, unused for leaves
+   * @param right Second operand value, unused unless binary
+   */
+  long eval_long(
+    const calc_node& node, calc_register left, calc_register right) const;
+
+  /**
+   * Evaluate a floating expression node from its operand values.
+   *
+   * @param node Expression node
+   * @param left First operand value, unused for leaves
+   * @param right Second operand value, unused unless binary
+   */
+  double eval_double(
+    const calc_node& node, calc_register left, calc_register right) const;
+
+  /**
+   * Return the error for a division by zero.
+   *
+   * Promoted integral operands are evaluated again so that they are reported
+   * with their exact integral values.
+   *
+   * @param index Division node index
+   * @param left First operand value
+   * @param right Second operand value
+   */
+  calc_eval_error division_error(
+    std::uint32_t index, calc_register left, calc_register right);
+
+  /**
+   * Return the value of a symbol.
+   *
+   * @tparam T Expected symbol value type
+   *
+   * @param name Symbol name index
+   *
+   * @throws calc_eval_error if the symbol is undefined or has another type
+   */
+  template <typename T>
+  T symbol_value(std::uint32_t name) const;
+
   /**
    * Perform cleanup for the Flex lexer.
    *
-   * Currently, all this does is close `yyin` unless `yyin` is `stdin`.
+   * Destroys the scanner state, unmaps any mapped input file, and closes the
+   * scanner input unless it is `stdin`.
    *
    * @param input_file Input file passed to `lex_setup`. Used in error reporting.
    */
@@ -0,0 +1,411 @@
+/**
+ * @file calc_program.cc
+ * @author Derek Huang
+ * @brief C++ source for the compiled infix calculator program representation
+ * @copyright MIT License
+ */
+
+#include "calc_program.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return the name an operation is written with when dumping an expression.
+ *
+ * @param op Node operation
+ */
+const char* operation_name(calc_op op) noexcept
+{
+  switch (op) {
+    case calc_op::literal:
+      return "literal";
+    case calc_op::symbol:
+      return "symbol";
+    case calc_op::to_double:
+      return "double";
+    case calc_op::negate:
+      return "neg";
+    case calc_op::bit_not:
+      return "~";
+    case calc_op::logical_not:
+      return "!";
+    case calc_op::exp:
+      return "exp";
+    case calc_op::log:
+      return "log";
+    case calc_op::log2:
+      return "log2";
+    case calc_op::log10:
+      return "log10";
+    case calc_op::sqrt:
+      return "sqrt";
+    case calc_op::sin:
+      return "sin";
+    case calc_op::cos:
+      return "cos";
+    case calc_op::tan:
+      return "tan";
+    case calc_op::add:
+      return "+";
+    case calc_op::subtract:
+      return "-";
+    case calc_op::multiply:
+      return "*";
+    case calc_op::divide:
+      return "/";
+    case calc_op::modulo:
+      return "%";
+    case calc_op::bit_and:
+      return "&";
+    case calc_op::bit_xor:
+      return "^";
+    case calc_op::bit_or:
+      return "|";
+    case calc_op::lshift:
+      return "<<";
+    case calc_op::rshift:
+      return ">>";
+    case calc_op::max:
+      return "max";
+    case calc_op::min:
+      return "min";
+    case calc_op::equal:
+      return "==";
+    case calc_op::not_equal:
+      return "!=";
+    case calc_op::less:
+      return "<";
+    case calc_op::greater:
+      return ">";
+    case calc_op::less_equal:
+      return "<=";
+    case calc_op::greater_equal:
+      return ">=";
+    case calc_op::logical_and:
+      return "&&";
+    case calc_op::logical_or:
+      return "||";
+  }
+  return "?";
+}
+
+/**
+ * Write a literal value as it would be written in the input.
+ *
+ * Floating values are written with the shortest round-trip representation
+ * and always have a decimal point or exponent to distinguish them from
+ * integral values.
+ *
+ * @param out Stream to write to
+ * @param node Literal node
+ */
+void dump_literal(std::ostream& out, const calc_node& node)
+{
+  switch (node.type) {
+    case calc_value_type::boolean:
+      out << (node.value<bool>() ? "true" : "false");
+      return;
+    case calc_value_type::integral:
+      out << node.value<long>();
+      return;
+    case calc_value_type::floating: {
+      char buf[32];
+      auto end = std::to_chars(buf, buf + sizeof buf, node.value<double>()).ptr;
+      std::string_view text{buf, static_cast<std::size_t>(end - buf)};
+      out << text;
+      if (text.find_first_not_of("-0123456789") == text.npos)
+        out << '.';
+      return;
+    }
+  }
+}
+
+/**
+ * Write an expression node as an S-expression.
+ *
+ * Nodes are written with an explicit stack so long expressions cannot
+ * overflow the call stack.
+ *
+ * @param out Stream to write to
+ * @param program Program containing the expression
+ * @param index Node index
+ * @param labels Label of each node used more than once, 0 if not written yet
+ * @param n_labels Number of labels written so far
+ */
+void dump_node(
+  std::ostream& out,
+  const calc_program& program,
+  std::uint32_t index,
+  std::unordered_map<std::uint32_t, std::uint32_t>& labels,
+  std::uint32_t& n_labels)
+{
+  // node index and number of operands written so far
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> frames{{index, 0}};
+  while (frames.size()) {
+    auto& [top, operands] = frames.back();
+    const auto& node = program.nodes()[top];
+    // first visit. label shared nodes on first use and refer to the label
+    // afterwards
+    if (!operands) {
+      auto label = labels.find(top);
+      if (label != labels.end()) {
+        if (label->second) {
+          out << '#' << label->second << '#';
+          frames.pop_back();
+          continue;
+        }
+        label->second = ++n_labels;
+        out << '#' << label->second << '=';
+      }
+      switch (node.op) {
+        case calc_op::literal:
+          dump_literal(out, node);
+          frames.pop_back();
+          continue;
+        case calc_op::symbol:
+          out << program.names()[node.left];
+          frames.pop_back();
+          continue;
+        default:
+          out << '(' << operation_name(node.op) << ' ';
+          operands = 1;
+          frames.push_back({node.left, 0});
+          continue;
+      }
+    }
+    if (operands == 1 && calc_is_binary(node.op)) {
+      out << ' ';
+      operands = 2;
+      frames.push_back({node.right, 0});
+      continue;
+    }
+    out << ')';
+    frames.pop_back();
+  }
+}
+
+/**
+ * Find the nodes of an expression that are used more than once.
+ *
+ * @param program Program containing the expression
+ * @param index Node index
+ * @param visited Nodes visited so far
+ * @param labels Map to add the nodes used more than once to
+ */
+void find_shared(
+  const calc_program& program,
+  std::uint32_t index,
+  std::unordered_set<std::uint32_t>& visited,
+  std::unordered_map<std::uint32_t, std::uint32_t>& labels)
+{
+  // every use of a node is seen once, so the order nodes are visited in
+  // does not matter and an explicit stack replaces recursion
+  std::vector<std::uint32_t> pending{index};
+  while (pending.size()) {
+    auto top = pending.back();
+    pending.pop_back();
+    // operands of a node already visited have also been visited
+    if (!visited.insert(top).second) {
+      labels.emplace(top, 0);
+      continue;
+    }
+    const auto& node = program.nodes()[top];
+    if (calc_is_leaf(node.op))
+      continue;
+    pending.push_back(node.left);
+    if (calc_is_binary(node.op))
+      pending.push_back(node.right);
+  }
+}
+
+}  // namespace
+
+/**
+ * Reset the program to be empty.
+ *
+ * Capacity is retained so that compiling a similar program does not allocate.
+ *
+ * @param name Input name used when reporting errors
+ */
+void calc_program::reset(std::string_view name)
+{
+  name_ = name;
+  nodes_.clear();
+  node_locations_.clear();
+  statements_.clear();
+  names_.clear();
+  name_storage_.clear();
+  name_indices_.clear();
+}
+
+/**
+ * Replace the program with a copy of another program.
+ *
+ * @param name Input name used when reporting errors
+ * @param other Program to copy
+ */
+void calc_program::assign(std::string_view name, const calc_program& other)
+{
+  reset(name);
+  nodes_.assign(other.nodes_.begin(), other.nodes_.end());
+  node_locations_.assign(
+    other.node_locations_.begin(), other.node_locations_.end()
+  );
+  statements_.assign(other.statements_.begin(), other.statements_.end());
+  for (auto iden : other.names_)
+    intern(iden);
+}
+
+/**
+ * Return the location of a node or `nullptr` if it has none.
+ *
+ * @param index Node index
+ */
+const calc_node_location*
+calc_program::node_location(std::uint32_t index) const noexcept
+{
+  auto it = std::lower_bound(
+    node_locations_.begin(),
+    node_locations_.end(),
+    index,
+    [](const auto& loc, auto node) { return loc.node < node; }
+  );
+  if (it == node_locations_.end() || it->node != index)
+    return nullptr;
+  return &*it;
+}
+
+/**
+ * Set the location of a node and return its index.
+ *
+ * Nodes are usually located as they are added, so the location is appended.
+ *
+ * @param loc Node location
+ */
+std::uint32_t calc_program::locate_node(const calc_node_location& loc)
+{
+  auto op = nodes_[loc.node].op;
+  if (op != calc_op::divide && op != calc_op::modulo)
+    return loc.node;
+  auto it = std::lower_bound(
+    node_locations_.begin(),
+    node_locations_.end(),
+    loc.node,
+    [](const auto& other, auto node) { return other.node < node; }
+  );
+  if (it != node_locations_.end() && it->node == loc.node)
+    *it = loc;
+  else
+    node_locations_.insert(it, loc);
+  return loc.node;
+}
+
+/**
+ * Add an operation node and return its index.
+ *
+ * @param op Unary or binary operation
+ * @param type Result type
+ * @param left Index of the first operand
+ * @param right Index of the second operand, ignored for unary operations
+ */
+std::uint32_t calc_program::node(
+  calc_op op, calc_value_type type, std::uint32_t left, std::uint32_t right)
+{
+  return append({op, type, left, right});
+}
+
+/**
+ * Add an arithmetic operation node and return its index.
+ *
+ * @param op Binary arithmetic operation
+ * @param left Index of the first operand
+ * @param right Index of the second operand
+ */
+std::uint32_t calc_program::arithmetic(
+  calc_op op, std::uint32_t left, std::uint32_t right)
+{
+  if (
+    nodes_[left].type == calc_value_type::integral &&
+    nodes_[right].type == calc_value_type::integral
+  )
+    return node(op, calc_value_type::integral, left, right);
+  // promote left first as argument evaluation order is unspecified
+  left = promote(left);
+  return node(op, calc_value_type::floating, left, promote(right));
+}
+
+/**
+ * Return index of a node promoting the given node to floating.
+ *
+ * @param index Node index
+ */
+std::uint32_t calc_program::promote(std::uint32_t index)
+{
+  if (nodes_[index].type != calc_value_type::integral)
+    return index;
+  return append({calc_op::to_double, calc_value_type::floating, index, 0});
+}
+
+/**
+ * Write an expression as an S-expression.
+ *
+ * @param out Stream to write to
+ * @param root Expression root node index
+ */
+void calc_program::dump(std::ostream& out, std::uint32_t root) const
+{
+  std::unordered_set<std::uint32_t> visited;
+  std::unordered_map<std::uint32_t, std::uint32_t> labels;
+  find_shared(*this, root, visited, labels);
+  std::uint32_t n_labels = 0;
+  dump_node(out, *this, root, labels, n_labels);
+}
+
+/**
+ * Append a node and return its index.
+ *
+ * @param node Node to append
+ */
+std::uint32_t calc_program::append(const calc_node& node)
+{
+  if (nodes_.size() >= std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error{"Too many expression nodes in " + name_};
+  nodes_.push_back(node);
+  return static_cast<std::uint32_t>(nodes_.size() - 1);
+}
+
+/**
+ * Return the index of the symbol name, adding it if necessary.
+ *
+ * @param iden Symbol identifier
+ */
+std::uint32_t calc_program::intern(std::string_view iden)
+{
+  auto it = name_indices_.find(iden);
+  if (it != name_indices_.end())
+    return it->second;
+  // name + key must view the stored name, not the caller's buffer
+  auto index = static_cast<std::uint32_t>(names_.size());
+  std::string_view name = name_storage_.emplace_front(iden);
+  names_.push_back(name);
+  name_indices_.emplace(name, index);
+  return index;
+}
+
+}  // namespace pdcalc
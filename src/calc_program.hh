@@ -0,0 +1,600 @@
+/**
+ * @file calc_program.hh
+ * @author Derek Huang
+ * @brief C++ header for the compiled infix calculator program representation
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_PROGRAM_HH_
+#define PDCALC_CALC_PROGRAM_HH_
+
+#include <cstdint>
+#include <cstring>
+#include <forward_list>
+#include <iosfwd>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pdcalc {
+
+/**
+ * Static type of an expression or a symbol.
+ */
+enum class calc_value_type : std::uint8_t {
+  boolean,   // bool
+  integral,  // long
+  floating   // double
+};
+
+/**
+ * Expression node operation.
+ *
+ * Operands of binary operations always have the same type as implicit
+ * integral to floating promotions are made explicit with `to_double` nodes.
+ */
+enum class calc_op : std::uint8_t {
+  // leaves
+  literal,
+  symbol,
+  // conversions
+  to_double,
+  // unary operations
+  negate,
+  bit_not,
+  logical_not,
+  exp,
+  log,
+  log2,
+  log10,
+  sqrt,
+  sin,
+  cos,
+  tan,
+  // binary arithmetic operations
+  add,
+  subtract,
+  multiply,
+  divide,
+  modulo,
+  bit_and,
+  bit_xor,
+  bit_or,
+  lshift,
+  rshift,
+  max,
+  min,
+  // binary comparison + logical operations
+  equal,
+  not_equal,
+  less,
+  greater,
+  less_equal,
+  greater_equal,
+  logical_and,
+  logical_or
+};
+
+/**
+ * Return `true` if the operation is a leaf, i.e. a literal or a symbol.
+ *
+ * @param op Node operation
+ */
+constexpr bool calc_is_leaf(calc_op op) noexcept
+{
+  return op <= calc_op::symbol;
+}
+
+/**
+ * Return `true` if the operation is a binary operation.
+ *
+ * @param op Node operation
+ */
+constexpr bool calc_is_binary(calc_op op) noexcept
+{
+  return op >= calc_op::add;
+}
+
+/**
+ * Expression node.
+ *
+ * Nodes refer to their operands by index into the program node array. For
+ * literals, the two index fields instead hold the bits of the value, and for
+ * symbols, the first index field holds the index into the symbol name table.
+ */
+struct calc_node {
+  calc_op op;            // operation
+  calc_value_type type;  // result type
+  std::uint32_t left;    // first operand, symbol name index, or value bits
+  std::uint32_t right;   // second operand or value bits
+
+  /**
+   * Return the literal value stored in the node.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   */
+  template <typename T>
+  T value() const noexcept
+  {
+    static_assert(sizeof(T) <= sizeof(std::uint64_t));
+    auto bits = (std::uint64_t{right} << 32) | left;
+    T res;
+    std::memcpy(&res, &bits, sizeof res);
+    return res;
+  }
+};
+
+/**
+ * Statement kind.
+ */
+enum class calc_statement_kind : std::uint8_t {
+  print,  // print expression value to the sink
+  assign  // assign expression value to a symbol
+};
+
+/**
+ * Statement.
+ *
+ * Compound assignments are stored as plain assignments, e.g. `a += b` is
+ * stored as `a = a + b`. The location is kept for error reporting and the
+ * expression root as written is kept so optimizations can be inspected.
+ */
+struct calc_statement {
+  calc_statement_kind kind;     // statement kind
+  std::uint32_t root;           // index of the expression root node
+  std::uint32_t source;         // index of the root node before optimization
+  std::uint32_t name;           // symbol name index for assignments
+  std::uint32_t begin_line;     // first line of the statement
+  std::uint32_t begin_column;   // first column of the statement
+  std::uint32_t end_line;       // last line of the statement
+  std::uint32_t end_column;     // column past the end of the statement
+};
+
+/**
+ * Location of an expression node.
+ *
+ * Only the nodes whose evaluation can fail have locations, so that errors are
+ * reported at the failing operation instead of the whole statement.
+ */
+struct calc_node_location {
+  std::uint32_t node;           // node index
+  std::uint32_t begin_line;     // first line of the node
+  std::uint32_t begin_column;   // first column of the node
+  std::uint32_t end_line;       // last line of the node
+  std::uint32_t end_column;     // column past the end of the node
+};
+
+/**
+ * Compiled program of statements over a flat expression node array.
+ *
+ * Nodes are appended in post-order as the grammar is reduced, so operands are
+ * always stored before the nodes that use them. Using indices instead of
+ * pointers keeps the nodes contiguous.
+ *
+ * The parser only builds trees, but an optimized statement expression can be
+ * a DAG where nodes are used more than once. Nodes are never shared between
+ * statements and all the nodes of a statement expression are stored after
+ * the nodes of the previous statement expression.
+ */
+class calc_program {
+public:
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate the program from
+   */
+  explicit calc_program(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : nodes_{resource},
+      node_locations_{resource},
+      statements_{resource},
+      names_{resource},
+      name_storage_{resource},
+      name_indices_{resource}
+  {}
+
+  /**
+   * Deleted copy ctor.
+   *
+   * Symbol names are views of storage owned by the program.
+   */
+  calc_program(const calc_program&) = delete;
+
+  /**
+   * Move ctor.
+   */
+  calc_program(calc_program&&) = default;
+
+  /**
+   * Move assignment operator.
+   *
+   * Both programs must use the same memory resource, as otherwise the names
+   * would be copied and the existing views of them left dangling.
+   */
+  calc_program& operator=(calc_program&&) = default;
+
+  /**
+   * Reset the program to be empty.
+   *
+   * @param name Input name used when reporting errors
+   */
+  void reset(std::string_view name);
+
+  /**
+   * Replace the program with a copy of another program.
+   *
+   * Names are interned again in order, so they keep the same indices, and
+   * the copy is allocated from this program's memory resource.
+   *
+   * @param name Input name used when reporting errors
+   * @param other Program to copy
+   */
+  void assign(std::string_view name, const calc_program& other);
+
+  /**
+   * Return the input name used when reporting errors.
+   */
+  const auto& name() const noexcept { return name_; }
+
+  /**
+   * Return the expression nodes.
+   */
+  const auto& nodes() const noexcept { return nodes_; }
+
+  /**
+   * Return the node locations in node order.
+   */
+  const auto& node_locations() const noexcept { return node_locations_; }
+
+  /**
+   * Return the location of a node or `nullptr` if it has none.
+   *
+   * @param index Node index
+   */
+  const calc_node_location* node_location(std::uint32_t index) const noexcept;
+
+  /**
+   * Return the statements in program order.
+   */
+  const auto& statements() const noexcept { return statements_; }
+
+  /**
+   * Return the symbol name table.
+   */
+  const auto& names() const noexcept { return names_; }
+
+  /**
+   * Add a literal node and return its index.
+   *
+   * @param value Literal value
+   */
+  std::uint32_t literal(bool value) { return literal(value, boolean_type); }
+
+  /**
+   * Add a literal node and return its index.
+   *
+   * @param value Literal value
+   */
+  std::uint32_t literal(long value) { return literal(value, integral_type); }
+
+  /**
+   * Add a literal node and return its index.
+   *
+   * @param value Literal value
+   */
+  std::uint32_t literal(double value) { return literal(value, floating_type); }
+
+  /**
+   * Return the index of the symbol name, adding it if necessary.
+   *
+   * The lexer interns identifiers as they are scanned so that the parser
+   * only passes name indices around. Lookup does not allocate.
+   *
+   * @param iden Symbol identifier
+   */
+  std::uint32_t intern(std::string_view iden);
+
+  /**
+   * Return the index of the symbol name if it has been interned.
+   *
+   * @param iden Symbol identifier
+   */
+  std::optional<std::uint32_t> find(std::string_view iden) const
+  {
+    auto it = name_indices_.find(iden);
+    if (it == name_indices_.end())
+      return {};
+    return it->second;
+  }
+
+  /**
+   * Add a symbol reference node and return its index.
+   *
+   * @param name Symbol name index
+   * @param type Symbol type at this point in the program
+   */
+  std::uint32_t symbol(std::uint32_t name, calc_value_type type)
+  {
+    return append({calc_op::symbol, type, name, 0});
+  }
+
+  /**
+   * Add an operation node and return its index.
+   *
+   * @param op Unary or binary operation
+   * @param type Result type
+   * @param left Index of the first operand
+   * @param right Index of the second operand, ignored for unary operations
+   */
+  std::uint32_t node(
+    calc_op op,
+    calc_value_type type,
+    std::uint32_t left,
+    std::uint32_t right = 0);
+
+  /**
+   * Add an arithmetic operation node and return its index.
+   *
+   * If both operands are integral the result is integral. Otherwise, any
+   * integral operand is promoted and the result is floating.
+   *
+   * @param op Binary arithmetic operation
+   * @param left Index of the first operand
+   * @param right Index of the second operand
+   */
+  std::uint32_t arithmetic(calc_op op, std::uint32_t left, std::uint32_t right);
+
+  /**
+   * Return index of a node promoting the given node to floating.
+   *
+   * If the node is not integral its index is returned unchanged.
+   *
+   * @param index Node index
+   */
+  std::uint32_t promote(std::uint32_t index);
+
+  /**
+   * Replace the expression root of a statement.
+   *
+   * The new expression must compute the same value with the same errors.
+   *
+   * @param statement Statement index
+   * @param root Index of the new expression root node
+   */
+  void root(std::uint32_t statement, std::uint32_t root) noexcept
+  {
+    statements_[statement].root = root;
+  }
+
+  /**
+   * Replace the location of a statement.
+   *
+   * @param statement Statement index
+   * @param begin_line First line of the statement
+   * @param begin_column First column of the statement
+   * @param end_line Last line of the statement
+   * @param end_column Column past the end of the statement
+   */
+  void locate(
+    std::uint32_t statement,
+    std::uint32_t begin_line,
+    std::uint32_t begin_column,
+    std::uint32_t end_line,
+    std::uint32_t end_column) noexcept
+  {
+    auto& stmt = statements_[statement];
+    stmt.begin_line = begin_line;
+    stmt.begin_column = begin_column;
+    stmt.end_line = end_line;
+    stmt.end_column = end_column;
+  }
+
+  /**
+   * Set the location of a node and return its index.
+   *
+   * Locations are only kept for divisions and remainders, which are the
+   * operations that can fail, so other nodes are returned unchanged.
+   *
+   * @param index Node index
+   * @param loc Node location
+   */
+  template <typename Location>
+  std::uint32_t locate_node(std::uint32_t index, const Location& loc)
+  {
+    return locate_node(
+      {
+        index,
+        static_cast<std::uint32_t>(loc.begin.line),
+        static_cast<std::uint32_t>(loc.begin.column),
+        static_cast<std::uint32_t>(loc.end.line),
+        static_cast<std::uint32_t>(loc.end.column)
+      }
+    );
+  }
+
+  /**
+   * Set the location of a node and return its index.
+   *
+   * @param loc Node location
+   */
+  std::uint32_t locate_node(const calc_node_location& loc);
+
+  /**
+   * Write an expression as an S-expression.
+   *
+   * Operations are written in prefix form, e.g. `(+ a (* b 2.))`. Nodes used
+   * more than once are labeled on first use, e.g. `#1=(sin a)`, and written
+   * as a reference, e.g. `#1#`, on any later use.
+   *
+   * @param out Stream to write to
+   * @param root Expression root node index
+   */
+  void dump(std::ostream& out, std::uint32_t root) const;
+
+  /**
+   * Add a print statement and return its index.
+   *
+   * @param root Index of the expression root node
+   * @param loc Statement location
+   */
+  template <typename Location>
+  std::uint32_t print(std::uint32_t root, const Location& loc)
+  {
+    return statement(calc_statement_kind::print, root, 0, loc);
+  }
+
+  /**
+   * Add an assignment statement and return its index.
+   *
+   * @param name Symbol name index
+   * @param root Index of the expression root node
+   * @param loc Statement location
+   */
+  template <typename Location>
+  std::uint32_t assign(
+    std::uint32_t name, std::uint32_t root, const Location& loc)
+  {
+    return statement(calc_statement_kind::assign, root, name, loc);
+  }
+
+  /**
+   * Make a statement printing an expression assign its value instead.
+   *
+   * @param index Statement index
+   * @param name Symbol name index
+   */
+  void assign_statement(std::uint32_t index, std::uint32_t name) noexcept
+  {
+    auto& stmt = statements_[index];
+    stmt.kind = calc_statement_kind::assign;
+    stmt.name = name;
+  }
+
+private:
+  static constexpr auto boolean_type = calc_value_type::boolean;
+  static constexpr auto integral_type = calc_value_type::integral;
+  static constexpr auto floating_type = calc_value_type::floating;
+
+  std::string name_;                             // input name
+  std::pmr::vector<calc_node> nodes_;            // expression nodes
+  // locations of the nodes that can fail to evaluate, in node order
+  std::pmr::vector<calc_node_location> node_locations_;
+  std::pmr::vector<calc_statement> statements_;  // statements in order
+  std::pmr::vector<std::string_view> names_;     // symbol names
+  // storage for the symbol names. list elements are never relocated, so the
+  // names and index keys can view them, and an empty list does not allocate
+  std::pmr::forward_list<std::pmr::string> name_storage_;
+  // symbol name to name index. lookups need no temporary string
+  std::pmr::unordered_map<std::string_view, std::uint32_t> name_indices_;
+
+  /**
+   * Add a literal node and return its index.
+   *
+   * @tparam T `bool`, `long`, or `double`
+   *
+   * @param value Literal value
+   * @param type Literal type
+   */
+  template <typename T>
+  std::uint32_t literal(T value, calc_value_type type)
+  {
+    static_assert(sizeof(T) <= sizeof(std::uint64_t));
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof value);
+    return append(
+      {
+        calc_op::literal,
+        type,
+        static_cast<std::uint32_t>(bits),
+        static_cast<std::uint32_t>(bits >> 32)
+      }
+    );
+  }
+
+  /**
+   * Append a node and return its index.
+   *
+   * @param node Node to append
+   */
+  std::uint32_t append(const calc_node& node);
+
+  /**
+   * Add a statement and return its index.
+   *
+   * @param kind Statement kind
+   * @param root Index of the expression root node
+   * @param name Symbol name index for assignments
+   * @param loc Statement location
+   */
+  template <typename Location>
+  std::uint32_t statement(
+    calc_statement_kind kind,
+    std::uint32_t root,
+    std::uint32_t name,
+    const Location& loc)
+  {
+    statements_.push_back(
+      {
+        kind,
+        root,
+        root,
+        name,
+        static_cast<std::uint32_t>(loc.begin.line),
+        static_cast<std::uint32_t>(loc.begin.column),
+        static_cast<std::uint32_t>(loc.end.line),
+        static_cast<std::uint32_t>(loc.end.column)
+      }
+    );
+    return static_cast<std::uint32_t>(statements_.size() - 1);
+  }
+};
+
+/**
+ * Exception thrown when a statement cannot be evaluated.
+ */
+class calc_eval_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+
+  /**
+   * Ctor for an error evaluating an expression node.
+   *
+   * @param message Error message
+   * @param node Index of the node that failed to evaluate
+   */
+  calc_eval_error(const std::string& message, std::uint32_t node)
+    : std::runtime_error{message}, node_{node}
+  {}
+
+  /**
+   * Return the index of the node that failed to evaluate if known.
+   */
+  const auto& node() const noexcept { return node_; }
+
+private:
+  std::optional<std::uint32_t> node_;
+};
+
+/**
+ * Return the error for a division by zero.
+ *
+ * Operands are passed formatted as they were written, so promoted integral
+ * operands are formatted from their exact integral values.
+ *
+ * @param left Left operand
+ * @param right Right operand
+ * @param node Division node index
+ */
+inline calc_eval_error calc_division_error(
+  const std::string& left, const std::string& right, std::uint32_t node)
+{
+  return {left + " / " + right + " is division by zero", node};
+}
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_PROGRAM_HH_
@@ -0,0 +1,428 @@
+/**
+ * @file calc_scanner.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator hand-written scanner
+ * @copyright MIT License
+ */
+
+#include "calc_parser_impl.hh"    // includes parser.yy.h
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if PDCALC_HAS_AVX2_SCANNER
+#include <immintrin.h>
+#elif PDCALC_HAS_SSE2_SCANNER
+#include <emmintrin.h>
+#endif  // !PDCALC_HAS_AVX2_SCANNER && !PDCALC_HAS_SSE2_SCANNER
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif  // _MSC_VER
+
+#include "calc_scanner.hh"
+#include "calc_token.hh"
+#include "mapped_file.hh"
+
+namespace pdcalc {
+
+namespace {
+
+#if PDCALC_HAS_AVX2_SCANNER || PDCALC_HAS_SSE2_SCANNER
+/**
+ * Return the index of the lowest set bit of a nonzero mask.
+ *
+ * @param mask Nonzero mask
+ */
+inline unsigned lowest_bit(unsigned mask) noexcept
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif  // !defined(_MSC_VER)
+}
+#endif  // PDCALC_HAS_AVX2_SCANNER || PDCALC_HAS_SSE2_SCANNER
+
+/**
+ * Find the first byte in a range matching or not matching a byte class.
+ *
+ * Blocks of 32 bytes with AVX2, then 16 bytes with SSE2, are compared with
+ * each byte of the class at once, with any remaining bytes checked one by one.
+ * The first byte is checked before any vector loads as runs are often short.
+ *
+ * @tparam Match `true` to find the first byte in the class, `false` to find
+ *  the first byte not in the class
+ * @tparam Cs Bytes in the class
+ *
+ * @param first Start of the range
+ * @param last End of the range
+ */
+template <bool Match, char... Cs>
+const char* find_class(const char* first, const char* last) noexcept
+{
+  // byte is in the class
+  auto in_class = [](char c) { return ((c == Cs) || ...); };
+  if (first == last || in_class(*first) == Match)
+    return first;
+  first++;
+#if PDCALC_HAS_AVX2_SCANNER
+  while (last - first >= 32) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    auto hits = _mm256_setzero_si256();
+    ((hits = _mm256_or_si256(
+      hits, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(Cs))
+    )), ...);
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if constexpr (!Match)
+      mask = ~mask;
+    if (mask)
+      return first + lowest_bit(mask);
+    first += 32;
+  }
+#endif  // PDCALC_HAS_AVX2_SCANNER
+#if PDCALC_HAS_SSE2_SCANNER
+  while (last - first >= 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    auto hits = _mm_setzero_si128();
+    ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(Cs)))),
+      ...);
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if constexpr (!Match)
+      mask = ~mask & 0xFFFFu;
+    if (mask)
+      return first + lowest_bit(mask);
+    first += 16;
+  }
+#endif  // PDCALC_HAS_SSE2_SCANNER
+  while (first != last && in_class(*first) != Match)
+    first++;
+  return first;
+}
+
+/**
+ * Return `true` if the byte is an ASCII decimal digit.
+ *
+ * @param c Byte to check
+ */
+constexpr bool is_digit(char c) noexcept
+{
+  return c >= '0' && c <= '9';
+}
+
+/**
+ * Return `true` if the byte can start an identifier.
+ *
+ * @param c Byte to check
+ */
+constexpr bool is_iden_start(char c) noexcept
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/**
+ * Return `true` if the byte can continue an identifier.
+ *
+ * @param c Byte to check
+ */
+constexpr bool is_iden_char(char c) noexcept
+{
+  return is_iden_start(c) || is_digit(c);
+}
+
+}  // namespace
+
+const char* skip_blanks(const char* first, const char* last) noexcept
+{
+  return find_class<false, ' ', '\t', '\r'>(first, last);
+}
+
+const char* skip_newlines(const char* first, const char* last) noexcept
+{
+  return find_class<false, '\n'>(first, last);
+}
+
+const char* find_newline(const char* first, const char* last) noexcept
+{
+  return find_class<true, '\n'>(first, last);
+}
+
+const char* calc_scanner::isa() noexcept
+{
+#if PDCALC_HAS_AVX2_SCANNER
+  return "avx2";
+#elif PDCALC_HAS_SSE2_SCANNER
+  return "sse2";
+#else
+  return "scalar";
+#endif  // !PDCALC_HAS_AVX2_SCANNER && !PDCALC_HAS_SSE2_SCANNER
+}
+
+/**
+ * Perform setup for the hand-written scanner to scan an input file.
+ *
+ * @param input_file Input file to read. If empty or "-", `stdin` is used.
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::scan_setup(const std::string& input_file)
+{
+  // empty file or "-" to read from stdin, same as for Flex
+  auto use_stdin = input_file.empty() || input_file == "-";
+  // if requested, scan a mapped file. the padding is not part of the input
+  if (
+    !use_stdin &&
+    input_mode_ == calc_input_mode::mmap &&
+    input_map_.map(input_file)
+  ) {
+    auto data = input_map_.data();
+    text_scanner_.reset(
+      data, data + input_map_.size() - mapped_file::padding
+    );
+    return true;
+  }
+  // otherwise, read the whole input. text mode is used as for Flex
+  auto input = use_stdin ? stdin : std::fopen(input_file.c_str(), "r");
+  if (!input) {
+    last_error_ =
+      "Error opening " + input_file + ": " + std::string{std::strerror(errno)};
+    return false;
+  }
+  // read in blocks, doubling the buffer size when it is full
+  constexpr std::size_t block_size = 1 << 16;
+  std::size_t size = 0;
+  while (true) {
+    if (input_text_.size() - size < block_size)
+      input_text_.resize(std::max(2 * input_text_.size(), size + block_size));
+    auto n_read = std::fread(
+      input_text_.data() + size, 1, input_text_.size() - size, input
+    );
+    size += n_read;
+    if (!n_read)
+      break;
+  }
+  auto read_error = std::ferror(input);
+  auto errno_value = errno;
+  if (input != stdin)
+    std::fclose(input);
+  if (read_error) {
+    last_error_ = "Error reading " + (use_stdin ? "stdin" : input_file) +
+      ": " + std::string{std::strerror(errno_value)};
+    return false;
+  }
+  text_scanner_.reset(input_text_.data(), input_text_.data() + size);
+  return true;
+}
+
+/**
+ * Perform setup for the hand-written scanner to scan a padded buffer.
+ *
+ * @param buffer Buffer of `size` bytes ending with two null bytes
+ * @param size Buffer size, including the padding
+ * @returns `true` on success, `false` on failure and sets `last_error_`
+ */
+bool calc_parser_impl::scan_setup_buffer(
+  const char* buffer, std::size_t size) noexcept
+{
+  if (size < 2 || buffer[size - 2] || buffer[size - 1]) {
+    last_error_ = "Input buffer must end with 2 null bytes";
+    return false;
+  }
+  text_scanner_.reset(buffer, buffer + size - 2);
+  return true;
+}
+
+/**
+ * Return the next token from the hand-written scanner.
+ *
+ * As with the Flex lexer, the location start is stepped onto the end of the
+ * previous token, the location end is advanced by the length of each matched
+ * token, and blanks, newlines, and comments are skipped within the same call.
+ */
+yy::parser::symbol_type calc_parser_impl::scan()
+{
+  auto& loc = location_;
+  loc.step();
+  const auto last = text_scanner_.end();
+  while (true) {
+    auto first = text_scanner_.pos();
+    if (first == last)
+      return yy::parser::make_YYEOF(loc);
+    // one past the matched token + its length as a column count
+    auto pos = first + 1;
+    auto length = [&] { return static_cast<int>(pos - first); };
+    // match a single or double character token
+    auto match = [&](char next, auto make_double, auto make_single)
+    {
+      if (pos != last && *pos == next) {
+        pos++;
+        loc.columns(length());
+        text_scanner_.advance(pos);
+        return make_double(loc);
+      }
+      loc.columns(1);
+      text_scanner_.advance(pos);
+      return make_single(loc);
+    };
+    switch (auto c = *first) {
+      // blanks
+      case ' ':
+      case '\t':
+      case '\r':
+        pos = skip_blanks(pos, last);
+        loc.columns(length());
+        loc.step();
+        text_scanner_.advance(pos);
+        continue;
+      // newlines
+      case '\n':
+        pos = skip_newlines(pos, last);
+        loc.columns(length());
+        loc.lines(length());
+        loc.step();
+        text_scanner_.advance(pos);
+        continue;
+      // line comment, including the newline ending it if any
+      case '#':
+        pos = find_newline(pos, last);
+        loc.columns(length());
+        if (pos != last) {
+          loc.columns(1);
+          loc.lines(1);
+          loc.step();
+          pos++;
+        }
+        text_scanner_.advance(pos);
+        continue;
+      // grammar tokens
+      case ';':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_SEMICOLON(loc);
+      case ',':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_COMMA(loc);
+      case '(':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_LPAREN(loc);
+      case ')':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_RPAREN(loc);
+      // operators
+      case '+':
+        return match(
+          '=', yy::parser::make_ASSIGN_PLUS, yy::parser::make_PLUS
+        );
+      case '-':
+        // a digit after a minus is a negative literal
+        if (pos != last && is_digit(*pos))
+          break;
+        return match(
+          '=', yy::parser::make_ASSIGN_MINUS, yy::parser::make_MINUS
+        );
+      case '*':
+        return match(
+          '=', yy::parser::make_ASSIGN_MULTIPLY, yy::parser::make_STAR
+        );
+      case '/':
+        return match(
+          '=', yy::parser::make_ASSIGN_DIVIDE, yy::parser::make_SLASH
+        );
+      case '%':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_PERCENT(loc);
+      case '|':
+        return match('|', yy::parser::make_OR, yy::parser::make_PIPE);
+      case '&':
+        return match('&', yy::parser::make_AND, yy::parser::make_AMPERSAND);
+      case '^':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_CARET(loc);
+      case '~':
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        return yy::parser::make_TILDE(loc);
+      case '<':
+        if (pos != last && *pos == '<')
+          return match('<', yy::parser::make_LSHIFT, yy::parser::make_LANGLE);
+        return match('=', yy::parser::make_LEQUALS, yy::parser::make_LANGLE);
+      case '>':
+        if (pos != last && *pos == '>')
+          return match('>', yy::parser::make_RSHIFT, yy::parser::make_RANGLE);
+        return match('=', yy::parser::make_GEQUALS, yy::parser::make_RANGLE);
+      case '=':
+        return match('=', yy::parser::make_EQUALS, yy::parser::make_ASSIGN);
+      case '!':
+        return match('=', yy::parser::make_NOT_EQUALS, yy::parser::make_NOT);
+      default:
+        // identifiers, keywords, and built-in function names
+        if (is_iden_start(c)) {
+          while (pos != last && is_iden_char(*pos))
+            pos++;
+          loc.columns(length());
+          text_scanner_.advance(pos);
+          std::string_view iden{first, static_cast<std::size_t>(pos - first)};
+          if (iden == "true")
+            return yy::parser::make_TRUTH(true, loc);
+          if (iden == "false")
+            return yy::parser::make_TRUTH(false, loc);
+          if (iden == "exp")
+            return yy::parser::make_F_EXP(loc);
+          if (iden == "log")
+            return yy::parser::make_F_LOG(loc);
+          if (iden == "log2")
+            return yy::parser::make_F_LOG2(loc);
+          if (iden == "log10")
+            return yy::parser::make_F_LOG10(loc);
+          if (iden == "sqrt")
+            return yy::parser::make_F_SQRT(loc);
+          if (iden == "max")
+            return yy::parser::make_F_MAX(loc);
+          if (iden == "min")
+            return yy::parser::make_F_MIN(loc);
+          if (iden == "sin")
+            return yy::parser::make_F_SIN(loc);
+          if (iden == "cos")
+            return yy::parser::make_F_COS(loc);
+          if (iden == "tan")
+            return yy::parser::make_F_TAN(loc);
+          return iden_token(iden);
+        }
+        // numeric literals are handled below
+        if (is_digit(c))
+          break;
+        // unrecognized byte. a null byte is reported as an empty token
+        loc.columns(1);
+        text_scanner_.advance(pos);
+        const char text[] = {c, '\0'};
+        throw unrecognized_token(text, loc);
+    }
+    // numeric literal, possibly starting with a minus
+    while (pos != last && is_digit(*pos))
+      pos++;
+    auto floating = (pos != last && *pos == '.');
+    if (floating) {
+      pos++;
+      while (pos != last && is_digit(*pos))
+        pos++;
+    }
+    loc.columns(length());
+    text_scanner_.advance(pos);
+    if (floating)
+      return make_floating_token(first, pos, loc);
+    return make_integral_token(first, pos, loc);
+  }
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,113 @@
+/**
+ * @file calc_scanner.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator hand-written scanner
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_SCANNER_HH_
+#define PDCALC_CALC_SCANNER_HH_
+
+// AVX2 is only used if the compiler targets it, e.g. with -mavx2
+#if defined(__AVX2__)
+#define PDCALC_HAS_AVX2_SCANNER 1
+#else
+#define PDCALC_HAS_AVX2_SCANNER 0
+#endif  // !defined(__AVX2__)
+
+// SSE2 is part of the x86-64 baseline and is optional on 32-bit x86
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDCALC_HAS_SSE2_SCANNER 1
+#else
+#define PDCALC_HAS_SSE2_SCANNER 0
+#endif  // !defined(__SSE2__) && !defined(_M_X64) && ...
+
+namespace pdcalc {
+
+/**
+ * Find the first byte in a range that is not a blank (space, tab, or '\r').
+ *
+ * @param first Start of the range
+ * @param last End of the range
+ * @returns Pointer to the first non-blank byte or `last` if all are blanks
+ */
+const char* skip_blanks(const char* first, const char* last) noexcept;
+
+/**
+ * Find the first byte in a range that is not a newline.
+ *
+ * @param first Start of the range
+ * @param last End of the range
+ * @returns Pointer to the first non-newline byte or `last` if there is none
+ */
+const char* skip_newlines(const char* first, const char* last) noexcept;
+
+/**
+ * Find the first newline in a range.
+ *
+ * @param first Start of the range
+ * @param last End of the range
+ * @returns Pointer to the first newline or `last` if there is none
+ */
+const char* find_newline(const char* first, const char* last) noexcept;
+
+/**
+ * Hand-written scanner over in-memory input.
+ *
+ * This is an alternative to the Flex lexer that produces the same tokens with
+ * the same locations. Runs of blanks and newlines and the contents of line
+ * comments, which make up most of typical input, are skipped with AVX2 or
+ * SSE2 where available, with scalar loops otherwise. The tokens themselves are
+ * produced by `calc_parser_impl::scan`, which consumes the input through this
+ * class.
+ *
+ * The input is never modified and does not need to be null-terminated or
+ * padded, and bytes past the end of the input are never read.
+ */
+class calc_scanner {
+public:
+  /**
+   * Return the name of the instruction set used to skip input.
+   *
+   * This is one of "avx2", "sse2", or "scalar".
+   */
+  static const char* isa() noexcept;
+
+  /**
+   * Start scanning a new input.
+   *
+   * @param first Start of the input
+   * @param last End of the input
+   */
+  void reset(const char* first, const char* last) noexcept
+  {
+    pos_ = first;
+    end_ = last;
+  }
+
+  /**
+   * Return pointer to the next byte to scan.
+   */
+  auto pos() const noexcept { return pos_; }
+
+  /**
+   * Return pointer to the end of the input.
+   */
+  auto end() const noexcept { return end_; }
+
+  /**
+   * Move the scan position forward.
+   *
+   * @param pos New scan position, not past the end of the input
+   */
+  void advance(const char* pos) noexcept { pos_ = pos; }
+
+private:
+  const char* pos_{};  // next byte to scan
+  const char* end_{};  // end of the input
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_SCANNER_HH_
@@ -0,0 +1,541 @@
+/**
+ * @file calc_server.cc
+ * @author Derek Huang
+ * @brief C++ source for the pdcalc Unix domain socket evaluation server
+ * @copyright MIT License
+ */
+
+#include "calc_server.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+#include "pdcalc/calc_parser.hh"
+#include "calc_frame.hh"
+
+namespace pdcalc {
+
+#if defined(__linux__)
+namespace {
+
+/**
+ * Return an error message for the current `errno` value.
+ *
+ * @param what Description of what failed
+ */
+std::string errno_message(std::string_view what)
+{
+  return std::string{what} + ": " +
+    std::error_code{errno, std::generic_category()}.message();
+}
+
+/**
+ * Stream buffer appending everything written to it to a string.
+ *
+ * This lets a session parser write results directly into the output buffer
+ * of its connection behind the header of the reply frame.
+ */
+class string_appendbuf : public std::streambuf {
+public:
+  /**
+   * Set the string to append to.
+   *
+   * @param target String to append to
+   */
+  void target(std::string* target) noexcept { target_ = target; }
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+      target_->push_back(traits_type::to_char_type(c));
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override
+  {
+    target_->append(s, static_cast<std::size_t>(n));
+    return n;
+  }
+
+private:
+  std::string* target_{};
+};
+
+}  // namespace
+
+/**
+ * Event loop serving the connections accepted by one thread.
+ *
+ * Events are level-triggered. A connection with unsent output is only polled
+ * for writability, so a client that does not read its replies stops having
+ * its requests read instead of growing the output buffer without bound.
+ */
+class calc_server::event_loop {
+public:
+  /**
+   * Ctor.
+   *
+   * @param server Server owning the listening socket
+   */
+  explicit event_loop(calc_server& server) : server_{server} {}
+
+  /**
+   * Dtor.
+   *
+   * Closes any remaining connections and the epoll instance.
+   */
+  ~event_loop()
+  {
+    for (auto& [fd, conn] : connections_)
+      ::close(fd);
+    if (epoll_fd_ >= 0)
+      ::close(epoll_fd_);
+  }
+
+  /**
+   * Deleted copy ctor.
+   */
+  event_loop(const event_loop&) = delete;
+
+  /**
+   * Deleted copy assignment operator.
+   */
+  event_loop& operator=(const event_loop&) = delete;
+
+  /**
+   * Serve connections until the server is stopped.
+   *
+   * Errors are reported to the server, which stops all loops. On return, all
+   * connections are closed and their counters are added to the server's.
+   */
+  void operator()();
+
+private:
+  /**
+   * Connection and its session.
+   */
+  struct connection {
+    /**
+     * Ctor.
+     *
+     * @param fd Connected socket
+     */
+    explicit connection(int fd) : fd{fd}, sink{&buffer}, parser{sink} {}
+
+    int fd;                          // connected socket
+    string_appendbuf buffer;         // appends parser output to output
+    std::ostream sink;               // parser sink writing to buffer
+    calc_parser parser;              // session parser
+    std::string input;               // received bytes not yet evaluated
+    std::string output;              // reply bytes not yet sent
+    std::size_t sent = 0;            // bytes of output already sent
+    std::uint32_t events = EPOLLIN;  // events polled for
+    bool eof = false;                // no more requests are read
+  };
+
+  // maximum number of events handled per wait
+  static constexpr int max_events = 64;
+
+  calc_server& server_;
+  int epoll_fd_ = -1;
+  std::unordered_map<int, std::unique_ptr<connection>> connections_;
+  calc_stats stats_{};
+  char read_buffer_[1 << 16];
+
+  /**
+   * Wait for and handle events until the server is stopped or fails.
+   */
+  void serve();
+
+  /**
+   * Accept a pending connection, if any.
+   *
+   * Only one connection is accepted per wakeup so that connections are
+   * spread over the loops sharing the listening socket.
+   *
+   * @returns `true` on success, `false` on error
+   */
+  bool accept();
+
+  /**
+   * Handle readiness of a connection.
+   *
+   * @param conn Connection
+   * @param events Ready events
+   * @returns `true` on success, `false` on error
+   */
+  bool handle(connection& conn, std::uint32_t events);
+
+  /**
+   * Evaluate all complete requests received by a connection.
+   *
+   * @param conn Connection
+   */
+  void evaluate(connection& conn);
+
+  /**
+   * Send as much pending output of a connection as the socket accepts.
+   *
+   * @param conn Connection
+   * @returns `true` on success, `false` if the connection failed
+   */
+  bool send(connection& conn);
+
+  /**
+   * Close a connection, adding its session counters to the loop counters.
+   *
+   * @param conn Connection
+   */
+  void close(connection& conn);
+};
+
+void calc_server::event_loop::operator()()
+{
+  serve();
+  while (!connections_.empty())
+    close(*connections_.begin()->second);
+  std::lock_guard lock{server_.mut_};
+  server_.stats_ += stats_;
+}
+
+void calc_server::event_loop::serve()
+{
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    server_.fail(errno_message("Error creating epoll instance"));
+    return;
+  }
+  // the listening socket and stop eventfd are told apart from connections by
+  // their addresses. only one of the loops is woken per pending connection
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.ptr = &server_.listen_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_.listen_fd_, &event)) {
+    server_.fail(errno_message("Error polling listening socket"));
+    return;
+  }
+  event.events = EPOLLIN;
+  event.data.ptr = &server_.stop_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_.stop_fd_, &event)) {
+    server_.fail(errno_message("Error polling stop event"));
+    return;
+  }
+  epoll_event events[max_events];
+  for (;;) {
+    auto n_events = ::epoll_wait(epoll_fd_, events, max_events, -1);
+    if (n_events < 0) {
+      if (errno == EINTR)
+        continue;
+      server_.fail(errno_message("Error waiting for events"));
+      return;
+    }
+    for (int i = 0; i < n_events; i++) {
+      auto ptr = events[i].data.ptr;
+      // stop eventfd is never read, so every loop sees it
+      if (ptr == &server_.stop_fd_)
+        return;
+      if (ptr == &server_.listen_fd_) {
+        if (!accept())
+          return;
+        continue;
+      }
+      auto& conn = *static_cast<connection*>(ptr);
+      if (!handle(conn, events[i].events))
+        close(conn);
+    }
+  }
+}
+
+bool calc_server::event_loop::accept()
+{
+  auto fd = ::accept4(
+    server_.listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC
+  );
+  if (fd < 0) {
+    switch (errno) {
+      // another loop took the connection or it was aborted by the client
+      case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+      case EWOULDBLOCK:
+#endif  // EWOULDBLOCK != EAGAIN
+      case EINTR:
+      case ECONNABORTED:
+      case EPROTO:
+      // out of resources. the connection stays pending until we can take it
+      case EMFILE:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+        return true;
+      default:
+        server_.fail(errno_message("Error accepting connection"));
+        return false;
+    }
+  }
+  auto conn = std::make_unique<connection>(fd);
+  conn->buffer.target(&conn->output);
+  server_.configure_(conn->parser);
+  epoll_event event{};
+  event.events = conn->events;
+  event.data.ptr = conn.get();
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)) {
+    ::close(fd);
+    server_.fail(errno_message("Error polling connection"));
+    return false;
+  }
+  connections_.emplace(fd, std::move(conn));
+  return true;
+}
+
+bool calc_server::event_loop::handle(connection& conn, std::uint32_t events)
+{
+  // only read more requests once all replies have been sent
+  if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && conn.output.empty()) {
+    auto n_read = ::recv(conn.fd, read_buffer_, sizeof read_buffer_, 0);
+    if (n_read > 0) {
+      conn.input.append(read_buffer_, static_cast<std::size_t>(n_read));
+      evaluate(conn);
+    }
+    else if (!n_read)
+      conn.eof = true;
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      return false;
+  }
+  if (!send(conn))
+    return false;
+  // done once the client stops sending and all replies are sent
+  auto pending = conn.sent < conn.output.size();
+  if (conn.eof && !pending)
+    return false;
+  std::uint32_t wanted = pending ? EPOLLOUT : EPOLLIN;
+  if (wanted != conn.events) {
+    epoll_event event{};
+    event.events = wanted;
+    event.data.ptr = &conn;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &event))
+      return false;
+    conn.events = wanted;
+  }
+  return true;
+}
+
+void calc_server::event_loop::evaluate(connection& conn)
+{
+  std::string_view input{conn.input};
+  std::size_t offset = 0;
+  while (auto header = calc_frame_peek(input.substr(offset))) {
+    // on a protocol error we reply with an error and stop reading
+    if (header->kind != calc_frame_kind::eval) {
+      calc_frame_append(
+        conn.output, calc_frame_kind::error, "Expected an eval frame\n"
+      );
+      conn.eof = true;
+      break;
+    }
+    if (header->size > calc_frame_max_size) {
+      calc_frame_append(
+        conn.output,
+        calc_frame_kind::error,
+        "Request of " + std::to_string(header->size) + " bytes exceeds " +
+          std::to_string(calc_frame_max_size) + " byte limit\n"
+      );
+      conn.eof = true;
+      break;
+    }
+    // the parser writes its results after a placeholder header that is then
+    // updated with the payload size and the outcome
+    auto start = conn.output.size();
+    conn.output.append(calc_frame_header_size, '\0');
+    auto text = input.substr(offset + calc_frame_header_size, header->size);
+    auto kind = calc_frame_kind::output;
+    if (!conn.parser({text, "<request>"})) {
+      std::stringstream ss;
+      for (const auto& error : conn.parser.errors()) {
+        ss.str("");
+        ss << error;
+        conn.output += ss.str();
+        conn.output += '\n';
+      }
+      if (ss.str() != conn.parser.last_error()) {
+        conn.output += conn.parser.last_error();
+        conn.output += '\n';
+      }
+      kind = calc_frame_kind::error;
+    }
+    auto size = conn.output.size() - start - calc_frame_header_size;
+    calc_frame_encode(
+      conn.output.data() + start, {kind, static_cast<std::uint32_t>(size)}
+    );
+    offset += calc_frame_header_size + header->size;
+  }
+  if (conn.eof)
+    conn.input.clear();
+  else
+    conn.input.erase(0, offset);
+}
+
+bool calc_server::event_loop::send(connection& conn)
+{
+  while (conn.sent < conn.output.size()) {
+    auto n_sent = ::send(
+      conn.fd,
+      conn.output.data() + conn.sent,
+      conn.output.size() - conn.sent,
+      MSG_NOSIGNAL
+    );
+    if (n_sent >= 0)
+      conn.sent += static_cast<std::size_t>(n_sent);
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    else if (errno != EINTR)
+      return false;
+  }
+  // reuse the buffer once everything is sent
+  if (conn.sent == conn.output.size()) {
+    conn.output.clear();
+    conn.sent = 0;
+  }
+  return true;
+}
+
+void calc_server::event_loop::close(connection& conn)
+{
+  stats_ += conn.parser.stats();
+  // closing the socket also removes it from the epoll instance
+  auto fd = conn.fd;
+  ::close(fd);
+  connections_.erase(fd);
+}
+#endif  // defined(__linux__)
+
+calc_server::calc_server(
+  std::filesystem::path path, unsigned n_threads, configure_type configure)
+  : path_{std::move(path)},
+    n_threads_{n_threads ? n_threads : 1},
+    configure_{std::move(configure)},
+    listen_fd_{-1},
+    stop_fd_{-1},
+    bound_{},
+    stats_{}
+{}
+
+calc_server::~calc_server()
+{
+#if defined(__linux__)
+  if (listen_fd_ >= 0)
+    ::close(listen_fd_);
+  if (stop_fd_ >= 0)
+    ::close(stop_fd_);
+#endif  // defined(__linux__)
+  if (bound_) {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+}
+
+bool calc_server::open()
+{
+#if defined(__linux__)
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const auto& path = path_.native();
+  if (path.empty() || path.size() >= sizeof address.sun_path) {
+    last_error_ = "Socket path '" + path + "' is empty or too long";
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    last_error_ = errno_message("Error creating socket");
+    return false;
+  }
+  if (
+    ::bind(
+      listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof address
+    )
+  ) {
+    last_error_ = errno_message("Error binding " + path);
+    return false;
+  }
+  bound_ = true;
+  if (::listen(listen_fd_, SOMAXCONN)) {
+    last_error_ = errno_message("Error listening on " + path);
+    return false;
+  }
+  stop_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (stop_fd_ < 0) {
+    last_error_ = errno_message("Error creating stop event");
+    return false;
+  }
+  return true;
+#else
+  last_error_ = "Serving is only supported on Linux";
+  return false;
+#endif  // !defined(__linux__)
+}
+
+bool calc_server::run()
+{
+#if defined(__linux__)
+  if (stop_fd_ < 0) {
+    last_error_ = "Server socket is not open";
+    return false;
+  }
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < n_threads_; i++)
+    threads.emplace_back([this] { event_loop{*this}(); });
+  for (auto& thread : threads)
+    thread.join();
+  return last_error_.empty();
+#else
+  last_error_ = "Serving is only supported on Linux";
+  return false;
+#endif  // !defined(__linux__)
+}
+
+void calc_server::stop() noexcept
+{
+#if defined(__linux__)
+  if (stop_fd_ < 0)
+    return;
+  std::uint64_t value = 1;
+  [[maybe_unused]] auto n_written = ::write(stop_fd_, &value, sizeof value);
+#endif  // defined(__linux__)
+}
+
+void calc_server::fail(const std::string& message)
+{
+  {
+    std::lock_guard lock{mut_};
+    if (last_error_.empty())
+      last_error_ = message;
+  }
+  stop();
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,128 @@
+/**
+ * @file calc_server.hh
+ * @author Derek Huang
+ * @brief C++ header for the pdcalc Unix domain socket evaluation server
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_SERVER_HH_
+#define PDCALC_CALC_SERVER_HH_
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "pdcalc/calc_parser.hh"
+
+namespace pdcalc {
+
+/**
+ * Evaluation server listening on a Unix domain socket.
+ *
+ * Each connection is a session with its own `calc_parser` and therefore its
+ * own symbol table. Clients send program text in `eval` frames and receive
+ * one reply frame per request, as described in `calc_frame.hh`.
+ *
+ * Connections are served by one or more event loop threads, each with its
+ * own epoll instance, and stay on the thread that accepted them. Requests of
+ * a connection are evaluated in order on that thread, so a session never
+ * needs any locking. Only Linux is supported.
+ */
+class calc_server {
+public:
+  /**
+   * Function applying parser settings to each new session.
+   */
+  using configure_type = std::function<void(calc_parser&)>;
+
+  /**
+   * Ctor.
+   *
+   * @param path Socket path
+   * @param n_threads Number of event loop threads, at least one
+   * @param configure Function applying parser settings to each new session
+   */
+  calc_server(
+    std::filesystem::path path, unsigned n_threads, configure_type configure);
+
+  /**
+   * Dtor.
+   *
+   * Closes the socket and removes the socket path if it was bound.
+   */
+  ~calc_server();
+
+  /**
+   * Deleted copy ctor.
+   */
+  calc_server(const calc_server&) = delete;
+
+  /**
+   * Deleted copy assignment operator.
+   */
+  calc_server& operator=(const calc_server&) = delete;
+
+  /**
+   * Create and bind the listening socket.
+   *
+   * An existing file at the socket path is an error, as it may belong to a
+   * running server.
+   *
+   * @returns `true` on success, `false` on failure
+   */
+  bool open();
+
+  /**
+   * Serve connections until `stop` is called or an error occurs.
+   *
+   * @returns `true` if stopped by `stop`, `false` on error
+   */
+  bool run();
+
+  /**
+   * Stop serving connections.
+   *
+   * Open connections are closed without replying to pending requests. This
+   * is async-signal-safe so that it can be called from a signal handler.
+   */
+  void stop() noexcept;
+
+  /**
+   * Return the performance counters summed over all closed sessions.
+   *
+   * Only meaningful once `run` returns.
+   */
+  const calc_stats& stats() const noexcept { return stats_; }
+
+  /**
+   * Return a message describing the last error that occurred.
+   */
+  const std::string& last_error() const noexcept { return last_error_; }
+
+private:
+  class event_loop;
+
+  std::filesystem::path path_;
+  unsigned n_threads_;
+  configure_type configure_;
+  int listen_fd_;  // listening socket
+  int stop_fd_;    // eventfd made readable to stop all event loops
+  bool bound_;     // socket path was created by us
+  std::mutex mut_;  // guards stats_ and last_error_ while running
+  calc_stats stats_;
+  std::string last_error_;
+
+  /**
+   * Record an error and stop all event loops.
+   *
+   * Only the first error is kept.
+   *
+   * @param message Error message
+   */
+  void fail(const std::string& message);
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_SERVER_HH_
@@ -0,0 +1,283 @@
+/**
+ * @file calc_snapshot.cc
+ * @author Derek Huang
+ * @brief C++ source for infix calculator symbol table snapshots
+ * @copyright MIT License
+ */
+
+#include "calc_snapshot.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+#include "calc_symbol_table.hh"
+
+namespace pdcalc {
+
+namespace {
+
+// file magic, version, and section sizes
+constexpr std::string_view magic{"pdcalcSS", 8};
+constexpr std::size_t header_size = 40;
+constexpr std::size_t checksum_size = 8;
+
+/**
+ * Return the 64-bit FNV-1a hash of some bytes.
+ *
+ * @param data Bytes to hash
+ */
+std::uint64_t fnv1a(std::string_view data) noexcept
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (auto c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+/**
+ * Append an unsigned integer in little-endian byte order.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param out String to append to
+ * @param value Value
+ */
+template <typename T>
+void put(std::string& out, T value)
+{
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+/**
+ * Read an unsigned integer in little-endian byte order.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param data Bytes to read from
+ * @param offset Offset of the first byte
+ */
+template <typename T>
+T get(std::string_view data, std::size_t offset) noexcept
+{
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++)
+    value |= static_cast<T>(static_cast<unsigned char>(data[offset + i])) <<
+      (8 * i);
+  return value;
+}
+
+/**
+ * Return the 64 bits stored for a value.
+ *
+ * @param value Symbol value
+ */
+std::uint64_t value_bits(const calc_symbol::value_type& value) noexcept
+{
+  if (auto b = std::get_if<bool>(&value))
+    return *b;
+  if (auto i = std::get_if<long>(&value))
+    return static_cast<std::uint64_t>(static_cast<std::int64_t>(*i));
+  std::uint64_t bits;
+  std::memcpy(&bits, &std::get<double>(value), sizeof bits);
+  return bits;
+}
+
+}  // namespace
+
+/**
+ * Write a snapshot of a symbol table.
+ *
+ * @param path Snapshot path
+ * @param symbols Symbol table
+ * @param position Input position
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_snapshot::save(
+  const std::filesystem::path& path,
+  const calc_symbol_table& symbols,
+  const calc_position& position,
+  std::string& error)
+{
+  // sizes must fit their fields
+  std::size_t names_size = 0;
+  for (const auto& sym : symbols)
+    names_size += sym.iden().size();
+  if (
+    symbols.size() > std::numeric_limits<std::uint32_t>::max() ||
+    names_size > std::numeric_limits<std::uint32_t>::max()
+  ) {
+    error = "Too many symbols to write snapshot " + path.string();
+    return false;
+  }
+  // build the whole snapshot in memory
+  std::string data;
+  data.reserve(
+    header_size + 13 * symbols.size() + names_size + checksum_size
+  );
+  data += magic;
+  put(data, version);
+  put(data, static_cast<std::uint32_t>(symbols.size()));
+  put(data, position.input);
+  put(data, position.line);
+  put(data, position.column);
+  put(data, static_cast<std::uint64_t>(names_size));
+  for (const auto& sym : symbols)
+    put(data, value_bits(sym.value()));
+  for (const auto& sym : symbols)
+    data.push_back(static_cast<char>(sym.value().index()));
+  std::uint32_t name_end = 0;
+  for (const auto& sym : symbols)
+    put(data, name_end += static_cast<std::uint32_t>(sym.iden().size()));
+  for (const auto& sym : symbols)
+    data += sym.iden();
+  put(data, fnv1a(data));
+  // write to a temporary file that then replaces the snapshot
+  auto temp_path = path;
+  temp_path += ".tmp";
+  {
+    std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+    if (!out.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+      error = "Error writing snapshot " + temp_path.string();
+      return false;
+    }
+    out.close();
+    if (!out) {
+      error = "Error writing snapshot " + temp_path.string();
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    error = "Error replacing snapshot " + path.string() + ": " + ec.message();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Open and validate a snapshot, closing any open snapshot.
+ *
+ * @param path Snapshot path
+ * @param error String to write an error message to on failure
+ * @returns `true` on success, `false` on failure
+ */
+bool calc_snapshot::open(const std::filesystem::path& path, std::string& error)
+{
+  // map the file or read it if it cannot be mapped. the padding is excluded
+  size_ = 0;
+  contents_.clear();
+  if (map_.map(path.string()))
+    data_ = {map_.data(), map_.size() - mapped_file::padding};
+  else {
+    map_.unmap();
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+      error = "Error opening snapshot " + path.string();
+      return false;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    contents_ = contents.str();
+    data_ = contents_;
+  }
+  auto corrupt = [&error, &path]
+  {
+    error = "Snapshot " + path.string() + " is truncated or corrupt";
+    return false;
+  };
+  // check header and checksum before trusting any sizes
+  if (
+    data_.size() < header_size + checksum_size ||
+    data_.substr(0, magic.size()) != magic
+  ) {
+    error = path.string() + " is not a pdcalc snapshot";
+    return false;
+  }
+  auto body_size = data_.size() - checksum_size;
+  auto checksum = get<std::uint64_t>(data_, body_size);
+  if (fnv1a(data_.substr(0, body_size)) != checksum)
+    return corrupt();
+  auto file_version = get<std::uint32_t>(data_, 8);
+  if (file_version != version) {
+    error = "Snapshot " + path.string() + " has unsupported version " +
+      std::to_string(file_version);
+    return false;
+  }
+  std::size_t n_symbols = get<std::uint32_t>(data_, 12);
+  position_.input = get<std::uint64_t>(data_, 16);
+  position_.line = get<std::uint32_t>(data_, 24);
+  position_.column = get<std::uint32_t>(data_, 28);
+  auto names_size = get<std::uint64_t>(data_, 32);
+  // section offsets + validate sizes, types, and name ends
+  values_ = header_size;
+  types_ = values_ + 8 * n_symbols;
+  name_ends_ = types_ + n_symbols;
+  names_ = name_ends_ + 4 * n_symbols;
+  if (names_ > body_size || names_size != body_size - names_)
+    return corrupt();
+  std::uint32_t name_end = 0;
+  for (std::size_t i = 0; i < n_symbols; i++) {
+    if (static_cast<unsigned char>(data_[types_ + i]) > 2)
+      return corrupt();
+    auto next_end = get<std::uint32_t>(data_, name_ends_ + 4 * i);
+    if (next_end < name_end || next_end > names_size)
+      return corrupt();
+    name_end = next_end;
+  }
+  size_ = n_symbols;
+  return true;
+}
+
+/**
+ * Return the identifier of a symbol.
+ *
+ * @param index Symbol index
+ */
+std::string_view calc_snapshot::iden(std::size_t index) const noexcept
+{
+  auto name_end = [this](std::size_t i)
+  {
+    return get<std::uint32_t>(data_, name_ends_ + 4 * i);
+  };
+  auto begin = index ? name_end(index - 1) : 0;
+  return data_.substr(names_ + begin, name_end(index) - begin);
+}
+
+/**
+ * Return the value of a symbol.
+ *
+ * @param index Symbol index
+ */
+calc_symbol::value_type calc_snapshot::value(std::size_t index) const noexcept
+{
+  auto bits = get<std::uint64_t>(data_, values_ + 8 * index);
+  switch (data_[types_ + index]) {
+    case 0:
+      return bits != 0;
+    case 1:
+      return static_cast<long>(static_cast<std::int64_t>(bits));
+    default: {
+      double value;
+      std::memcpy(&value, &bits, sizeof value);
+      return value;
+    }
+  }
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,121 @@
+/**
+ * @file calc_snapshot.hh
+ * @author Derek Huang
+ * @brief C++ header for infix calculator symbol table snapshots
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_SNAPSHOT_HH_
+#define PDCALC_CALC_SNAPSHOT_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "pdcalc/calc_parser.hh"
+#include "pdcalc/calc_symbol.hh"
+#include "calc_symbol_table.hh"
+#include "mapped_file.hh"
+
+namespace pdcalc {
+
+/**
+ * Read-only view of a symbol table snapshot file.
+ *
+ * A snapshot holds every symbol of a table in insertion order and the input
+ * position reached when it was taken. All integers are little-endian and the
+ * file is laid out as follows:
+ *
+ * | Field     | Size               | Contents                                |
+ * | --------- | ------------------ | --------------------------------------- |
+ * | header    | 40                 | magic, version, counts, position        |
+ * | values    | 8 * `n_symbols`    | value bits, `long` stored as 64 bits    |
+ * | types     | `n_symbols`        | variant index of each value             |
+ * | name ends | 4 * `n_symbols`    | end offset of each name in the names    |
+ * | names     | `names_size`       | concatenated symbol names               |
+ * | checksum  | 8                  | FNV-1a hash of all the preceding bytes  |
+ *
+ * The header is the 8-byte magic, the 4-byte version, the 4-byte number of
+ * symbols, the 8-byte input count, the 4-byte line, the 4-byte column, and
+ * the 8-byte names size. Values come first so that they are 8-byte aligned.
+ *
+ * Files are memory-mapped where possible and read otherwise. The whole file
+ * is checked against its checksum before any symbol is read, so a snapshot
+ * cut short by a crash while it was written is rejected as a whole.
+ */
+class calc_snapshot {
+public:
+  /**
+   * Snapshot format version.
+   */
+  static constexpr std::uint32_t version = 1;
+
+  /**
+   * Write a snapshot of a symbol table.
+   *
+   * The snapshot is written to a temporary file next to `path` that then
+   * replaces `path`, so an existing snapshot is only replaced by a complete
+   * one.
+   *
+   * @param path Snapshot path
+   * @param symbols Symbol table
+   * @param position Input position
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  static bool save(
+    const std::filesystem::path& path,
+    const calc_symbol_table& symbols,
+    const calc_position& position,
+    std::string& error);
+
+  /**
+   * Open and validate a snapshot, closing any open snapshot.
+   *
+   * @param path Snapshot path
+   * @param error String to write an error message to on failure
+   * @returns `true` on success, `false` on failure
+   */
+  bool open(const std::filesystem::path& path, std::string& error);
+
+  /**
+   * Return the number of symbols.
+   */
+  auto size() const noexcept { return size_; }
+
+  /**
+   * Return the input position.
+   */
+  const auto& position() const noexcept { return position_; }
+
+  /**
+   * Return the identifier of a symbol.
+   *
+   * @param index Symbol index
+   */
+  std::string_view iden(std::size_t index) const noexcept;
+
+  /**
+   * Return the value of a symbol.
+   *
+   * @param index Symbol index
+   */
+  calc_symbol::value_type value(std::size_t index) const noexcept;
+
+private:
+  mapped_file map_;             // mapped file if it could be mapped
+  std::string contents_;        // file contents if it could not be mapped
+  std::string_view data_;       // file contents excluding any padding
+  std::size_t size_{};          // number of symbols
+  calc_position position_;      // input position
+  std::size_t values_{};        // offset of the values
+  std::size_t types_{};         // offset of the types
+  std::size_t name_ends_{};     // offset of the name end offsets
+  std::size_t names_{};         // offset of the names
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_SNAPSHOT_HH_
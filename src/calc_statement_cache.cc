@@ -0,0 +1,350 @@
+/**
+ * @file calc_statement_cache.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator compiled statement cache
+ * @copyright MIT License
+ */
+
+#include "calc_statement_cache.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return `true` if a character can be part of an identifier or literal.
+ *
+ * @param c Character
+ */
+constexpr bool is_word(char c) noexcept
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+    (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+/**
+ * Return `true` if removing whitespace between two characters could change
+ * how they are scanned.
+ *
+ * Words would join, operators would form the two-character operators, and a
+ * minus followed by a digit would be scanned as a negative literal.
+ *
+ * @param left Character before the whitespace
+ * @param right Character after the whitespace
+ */
+constexpr bool is_joinable(char left, char right) noexcept
+{
+  if (is_word(left) && is_word(right))
+    return true;
+  if (left == '-' && right >= '0' && right <= '9')
+    return true;
+  auto is_operator = [](char c)
+  {
+    return std::string_view{"+-*/<>=!&|"}.find(c) != std::string_view::npos;
+  };
+  auto is_second = [](char c)
+  {
+    return std::string_view{"<>=&|"}.find(c) != std::string_view::npos;
+  };
+  return is_operator(left) && is_second(right);
+}
+
+/**
+ * Scan an input text, calling a function for each normalized character.
+ *
+ * Lines and columns are counted as the lexers count them, so they match the
+ * locations of the tokens the characters are in.
+ *
+ * @tparam Func Callable taking a character, its normalized text offset, line,
+ *  and column
+ *
+ * @param text Input text
+ * @param func Function to call for each character of the normalized text
+ *  that is also in the input text
+ * @returns Size of the normalized text
+ */
+template <typename Func>
+std::size_t scan(std::string_view text, Func&& func)
+{
+  std::size_t size = 0;
+  std::uint32_t line = 1;
+  std::uint32_t column = 1;
+  bool comment = false;
+  bool blank = false;
+  char last = '\0';
+  for (auto c : text) {
+    // skip comments + whitespace, counting lines
+    if (c == '\n') {
+      line++;
+      column = 1;
+      comment = false;
+      blank = true;
+      continue;
+    }
+    if (comment || c == '#' || c == ' ' || c == '\t' || c == '\r') {
+      comment = comment || c == '#';
+      blank = true;
+      column++;
+      continue;
+    }
+    // keep a single space if dropping the whitespace would join tokens
+    if (blank && size && is_joinable(last, c))
+      func(' ', size++, std::uint32_t{0}, std::uint32_t{0});
+    func(c, size++, line, column);
+    blank = false;
+    last = c;
+    column++;
+  }
+  return size;
+}
+
+}  // namespace
+
+/**
+ * Set the maximum number of entries, evicting the least recently used.
+ *
+ * @param capacity Maximum number of entries, zero to disable caching
+ */
+void calc_statement_cache::capacity(std::size_t capacity)
+{
+  capacity_ = capacity;
+  while (index_.size() > capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+/**
+ * Write the normalized form of an input text.
+ *
+ * @param text Input text
+ * @param key String to write the normalized text to
+ */
+void calc_statement_cache::normalize(
+  std::string_view text, std::pmr::string& key)
+{
+  key.clear();
+  scan(text, [&key](char c, auto, auto, auto) { key.push_back(c); });
+}
+
+/**
+ * Return the entry for a normalized text, making it the most recently used.
+ *
+ * @param key Normalized input text
+ * @returns Entry or `nullptr` if there is none
+ */
+auto calc_statement_cache::find(std::string_view key) -> entry*
+{
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return nullptr;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return &*it->second;
+}
+
+/**
+ * Return a cleared entry for a normalized text, evicting if necessary.
+ *
+ * An existing entry for the text or the least recently used entry is reused
+ * so that its storage does not need to be allocated again.
+ *
+ * @param key Normalized input text
+ */
+auto calc_statement_cache::insert(std::string_view key) -> entry&
+{
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    index_.erase(it);
+  }
+  else if (index_.size() >= capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+  }
+  else
+    entries_.emplace_front(entries_.get_allocator().resource());
+  auto& item = entries_.front();
+  item.key.assign(key);
+  item.text.clear();
+  item.bytecode.clear();
+  item.inputs.clear();
+  item.offsets.clear();
+  item.node_offsets.clear();
+  item.first_nodes.clear();
+  index_.emplace(item.key, entries_.begin());
+  return item;
+}
+
+/**
+ * Remove the entry for a normalized text if there is one.
+ *
+ * @param key Normalized input text
+ */
+void calc_statement_cache::erase(std::string_view key)
+{
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return;
+  auto item = it->second;
+  index_.erase(it);
+  entries_.erase(item);
+}
+
+/**
+ * Record the normalized text offsets of the locations of an entry.
+ *
+ * Statements are in input order, starting at their first token and ending
+ * just past their semicolon, so their first and last characters are found
+ * in order in a single scan of the text. Node locations are nested instead,
+ * so their first and last characters are sorted by position first and found
+ * in the same scan.
+ *
+ * @param text Input text the entry program was compiled from
+ * @param item Entry with a compiled program
+ * @returns `true` on success, `false` if a statement or node location does
+ *  not match the text
+ */
+bool calc_statement_cache::record(std::string_view text, entry& item)
+{
+  const auto& statements = item.program.statements();
+  const auto& locations = item.program.node_locations();
+  auto& offsets = item.offsets;
+  auto& node_offsets = item.node_offsets;
+  offsets.clear();
+  offsets.reserve(2 * statements.size());
+  // line, column, and location index times two plus one for the last
+  // character, sorted by position. the offset is filled in by the scan
+  struct position {
+    std::uint32_t line;
+    std::uint32_t column;
+    std::uint32_t index;
+  };
+  std::pmr::vector<position> positions{node_offsets.get_allocator()};
+  positions.reserve(2 * locations.size());
+  for (std::uint32_t i = 0; i < locations.size(); i++) {
+    const auto& loc = locations[i];
+    positions.push_back({loc.begin_line, loc.begin_column, 2 * i});
+    positions.push_back({loc.end_line, loc.end_column - 1, 2 * i + 1});
+  }
+  auto before = [](const position& a, auto line, auto column)
+  {
+    return a.line < line || (a.line == line && a.column < column);
+  };
+  std::sort(
+    positions.begin(),
+    positions.end(),
+    [&before](const auto& a, const auto& b)
+    {
+      return before(a, b.line, b.column);
+    }
+  );
+  node_offsets.clear();
+  node_offsets.reserve(positions.size());
+  std::size_t next = 0;
+  scan(
+    text,
+    [&](char, std::size_t offset, auto line, auto column)
+    {
+      if (!line)
+        return;
+      // positions passed over are not in the text
+      while (next < positions.size() && before(positions[next], line, column))
+        next++;
+      for (
+        ;
+        next < positions.size() &&
+          positions[next].line == line && positions[next].column == column;
+        next++
+      )
+        node_offsets.emplace_back(
+          static_cast<std::uint32_t>(offset), positions[next].index
+        );
+      auto index = offsets.size();
+      if (index == 2 * statements.size())
+        return;
+      const auto& stmt = statements[index / 2];
+      if (index % 2 == 0) {
+        if (line == stmt.begin_line && column == stmt.begin_column)
+          offsets.push_back(static_cast<std::uint32_t>(offset));
+      }
+      else if (line == stmt.end_line && column + 1 == stmt.end_column)
+        offsets.push_back(static_cast<std::uint32_t>(offset));
+    }
+  );
+  return offsets.size() == 2 * statements.size() &&
+    node_offsets.size() == positions.size();
+}
+
+/**
+ * Move the locations of a program copied from an entry onto another text.
+ *
+ * @param text Input text with the same normalized form as the entry key
+ * @param item Entry the program was copied from
+ * @param program Program to move the statement and node locations of
+ */
+void calc_statement_cache::relocate(
+  std::string_view text, const entry& item, calc_program& program)
+{
+  const auto& offsets = item.offsets;
+  const auto& node_offsets = item.node_offsets;
+  std::pmr::vector<calc_node_location> locations{
+    program.node_locations().begin(),
+    program.node_locations().end(),
+    node_offsets.get_allocator()
+  };
+  std::size_t index = 0;
+  std::size_t next = 0;
+  std::uint32_t begin_line = 0;
+  std::uint32_t begin_column = 0;
+  scan(
+    text,
+    [&](char, std::size_t offset, auto line, auto column)
+    {
+      for (
+        ;
+        next < node_offsets.size() && node_offsets[next].first == offset;
+        next++
+      ) {
+        auto& loc = locations[node_offsets[next].second / 2];
+        if (node_offsets[next].second % 2 == 0) {
+          loc.begin_line = line;
+          loc.begin_column = column;
+        }
+        else {
+          loc.end_line = line;
+          loc.end_column = column + 1;
+        }
+      }
+      if (index == offsets.size() || offset != offsets[index])
+        return;
+      if (index % 2 == 0) {
+        begin_line = line;
+        begin_column = column;
+      }
+      else
+        program.locate(
+          static_cast<std::uint32_t>(index / 2),
+          begin_line,
+          begin_column,
+          line,
+          column + 1
+        );
+      index++;
+    }
+  );
+  for (const auto& loc : locations)
+    program.locate_node(loc);
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,183 @@
+/**
+ * @file calc_statement_cache.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator compiled statement cache
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_STATEMENT_CACHE_HH_
+#define PDCALC_CALC_STATEMENT_CACHE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "calc_bytecode.hh"
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+/**
+ * Bounded least recently used cache of compiled inputs.
+ *
+ * Entries are keyed by the normalized input text, which has comments removed
+ * and whitespace removed except where it separates two tokens that would
+ * otherwise be scanned differently, e.g. `a - 1` and `a -1`. Inputs that only
+ * differ in layout share an entry, while inputs that scan differently never
+ * do.
+ *
+ * Since identifier tokens are typed from the symbol table, an entry records
+ * the type of each symbol its program reads before assigning it, and is only
+ * valid while those symbols have the same types. Statement and node locations
+ * are kept as offsets into the normalized text so that they can be mapped back
+ * onto any input text with the same normalized form.
+ */
+class calc_statement_cache {
+public:
+  /**
+   * Largest input text in bytes that is cached.
+   */
+  static constexpr std::size_t max_text_size = 1 << 16;
+
+  /**
+   * Compiled input.
+   */
+  struct entry {
+    /**
+     * Ctor.
+     *
+     * @param resource Resource to allocate from
+     */
+    explicit entry(std::pmr::memory_resource* resource)
+      : key{resource},
+        text{resource},
+        program{resource},
+        bytecode{resource},
+        inputs{resource},
+        offsets{resource},
+        node_offsets{resource},
+        first_nodes{resource}
+    {}
+
+    std::pmr::string key;        // normalized input text
+    std::pmr::string text;       // input text the program was compiled from
+    calc_program program;        // compiled program
+    calc_bytecode bytecode;      // program bytecode, empty if not compiled
+    // name index and type of each symbol read before it is assigned
+    std::pmr::vector<std::pair<std::uint32_t, calc_value_type>> inputs;
+    // normalized text offsets of the first and last character of each
+    // statement, two per statement
+    std::pmr::vector<std::uint32_t> offsets;
+    // normalized text offsets of the first and last character of each node
+    // location with the location index times two plus one for the last
+    // character, in offset order
+    std::pmr::vector<std::pair<std::uint32_t, std::uint32_t>> node_offsets;
+    // first node of each statement expression as written
+    std::pmr::vector<std::uint32_t> first_nodes;
+  };
+
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate from
+   */
+  explicit calc_statement_cache(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : entries_{resource}, index_{resource}
+  {}
+
+  /**
+   * Return the maximum number of entries.
+   */
+  auto capacity() const noexcept { return capacity_; }
+
+  /**
+   * Set the maximum number of entries, evicting the least recently used.
+   *
+   * @param capacity Maximum number of entries, zero to disable caching
+   */
+  void capacity(std::size_t capacity);
+
+  /**
+   * Return the number of entries.
+   */
+  auto size() const noexcept { return index_.size(); }
+
+  /**
+   * Remove all entries.
+   */
+  void clear() noexcept
+  {
+    index_.clear();
+    entries_.clear();
+  }
+
+  /**
+   * Write the normalized form of an input text.
+   *
+   * @param text Input text
+   * @param key String to write the normalized text to
+   */
+  static void normalize(std::string_view text, std::pmr::string& key);
+
+  /**
+   * Return the entry for a normalized text, making it the most recently used.
+   *
+   * @param key Normalized input text
+   * @returns Entry or `nullptr` if there is none
+   */
+  entry* find(std::string_view key);
+
+  /**
+   * Return a cleared entry for a normalized text, evicting if necessary.
+   *
+   * The entry is the most recently used. The capacity must be nonzero.
+   *
+   * @param key Normalized input text
+   */
+  entry& insert(std::string_view key);
+
+  /**
+   * Remove the entry for a normalized text if there is one.
+   *
+   * @param key Normalized input text
+   */
+  void erase(std::string_view key);
+
+  /**
+   * Record the normalized text offsets of the locations of an entry.
+   *
+   * @param text Input text the entry program was compiled from
+   * @param item Entry with a compiled program
+   * @returns `true` on success, `false` if a statement or node location does
+   *  not match the text
+   */
+  static bool record(std::string_view text, entry& item);
+
+  /**
+   * Move the locations of a program copied from an entry onto another text.
+   *
+   * @param text Input text with the same normalized form as the entry key
+   * @param item Entry the program was copied from
+   * @param program Program to move the statement and node locations of
+   */
+  static void relocate(
+    std::string_view text, const entry& item, calc_program& program);
+
+private:
+  std::size_t capacity_{};                 // maximum number of entries
+  std::pmr::list<entry> entries_;          // entries, most recently used first
+  // entries indexed by key, which views the key of the entry
+  std::pmr::unordered_map<std::string_view, std::pmr::list<entry>::iterator>
+    index_;
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_STATEMENT_CACHE_HH_
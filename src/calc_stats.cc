@@ -0,0 +1,52 @@
+/**
+ * @file calc_stats.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator performance counter helpers
+ * @copyright MIT License
+ */
+
+#include "calc_stats.hh"
+
+#include <chrono>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif  // WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif  // !defined(_WIN32)
+
+namespace pdcalc {
+
+/**
+ * Return the CPU time used by the calling thread.
+ *
+ * On Windows this is the sum of the thread kernel and user times, which are
+ * reported in 100 ns units.
+ */
+std::chrono::nanoseconds calc_thread_cpu_time() noexcept
+{
+#if defined(_WIN32)
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    return {};
+  auto ticks = [](const FILETIME& time)
+  {
+    return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) |
+      time.dwLowDateTime;
+  };
+  return std::chrono::nanoseconds{100 * (ticks(kernel) + ticks(user))};
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  timespec time;
+  if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time))
+    return {};
+  return std::chrono::seconds{time.tv_sec} +
+    std::chrono::nanoseconds{time.tv_nsec};
+#else
+  return {};
+#endif  // !defined(_WIN32) && !defined(CLOCK_THREAD_CPUTIME_ID)
+}
+
+}  // namespace pdcalc
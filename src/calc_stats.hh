@@ -0,0 +1,167 @@
+/**
+ * @file calc_stats.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator performance counter helpers
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_STATS_HH_
+#define PDCALC_CALC_STATS_HH_
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+#include "pdcalc/calc_parser.hh"
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+/**
+ * Return the CPU time used by the calling thread.
+ *
+ * Returns zero if the platform has no thread CPU clock.
+ */
+std::chrono::nanoseconds calc_thread_cpu_time() noexcept;
+
+/**
+ * Return the builtin function computed by an operation if any.
+ *
+ * @param op Node operation
+ */
+constexpr std::optional<calc_builtin> calc_op_builtin(calc_op op) noexcept
+{
+  if (op >= calc_op::exp && op <= calc_op::tan)
+    return calc_builtin{
+      static_cast<int>(op) - static_cast<int>(calc_op::exp) +
+      static_cast<int>(calc_builtin::exp)
+    };
+  if (op == calc_op::max)
+    return calc_builtin::max;
+  if (op == calc_op::min)
+    return calc_builtin::min;
+  return {};
+}
+
+/**
+ * Timer splitting elapsed wall and thread CPU time between phases.
+ *
+ * Only one phase is timed at once, so entering a nested phase stops the time
+ * of the enclosing phase until it is entered again. This keeps phase times
+ * exclusive without any per-phase start times.
+ *
+ * Reading the thread CPU time is a system call on most platforms, which is
+ * too slow to make per token or statement. It is only read when timing starts
+ * or stops, and the CPU time in between is split between the phases timed by
+ * their wall time.
+ */
+class calc_phase_timer {
+public:
+  /**
+   * Start timing a phase, adding the time since the last switch to the phase
+   * that was being timed if any.
+   *
+   * @param stats Counters to add the time to
+   * @param phase Phase to time from now on
+   * @returns Phase that was being timed, if any
+   */
+  std::optional<calc_phase>
+  enter(calc_stats& stats, std::optional<calc_phase> phase) noexcept
+  {
+    auto wall = clock::now();
+    auto last = phase_;
+    if (last) {
+      auto i = static_cast<std::size_t>(*last);
+      stats.wall_time[i] += wall - wall_;
+      split_[i] += wall - wall_;
+    }
+    if (!last || !phase) {
+      auto cpu = calc_thread_cpu_time();
+      if (last)
+        split_cpu_time(stats, cpu - cpu_);
+      cpu_ = cpu;
+    }
+    phase_ = phase;
+    wall_ = wall;
+    return last;
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * Add CPU time to the phases timed since timing started by wall time.
+   *
+   * @param stats Counters to add the time to
+   * @param cpu Thread CPU time since timing started
+   */
+  void split_cpu_time(calc_stats& stats, std::chrono::nanoseconds cpu) noexcept
+  {
+    clock::duration wall{};
+    for (auto time : split_)
+      wall += time;
+    for (std::size_t i = 0; i < calc_stats::n_phases; i++) {
+      if (wall.count())
+        stats.cpu_time[i] += std::chrono::nanoseconds{
+          static_cast<std::chrono::nanoseconds::rep>(
+            static_cast<double>(cpu.count()) * split_[i].count() / wall.count()
+          )
+        };
+      split_[i] = {};
+    }
+  }
+
+  std::optional<calc_phase> phase_;  // phase being timed if any
+  clock::time_point wall_;           // wall time of the last switch
+  std::chrono::nanoseconds cpu_{};   // thread CPU time when timing started
+  // wall time of each phase since timing started
+  clock::duration split_[calc_stats::n_phases]{};
+};
+
+/**
+ * Scope timed as a phase, after which the enclosing phase is timed again.
+ *
+ * Nothing is timed if no counters are given, which costs only a branch.
+ */
+class calc_phase_scope {
+public:
+  /**
+   * Ctor.
+   *
+   * @param stats Counters to add the time to or `nullptr` to time nothing
+   * @param timer Phase timer
+   * @param phase Phase to time until the scope ends
+   */
+  calc_phase_scope(
+    calc_stats* stats, calc_phase_timer& timer, calc_phase phase) noexcept
+    : stats_{stats}, timer_{timer}
+  {
+    if (stats_)
+      last_ = timer_.enter(*stats_, phase);
+  }
+
+  /**
+   * Dtor.
+   *
+   * Resumes timing the enclosing phase, if any.
+   */
+  ~calc_phase_scope()
+  {
+    if (stats_)
+      timer_.enter(*stats_, last_);
+  }
+
+  /**
+   * Deleted copy ctor.
+   */
+  calc_phase_scope(const calc_phase_scope&) = delete;
+
+private:
+  calc_stats* stats_;               // counters or `nullptr`
+  calc_phase_timer& timer_;         // phase timer
+  std::optional<calc_phase> last_;  // enclosing phase if any
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_STATS_HH_
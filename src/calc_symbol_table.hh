@@ -0,0 +1,95 @@
+/**
+ * @file calc_symbol_table.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator symbol table
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_SYMBOL_TABLE_HH_
+#define PDCALC_CALC_SYMBOL_TABLE_HH_
+
+#include <deque>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "pdcalc/calc_symbol.hh"
+
+namespace pdcalc {
+
+/**
+ * Table of bound symbols keyed by identifier.
+ *
+ * Symbols are stored in a deque so their addresses are stable and the index
+ * is keyed by views of the stored identifiers, so lookups never construct a
+ * temporary string or symbol. Rebinding a symbol updates its value in place.
+ */
+class calc_symbol_table {
+public:
+  /**
+   * Ctor.
+   *
+   * @param resource Resource to allocate the table from
+   */
+  explicit calc_symbol_table(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : symbols_{resource}, index_{resource}
+  {}
+
+  /**
+   * Return the number of symbols.
+   */
+  auto size() const noexcept { return symbols_.size(); }
+
+  /**
+   * Return iterator to the first symbol.
+   */
+  auto begin() const noexcept { return symbols_.begin(); }
+
+  /**
+   * Return iterator one past the last symbol.
+   */
+  auto end() const noexcept { return symbols_.end(); }
+
+  /**
+   * Get a pointer to the symbol if it exists and return `nullptr` otherwise.
+   *
+   * @param iden Symbol identifier
+   */
+  const calc_symbol* find(std::string_view iden) const noexcept
+  {
+    auto it = index_.find(iden);
+    return (it == index_.end()) ? nullptr : it->second;
+  }
+
+  /**
+   * Bind a symbol, replacing the value of any existing symbol in place.
+   *
+   * @param iden Symbol identifier
+   * @param value Symbol value
+   * @returns Reference to the bound symbol
+   */
+  const calc_symbol&
+  assign(std::string_view iden, calc_symbol::value_type value)
+  {
+    auto it = index_.find(iden);
+    if (it != index_.end()) {
+      it->second->value(std::move(value));
+      return *it->second;
+    }
+    // key is a view of the stored identifier which never moves
+    auto& sym = symbols_.emplace_back(iden, std::move(value));
+    index_.emplace(sym.iden(), &sym);
+    return sym;
+  }
+
+private:
+  std::pmr::deque<calc_symbol> symbols_;  // bound symbols
+  // identifier to bound symbol
+  std::pmr::unordered_map<std::string_view, calc_symbol*> index_;
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_SYMBOL_TABLE_HH_
@@ -0,0 +1,114 @@
+/**
+ * @file calc_token.hh
+ * @author Derek Huang
+ * @brief C++ header for the infix calculator token constructors
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_CALC_TOKEN_HH_
+#define PDCALC_CALC_TOKEN_HH_
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <system_error>
+
+#include "calc_parser_impl.hh"    // includes parser.yy.h
+#include "calc_program.hh"
+
+// token constructors shared by the Flex lexer and the hand-written scanner so
+// that both produce identical tokens and errors for the same matched text
+
+namespace pdcalc {
+
+/**
+ * Return the identifier token for a symbol with the given type.
+ *
+ * @param name Symbol name index
+ * @param type Compile-time symbol type
+ * @param loc Parser location
+ */
+inline auto make_iden_token(
+  std::uint32_t name, calc_value_type type, const yy::location& loc)
+{
+  switch (type) {
+    case calc_value_type::boolean:
+      return yy::parser::make_BOOL_IDEN(name, loc);
+    case calc_value_type::integral:
+      return yy::parser::make_LONG_IDEN(name, loc);
+    default:
+      return yy::parser::make_DOUBLE_IDEN(name, loc);
+  }
+}
+
+/**
+ * Return the integral literal token for the matched text.
+ *
+ * Literals with at most `digits10` digits cannot overflow and are accumulated
+ * directly, while longer literals are converted with `std::from_chars`. This
+ * avoids the locale handling and null-terminated input of `std::stol`.
+ *
+ * @param first Start of the literal, which may start with '-'
+ * @param last End of the literal
+ * @param loc Parser location
+ *
+ * @throws yy::parser::syntax_error if the literal does not fit in a long
+ */
+inline auto make_integral_token(
+  const char* first, const char* last, const yy::location& loc)
+{
+  auto negative = (*first == '-');
+  auto digits = first + negative;
+  // fast path for short literals
+  if (last - digits <= std::numeric_limits<long>::digits10) {
+    long value = 0;
+    for (; digits != last; digits++)
+      value = 10 * value + (*digits - '0');
+    return yy::parser::make_INTEGRAL(negative ? -value : value, loc);
+  }
+  long value;
+  if (std::from_chars(first, last, value).ec != std::errc{})
+    throw yy::parser::syntax_error{
+      loc, "Literal '" + std::string{first, last} + "' is out of range for long"
+    };
+  return yy::parser::make_INTEGRAL(value, loc);
+}
+
+/**
+ * Return the floating literal token for the matched text.
+ *
+ * @param first Start of the literal, which may start with '-'
+ * @param last End of the literal
+ * @param loc Parser location
+ *
+ * @throws yy::parser::syntax_error if the literal overflows or underflows
+ */
+inline auto make_floating_token(
+  const char* first, const char* last, const yy::location& loc)
+{
+  double value;
+  if (std::from_chars(first, last, value).ec != std::errc{})
+    throw yy::parser::syntax_error{
+      loc,
+      "Literal '" + std::string{first, last} + "' is out of range for double"
+    };
+  return yy::parser::make_FLOATING(value, loc);
+}
+
+/**
+ * Return the error for an unrecognized token.
+ *
+ * @param text Null-terminated matched text
+ * @param loc Parser location
+ */
+inline auto unrecognized_token(const char* text, const yy::location& loc)
+{
+  return yy::parser::syntax_error{
+    loc, "Unrecognized token '" + std::string{text} + "'"
+  };
+}
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_CALC_TOKEN_HH_
@@ -0,0 +1,364 @@
+/**
+ * @file calc_vm.cc
+ * @author Derek Huang
+ * @brief C++ source for the infix calculator register VM
+ * @copyright MIT License
+ */
+
+#include "calc_parser_impl.hh"    // includes parser.yy.h
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "pdcalc/features.h"
+#include "calc_bytecode.hh"
+#include "calc_jit.hh"
+#include "calc_program.hh"
+
+namespace pdcalc {
+
+namespace {
+
+/**
+ * Return the literal value whose bits are stored in an instruction.
+ *
+ * @tparam T `bool`, `long`, or `double`
+ *
+ * @param ins Instruction with value bits in its operand fields
+ */
+template <typename T>
+T literal_value(const calc_instruction& ins) noexcept
+{
+  static_assert(sizeof(T) <= sizeof(std::uint64_t));
+  auto bits = (std::uint64_t{ins.b} << 32) | ins.a;
+  T res;
+  std::memcpy(&res, &bits, sizeof res);
+  return res;
+}
+
+/**
+ * Return the value of a symbol.
+ *
+ * @tparam T Expected symbol value type
+ *
+ * @param sym Symbol or `nullptr` if undefined
+ * @param iden Symbol identifier
+ *
+ * @throws calc_eval_error if the symbol is undefined or has another type
+ */
+template <typename T>
+T load_value(const calc_symbol* sym, std::string_view iden)
+{
+  if (!sym)
+    throw calc_eval_error{"Undefined symbol '" + std::string{iden} + "'"};
+  auto value = sym->get_if<T>();
+  if (!value)
+    throw calc_eval_error{
+      "Symbol '" + std::string{iden} + "' changed type since compile"
+    };
+  return *value;
+}
+
+}  // namespace
+
+/**
+ * Run a compiled statement on the register VM, writing any output to the sink.
+ *
+ * Statements not yet compiled to bytecode are compiled first. Instructions of
+ * a statement are executed until its terminating print or store instruction.
+ * Statements needing too many registers to compile are evaluated by walking
+ * their expression trees instead.
+ * On GCC and Clang we use computed goto dispatch so each handler jumps to the
+ * next one directly through the label table, otherwise we use a switch loop.
+ *
+ * @param index Statement index
+ *
+ * @throws calc_eval_error on evaluation failure
+ */
+void calc_parser_impl::execute_bytecode(std::uint32_t index)
+{
+  if (index >= bytecode_.size())
+    compile_bytecode();
+  if (!bytecode_.compiled(index)) {
+    execute(program_.statements()[index]);
+    return;
+  }
+  const auto& names = program_.names();
+  auto code = bytecode_.code().data();
+  auto ip = code + bytecode_.offset(index);
+  auto regs = registers_.data();
+// register references for the current instruction
+#define PDCALC_VM_DST regs[ip->dst]
+#define PDCALC_VM_A regs[ip->a]
+#define PDCALC_VM_B regs[ip->b]
+// error for the current division instruction
+#define PDCALC_VM_DIVISION_ERROR() \
+  division_error( \
+    bytecode_.division_node(static_cast<std::uint32_t>(ip - code)), \
+    PDCALC_VM_A, \
+    PDCALC_VM_B \
+  )
+// dispatch helpers. PDCALC_VM_NEXT() advances to the next instruction
+#if PDCALC_HAS_COMPUTED_GOTO
+#define PDCALC_VM_LABEL_ADDRESS(name) &&op_##name,
+  static void* const dispatch_table[] = {
+    PDCALC_VM_OPCODES(PDCALC_VM_LABEL_ADDRESS)
+  };
+#undef PDCALC_VM_LABEL_ADDRESS
+#define PDCALC_VM_CASE(name) op_##name:
+#define PDCALC_VM_DISPATCH() \
+  goto *dispatch_table[static_cast<std::size_t>(ip->op)]
+#define PDCALC_VM_NEXT() \
+  do { \
+    ip++; \
+    PDCALC_VM_DISPATCH(); \
+  } \
+  while (false)
+  PDCALC_VM_DISPATCH();
+#else
+#define PDCALC_VM_CASE(name) case calc_opcode::name:
+#define PDCALC_VM_NEXT() \
+  ip++; \
+  continue
+  for (;;) {
+    switch (ip->op) {
+#endif  // !PDCALC_HAS_COMPUTED_GOTO
+// dst = a op b handler
+#define PDCALC_VM_BINARY(name, dst_field, operand_field, op) \
+  PDCALC_VM_CASE(name) \
+    PDCALC_VM_DST.dst_field = \
+      PDCALC_VM_A.operand_field op PDCALC_VM_B.operand_field; \
+    PDCALC_VM_NEXT();
+// dst = func(a) handler for double registers
+#define PDCALC_VM_MATH(name, func) \
+  PDCALC_VM_CASE(name) \
+    PDCALC_VM_DST.d = func(PDCALC_VM_A.d); \
+    PDCALC_VM_NEXT();
+  // literals + symbol loads
+  PDCALC_VM_CASE(const_b)
+    PDCALC_VM_DST.b = literal_value<bool>(*ip);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(const_l)
+    PDCALC_VM_DST.l = literal_value<long>(*ip);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(const_d)
+    PDCALC_VM_DST.d = literal_value<double>(*ip);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(load_b)
+    PDCALC_VM_DST.b =
+      load_value<bool>(find_symbol(names[ip->a]), names[ip->a]);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(load_l)
+    PDCALC_VM_DST.l =
+      load_value<long>(find_symbol(names[ip->a]), names[ip->a]);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(load_d)
+    PDCALC_VM_DST.d =
+      load_value<double>(find_symbol(names[ip->a]), names[ip->a]);
+    PDCALC_VM_NEXT();
+  // unary operations
+  PDCALC_VM_CASE(to_double)
+    PDCALC_VM_DST.d = static_cast<double>(PDCALC_VM_A.l);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(neg_l)
+    PDCALC_VM_DST.l = -PDCALC_VM_A.l;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(neg_d)
+    PDCALC_VM_DST.d = -PDCALC_VM_A.d;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(bit_not_l)
+    PDCALC_VM_DST.l = ~PDCALC_VM_A.l;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(not_b)
+    PDCALC_VM_DST.b = !PDCALC_VM_A.b;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_MATH(exp_d, std::exp)
+  PDCALC_VM_MATH(log_d, std::log)
+  PDCALC_VM_MATH(log2_d, std::log2)
+  PDCALC_VM_MATH(log10_d, std::log10)
+  PDCALC_VM_MATH(sqrt_d, std::sqrt)
+  PDCALC_VM_MATH(sin_d, std::sin)
+  PDCALC_VM_MATH(cos_d, std::cos)
+  PDCALC_VM_MATH(tan_d, std::tan)
+  // integral arithmetic
+  PDCALC_VM_BINARY(add_l, l, l, +)
+  PDCALC_VM_BINARY(sub_l, l, l, -)
+  PDCALC_VM_BINARY(mul_l, l, l, *)
+  PDCALC_VM_CASE(div_l)
+    if (!PDCALC_VM_B.l)
+      throw PDCALC_VM_DIVISION_ERROR();
+    PDCALC_VM_DST.l = PDCALC_VM_A.l / PDCALC_VM_B.l;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_BINARY(mod_l, l, l, %)
+  PDCALC_VM_BINARY(and_l, l, l, &)
+  PDCALC_VM_BINARY(xor_l, l, l, ^)
+  PDCALC_VM_BINARY(or_l, l, l, |)
+  PDCALC_VM_BINARY(shl_l, l, l, <<)
+  PDCALC_VM_BINARY(shr_l, l, l, >>)
+  PDCALC_VM_CASE(max_l)
+    PDCALC_VM_DST.l = std::max(PDCALC_VM_A.l, PDCALC_VM_B.l);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(min_l)
+    PDCALC_VM_DST.l = std::min(PDCALC_VM_A.l, PDCALC_VM_B.l);
+    PDCALC_VM_NEXT();
+  // floating arithmetic
+  PDCALC_VM_BINARY(add_d, d, d, +)
+  PDCALC_VM_BINARY(sub_d, d, d, -)
+  PDCALC_VM_BINARY(mul_d, d, d, *)
+  PDCALC_VM_CASE(div_d)
+    if (!PDCALC_VM_B.d)
+      throw PDCALC_VM_DIVISION_ERROR();
+    PDCALC_VM_DST.d = PDCALC_VM_A.d / PDCALC_VM_B.d;
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(max_d)
+    PDCALC_VM_DST.d = std::max(PDCALC_VM_A.d, PDCALC_VM_B.d);
+    PDCALC_VM_NEXT();
+  PDCALC_VM_CASE(min_d)
+    PDCALC_VM_DST.d = std::min(PDCALC_VM_A.d, PDCALC_VM_B.d);
+    PDCALC_VM_NEXT();
+  // comparison + logical operations. both logical operands are evaluated
+  PDCALC_VM_BINARY(eq_b, b, b, ==)
+  PDCALC_VM_BINARY(ne_b, b, b, !=)
+  PDCALC_VM_BINARY(and_b, b, b, &&)
+  PDCALC_VM_BINARY(or_b, b, b, ||)
+  PDCALC_VM_BINARY(eq_l, b, l, ==)
+  PDCALC_VM_BINARY(ne_l, b, l, !=)
+  PDCALC_VM_BINARY(lt_l, b, l, <)
+  PDCALC_VM_BINARY(gt_l, b, l, >)
+  PDCALC_VM_BINARY(le_l, b, l, <=)
+  PDCALC_VM_BINARY(ge_l, b, l, >=)
+  PDCALC_VM_BINARY(eq_d, b, d, ==)
+  PDCALC_VM_BINARY(ne_d, b, d, !=)
+  PDCALC_VM_BINARY(lt_d, b, d, <)
+  PDCALC_VM_BINARY(gt_d, b, d, >)
+  PDCALC_VM_BINARY(le_d, b, d, <=)
+  PDCALC_VM_BINARY(ge_d, b, d, >=)
+  // statement terminators
+  PDCALC_VM_CASE(print_b)
+  PDCALC_VM_CASE(print_l)
+  PDCALC_VM_CASE(print_d)
+  PDCALC_VM_CASE(store_b)
+  PDCALC_VM_CASE(store_l)
+  PDCALC_VM_CASE(store_d)
+    finish_bytecode(*ip);
+    return;
+#if !PDCALC_HAS_COMPUTED_GOTO
+    }
+  }
+#endif  // !PDCALC_HAS_COMPUTED_GOTO
+#undef PDCALC_VM_MATH
+#undef PDCALC_VM_BINARY
+#undef PDCALC_VM_NEXT
+#undef PDCALC_VM_DISPATCH
+#undef PDCALC_VM_CASE
+#undef PDCALC_VM_DIVISION_ERROR
+#undef PDCALC_VM_B
+#undef PDCALC_VM_A
+#undef PDCALC_VM_DST
+}
+
+/**
+ * Run a compiled statement as native code, writing any output to the sink.
+ *
+ * Symbol values are loaded here before calling the native code so that any
+ * errors are thrown from C++ code. The native code cannot throw itself and
+ * instead returns the index of a failing division plus one.
+ *
+ * @param index Statement index
+ *
+ * @throws calc_eval_error on evaluation failure
+ */
+void calc_parser_impl::execute_native(std::uint32_t index)
+{
+  if (index >= bytecode_.size())
+    compile_bytecode();
+  if (!bytecode_.compiled(index)) {
+    execute(program_.statements()[index]);
+    return;
+  }
+  if (index >= jit_.size() && !jit_.compile(bytecode_)) {
+    execute_bytecode(index);
+    return;
+  }
+  const auto& names = program_.names();
+  const auto& code = bytecode_.code();
+  // load symbol values into slots
+  auto [first, last] = jit_.loads(index);
+  if (slots_.size() < static_cast<std::size_t>(last - first))
+    slots_.resize(last - first);
+  for (auto slot = slots_.data(); first != last; first++, slot++) {
+    const auto& ins = code[*first];
+    const auto& iden = names[ins.a];
+    switch (ins.op) {
+      case calc_opcode::load_b:
+        slot->b = load_value<bool>(find_symbol(iden), iden);
+        break;
+      case calc_opcode::load_l:
+        slot->l = load_value<long>(find_symbol(iden), iden);
+        break;
+      default:
+        slot->d = load_value<double>(find_symbol(iden), iden);
+    }
+  }
+  // run + handle division by zero using the operand registers
+  auto regs = registers_.data();
+  if (auto status = jit_.function(index)(regs, slots_.data())) {
+    const auto& ins = code[status - 1];
+    throw division_error(
+      bytecode_.division_node(status - 1), regs[ins.a], regs[ins.b]
+    );
+  }
+  // statement ends with the instruction before the next statement
+  auto end = (index + 1 < bytecode_.size()) ?
+    bytecode_.offset(index + 1) : static_cast<std::uint32_t>(code.size());
+  finish_bytecode(code[end - 1]);
+}
+
+/**
+ * Compile any new statements to bytecode and ensure enough VM registers.
+ */
+void calc_parser_impl::compile_bytecode()
+{
+  bytecode_.compile(program_);
+  if (registers_.size() < bytecode_.n_registers())
+    registers_.resize(bytecode_.n_registers());
+}
+
+/**
+ * Print or store the statement result in VM register 0.
+ *
+ * @param ins Print or store instruction ending the statement
+ */
+void calc_parser_impl::finish_bytecode(const calc_instruction& ins)
+{
+  const auto& value = registers_[ins.a];
+  switch (ins.op) {
+    case calc_opcode::print_b:
+      print_result(value.b);
+      break;
+    case calc_opcode::print_l:
+      print_result(value.l);
+      break;
+    case calc_opcode::print_d:
+      print_result(value.d);
+      break;
+    case calc_opcode::store_b:
+      store_symbol(program_.names()[ins.b], value.b);
+      break;
+    case calc_opcode::store_l:
+      store_symbol(program_.names()[ins.b], value.l);
+      break;
+    case calc_opcode::store_d:
+      store_symbol(program_.names()[ins.b], value.d);
+      break;
+    default:
+      throw calc_eval_error{"Statement does not end with print or store"};
+  }
+}
+
+}  // namespace pdcalc
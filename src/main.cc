@@ -5,22 +5,48 @@
  * @copyright MIT License
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif  // defined(_WIN32)
+
+#include "pdcalc/calc_binary_format.hh"
 #include "pdcalc/calc_parser.hh"
 #include "pdcalc/config.hh"
 #include "pdcalc/string.hh"  // for operator+ for string and string view
 #include "pdcalc/version.h"
+#include "calc_binary_output.hh"
+#include "calc_column_file.hh"
+#include "calc_server.hh"
 
 namespace {
 
@@ -35,7 +61,15 @@ const std::string program_version_info{
   pdcalc::system_version + ")"
 };
 const std::string program_usage{
-  "Usage: " + progname + " [-h] [-t[l[p]]] [FILE...]\n"
+  "Usage: " + progname + " [-h] [-t[l[p]]] [-j N] [--independent] [--mmap]\n"
+  "       [--lexer=LEXER] [--no-optimize] [--keep-going] [--dump-ir]\n"
+  "       [--flush=WHEN] [--shortest] [--output-format=FORMAT\n"
+  "       [--output-locations]] [--stats] [--load-snapshot=FILE]\n"
+  "       [--save-snapshot=FILE] [--checkpoint=FILE [--checkpoint-every=N]\n"
+  "       [--resume]] [FILE...]\n"
+  "       " + progname + " --serve=SOCKET [-j N] [--cache=N] [OPTION...]\n"
+  "       " + progname + " --expr=PROGRAM --input=FILE --output=FILE\n"
+  "       [--columns=NAMES] [--chunk-rows=N] [--csv-integers] [OPTION...]\n"
   "\n"
   "A statement-based infix calculator.\n"
   "\n"
@@ -52,9 +86,330 @@ const std::string program_usage{
   "                      -t to enable lexer and parser tracing respectively,\n"
   "                      while the specifiers lexer, parser can be passed to\n"
   "                      --trace for the same purpose. If -t, --trace has no\n"
-  "                      specifiers, both lexer and parser tracing is enabled."
+  "                      specifiers, both lexer and parser tracing is\n"
+  "                      enabled.\n"
+  "\n"
+  "  --independent       Evaluate each FILE independently with its own symbol\n"
+  "                      table on a pool of worker threads, one per CPU by\n"
+  "                      default. Output is buffered per FILE and written in\n"
+  "                      command-line order. By default, all FILE inputs are\n"
+  "                      evaluated in order and share the same symbol table.\n"
+  "  -j N, --jobs=N      Number of worker threads to use. Implies\n"
+  "                      --independent.\n"
+  "  --mmap              Memory-map each FILE and scan it in place instead of\n"
+  "                      reading it through stdio buffering. Inputs that\n"
+  "                      cannot be mapped, e.g. stdin, are read normally.\n"
+  "  --lexer=LEXER       Lexer used to tokenize input. LEXER can be flex for\n"
+  "                      the Flex lexer or simd for the hand-written scanner,\n"
+  "                      which skips blanks, newlines, and comments with\n"
+  "                      vector instructions. Lexer tracing is only done by\n"
+  "                      the Flex lexer. Default flex.\n"
+  "  --no-optimize       Evaluate statements as written without constant\n"
+  "                      folding, strength reduction, or common subexpression\n"
+  "                      elimination. Results and errors are the same.\n"
+  "  --keep-going        Continue after a statement fails. A statement with a\n"
+  "                      syntax error is skipped up to the next ;, and the\n"
+  "                      result of each failed statement is written as\n"
+  "                      <error>. Each error is written to stderr and the\n"
+  "                      remaining input and FILE inputs are evaluated. The\n"
+  "                      exit status is still nonzero if any failed.\n"
+  "  --dump-ir           After each input is evaluated, write each statement\n"
+  "                      to stderr as an S-expression, followed by the\n"
+  "                      optimized expression on a line starting with => if\n"
+  "                      optimization changed it.\n"
+  "  --flush=WHEN        When results are written to stdout. WHEN can be\n"
+  "                      statement to write after every statement, end to\n"
+  "                      write once each input ends, or a positive number of\n"
+  "                      bytes to buffer before writing. Default statement.\n"
+  "  --shortest          Print each double with the fewest digits that read\n"
+  "                      back as the same value instead of with 6 significant\n"
+  "                      digits.\n"
+  "  --output-format=FORMAT\n"
+  "                      Format results are written to stdout in. FORMAT can\n"
+  "                      be text for one <type> value line per result or\n"
+  "                      binary for a header followed by one fixed-size\n"
+  "                      record per result holding its type and exact value,\n"
+  "                      as described in pdcalc/calc_binary_format.hh. Use\n"
+  "                      pdcalc_read to convert binary output to text. Not\n"
+  "                      supported with --serve. Default text.\n"
+  "  --output-locations  With --output-format=binary, also write the line and\n"
+  "                      the statement index in its input of each result.\n"
+  "  --stats             After all input is evaluated, write a summary of the\n"
+  "                      bytes read, tokens, statements, symbol lookups and\n"
+  "                      inserts, builtin calls, --cache hits and misses,\n"
+  "                      and the wall and CPU time spent in each phase to\n"
+  "                      stderr. With --independent, the counters and times\n"
+  "                      of all FILE inputs are summed.\n"
+  "  --load-snapshot=FILE\n"
+  "                      Add the symbols of the snapshot FILE before\n"
+  "                      evaluating any input, e.g. a prelude of constants\n"
+  "                      saved with --save-snapshot. With --independent,\n"
+  "                      every FILE input starts from the snapshot symbols.\n"
+  "  --save-snapshot=FILE\n"
+  "                      After all input is successfully evaluated, write\n"
+  "                      all symbols to the snapshot FILE.\n"
+  "  --checkpoint=FILE   While evaluating FILE inputs in order, write a\n"
+  "                      snapshot of all symbols and the position reached to\n"
+  "                      FILE every --checkpoint-every statements and after\n"
+  "                      each input. FILE is removed once all input is\n"
+  "                      successfully evaluated.\n"
+  "  --checkpoint-every=N\n"
+  "                      Number of statements evaluated between checkpoints.\n"
+  "                      Default 100000.\n"
+  "  --resume            If the --checkpoint FILE exists, continue from the\n"
+  "                      position it was written at instead of the start of\n"
+  "                      the input. Results of statements evaluated after\n"
+  "                      the last checkpoint are printed again.\n"
+  "\n"
+  "  --serve=SOCKET      Serve evaluation requests on the Unix domain socket\n"
+  "                      SOCKET until interrupted instead of reading input.\n"
+  "                      Each connection is a session with its own symbol\n"
+  "                      table. Requests and replies are length-prefixed\n"
+  "                      frames, one reply per request, holding program\n"
+  "                      text and its results or error. With -j N,\n"
+  "                      connections are spread over N event loop threads.\n"
+  "                      Only Linux is supported.\n"
+  "  --cache=N           Number of distinct request texts each --serve\n"
+  "                      session keeps compiled. A request whose text only\n"
+  "                      differs from a cached one in whitespace or comments\n"
+  "                      is evaluated without being lexed or parsed again.\n"
+  "                      Results and errors are the same. Default 0, which\n"
+  "                      disables caching.\n"
+  "\n"
+  "  --expr=PROGRAM      Evaluate PROGRAM once for each row of the --input\n"
+  "                      columnar data file instead of reading input, with\n"
+  "                      each input column bound to the symbol of the same\n"
+  "                      name, and write the --columns symbols after each\n"
+  "                      row to the --output file. PROGRAM is compiled once\n"
+  "                      and evaluated over --chunk-rows rows at a time, so\n"
+  "                      memory use does not depend on the file sizes. The\n"
+  "                      ; ending the last statement may be omitted.\n"
+  "  --input=FILE        Columnar data file to read. FILE is CSV with a first\n"
+  "                      line of column names if it ends in .csv or is - for\n"
+  "                      stdin and is binary columnar data as described in\n"
+  "                      pdcalc/calc_binary_format.hh otherwise. CSV column\n"
+  "                      types are those of the values of the first row,\n"
+  "                      where true and false are bool and numbers are\n"
+  "                      double.\n"
+  "  --output=FILE       Columnar data file to write, where FILE is CSV or\n"
+  "                      binary as with --input and - is stdout.\n"
+  "  --columns=NAMES     Comma-separated symbols written as output columns.\n"
+  "                      If not given, PROGRAM must be a single expression,\n"
+  "                      which is written as the column result.\n"
+  "  --chunk-rows=N      Maximum number of rows read and evaluated at a time.\n"
+  "                      Default 65536.\n"
+  "  --csv-integers      Read CSV columns whose first value is an integer as\n"
+  "                      long instead of double. Every later value of such a\n"
+  "                      column must then be an integer."
+};
+
+/**
+ * Parser settings shared by all the ways input can be parsed.
+ */
+struct parse_options {
+  pdcalc::calc_input_mode input_mode;        // how input files are read
+  pdcalc::calc_lexer lexer;                  // lexer used to tokenize input
+  bool trace_lexer;                          // trace lexer operations
+  bool trace_parser;                         // trace parser operations
+  bool optimize;                             // optimize statements
+  bool keep_going;                           // continue after failures
+  bool dump_ir;                              // write each program to stderr
+  pdcalc::calc_flush_policy flush_policy;    // when results are written
+  std::size_t flush_bytes;                   // bytes buffered before writing
+  pdcalc::calc_double_format double_format;  // double result format
+  bool binary_output;                        // write binary records
+  std::uint32_t binary_flags;                // binary format flags
+  bool stats;                                // write counters to stderr
+  std::string load_snapshot;                 // snapshot to add symbols from
+  std::string save_snapshot;                 // snapshot to write at the end
+  std::string checkpoint;                    // checkpoint file if any
+  std::uint64_t checkpoint_every;            // statements between checkpoints
+  bool resume;                               // continue from checkpoint
+  std::size_t cache_capacity;                // compiled inputs cached
 };
 
+/**
+ * Settings for evaluating a program over columnar data files.
+ */
+struct column_options {
+  std::string program;               // program text
+  std::string input;                 // input file, "-" for stdin
+  std::string output;                // output file, "-" for stdout
+  std::vector<std::string> columns;  // output column symbols
+  std::size_t chunk_rows;            // rows evaluated at a time
+  bool csv_integers;                 // CSV integers read as long
+};
+
+/**
+ * Apply the parser settings from the parse options to a parser.
+ *
+ * @param parser Parser to configure
+ * @param options Parse options
+ */
+void configure_parser(
+  pdcalc::calc_parser& parser, const parse_options& options)
+{
+  parser.input_mode(options.input_mode).lexer(options.lexer);
+  parser.optimize(options.optimize).keep_going(options.keep_going);
+  if (options.flush_policy == pdcalc::calc_flush_policy::bytes)
+    parser.flush_bytes(options.flush_bytes);
+  else
+    parser.flush_policy(options.flush_policy);
+  parser.double_format(options.double_format);
+  parser.stats(options.stats);
+  parser.cache_capacity(options.cache_capacity);
+}
+
+/**
+ * Set up a binary result writer for a parser if binary output is requested.
+ *
+ * The writer must outlive the parser. Only records are written, so the header
+ * must be written separately with `write_binary_header`.
+ *
+ * @param parser Parser to write the results of
+ * @param output Writer to set up, left empty for text output
+ * @param sink Stream to write to
+ * @param options Parse options
+ */
+void configure_output(
+  pdcalc::calc_parser& parser,
+  std::optional<pdcalc::calc_binary_output>& output,
+  std::ostream& sink,
+  const parse_options& options)
+{
+  if (!options.binary_output)
+    return;
+  output.emplace(sink, options.binary_flags);
+  output->flush_policy(options.flush_policy);
+  output->flush_bytes(options.flush_bytes);
+  parser.visitor(&*output);
+}
+
+/**
+ * Write the binary output header to stdout if binary output is requested.
+ *
+ * @param options Parse options
+ */
+void write_binary_header(const parse_options& options)
+{
+  if (options.binary_output)
+    pdcalc::calc_binary_output::write_header(
+      std::cout, options.binary_flags
+    );
+}
+
+/**
+ * Add the symbols of the snapshot to load, if any, to a parser.
+ *
+ * The input position of the snapshot is discarded so that input is evaluated
+ * from the start.
+ *
+ * @param parser Parser to add the symbols to
+ * @param options Parse options
+ * @returns `true` on success, `false` on failure
+ */
+bool load_snapshot(pdcalc::calc_parser& parser, const parse_options& options)
+{
+  if (options.load_snapshot.empty())
+    return true;
+  if (!parser.restore_snapshot(options.load_snapshot))
+    return false;
+  parser.position({});
+  return true;
+}
+
+/**
+ * Write the errors of the last parse, one per line.
+ *
+ * Each error of a statement that failed is written, followed by the last
+ * error if the parse failed for another reason.
+ *
+ * @param out Stream to write to
+ * @param parser Parser to write the errors of
+ */
+void write_errors(std::ostream& out, const pdcalc::calc_parser& parser)
+{
+  std::stringstream ss;
+  for (const auto& error : parser.errors()) {
+    ss.str("");
+    ss << error;
+    out << progname << ": " << ss.str() << '\n';
+  }
+  if (ss.str() != parser.last_error())
+    out << progname << ": " << parser.last_error() << '\n';
+  out << std::flush;
+}
+
+/**
+ * Write a summary of the performance counters.
+ *
+ * Only the builtin functions that were called are listed.
+ *
+ * @param out Stream to write to
+ * @param stats Performance counters
+ */
+void write_stats(std::ostream& out, const pdcalc::calc_stats& stats)
+{
+  // writes a labeled count with the counts aligned
+  auto count = [&out](std::string_view label, std::uint64_t value)
+  {
+    out << "  " << std::left << std::setw(18) << label << std::right <<
+      std::setw(12) << value << '\n';
+  };
+  // milliseconds with microsecond resolution
+  auto millis = [](std::chrono::nanoseconds time)
+  {
+    return std::chrono::duration<double, std::milli>{time}.count();
+  };
+  constexpr const char* type_names[] = {"bool", "long", "double"};
+  out << progname << ": stats\n";
+  count("bytes read", stats.bytes_read);
+  count("tokens", stats.tokens);
+  count("statements", stats.statements());
+  for (std::size_t i = 0; i < pdcalc::calc_stats::n_types; i++)
+    count(std::string{"  print "} + type_names[i], stats.prints[i]);
+  for (std::size_t i = 0; i < pdcalc::calc_stats::n_types; i++)
+    count(std::string{"  assign "} + type_names[i], stats.assignments[i]);
+  count("symbol lookups", stats.symbol_lookups);
+  count("symbol inserts", stats.symbol_inserts);
+  std::uint64_t n_calls = 0;
+  for (auto calls : stats.builtin_calls)
+    n_calls += calls;
+  count("builtin calls", n_calls);
+  for (std::size_t i = 0; i < pdcalc::calc_stats::n_builtins; i++) {
+    auto builtin = static_cast<pdcalc::calc_builtin>(i);
+    if (stats.builtin_calls[i])
+      count(
+        std::string{"  "} + pdcalc::calc_builtin_name(builtin),
+        stats.builtin_calls[i]
+      );
+  }
+  count("cache hits", stats.cache_hits);
+  count("cache misses", stats.cache_misses);
+  // phase times
+  out << "  " << std::left << std::setw(8) << "phase" << std::right <<
+    std::setw(14) << "wall (ms)" << std::setw(14) << "cpu (ms)" << '\n';
+  std::chrono::nanoseconds wall{}, cpu{};
+  auto time = [&](std::string_view label, auto phase_wall, auto phase_cpu)
+  {
+    out << "  " << std::left << std::setw(8) << label << std::right <<
+      std::fixed << std::setprecision(3) << std::setw(14) <<
+      millis(phase_wall) << std::setw(14) << millis(phase_cpu) << '\n' <<
+      std::defaultfloat;
+  };
+  for (std::size_t i = 0; i < pdcalc::calc_stats::n_phases; i++) {
+    time(
+      pdcalc::calc_phase_name(static_cast<pdcalc::calc_phase>(i)),
+      stats.wall_time[i],
+      stats.cpu_time[i]
+    );
+    wall += stats.wall_time[i];
+    cpu += stats.cpu_time[i];
+  }
+  time("total", wall, cpu);
+  out << std::flush;
+}
+
 /**
  * Parse the trace specifiers for the short trace option.
  *
@@ -144,6 +499,211 @@ bool parse_long_trace_args(cliopt_map& opt_map, const std::string_view& arg)
   return true;
 }
 
+/**
+ * Parse the number of worker threads for the jobs option.
+ *
+ * @param value Option value, which must be a positive integer
+ * @param n_jobs Number of jobs to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_jobs_arg(const std::string& value, unsigned& n_jobs)
+{
+  // must be all digits (strtoul accepts leading whitespace and signs)
+  if (value.empty() || value.find_first_not_of("0123456789") != value.npos) {
+    std::cerr << progname << ": --jobs requires a positive integer, got '" <<
+      value << "'" << std::endl;
+    return false;
+  }
+  // must be positive and fit in an unsigned
+  errno = 0;
+  auto jobs = std::strtoul(value.c_str(), nullptr, 10);
+  if (!jobs || errno == ERANGE || jobs > static_cast<unsigned>(-1)) {
+    std::cerr << progname << ": --jobs value '" << value << "' out of range" <<
+      std::endl;
+    return false;
+  }
+  n_jobs = static_cast<unsigned>(jobs);
+  return true;
+}
+
+/**
+ * Parse the number of statements between checkpoints.
+ *
+ * @param value Option value, which must be a positive integer
+ * @param options Parse options to write the interval to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_checkpoint_every_arg(
+  const std::string& value, parse_options& options)
+{
+  if (value.empty() || value.find_first_not_of("0123456789") != value.npos) {
+    std::cerr << progname << ": --checkpoint-every requires a positive " <<
+      "integer, got '" << value << "'" << std::endl;
+    return false;
+  }
+  errno = 0;
+  auto n_statements = std::strtoull(value.c_str(), nullptr, 10);
+  if (!n_statements || errno == ERANGE) {
+    std::cerr << progname << ": --checkpoint-every value '" << value <<
+      "' out of range" << std::endl;
+    return false;
+  }
+  options.checkpoint_every = n_statements;
+  return true;
+}
+
+/**
+ * Parse the number of compiled inputs to cache for the cache option.
+ *
+ * @param value Option value, which must be a nonnegative integer
+ * @param options Parse options to write the capacity to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_cache_arg(const std::string& value, parse_options& options)
+{
+  if (value.empty() || value.find_first_not_of("0123456789") != value.npos) {
+    std::cerr << progname << ": --cache requires a nonnegative integer, " <<
+      "got '" << value << "'" << std::endl;
+    return false;
+  }
+  errno = 0;
+  auto capacity = std::strtoull(value.c_str(), nullptr, 10);
+  if (errno == ERANGE || capacity > static_cast<std::size_t>(-1)) {
+    std::cerr << progname << ": --cache value '" << value <<
+      "' out of range" << std::endl;
+    return false;
+  }
+  options.cache_capacity = static_cast<std::size_t>(capacity);
+  return true;
+}
+
+/**
+ * Parse the flush policy for the flush option.
+ *
+ * @param value Option value, either "statement", "end", or a byte count
+ * @param options Parse options to write the flush policy to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_flush_arg(const std::string& value, parse_options& options)
+{
+  if (value == "statement") {
+    options.flush_policy = pdcalc::calc_flush_policy::statement;
+    return true;
+  }
+  if (value == "end") {
+    options.flush_policy = pdcalc::calc_flush_policy::end;
+    return true;
+  }
+  // otherwise must be a positive byte count
+  if (value.empty() || value.find_first_not_of("0123456789") != value.npos) {
+    std::cerr << progname << ": --flush requires statement, end, or a " <<
+      "positive integer, got '" << value << "'" << std::endl;
+    return false;
+  }
+  errno = 0;
+  auto n_bytes = std::strtoull(value.c_str(), nullptr, 10);
+  if (!n_bytes || errno == ERANGE || n_bytes > static_cast<std::size_t>(-1)) {
+    std::cerr << progname << ": --flush value '" << value <<
+      "' out of range" << std::endl;
+    return false;
+  }
+  options.flush_policy = pdcalc::calc_flush_policy::bytes;
+  options.flush_bytes = static_cast<std::size_t>(n_bytes);
+  return true;
+}
+
+/**
+ * Parse the lexer option value.
+ *
+ * @param value Option value, either "flex" or "simd"
+ * @param options Parse options to update
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_lexer_arg(const std::string& value, parse_options& options)
+{
+  if (value == "flex")
+    options.lexer = pdcalc::calc_lexer::flex;
+  else if (value == "simd")
+    options.lexer = pdcalc::calc_lexer::simd;
+  else {
+    std::cerr << progname << ": --lexer requires flex or simd, got '" <<
+      value << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse the output format option value.
+ *
+ * @param value Option value, either "text" or "binary"
+ * @param options Parse options to update
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_output_format_arg(const std::string& value, parse_options& options)
+{
+  if (value == "text")
+    options.binary_output = false;
+  else if (value == "binary")
+    options.binary_output = true;
+  else {
+    std::cerr << progname << ": --output-format requires text or binary, " <<
+      "got '" << value << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse the number of rows evaluated at a time for the chunk rows option.
+ *
+ * @param value Option value, which must be a positive integer
+ * @param options Column options to write the number of rows to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_chunk_rows_arg(const std::string& value, column_options& options)
+{
+  if (value.empty() || value.find_first_not_of("0123456789") != value.npos) {
+    std::cerr << progname << ": --chunk-rows requires a positive integer, " <<
+      "got '" << value << "'" << std::endl;
+    return false;
+  }
+  errno = 0;
+  auto n_rows = std::strtoull(value.c_str(), nullptr, 10);
+  if (!n_rows || errno == ERANGE || n_rows > static_cast<std::size_t>(-1)) {
+    std::cerr << progname << ": --chunk-rows value '" << value <<
+      "' out of range" << std::endl;
+    return false;
+  }
+  options.chunk_rows = static_cast<std::size_t>(n_rows);
+  return true;
+}
+
+/**
+ * Parse the output column symbols for the columns option.
+ *
+ * @param value Option value, which must be comma-separated symbols
+ * @param options Column options to write the symbols to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_columns_arg(const std::string& value, column_options& options)
+{
+  std::string_view names{value};
+  while (true) {
+    auto end = names.find(',');
+    auto name = names.substr(0, end);
+    if (name.empty()) {
+      std::cerr << progname << ": --columns requires comma-separated " <<
+        "symbols, got '" << value << "'" << std::endl;
+      return false;
+    }
+    options.columns.emplace_back(name);
+    if (end == names.npos)
+      return true;
+    names.remove_prefix(end + 1);
+  }
+}
+
 /**
  * Parse incoming command-line args and store them in the options map.
  *
@@ -181,6 +741,132 @@ bool parse_args(cliopt_map& opt_map, int argc, char** argv)
       if (!parse_long_trace_args(opt_map, arg))
         return false;
     }
+    // independent file evaluation option
+    else if (arg == "--independent")
+      opt_map.insert_or_assign("independent", mapped_type{});
+    // memory-mapped input option
+    else if (arg == "--mmap")
+      opt_map.insert_or_assign("mmap", mapped_type{});
+    // output format options
+    else if (arg.substr(0, 16) == "--output-format=")
+      opt_map.insert_or_assign(
+        "output_format", mapped_type{std::string{arg.substr(16)}}
+      );
+    else if (arg == "--output-locations")
+      opt_map.insert_or_assign("output_locations", mapped_type{});
+    // lexer option
+    else if (arg.substr(0, 8) == "--lexer=")
+      opt_map.insert_or_assign(
+        "lexer", mapped_type{std::string{arg.substr(8)}}
+      );
+    // disable optimization option
+    else if (arg == "--no-optimize")
+      opt_map.insert_or_assign("no_optimize", mapped_type{});
+    // error recovery option
+    else if (arg == "--keep-going")
+      opt_map.insert_or_assign("keep_going", mapped_type{});
+    // program dump option
+    else if (arg == "--dump-ir")
+      opt_map.insert_or_assign("dump_ir", mapped_type{});
+    // output flush policy option
+    else if (arg.substr(0, 8) == "--flush=")
+      opt_map.insert_or_assign(
+        "flush", mapped_type{std::string{arg.substr(8)}}
+      );
+    // shortest round-trip double output option
+    else if (arg == "--shortest")
+      opt_map.insert_or_assign("shortest", mapped_type{});
+    // performance counter summary option
+    else if (arg == "--stats")
+      opt_map.insert_or_assign("stats", mapped_type{});
+    // snapshot options
+    else if (arg.substr(0, 16) == "--load-snapshot=")
+      opt_map.insert_or_assign(
+        "load_snapshot", mapped_type{std::string{arg.substr(16)}}
+      );
+    else if (arg.substr(0, 16) == "--save-snapshot=")
+      opt_map.insert_or_assign(
+        "save_snapshot", mapped_type{std::string{arg.substr(16)}}
+      );
+    // checkpoint options
+    else if (arg.substr(0, 13) == "--checkpoint=")
+      opt_map.insert_or_assign(
+        "checkpoint", mapped_type{std::string{arg.substr(13)}}
+      );
+    else if (arg.substr(0, 19) == "--checkpoint-every=")
+      opt_map.insert_or_assign(
+        "checkpoint_every", mapped_type{std::string{arg.substr(19)}}
+      );
+    else if (arg == "--resume")
+      opt_map.insert_or_assign("resume", mapped_type{});
+    // server option, value in next argument or after "="
+    else if (arg == "--serve") {
+      if (i + 1 >= argc) {
+        std::cerr << progname << ": " << arg << " requires an argument" <<
+          std::endl;
+        return false;
+      }
+      opt_map.insert_or_assign("serve", mapped_type{argv[++i]});
+    }
+    else if (arg.substr(0, 8) == "--serve=")
+      opt_map.insert_or_assign(
+        "serve", mapped_type{std::string{arg.substr(8)}}
+      );
+    // columnar data evaluation options, value in next argument
+    else if (
+      arg == "--expr" || arg == "--input" || arg == "--output" ||
+      arg == "--columns" || arg == "--chunk-rows"
+    ) {
+      if (i + 1 >= argc) {
+        std::cerr << progname << ": " << arg << " requires an argument" <<
+          std::endl;
+        return false;
+      }
+      // option name without the leading "--" and with "_" for "-"
+      std::string name{arg.substr(2)};
+      std::replace(name.begin(), name.end(), '-', '_');
+      opt_map.insert_or_assign(name, mapped_type{argv[++i]});
+    }
+    // columnar data evaluation options, value after "=" or none
+    else if (arg == "--csv-integers")
+      opt_map.insert_or_assign("csv_integers", mapped_type{});
+    else if (arg.substr(0, 7) == "--expr=")
+      opt_map.insert_or_assign(
+        "expr", mapped_type{std::string{arg.substr(7)}}
+      );
+    else if (arg.substr(0, 8) == "--input=")
+      opt_map.insert_or_assign(
+        "input", mapped_type{std::string{arg.substr(8)}}
+      );
+    else if (arg.substr(0, 9) == "--output=")
+      opt_map.insert_or_assign(
+        "output", mapped_type{std::string{arg.substr(9)}}
+      );
+    else if (arg.substr(0, 10) == "--columns=")
+      opt_map.insert_or_assign(
+        "columns", mapped_type{std::string{arg.substr(10)}}
+      );
+    else if (arg.substr(0, 13) == "--chunk-rows=")
+      opt_map.insert_or_assign(
+        "chunk_rows", mapped_type{std::string{arg.substr(13)}}
+      );
+    // statement cache option
+    else if (arg.substr(0, 8) == "--cache=")
+      opt_map.insert_or_assign(
+        "cache", mapped_type{std::string{arg.substr(8)}}
+      );
+    // number of jobs option, value in next argument
+    else if (arg == "-j" || arg == "--jobs") {
+      if (i + 1 >= argc) {
+        std::cerr << progname << ": " << arg << " requires an argument" <<
+          std::endl;
+        return false;
+      }
+      opt_map.insert_or_assign("jobs", mapped_type{argv[++i]});
+    }
+    // number of jobs option, value after "="
+    else if (arg.substr(0, 7) == "--jobs=")
+      opt_map.insert_or_assign("jobs", mapped_type{std::string{arg.substr(7)}});
     // unknown option
     else {
       std::cerr << "Error: Unknown option '" << argv[i] << "'. Try " <<
@@ -192,46 +878,430 @@ bool parse_args(cliopt_map& opt_map, int argc, char** argv)
 }
 
 /**
- * Parse the given input file paths.
- *
- * @todo Replace with use of the `pdcalc` parser driver.
+ * Check that the given input file paths exist and are regular files.
  *
  * @param input_files Input file paths
- * @param trace_lexer `true` to trace lexer operations
- * @param trace_parser `true` to trace parser operations
- * @returns `EXIT_SUCCESS` if successful, `EXIT_FAILURE` on error
+ * @returns `true` if all files are valid, `false` otherwise
  */
-int parse_files(
-  const std::vector<std::string>& input_files,
-  bool trace_lexer,
-  bool trace_parser)
+bool check_input_files(const std::vector<std::string>& input_files)
 {
-  // check that input files exist and are regular
   for (const auto& input_file : input_files) {
     // file existence
     if (!std::filesystem::exists(input_file)) {
       std::cerr << progname << ": " << input_file << " does not exist" <<
         std::endl;
-      return EXIT_FAILURE;
+      return false;
     }
     // not a directory, device, etc.
     if (!std::filesystem::is_regular_file(input_file)) {
       std::cerr << progname << ": " << input_file << " is not a regular file" <<
         std::endl;
-      return EXIT_FAILURE;
+      return false;
     }
   }
-  // parse in a batch
+  return true;
+}
+
+/**
+ * Parse the rest of an input file from the position of the parser.
+ *
+ * @param parser Parser resuming the input file
+ * @param input_file Input file path
+ * @param options Parse options
+ * @returns `true` on success, `false` on failure
+ */
+bool parse_file_rest(
+  pdcalc::calc_parser& parser,
+  const std::string& input_file,
+  const parse_options& options)
+{
+  std::ifstream in{input_file, std::ios::binary};
+  std::ostringstream contents;
+  if (in)
+    contents << in.rdbuf();
+  auto text = contents.str();
+  auto offset = pdcalc::calc_position_offset(text, parser.position());
+  return parser(
+    {std::string_view{text}.substr(offset), input_file},
+    options.trace_lexer,
+    options.trace_parser
+  );
+}
+
+/**
+ * Parse the given input file paths.
+ *
+ * All files are parsed in order by the same parser and share a symbol table.
+ * When resuming from a checkpoint, the files it had already evaluated are
+ * skipped and evaluation continues from its position in the next file.
+ *
+ * @param input_files Input file paths
+ * @param options Parse options
+ * @returns `EXIT_SUCCESS` if successful, `EXIT_FAILURE` on error
+ */
+int parse_files(
+  const std::vector<std::string>& input_files, const parse_options& options)
+{
+  // check that input files exist and are regular
+  if (!check_input_files(input_files))
+    return EXIT_FAILURE;
+  // set up parser, restoring the last checkpoint if resuming
+  std::optional<pdcalc::calc_binary_output> output;
   pdcalc::calc_parser parser;
-  for (const auto& input_file : input_files) {
-    if (!parser(input_file, trace_lexer, trace_parser)) {
+  configure_parser(parser, options);
+  configure_output(parser, output, std::cout, options);
+  auto resume = options.resume && std::filesystem::exists(options.checkpoint);
+  if (
+    !load_snapshot(parser, options) ||
+    (resume && !parser.restore_snapshot(options.checkpoint))
+  ) {
+    std::cerr << progname << ": " << parser.last_error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!options.checkpoint.empty())
+    parser.checkpoint(options.checkpoint, options.checkpoint_every);
+  write_binary_header(options);
+  // parse in a batch
+  auto status = EXIT_SUCCESS;
+  std::size_t first =
+    resume ? static_cast<std::size_t>(parser.position().input) : 0;
+  for (auto i = first; i < input_files.size(); i++) {
+    auto success = (resume && i == first) ?
+      parse_file_rest(parser, input_files[i], options) :
+      parser(input_files[i], options.trace_lexer, options.trace_parser);
+    if (options.dump_ir)
+      parser.dump_program(std::cerr);
+    // stop at the first failure unless continuing after failures
+    if (!success) {
+      write_errors(std::cerr, parser);
+      status = EXIT_FAILURE;
+      if (!options.keep_going)
+        break;
+    }
+  }
+  // save snapshot + remove checkpoint so a completed run is not resumed
+  if (status == EXIT_SUCCESS) {
+    if (
+      !options.save_snapshot.empty() &&
+      !parser.save_snapshot(options.save_snapshot)
+    ) {
       std::cerr << progname << ": " << parser.last_error() << std::endl;
-      return EXIT_FAILURE;
+      status = EXIT_FAILURE;
+    }
+    std::error_code ec;
+    if (!options.checkpoint.empty())
+      std::filesystem::remove(options.checkpoint, ec);
+  }
+  if (options.stats)
+    write_stats(std::cerr, parser.stats());
+  return status;
+}
+
+/**
+ * Result of independently parsing a single input file.
+ */
+struct file_parse_result {
+  bool success;        // parse status
+  std::string output;  // buffered parser output
+  std::string dump;    // buffered program dump if requested
+  std::string error;   // parser error lines if parsing failed
+  pdcalc::calc_stats stats;  // performance counters if requested
+};
+
+/**
+ * Parse the given input file paths independently on a pool of worker threads.
+ *
+ * Each file is parsed by its own parser with its own symbol table. The output
+ * of each file is buffered and written in command-line order, so the output
+ * is identical to sequentially parsing each file with a fresh parser. As in
+ * `parse_files`, no output is written for any files after the first failure
+ * unless continuing after failures.
+ *
+ * @param input_files Input file paths
+ * @param n_jobs Number of worker threads to use
+ * @param options Parse options
+ * @returns `EXIT_SUCCESS` if successful, `EXIT_FAILURE` on error
+ */
+int parse_files_independent(
+  const std::vector<std::string>& input_files,
+  unsigned n_jobs,
+  const parse_options& options)
+{
+  // check that input files exist and are regular
+  if (!check_input_files(input_files))
+    return EXIT_FAILURE;
+  // per-file results and completion flags guarded by the mutex
+  const auto n_files = input_files.size();
+  std::vector<file_parse_result> results(n_files);
+  std::vector<bool> done(n_files);
+  std::mutex results_mut;
+  std::condition_variable results_cv;
+  // index of the next file to parse. set to n_files to stop workers early
+  std::atomic<std::size_t> next_file{0};
+  // worker that parses files until there are none left
+  auto worker = [&]
+  {
+    for (auto i = next_file++; i < n_files; i = next_file++) {
+      std::stringstream sink;
+      std::optional<pdcalc::calc_binary_output> output;
+      pdcalc::calc_parser parser{sink};
+      configure_parser(parser, options);
+      configure_output(parser, output, sink, options);
+      auto success = load_snapshot(parser, options) && parser(
+        input_files[i], options.trace_lexer, options.trace_parser
+      );
+      std::stringstream dump;
+      if (options.dump_ir)
+        parser.dump_program(dump);
+      std::stringstream error;
+      if (!success)
+        write_errors(error, parser);
+      {
+        std::lock_guard lock{results_mut};
+        results[i] = {
+          success, sink.str(), dump.str(), error.str(), parser.stats()
+        };
+        done[i] = true;
+      }
+      results_cv.notify_all();
+    }
+  };
+  // no point in having more workers than files
+  if (n_jobs > n_files)
+    n_jobs = static_cast<unsigned>(n_files);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < n_jobs; i++)
+    workers.emplace_back(worker);
+  // write results in command-line order as they become available
+  write_binary_header(options);
+  auto status = EXIT_SUCCESS;
+  pdcalc::calc_stats stats{};
+  for (decltype(results.size()) i = 0; i < n_files; i++) {
+    // wait for result and take ownership so memory is released as we go
+    std::unique_lock lock{results_mut};
+    results_cv.wait(lock, [&done, i] { return done[i]; });
+    auto result = std::move(results[i]);
+    lock.unlock();
+    std::cout << result.output << std::flush;
+    std::cerr << result.dump << std::flush;
+    stats += result.stats;
+    // on failure, stop the workers from taking any more files unless
+    // continuing after failures
+    if (!result.success) {
+      std::cerr << result.error << std::flush;
+      status = EXIT_FAILURE;
+      if (!options.keep_going) {
+        next_file = n_files;
+        break;
+      }
+    }
+  }
+  for (auto& thread : workers)
+    thread.join();
+  if (options.stats)
+    write_stats(std::cerr, stats);
+  return status;
+}
+
+/**
+ * Return a program with a `;` after its last token if it has none.
+ *
+ * The `;` is inserted right after the last token, before any trailing blanks
+ * or comments, so that error locations are those of the program as written.
+ *
+ * @param program Program text
+ */
+std::string terminate_program(std::string program)
+{
+  auto comment = false;
+  auto end = program.npos;
+  for (std::size_t i = 0; i < program.size(); i++) {
+    auto c = program[i];
+    if (c == '\n')
+      comment = false;
+    else if (!comment && c == '#')
+      comment = true;
+    else if (!comment && !std::isspace(static_cast<unsigned char>(c)))
+      end = i;
+  }
+  if (end == program.npos || program[end] != ';')
+    program.insert(end == program.npos ? 0 : end + 1, 1, ';');
+  return program;
+}
+
+/**
+ * Evaluate a program over the rows of a columnar data file.
+ *
+ * The input column symbols are added with values of the column types so that
+ * the program is compiled once for all rows. The input is then read,
+ * evaluated, and written one chunk of rows at a time.
+ *
+ * @param columns Column options
+ * @param options Parse options
+ * @returns `EXIT_SUCCESS` if successful, `EXIT_FAILURE` on error
+ */
+int evaluate_columns(
+  const column_options& columns, const parse_options& options)
+{
+  auto fail = [](const std::string& error)
+  {
+    std::cerr << progname << ": " << error << std::endl;
+    return EXIT_FAILURE;
+  };
+  std::string error;
+  pdcalc::calc_column_reader reader;
+  reader.csv_integers(columns.csv_integers);
+  if (!reader.open(columns.input, error))
+    return fail(error);
+  // compile with the input column types. columns shadow snapshot symbols
+  pdcalc::calc_parser parser;
+  configure_parser(parser, options);
+  if (!load_snapshot(parser, options))
+    return fail(parser.last_error());
+  for (const auto& column : reader.columns()) {
+    switch (column.type()) {
+      case pdcalc::calc_binary_tag::bool_value:
+        parser.add_symbol(column.name(), false);
+        break;
+      case pdcalc::calc_binary_tag::long_value:
+        parser.add_symbol(column.name(), 0L);
+        break;
+      default:
+        parser.add_symbol(column.name(), 0.);
+        break;
+    }
+  }
+  auto program = terminate_program(columns.program);
+  if (
+    !parser.compile(
+      {program, "expr"}, options.trace_lexer, options.trace_parser
+    )
+  ) {
+    // reading an unbound identifier is most likely a misspelled column
+    auto iden = parser.unbound_symbol();
+    if (!iden.empty())
+      return fail("expr: no input column '" + std::string{iden} + "'");
+    if (options.dump_ir)
+      parser.dump_program(std::cerr);
+    write_errors(std::cerr, parser);
+    return EXIT_FAILURE;
+  }
+  // without output columns the value of the expression is the result column
+  auto names = columns.columns;
+  if (names.empty()) {
+    if (!parser.assign_result("result"))
+      return fail(
+        parser.last_error() + ". Use --columns to write the symbols it " +
+        "assigns"
+      );
+    names.emplace_back("result");
+  }
+  if (options.dump_ir)
+    parser.dump_program(std::cerr);
+  // output column types are those of the symbols after the program
+  std::vector<pdcalc::calc_column> outputs;
+  for (const auto& name : names) {
+    auto type = parser.symbol_type(name);
+    if (type == std::variant_npos)
+      return fail("Output column '" + name + "' is not a symbol");
+    outputs.emplace_back(name, static_cast<pdcalc::calc_binary_tag>(type));
+  }
+  pdcalc::calc_column_writer writer;
+  if (!writer.open(columns.output, outputs, options.double_format, error))
+    return fail(error);
+  // evaluate chunks until the input ends
+  std::vector<pdcalc::calc_input_column> input_columns;
+  std::vector<pdcalc::calc_output_column> output_columns;
+  while (true) {
+    std::size_t n_rows;
+    if (!reader.read(columns.chunk_rows, n_rows, error))
+      return fail(error);
+    if (!n_rows)
+      break;
+    // columns are allocated on the first read so bind them after it
+    if (input_columns.empty() && output_columns.empty()) {
+      for (const auto& column : reader.columns())
+        input_columns.push_back(column.input());
+      for (auto& column : outputs) {
+        column.reserve(columns.chunk_rows);
+        output_columns.push_back(column.output());
+      }
     }
+    if (
+      !parser.run_columns(
+        input_columns.data(),
+        input_columns.size(),
+        output_columns.data(),
+        output_columns.size(),
+        n_rows
+      )
+    )
+      return fail(parser.last_error());
+    if (!writer.write(outputs, n_rows, error))
+      return fail(error);
   }
+  if (!writer.close(error))
+    return fail(error);
+  if (options.stats)
+    write_stats(std::cerr, parser.stats());
   return EXIT_SUCCESS;
 }
 
+/**
+ * Server stopped by `SIGINT` and `SIGTERM` while serving.
+ */
+std::atomic<pdcalc::calc_server*> active_server;
+
+/**
+ * Signal handler stopping the active server.
+ *
+ * @param signal Signal number
+ */
+void stop_server(int /*signal*/)
+{
+  if (auto server = active_server.load())
+    server->stop();
+}
+
+/**
+ * Serve evaluation requests on a Unix domain socket until interrupted.
+ *
+ * Each session parser is configured with the parse options. Tracing and
+ * program dumps are not done when serving.
+ *
+ * @param socket_path Socket path
+ * @param n_threads Number of event loop threads
+ * @param options Parse options
+ * @returns `EXIT_SUCCESS` if stopped by a signal, `EXIT_FAILURE` on error
+ */
+int serve(
+  const std::string& socket_path,
+  unsigned n_threads,
+  const parse_options& options)
+{
+  auto configure = [&options](pdcalc::calc_parser& parser)
+  {
+    configure_parser(parser, options);
+  };
+  pdcalc::calc_server server{socket_path, n_threads, configure};
+  if (!server.open()) {
+    std::cerr << progname << ": " << server.last_error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  active_server = &server;
+  std::signal(SIGINT, stop_server);
+  std::signal(SIGTERM, stop_server);
+  auto success = server.run();
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+  active_server = nullptr;
+  if (!success)
+    std::cerr << progname << ": " << server.last_error() << std::endl;
+  if (options.stats)
+    write_stats(std::cerr, server.stats());
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 }  // namespace
 
 int main(int argc, char** argv)
@@ -250,17 +1320,191 @@ int main(int argc, char** argv)
     std::cout << program_version_info << std::endl;
     return EXIT_SUCCESS;
   }
+  parse_options options{};
   // get lexer + parser trace flags
-  bool trace_lexer = opt_map.find("trace_lexer") != opt_map.end();
-  bool trace_parser = opt_map.find("trace_parser") != opt_map.end();
+  options.trace_lexer = opt_map.find("trace_lexer") != opt_map.end();
+  options.trace_parser = opt_map.find("trace_parser") != opt_map.end();
+  // get input mode for files
+  options.input_mode = (opt_map.find("mmap") != opt_map.end()) ?
+    pdcalc::calc_input_mode::mmap : pdcalc::calc_input_mode::stdio;
+  // get lexer
+  if (opt_map.find("lexer") != opt_map.end()) {
+    if (!parse_lexer_arg(opt_map.at("lexer").front(), options))
+      return EXIT_FAILURE;
+  }
+  // get optimization + program dump flags
+  options.optimize = opt_map.find("no_optimize") == opt_map.end();
+  options.keep_going = opt_map.find("keep_going") != opt_map.end();
+  options.dump_ir = opt_map.find("dump_ir") != opt_map.end();
+  // get output flush policy + double format
+  if (opt_map.find("flush") != opt_map.end()) {
+    if (!parse_flush_arg(opt_map.at("flush").front(), options))
+      return EXIT_FAILURE;
+  }
+  if (opt_map.find("shortest") != opt_map.end())
+    options.double_format = pdcalc::calc_double_format::shortest;
+  // get output format. binary output is written to stdout unmodified
+  if (opt_map.find("output_format") != opt_map.end()) {
+    if (!parse_output_format_arg(opt_map.at("output_format").front(), options))
+      return EXIT_FAILURE;
+  }
+  if (opt_map.find("output_locations") != opt_map.end()) {
+    if (!options.binary_output) {
+      std::cerr << progname << ": --output-locations requires " <<
+        "--output-format=binary" << std::endl;
+      return EXIT_FAILURE;
+    }
+    options.binary_flags |= pdcalc::calc_binary_locations;
+  }
+#if defined(_WIN32)
+  if (options.binary_output)
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif  // defined(_WIN32)
+  // get performance counter summary flag
+  options.stats = opt_map.find("stats") != opt_map.end();
+  // get snapshot + checkpoint options
+  if (opt_map.find("load_snapshot") != opt_map.end())
+    options.load_snapshot = opt_map.at("load_snapshot").front();
+  if (opt_map.find("save_snapshot") != opt_map.end())
+    options.save_snapshot = opt_map.at("save_snapshot").front();
+  if (opt_map.find("checkpoint") != opt_map.end())
+    options.checkpoint = opt_map.at("checkpoint").front();
+  options.checkpoint_every = 100000;
+  if (opt_map.find("checkpoint_every") != opt_map.end()) {
+    auto& value = opt_map.at("checkpoint_every").front();
+    if (!parse_checkpoint_every_arg(value, options))
+      return EXIT_FAILURE;
+  }
+  options.resume = opt_map.find("resume") != opt_map.end();
+  if (options.resume && options.checkpoint.empty()) {
+    std::cerr << progname << ": --resume requires --checkpoint" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // get statement cache capacity. only server requests are cached
+  options.cache_capacity = 0;
+  if (opt_map.find("cache") != opt_map.end()) {
+    if (!parse_cache_arg(opt_map.at("cache").front(), options))
+      return EXIT_FAILURE;
+    if (opt_map.find("serve") == opt_map.end()) {
+      std::cerr << progname << ": --cache requires --serve" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  // get number of jobs for independent parsing. 0 indicates shared parsing
+  unsigned n_jobs = 0;
+  if (opt_map.find("jobs") != opt_map.end()) {
+    if (!parse_jobs_arg(opt_map.at("jobs").front(), n_jobs))
+      return EXIT_FAILURE;
+  }
+  else if (opt_map.find("independent") != opt_map.end())
+    n_jobs = std::max(std::thread::hardware_concurrency(), 1U);
+  // snapshots are only saved and checkpoints only written when evaluating
+  // input in order with a single symbol table
+  auto saving = !options.save_snapshot.empty() || !options.checkpoint.empty();
+  auto has_files = opt_map.find("file") != opt_map.end();
+  if (saving && (n_jobs || opt_map.find("serve") != opt_map.end())) {
+    std::cerr << progname << ": --save-snapshot and --checkpoint cannot be " <<
+      "used with --independent, --jobs, or --serve" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!options.checkpoint.empty() && !has_files) {
+    std::cerr << progname << ": --checkpoint requires FILE arguments" <<
+      std::endl;
+    return EXIT_FAILURE;
+  }
+  // evaluate a program over columnar data instead of reading input
+  auto has_expr = opt_map.find("expr") != opt_map.end();
+  for (
+    auto name : {"input", "output", "columns", "chunk_rows", "csv_integers"}
+  ) {
+    if (!has_expr && opt_map.find(name) != opt_map.end()) {
+      std::cerr << progname << ": --input, --output, --columns, " <<
+        "--chunk-rows, and --csv-integers require --expr" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (has_expr) {
+    if (
+      has_files ||
+      n_jobs ||
+      opt_map.find("serve") != opt_map.end() ||
+      !options.save_snapshot.empty() ||
+      options.binary_output
+    ) {
+      std::cerr << progname << ": --expr cannot be used with FILE " <<
+        "arguments, --independent, --jobs, --serve, --save-snapshot, or " <<
+        "--output-format=binary" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (
+      opt_map.find("input") == opt_map.end() ||
+      opt_map.find("output") == opt_map.end()
+    ) {
+      std::cerr << progname << ": --expr requires --input and --output" <<
+        std::endl;
+      return EXIT_FAILURE;
+    }
+    column_options columns{};
+    columns.program = opt_map.at("expr").front();
+    columns.input = opt_map.at("input").front();
+    columns.output = opt_map.at("output").front();
+    columns.chunk_rows = 65536;
+    columns.csv_integers = opt_map.find("csv_integers") != opt_map.end();
+    if (opt_map.find("chunk_rows") != opt_map.end()) {
+      if (!parse_chunk_rows_arg(opt_map.at("chunk_rows").front(), columns))
+        return EXIT_FAILURE;
+    }
+    // without output columns the program is a single expression
+    if (opt_map.find("columns") != opt_map.end()) {
+      if (!parse_columns_arg(opt_map.at("columns").front(), columns))
+        return EXIT_FAILURE;
+    }
+    return evaluate_columns(columns, options);
+  }
+  // serve requests instead of reading input. one event loop by default
+  if (opt_map.find("serve") != opt_map.end()) {
+    if (has_files) {
+      std::cerr << progname << ": --serve does not take FILE arguments" <<
+        std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!options.load_snapshot.empty()) {
+      std::cerr << progname << ": --load-snapshot cannot be used with " <<
+        "--serve" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (options.binary_output) {
+      std::cerr << progname << ": --output-format=binary cannot be used " <<
+        "with --serve" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return serve(opt_map.at("serve").front(), std::max(n_jobs, 1U), options);
+  }
   // process input files
-  if (opt_map.find("file") != opt_map.end())
-    return parse_files(opt_map.at("file"), trace_lexer, trace_parser);
+  if (has_files) {
+    if (n_jobs)
+      return parse_files_independent(opt_map.at("file"), n_jobs, options);
+    return parse_files(opt_map.at("file"), options);
+  }
   // otherwise, parse input from stdin
+  std::optional<pdcalc::calc_binary_output> output;
   pdcalc::calc_parser parser;
-  if (!parser(trace_lexer, trace_parser)) {
-    std::cerr << progname << ": " << parser.last_error() << std::endl;
-    return EXIT_FAILURE;
-  }
-  return EXIT_SUCCESS;
+  configure_parser(parser, options);
+  configure_output(parser, output, std::cout, options);
+  write_binary_header(options);
+  auto success = load_snapshot(parser, options) &&
+    parser(options.trace_lexer, options.trace_parser);
+  if (options.dump_ir)
+    parser.dump_program(std::cerr);
+  if (
+    success &&
+    !options.save_snapshot.empty() &&
+    !parser.save_snapshot(options.save_snapshot)
+  )
+    success = false;
+  if (!success)
+    write_errors(std::cerr, parser);
+  if (options.stats)
+    write_stats(std::cerr, parser.stats());
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,102 @@
+/**
+ * @file mapped_file.cc
+ * @author Derek Huang
+ * @brief C++ source for memory-mapped lexer input files
+ * @copyright MIT License
+ */
+
+#include "mapped_file.hh"
+
+#include <cstddef>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+namespace pdcalc {
+
+/**
+ * Map the specified file, unmapping any currently mapped file.
+ *
+ * We first reserve an anonymous zero-filled mapping large enough for the file
+ * and the padding and then map the file over the start of it. Bytes past the
+ * end of the file in its last page are zero-filled by the kernel, as are the
+ * remaining anonymous pages, so the padding is null even when the file size
+ * is an exact multiple of the page size.
+ *
+ * @param path File path
+ * @returns `true` if mapped, `false` if the file cannot be mapped
+ */
+bool mapped_file::map(const std::string& path) noexcept
+{
+  unmap();
+#if defined(_WIN32)
+  (void) path;
+  return false;
+#else
+  // open and check that file is regular + non-empty
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (::fstat(fd, &info) || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  // file size + total mapping size rounded up to page size multiple
+  auto file_size = static_cast<std::size_t>(info.st_size);
+  auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  auto map_size = file_size + padding + page_size - 1;
+  map_size -= map_size % page_size;
+  // reserve zero-filled pages
+  auto base = ::mmap(
+    nullptr,
+    map_size,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0
+  );
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  // map file copy-on-write over the start of the reservation
+  auto file_base = ::mmap(
+    base, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0
+  );
+  // mapping keeps its own reference to the file so fd can be closed now
+  ::close(fd);
+  if (file_base == MAP_FAILED) {
+    ::munmap(base, map_size);
+    return false;
+  }
+  // advise kernel of sequential access for more aggressive readahead. this is
+  // only a hint so failure is not an error
+  ::madvise(base, file_size, MADV_SEQUENTIAL);
+  data_ = static_cast<char*>(base);
+  size_ = file_size + padding;
+  map_size_ = map_size;
+  return true;
+#endif  // !defined(_WIN32)
+}
+
+/**
+ * Unmap the currently mapped file, if any.
+ */
+void mapped_file::unmap() noexcept
+{
+  if (!data_)
+    return;
+#ifndef _WIN32
+  ::munmap(data_, map_size_);
+#endif  // _WIN32
+  data_ = nullptr;
+  size_ = map_size_ = 0;
+}
+
+}  // namespace pdcalc
@@ -0,0 +1,94 @@
+/**
+ * @file mapped_file.hh
+ * @author Derek Huang
+ * @brief C++ header for memory-mapped lexer input files
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_MAPPED_FILE_HH_
+#define PDCALC_MAPPED_FILE_HH_
+
+#include <cstddef>
+#include <string>
+
+namespace pdcalc {
+
+/**
+ * Memory-mapped input file that can be scanned in place by the Flex lexer.
+ *
+ * The file contents are mapped privately and followed by `padding` null bytes
+ * as required by `yy_scan_buffer`. Since the Flex lexer temporarily writes
+ * null terminators into the buffer, pages are mapped copy-on-write so that
+ * the underlying file is never modified.
+ *
+ * Only regular, non-empty files on POSIX systems can be mapped. Callers are
+ * expected to fall back to reading through stdio otherwise, e.g. for pipes.
+ */
+class mapped_file {
+public:
+  /**
+   * Number of null bytes following the file contents.
+   */
+  static constexpr std::size_t padding = 2;
+
+  /**
+   * Default ctor.
+   *
+   * No file is mapped.
+   */
+  mapped_file() noexcept = default;
+
+  /**
+   * Dtor.
+   *
+   * Unmaps any mapped file.
+   */
+  ~mapped_file() { unmap(); }
+
+  /**
+   * Deleted copy ctor.
+   */
+  mapped_file(const mapped_file&) = delete;
+
+  /**
+   * Deleted copy assignment operator.
+   */
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  /**
+   * Map the specified file, unmapping any currently mapped file.
+   *
+   * @param path File path
+   * @returns `true` if mapped, `false` if the file cannot be mapped
+   */
+  bool map(const std::string& path) noexcept;
+
+  /**
+   * Unmap the currently mapped file, if any.
+   */
+  void unmap() noexcept;
+
+  /**
+   * Return pointer to the mapped file contents or `nullptr` if not mapped.
+   */
+  char* data() const noexcept { return data_; }
+
+  /**
+   * Return size of the mapped file contents, including the padding.
+   */
+  std::size_t size() const noexcept { return size_; }
+
+  /**
+   * Indicate if a file is currently mapped.
+   */
+  bool mapped() const noexcept { return data_ != nullptr; }
+
+private:
+  char* data_{};             // start of the mapping
+  std::size_t size_{};       // file size + padding
+  std::size_t map_size_{};   // total mapping size (page multiple)
+};
+
+}  // namespace pdcalc
+
+#endif  // PDCALC_MAPPED_FILE_HH_
@@ -13,83 +13,144 @@
 #include <corecrt.h>
 #endif  // _WIN32
 
-#include <algorithm>
-#include <cmath>
-#include <ios>
-#include <iostream>
+#include <cstdint>
 #include <sstream>
 #include <string>
 
 #include "calc_parser_impl.hh"
+#include "calc_program.hh"
 
 /**
- * Assign result of division to a target while handling divide by zero.
- *
- * On error, the parse driver's last error is updated.
+ * Add an expression node of the given type to the driver's program.
  *
  * @note This should only be used from within the Bison-generated parser.
  *
- * @param target Target to assign result to
- * @param left Left operand
- * @param right Right operand
+ * @param type `calc_value_type` enumerator name giving the result type
+ * @param op `calc_op` enumerator name giving the operation
+ * @param ... Operand node indices
  */
-#define PDCALC_YY_SAFE_DIVIDE(target, left, right) \
-  do { \
-    if (right) \
-      target = (left) / (right); \
-    else { \
-      error( \
-        driver.location_, \
-        std::to_string(left) + " / " + std::to_string(right) + \
-          " is division by zero" \
-      ); \
-      YYABORT; \
-    } \
-  } \
-  while (false)
+#define PDCALC_YY_NODE(type, op, ...) \
+  driver.program_.node( \
+    pdcalc::calc_op::op, pdcalc::calc_value_type::type, __VA_ARGS__ \
+  )
+
+/**
+ * Add a boolean expression node to the driver's program.
+ *
+ * @param op `calc_op` enumerator name giving the operation
+ * @param ... Operand node indices
+ */
+#define PDCALC_YY_B_NODE(op, ...) PDCALC_YY_NODE(boolean, op, __VA_ARGS__)
+
+/**
+ * Add an integral expression node to the driver's program.
+ *
+ * @param op `calc_op` enumerator name giving the operation
+ * @param ... Operand node indices
+ */
+#define PDCALC_YY_I_NODE(op, ...) PDCALC_YY_NODE(integral, op, __VA_ARGS__)
+
+/**
+ * Add a floating expression node to the driver's program.
+ *
+ * @param op `calc_op` enumerator name giving the operation
+ * @param ... Operand node indices
+ */
+#define PDCALC_YY_D_NODE(op, ...) PDCALC_YY_NODE(floating, op, __VA_ARGS__)
 
 /**
- * Print an expression truth value to stdout as "true" or "false".
+ * Promote an integral expression node to floating.
  *
- * @param value Boolean value of an expression
+ * @param index Node index
  */
-#define PDCALC_YY_PRINT_BOOL(value) \
-  driver.sink() << "<bool> " << std::boolalpha << (value) << \
-    std::noboolalpha << std::endl
+#define PDCALC_YY_PROMOTE(index) driver.program_.promote(index)
 
 /**
- * Report an undefined symbol error.
+ * Set the location of an expression node that can fail to evaluate.
  *
- * @param iden `std::string` symbol identifier
+ * @param index Node index
+ * @param loc Node location
+ * @returns Node index
  */
-#define PDCALC_YY_UNDEFINED_SYMBOL(iden) \
-  error(driver.location_, "Undefined symbol '" + (iden) + "'")
+#define PDCALC_YY_LOCATE(index, loc) driver.program_.locate_node(index, loc)
 
 /**
- * Extract the value of a defined symbol.
+ * Add a symbol reference node to the driver's program.
+ *
+ * The lexer has already determined the symbol type from the compile-time
+ * symbol types so the symbol need not exist until the program is evaluated.
  *
- * We do not need to check if the symbol exists or not as the lexer has already
- * done that for us (symbol is not unknown and is a typed symbol).
+ * @param iden `std::uint32_t` symbol name index
+ * @param type `calc_value_type` enumerator name giving the symbol type
+ */
+#define PDCALC_YY_SYMBOL(iden, type) \
+  driver.program_.symbol(iden, pdcalc::calc_value_type::type)
+
+/**
+ * Complete a compiled statement, evaluating it if requested.
  *
- * @note Safety check is still included but is probably unnecessary.
+ * On error, the parse driver's last error has been set so we just abort,
+ * unless the driver is recovering from failed statements.
  *
- * @param out Semantic value to assign to
- * @param iden Symbol identifier
- * @param type Symbol value C++ type
+ * @param index Statement index
  */
-#define PDCALC_YY_GET_SYMBOL_VALUE(out, iden, type) \
+#define PDCALC_YY_COMPLETE(index) \
   do { \
-    /* lookup symbol */ \
-    auto sym = driver.get_symbol(iden); \
-    /* doesn't exist, so report error and abort */ \
-    if (!sym) { \
-      PDCALC_YY_UNDEFINED_SYMBOL(iden); \
+    if (!driver.complete_statement(index)) \
       YYABORT; \
-    } \
-    /* otherwise, assign the value. no need to check type (lexer handled) */ \
-    out = sym->get<type>(); \
   } \
   while (false)
+
+/**
+ * Compile a statement printing the value of an expression.
+ *
+ * @param root Expression root node index
+ * @param loc Statement location
+ */
+#define PDCALC_YY_PRINT(root, loc) \
+  PDCALC_YY_COMPLETE(driver.program_.print(root, loc))
+
+/**
+ * Compile a statement assigning the value of an expression to a symbol.
+ *
+ * The compile-time type of the symbol is updated before the statement is
+ * completed so that the lexer types following uses of the symbol correctly.
+ *
+ * @param iden `std::uint32_t` symbol name index
+ * @param root Expression root node index
+ * @param loc Statement location
+ */
+#define PDCALC_YY_ASSIGN(iden, root, loc) \
+  do { \
+    auto index_ = driver.program_.assign(iden, root, loc); \
+    driver.declare_symbol(iden, driver.program_.nodes()[root].type); \
+    PDCALC_YY_COMPLETE(index_); \
+  } \
+  while (false)
+
+/**
+ * Compile a compound assignment statement.
+ *
+ * For example, `a += b` is compiled as `a = a + b`, where the result type
+ * follows the usual arithmetic promotion rules.
+ *
+ * @param iden `std::uint32_t` symbol name index
+ * @param type `calc_value_type` enumerator name giving the symbol type
+ * @param op `calc_op` enumerator name giving the arithmetic operation
+ * @param right Right operand node index
+ * @param loc Statement location
+ */
+#define PDCALC_YY_COMPOUND_ASSIGN(iden, type, op, right, loc) \
+  PDCALC_YY_ASSIGN( \
+    iden, \
+    PDCALC_YY_LOCATE( \
+      driver.program_.arithmetic( \
+        pdcalc::calc_op::op, PDCALC_YY_SYMBOL(iden, type), right \
+      ), \
+      loc \
+    ), \
+    loc \
+  )
 %}
 
 /* C++ LR parser using variants handling complete symbols with error reporting.
@@ -101,6 +162,9 @@
  * it is better for parse.error to have the value of detailed. Lookahead
  * correction enabled for more accurate error reporting of location. The
  * api.location.file %define is used to prevent location.hh generation.
+ *
+ * The reentrant Flex scanner state is also passed to both the parser ctor and
+ * to yylex so that each parse driver can use its own independent scanner.
  */
 %require "3.2"
 %language "c++"
@@ -112,6 +176,21 @@
 %locations
 %define api.location.file none
 %param { pdcalc::calc_parser_impl& driver }
+%param { yyscan_t scanner }
+
+/* Reentrant Flex scanner state type.
+ *
+ * This is the same typedef the Flex-generated lexer uses, guarded the same way
+ * so that whichever of the lexer or parser.yy.h is included first defines it.
+ */
+%code requires {
+#include <cstdint>
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif  // YY_TYPEDEF_YY_SCANNER_T
+}
 
 /* Token definitions */
 %token <double> FLOATING
@@ -150,12 +229,14 @@
  *
  * We have typed identifiers, which are intended to be verified by actually
  * looking up the parser table of symbols for the valid identifier. The lexer
- * will perform this lookup to disambiguate the identifier type.
+ * will perform this lookup to disambiguate the identifier type. Identifier
+ * tokens carry the program name index the lexer interned the identifier as
+ * so that no string is copied per token.
  */
-%token <std::string> BOOL_IDEN
-%token <std::string> LONG_IDEN
-%token <std::string> DOUBLE_IDEN
-%token <std::string> UNKNOWN_IDEN
+%token <std::uint32_t> BOOL_IDEN
+%token <std::uint32_t> LONG_IDEN
+%token <std::uint32_t> DOUBLE_IDEN
+%token <std::uint32_t> UNKNOWN_IDEN
 /* Built-in function names */
 %token F_EXP "exp"
 %token F_LOG "log"
@@ -182,14 +263,18 @@
 %right "!" "~"
 
 /* Non-terminal type declarations.
+ *
+ * Expressions are compiled into the driver's calc_program and so each semantic
+ * value is the index of the expression's root node. The nonterminal still
+ * carries the static type of the expression.
  *
  * b_expr -- Boolean expression (bool)
  * d_expr -- Float arithmetic expression (double)
  * i_expr -- Integral arithmetic expression (long)
  */
-%nterm <double> d_expr
-%nterm <bool> b_expr
-%nterm <long> i_expr
+%nterm <std::uint32_t> d_expr
+%nterm <std::uint32_t> b_expr
+%nterm <std::uint32_t> i_expr
 
 %%
 
@@ -210,149 +295,149 @@ stmt:
 /* printing literal expressions */
 | i_expr ";"
   {
-    driver.sink() << "<long> " << $1 << std::endl;
+    PDCALC_YY_PRINT($1, @$);
   }
 | d_expr ";"
   {
-    driver.sink() << "<double> " << $1 << std::endl;
+    PDCALC_YY_PRINT($1, @$);
   }
 | b_expr ";"
   {
-    PDCALC_YY_PRINT_BOOL($1);
+    PDCALC_YY_PRINT($1, @$);
   }
 /* assigning new identifiers */
 | UNKNOWN_IDEN "=" i_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | UNKNOWN_IDEN "=" d_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | UNKNOWN_IDEN "=" b_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 /* rebinding existing identifiers (note: can result in type change) */
 | LONG_IDEN "=" i_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | LONG_IDEN "=" d_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | LONG_IDEN "=" b_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | DOUBLE_IDEN "=" i_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | DOUBLE_IDEN "=" d_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | DOUBLE_IDEN "=" b_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | BOOL_IDEN "=" i_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | BOOL_IDEN "=" d_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 | BOOL_IDEN "=" b_expr ";"
   {
-    driver.add_symbol($1, $3);
+    PDCALC_YY_ASSIGN($1, $3, @$);
   }
 /* modifying existing identifiers (note: can result in type change) */
 | LONG_IDEN "+=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() + $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, add, $3, @$);
   }
 | LONG_IDEN "+=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() + $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, add, $3, @$);
   }
 | LONG_IDEN "-=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() - $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, subtract, $3, @$);
   }
 | LONG_IDEN "-=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() - $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, subtract, $3, @$);
   }
 | LONG_IDEN "*=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() * $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, multiply, $3, @$);
   }
 | LONG_IDEN "*=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<long>() * $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, multiply, $3, @$);
   }
 | LONG_IDEN "/=" i_expr ";"
   {
-    long res;
-    PDCALC_YY_SAFE_DIVIDE(res, driver.get_symbol($1)->get<long>(), $3);
-    driver.add_symbol($1, res);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, divide, $3, @$);
   }
 | LONG_IDEN "/=" d_expr ";"
   {
-    double res;
-    PDCALC_YY_SAFE_DIVIDE(res, driver.get_symbol($1)->get<long>(), $3);
-    driver.add_symbol($1, res);
+    PDCALC_YY_COMPOUND_ASSIGN($1, integral, divide, $3, @$);
   }
 | DOUBLE_IDEN "+=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() + $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, add, $3, @$);
   }
 | DOUBLE_IDEN "+=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() + $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, add, $3, @$);
   }
 | DOUBLE_IDEN "-=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() - $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, subtract, $3, @$);
   }
 | DOUBLE_IDEN "-=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() - $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, subtract, $3, @$);
   }
 | DOUBLE_IDEN "*=" i_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() * $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, multiply, $3, @$);
   }
 | DOUBLE_IDEN "*=" d_expr ";"
   {
-    driver.add_symbol($1, driver.get_symbol($1)->get<double>() * $3);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, multiply, $3, @$);
   }
 | DOUBLE_IDEN "/=" i_expr ";"
   {
-    double res;
-    PDCALC_YY_SAFE_DIVIDE(res, driver.get_symbol($1)->get<double>(), $3);
-    driver.add_symbol($1, res);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, divide, $3, @$);
   }
 | DOUBLE_IDEN "/=" d_expr ";"
   {
-    double res;
-    PDCALC_YY_SAFE_DIVIDE(res, driver.get_symbol($1)->get<double>(), $3);
-    driver.add_symbol($1, res);
+    PDCALC_YY_COMPOUND_ASSIGN($1, floating, divide, $3, @$);
+  }
+/* skipping a statement with an error up to the next semicolon. yyerrok lets
+ * an error in the very next statement be reported too */
+| error ";"
+  {
+    if (!driver.skip_statement(@$))
+      YYABORT;
+    yyerrok;
   }
 
 /* Integral expression rule */
 i_expr:
   INTEGRAL
   {
-    $$ = $1;
+    $$ = driver.program_.literal($1);
   }
 | LONG_IDEN
   {
-    PDCALC_YY_GET_SYMBOL_VALUE($$, $1, long);
+    $$ = PDCALC_YY_SYMBOL($1, integral);
   }
 | "(" i_expr ")"
   {
@@ -360,71 +445,75 @@ i_expr:
   }
 | "-" i_expr
   {
-    $$ = -$2;
+    $$ = PDCALC_YY_I_NODE(negate, $2);
   }
 | i_expr "+" i_expr
   {
-    $$ = $1 + $3;
+    $$ = PDCALC_YY_I_NODE(add, $1, $3);
   }
 | i_expr "-" i_expr
   {
-    $$ = $1 - $3;
+    $$ = PDCALC_YY_I_NODE(subtract, $1, $3);
   }
 | i_expr "*" i_expr
   {
-    $$ = $1 * $3;
+    $$ = PDCALC_YY_I_NODE(multiply, $1, $3);
   }
 | i_expr "/" i_expr
   {
-    PDCALC_YY_SAFE_DIVIDE($$, $1, $3);
+    $$ = PDCALC_YY_LOCATE(
+      PDCALC_YY_I_NODE(divide, $1, $3), @$
+    );
   }
 | i_expr "%" i_expr
   {
-    $$ = $1 % $3;
+    $$ = PDCALC_YY_LOCATE(
+      PDCALC_YY_I_NODE(modulo, $1, $3), @$
+    );
   }
 | i_expr "&" i_expr
   {
-    $$ = $1 & $3;
+    $$ = PDCALC_YY_I_NODE(bit_and, $1, $3);
   }
 | i_expr "^" i_expr
   {
-    $$ = $1 ^ $3;
+    $$ = PDCALC_YY_I_NODE(bit_xor, $1, $3);
   }
 | i_expr "|" i_expr
   {
-    $$ = $1 | $3;
+    $$ = PDCALC_YY_I_NODE(bit_or, $1, $3);
   }
 | "~" i_expr
   {
-    $$ = ~$2;
+    $$ = PDCALC_YY_I_NODE(bit_not, $2);
   }
 | i_expr "<<" i_expr
   {
-    $$ = $1 << $3;
+    $$ = PDCALC_YY_I_NODE(lshift, $1, $3);
   }
 | i_expr ">>" i_expr
   {
-    $$ = $1 >> $3;
+    $$ = PDCALC_YY_I_NODE(rshift, $1, $3);
   }
 /* Binary function calls */
 | "max" "(" i_expr "," i_expr ")"
   {
-    $$ = std::max($3, $5);
+    $$ = PDCALC_YY_I_NODE(max, $3, $5);
   }
 | "min" "(" i_expr "," i_expr ")"
   {
-    $$ = std::min($3, $5);
+    $$ = PDCALC_YY_I_NODE(min, $3, $5);
   }
 
 /* Float arithmetic expression rule */
 d_expr:
   FLOATING
   {
-    $$ = $1;
+    $$ = driver.program_.literal($1);
   }
 | DOUBLE_IDEN
   {
-    PDCALC_YY_GET_SYMBOL_VALUE($$, $1, double);
+    $$ = PDCALC_YY_SYMBOL($1, floating);
   }
 | "(" d_expr ")"
   {
@@ -432,163 +521,169 @@ d_expr:
   }
 | "-" d_expr
   {
-    $$ = -$2;
+    $$ = PDCALC_YY_D_NODE(negate, $2);
   }
 | d_expr "+" d_expr
   {
-    $$ = $1 + $3;
+    $$ = PDCALC_YY_D_NODE(add, $1, $3);
   }
 | d_expr "-" d_expr
   {
-    $$ = $1 - $3;
+    $$ = PDCALC_YY_D_NODE(subtract, $1, $3);
   }
 | d_expr "*" d_expr
   {
-    $$ = $1 * $3;
+    $$ = PDCALC_YY_D_NODE(multiply, $1, $3);
   }
 | d_expr "/" d_expr
   {
-    PDCALC_YY_SAFE_DIVIDE($$, $1, $3);
+    $$ = PDCALC_YY_LOCATE(
+      PDCALC_YY_D_NODE(divide, $1, $3), @$
+    );
   }
 /* promoting right i_expr */
 | d_expr "+" i_expr
   {
-    $$ = $1 + $3;
+    $$ = PDCALC_YY_D_NODE(add, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "-" i_expr
   {
-    $$ = $1 - $3;
+    $$ = PDCALC_YY_D_NODE(subtract, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "*" i_expr
   {
-    $$ = $1 * $3;
+    $$ = PDCALC_YY_D_NODE(multiply, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "/" i_expr
   {
-    PDCALC_YY_SAFE_DIVIDE($$, $1, $3);
+    $$ = PDCALC_YY_LOCATE(
+      PDCALC_YY_D_NODE(divide, $1, PDCALC_YY_PROMOTE($3)), @$
+    );
   }
 /* promoting left i_expr */
 | i_expr "+" d_expr
   {
-    $$ = $1 + $3;
+    $$ = PDCALC_YY_D_NODE(add, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "-" d_expr
   {
-    $$ = $1 - $3;
+    $$ = PDCALC_YY_D_NODE(subtract, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "*" d_expr
   {
-    $$ = $1 * $3;
+    $$ = PDCALC_YY_D_NODE(multiply, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "/" d_expr
   {
-    PDCALC_YY_SAFE_DIVIDE($$, $1, $3);
+    $$ = PDCALC_YY_LOCATE(
+      PDCALC_YY_D_NODE(divide, PDCALC_YY_PROMOTE($1), $3), @$
+    );
   }
 /* Unary function calls */
 | "exp" "(" d_expr ")"
   {
-    $$ = std::exp($3);
+    $$ = PDCALC_YY_D_NODE(exp, $3);
   }
 | "exp" "(" i_expr ")"
   {
-    $$ = std::exp($3);
+    $$ = PDCALC_YY_D_NODE(exp, PDCALC_YY_PROMOTE($3));
   }
 | "log" "(" d_expr ")"
   {
-    $$ = std::log($3);
+    $$ = PDCALC_YY_D_NODE(log, $3);
   }
 | "log" "(" i_expr ")"
   {
-    $$ = std::log($3);
+    $$ = PDCALC_YY_D_NODE(log, PDCALC_YY_PROMOTE($3));
   }
 | "log2" "(" d_expr ")"
   {
-    $$ = std::log2($3);
+    $$ = PDCALC_YY_D_NODE(log2, $3);
   }
 | "log2" "(" i_expr ")"
   {
-    $$ = std::log2($3);
+    $$ = PDCALC_YY_D_NODE(log2, PDCALC_YY_PROMOTE($3));
   }
 | "log10" "(" d_expr ")"
   {
-    $$ = std::log10($3);
+    $$ = PDCALC_YY_D_NODE(log10, $3);
   }
 | "log10" "(" i_expr ")"
   {
-    $$ = std::log10($3);
+    $$ = PDCALC_YY_D_NODE(log10, PDCALC_YY_PROMOTE($3));
   }
 | "sqrt" "(" d_expr ")"
   {
-    $$ = std::sqrt($3);
+    $$ = PDCALC_YY_D_NODE(sqrt, $3);
   }
 | "sqrt" "(" i_expr ")"
   {
-    $$ = std::sqrt($3);
+    $$ = PDCALC_YY_D_NODE(sqrt, PDCALC_YY_PROMOTE($3));
   }
 | "sin" "(" d_expr ")"
   {
-    $$ = std::sin($3);
+    $$ = PDCALC_YY_D_NODE(sin, $3);
   }
 | "sin" "(" i_expr ")"
   {
-    $$ = std::sin($3);
+    $$ = PDCALC_YY_D_NODE(sin, PDCALC_YY_PROMOTE($3));
   }
 | "cos" "(" d_expr ")"
   {
-    $$ = std::cos($3);
+    $$ = PDCALC_YY_D_NODE(cos, $3);
   }
 | "cos" "(" i_expr ")"
   {
-    $$ = std::cos($3);
+    $$ = PDCALC_YY_D_NODE(cos, PDCALC_YY_PROMOTE($3));
   }
 | "tan" "(" d_expr ")"
   {
-    $$ = std::tan($3);
+    $$ = PDCALC_YY_D_NODE(tan, $3);
   }
 | "tan" "(" i_expr ")"
   {
-    $$ = std::tan($3);
+    $$ = PDCALC_YY_D_NODE(tan, PDCALC_YY_PROMOTE($3));
   }
 /*
  * Binary function calls.
  *
- * Note that in some cases, explicit template type is specified since the min +
- * max templates have a (const T& a, const T& b) signature.
+ * Note that integral operands are explicitly promoted since the min + max
+ * nodes, like the std::min + std::max templates, require same-type operands.
  */
 | "max" "(" d_expr "," d_expr ")"
   {
-    $$ = std::max($3, $5);
+    $$ = PDCALC_YY_D_NODE(max, $3, $5);
   }
 | "max" "(" d_expr "," i_expr ")"
   {
-    $$ = std::max<double>($3, $5);
+    $$ = PDCALC_YY_D_NODE(max, $3, PDCALC_YY_PROMOTE($5));
   }
 | "max" "(" i_expr "," d_expr ")"
   {
-    $$ = std::max<double>($3, $5);
+    $$ = PDCALC_YY_D_NODE(max, PDCALC_YY_PROMOTE($3), $5);
   }
 | "min" "(" d_expr "," d_expr ")"
   {
-    $$ = std::min($3, $5);
+    $$ = PDCALC_YY_D_NODE(min, $3, $5);
   }
 | "min" "(" d_expr "," i_expr ")"
   {
-    $$ = std::min<double>($3, $5);
+    $$ = PDCALC_YY_D_NODE(min, $3, PDCALC_YY_PROMOTE($5));
   }
 | "min" "(" i_expr "," d_expr ")"
   {
-    $$ = std::min<double>($3, $5);
+    $$ = PDCALC_YY_D_NODE(min, PDCALC_YY_PROMOTE($3), $5);
   }
 
 /* Boolean expression rule */
 b_expr:
   TRUTH
   {
-    $$ = $1;
+    $$ = driver.program_.literal($1);
   }
 | BOOL_IDEN
   {
-    PDCALC_YY_GET_SYMBOL_VALUE($$, $1, bool);
+    $$ = PDCALC_YY_SYMBOL($1, boolean);
   }
 | "(" b_expr ")"
   {
@@ -597,122 +692,122 @@ b_expr:
 /* b_expr comparisons */
 | b_expr "==" b_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(equal, $1, $3);
   }
 | b_expr "!=" b_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(not_equal, $1, $3);
   }
 | b_expr "||" b_expr
   {
-    $$ = ($1 || $3);
+    $$ = PDCALC_YY_B_NODE(logical_or, $1, $3);
   }
 | b_expr "&&" b_expr
   {
-    $$ = ($1 && $3);
+    $$ = PDCALC_YY_B_NODE(logical_and, $1, $3);
   }
 | "!" b_expr
   {
-    $$ = !$2;
+    $$ = PDCALC_YY_B_NODE(logical_not, $2);
   }
 /* d_expr, i_expr comparisons */
 | d_expr "==" d_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(equal, $1, $3);
   }
 | d_expr "!=" d_expr
   {
-    $$ = ($1 != $3);
+    $$ = PDCALC_YY_B_NODE(not_equal, $1, $3);
   }
 | i_expr "==" i_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(equal, $1, $3);
   }
 | i_expr "!=" i_expr
   {
-    $$ = ($1 != $3);
+    $$ = PDCALC_YY_B_NODE(not_equal, $1, $3);
   }
 | d_expr "<" d_expr
   {
-    $$ = ($1 < $3);
+    $$ = PDCALC_YY_B_NODE(less, $1, $3);
   }
 | d_expr ">" d_expr
   {
-    $$ = ($1 > $3);
+    $$ = PDCALC_YY_B_NODE(greater, $1, $3);
   }
 | d_expr "<=" d_expr
   {
-    $$ = ($1 <= $3);
+    $$ = PDCALC_YY_B_NODE(less_equal, $1, $3);
   }
 | d_expr ">=" d_expr
   {
-    $$ = ($1 >= $3);
+    $$ = PDCALC_YY_B_NODE(greater_equal, $1, $3);
   }
 | i_expr "<" i_expr
   {
-    $$ = ($1 < $3);
+    $$ = PDCALC_YY_B_NODE(less, $1, $3);
   }
 | i_expr ">" i_expr
   {
-    $$ = ($1 > $3);
+    $$ = PDCALC_YY_B_NODE(greater, $1, $3);
   }
 | i_expr "<=" i_expr
   {
-    $$ = ($1 <= $3);
+    $$ = PDCALC_YY_B_NODE(less_equal, $1, $3);
   }
 | i_expr ">=" i_expr
   {
-    $$ = ($1 >= $3);
+    $$ = PDCALC_YY_B_NODE(greater_equal, $1, $3);
   }
 /* d_expr left, i_expr right */
 | d_expr "==" i_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(equal, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "!=" i_expr
   {
-    $$ = ($1 != $3);
+    $$ = PDCALC_YY_B_NODE(not_equal, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "<" i_expr
   {
-    $$ = ($1 < $3);
+    $$ = PDCALC_YY_B_NODE(less, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr ">" i_expr
   {
-    $$ = ($1 > $3);
+    $$ = PDCALC_YY_B_NODE(greater, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr "<=" i_expr
   {
-    $$ = ($1 <= $3);
+    $$ = PDCALC_YY_B_NODE(less_equal, $1, PDCALC_YY_PROMOTE($3));
   }
 | d_expr ">=" i_expr
   {
-    $$ = ($1 >= $3);
+    $$ = PDCALC_YY_B_NODE(greater_equal, $1, PDCALC_YY_PROMOTE($3));
   }
 /* i_expr left, d_expr right */
 | i_expr "==" d_expr
   {
-    $$ = ($1 == $3);
+    $$ = PDCALC_YY_B_NODE(equal, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "!=" d_expr
   {
-    $$ = ($1 != $3);
+    $$ = PDCALC_YY_B_NODE(not_equal, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "<" d_expr
   {
-    $$ = ($1 < $3);
+    $$ = PDCALC_YY_B_NODE(less, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr ">" d_expr
   {
-    $$ = ($1 > $3);
+    $$ = PDCALC_YY_B_NODE(greater, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr "<=" d_expr
   {
-    $$ = ($1 <= $3);
+    $$ = PDCALC_YY_B_NODE(less_equal, PDCALC_YY_PROMOTE($1), $3);
   }
 | i_expr ">=" d_expr
   {
-    $$ = ($1 >= $3);
+    $$ = PDCALC_YY_B_NODE(greater_equal, PDCALC_YY_PROMOTE($1), $3);
   }
 
 %%
@@ -722,16 +817,14 @@ namespace yy {
 /**
  * User-defined error handler.
  *
- * The parse driver's last error member is updated with location + error.
+ * The parse driver handles the error message with its location.
  *
  * @param loc Bison error location
  * @param msg Bison exception error message
  */
 void parser::error(const parser::location_type& loc, const std::string& msg)
 {
-  std::stringstream ss;
-  ss << loc << ": " << msg;
-  driver.last_error_ = ss.str();
+  driver.syntax_error(loc, msg);
 }
 
 }  // namespace yy
@@ -0,0 +1,1175 @@
+/**
+ * @file pdcalc_gen.cc
+ * @author Derek Huang
+ * @brief Main source file for the pdcalc workload generator and checker
+ * @copyright MIT License
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+namespace {
+
+// program name + program usage
+const std::string progname{"pdcalc_gen"};
+const std::string program_usage{
+  "Usage: " + progname + " [-h] [--seed=N] [-n N] [--mix=A,B,L,F]\n"
+  "       [--depth=N] [--vars=N] [--rebind=P] [--comments=P]\n"
+  "       " + progname + " --check=PROGRAM [--rtol=X] [OUTPUT]\n"
+  "\n"
+  "Generates a reproducible pdcalc program and writes it to stdout, or checks\n"
+  "pdcalc output against the expected results in a program.\n"
+  "\n"
+  "As in the sample inputs, the expected result of each statement that prints\n"
+  "a result is written on the line before it as a # <type> value comment.\n"
+  "A statement expected to fail with pdcalc --keep-going is written as a\n"
+  "# <error> comment.\n"
+  "Expected results are computed by the generator itself, so output can be\n"
+  "checked without a reference implementation. The same options and seed\n"
+  "give the same program on every platform.\n"
+  "\n"
+  "Options:\n"
+  "  -h, --help          Print this usage\n"
+  "\n"
+  "  --seed=N            Random seed. Default 1.\n"
+  "  -n N, --statements=N\n"
+  "                      Number of statements after the variable definitions.\n"
+  "                      Default 1000.\n"
+  "  --mix=A,B,L,F       Relative weights of arithmetic, bitwise, boolean,\n"
+  "                      and built-in function operations. Default 4,1,2,2.\n"
+  "  --depth=N           Maximum expression nesting depth. Default 4.\n"
+  "  --vars=N            Number of variables, all defined at the start of the\n"
+  "                      program. Default 16.\n"
+  "  --rebind=P          Fraction of statements that assign to an existing\n"
+  "                      variable, possibly changing its type. Default 0.1.\n"
+  "  --comments=P        Fraction of statements preceded by a comment line in\n"
+  "                      addition to any expected result. Default 0.1.\n"
+  "\n"
+  "  --check=PROGRAM     Check pdcalc output read from OUTPUT, or stdin if\n"
+  "                      OUTPUT is omitted or -, against the expected results\n"
+  "                      in PROGRAM. Both are read as streams so inputs of\n"
+  "                      any size can be checked.\n"
+  "  --rtol=X            Relative tolerance for double results. The default\n"
+  "                      of 1e-5 allows for pdcalc printing 6 significant\n"
+  "                      digits. Use a smaller value with pdcalc --shortest."
+};
+
+/**
+ * Kind of operation in a generated expression.
+ *
+ * The values index the operation mix weights.
+ */
+enum op_class : std::size_t { arithmetic, bitwise, boolean, function };
+
+/**
+ * Generator settings.
+ */
+struct gen_options {
+  std::uint64_t seed = 1;                   // random seed
+  std::uint64_t n_statements = 1000;        // statements after definitions
+  std::array<unsigned, 4> mix{4, 1, 2, 2};  // weights indexed by op_class
+  unsigned depth = 4;                       // maximum nesting depth
+  std::size_t n_vars = 16;                  // number of variables
+  double rebind = 0.1;                      // fraction of assignments
+  double comments = 0.1;                    // fraction with extra comments
+};
+
+/**
+ * Checker settings.
+ */
+struct check_options {
+  std::string program;  // program with expected results
+  std::string output;   // pdcalc output, empty or "-" for stdin
+  double rtol = 1e-5;   // relative tolerance for doubles
+};
+
+/**
+ * Value of a generated expression or variable.
+ *
+ * The alternatives are in the same order as `calc_symbol::value_type`.
+ */
+using gen_value = std::variant<bool, long, double>;
+
+/**
+ * Generated expression text and its value.
+ */
+struct gen_expr {
+  std::string text;  // expression text
+  gen_value value;   // expression value
+  bool leaf;         // literal or variable that needs no parentheses
+};
+
+/**
+ * Bound on the magnitude of integral values.
+ *
+ * This is small enough that products of two values fit in a 32-bit `long` so
+ * that generated programs have the same results on every platform.
+ */
+constexpr long long_bound = 1L << 15;
+
+/**
+ * Bound on the magnitude of floating values.
+ */
+constexpr double double_bound = 1e12;
+
+/**
+ * Probability that a node above the maximum depth is a leaf.
+ */
+constexpr double leaf_rate = 0.25;
+
+/**
+ * Return the type name of a value as written by pdcalc.
+ *
+ * @param value Value
+ */
+const char* type_name(const gen_value& value) noexcept
+{
+  switch (value.index()) {
+    case 0:
+      return "bool";
+    case 1:
+      return "long";
+    default:
+      return "double";
+  }
+}
+
+/**
+ * Return the value as a double, promoting integral values.
+ *
+ * @param value Integral or floating value
+ */
+double as_double(const gen_value& value) noexcept
+{
+  if (auto i = std::get_if<long>(&value))
+    return static_cast<double>(*i);
+  return std::get<double>(value);
+}
+
+/**
+ * Append the text of a value as pdcalc writes it in shortest format.
+ *
+ * @param text String to append to
+ * @param value Value
+ */
+void append_value(std::string& text, const gen_value& value)
+{
+  if (auto b = std::get_if<bool>(&value)) {
+    text += *b ? "true" : "false";
+    return;
+  }
+  char buf[32];
+  auto [end, ec] = std::holds_alternative<long>(value) ?
+    std::to_chars(buf, buf + sizeof buf, std::get<long>(value)) :
+    std::to_chars(buf, buf + sizeof buf, std::get<double>(value));
+  text.append(buf, end);
+}
+
+/**
+ * Reproducible pdcalc program generator.
+ *
+ * Only the output of `std::mt19937_64` is used, which unlike the standard
+ * distributions is fully specified, so that a seed gives the same program
+ * everywhere. Every operation is chosen so that it is well-defined and cannot
+ * fail, e.g. divisors are nonzero, shifted values are nonnegative, and values
+ * stay within `long_bound` and `double_bound`. Operations that would violate
+ * this are replaced by one of their operands.
+ */
+class generator {
+public:
+  /**
+   * Ctor.
+   *
+   * @param options Generator settings
+   */
+  generator(const gen_options& options)
+    : options_{options},
+      rng_{options.seed},
+      vars_(options.n_vars),
+      defined_(options.n_vars),
+      slots_(options.n_vars)
+  {}
+
+  /**
+   * Generate the program and write it to `stdout`.
+   *
+   * @returns `true` on success, `false` on write error
+   */
+  bool operator()()
+  {
+    text_ = "# generated by " + progname + " --seed=" +
+      std::to_string(options_.seed) + " -n " +
+      std::to_string(options_.n_statements) + " --mix=" +
+      std::to_string(options_.mix[arithmetic]) + "," +
+      std::to_string(options_.mix[bitwise]) + "," +
+      std::to_string(options_.mix[boolean]) + "," +
+      std::to_string(options_.mix[function]) + " --depth=" +
+      std::to_string(options_.depth) + " --vars=" +
+      std::to_string(options_.n_vars) + " --rebind=" +
+      std::to_string(options_.rebind) + " --comments=" +
+      std::to_string(options_.comments) + "\n\n";
+    // define every variable first
+    for (std::size_t i = 0; i < vars_.size(); i++)
+      if (!assign(i))
+        return false;
+    // then the statements
+    for (std::uint64_t i = 0; i < options_.n_statements; i++) {
+      if (chance(options_.comments))
+        text_ += "# statement " + std::to_string(i) + "\n";
+      if (vars_.size() && chance(options_.rebind)) {
+        if (!assign(static_cast<std::size_t>(uniform(vars_.size()))))
+          return false;
+      }
+      else if (!print())
+        return false;
+    }
+    return flush(true);
+  }
+
+private:
+  gen_options options_;
+  std::mt19937_64 rng_;
+  std::vector<gen_value> vars_;                      // variable values
+  std::vector<bool> defined_;                        // variable is defined
+  std::array<std::vector<std::size_t>, 3> by_type_;  // variables by type
+  std::vector<std::size_t> slots_;                   // index in by_type_ list
+  std::string text_;                                 // unwritten text
+
+  /**
+   * Return a random integer in `[0, n)` for positive `n`.
+   *
+   * @param n Upper bound
+   */
+  std::uint64_t uniform(std::uint64_t n) { return rng_() % n; }
+
+  /**
+   * Return `true` with the given probability.
+   *
+   * @param p Probability
+   */
+  bool chance(double p)
+  {
+    return static_cast<double>(rng_() >> 11) * 0x1p-53 < p;
+  }
+
+  /**
+   * Return a random index with probability proportional to its weight.
+   *
+   * @param weights Weights
+   * @returns Index or `weights.size()` if all weights are zero
+   */
+  std::size_t pick(std::initializer_list<unsigned> weights)
+  {
+    std::uint64_t total = 0;
+    for (auto weight : weights)
+      total += weight;
+    if (!total)
+      return weights.size();
+    auto target = uniform(total);
+    std::size_t index = 0;
+    for (auto weight : weights) {
+      if (target < weight)
+        break;
+      target -= weight;
+      index++;
+    }
+    return index;
+  }
+
+  /**
+   * Write the buffered program text to `stdout` if enough has accumulated.
+   *
+   * @param force `true` to write regardless of the buffered size
+   * @returns `true` on success, `false` on write error
+   */
+  bool flush(bool force = false)
+  {
+    if (!force && text_.size() < (1u << 16))
+      return true;
+    if (std::fwrite(text_.data(), 1, text_.size(), stdout) != text_.size()) {
+      std::cerr << progname << ": Error writing program" << std::endl;
+      return false;
+    }
+    text_.clear();
+    return !force || !std::fflush(stdout);
+  }
+
+  /**
+   * Return an expression wrapped in parentheses unless it is a leaf.
+   *
+   * @param expr Expression
+   */
+  static std::string wrap(const gen_expr& expr)
+  {
+    return expr.leaf ? expr.text : "(" + expr.text + ")";
+  }
+
+  /**
+   * Return a binary expression.
+   *
+   * @param left Left operand
+   * @param op Operator
+   * @param right Right operand
+   * @param value Expression value
+   */
+  static gen_expr binary(
+    const gen_expr& left, std::string_view op, const gen_expr& right,
+    gen_value value)
+  {
+    return {
+      wrap(left) + " " + std::string{op} + " " + wrap(right),
+      std::move(value),
+      false
+    };
+  }
+
+  /**
+   * Return a call of a built-in function.
+   *
+   * @param name Function name
+   * @param args Function argument text, comma-separated if more than one
+   * @param value Expression value
+   */
+  static gen_expr call(
+    std::string_view name, const std::string& args, gen_value value)
+  {
+    return {std::string{name} + "(" + args + ")", std::move(value), true};
+  }
+
+  /**
+   * Choose a random defined variable of the given type, if any.
+   *
+   * @param type Type index of `gen_value`
+   * @param expr Expression to write the variable to
+   * @returns `true` on success, `false` if no variable has the type
+   */
+  bool variable(std::size_t type, gen_expr& expr)
+  {
+    const auto& candidates = by_type_[type];
+    if (candidates.empty())
+      return false;
+    auto index = candidates[uniform(candidates.size())];
+    expr = {"v" + std::to_string(index), vars_[index], true};
+    return true;
+  }
+
+  /**
+   * Return a boolean leaf.
+   */
+  gen_expr boolean_leaf()
+  {
+    gen_expr expr;
+    if (chance(0.5) && variable(0, expr))
+      return expr;
+    auto value = chance(0.5);
+    return {value ? "true" : "false", value, true};
+  }
+
+  /**
+   * Return an integral leaf.
+   */
+  gen_expr integral_leaf()
+  {
+    gen_expr expr;
+    if (chance(0.5) && variable(1, expr))
+      return expr;
+    auto value = static_cast<long>(uniform(1000));
+    if (chance(0.25))
+      value = -value;
+    return {std::to_string(value), value, true};
+  }
+
+  /**
+   * Return a floating leaf.
+   *
+   * The literal value is read from its text as the pdcalc lexer does.
+   */
+  gen_expr floating_leaf()
+  {
+    gen_expr expr;
+    if (chance(0.5) && variable(2, expr))
+      return expr;
+    auto fraction = std::to_string(uniform(1000));
+    auto text = (chance(0.25) ? "-" : "") + std::to_string(uniform(100)) +
+      "." + std::string(3 - fraction.size(), '0') + fraction;
+    double value;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return {std::move(text), value, true};
+  }
+
+  /**
+   * Return a boolean expression.
+   *
+   * @param depth Maximum nesting depth
+   */
+  gen_expr boolean_expr(unsigned depth)
+  {
+    if (!depth || chance(leaf_rate))
+      return boolean_leaf();
+    auto kind = pick(
+      {options_.mix[arithmetic] + options_.mix[function], options_.mix[boolean]}
+    );
+    // comparison of numeric values, promoting if either is floating
+    if (kind == 0) {
+      auto left = numeric_expr(depth - 1);
+      auto right = numeric_expr(depth - 1);
+      auto l = as_double(left.value);
+      auto r = as_double(right.value);
+      if (
+        std::holds_alternative<long>(left.value) &&
+        std::holds_alternative<long>(right.value)
+      ) {
+        // compare integral values exactly
+        auto li = std::get<long>(left.value);
+        auto ri = std::get<long>(right.value);
+        l = (li < ri) ? 0. : ((li == ri) ? 1. : 2.);
+        r = 1.;
+      }
+      switch (uniform(6)) {
+        case 0:
+          return binary(left, "==", right, l == r);
+        case 1:
+          return binary(left, "!=", right, l != r);
+        case 2:
+          return binary(left, "<", right, l < r);
+        case 3:
+          return binary(left, ">", right, l > r);
+        case 4:
+          return binary(left, "<=", right, l <= r);
+        default:
+          return binary(left, ">=", right, l >= r);
+      }
+    }
+    // boolean operations
+    if (kind == 1) {
+      auto left = boolean_expr(depth - 1);
+      auto l = std::get<bool>(left.value);
+      if (!uniform(5))
+        return {"!" + wrap(left), !l, false};
+      auto right = boolean_expr(depth - 1);
+      auto r = std::get<bool>(right.value);
+      switch (uniform(4)) {
+        case 0:
+          return binary(left, "&&", right, l && r);
+        case 1:
+          return binary(left, "||", right, l || r);
+        case 2:
+          return binary(left, "==", right, l == r);
+        default:
+          return binary(left, "!=", right, l != r);
+      }
+    }
+    return boolean_leaf();
+  }
+
+  /**
+   * Return an integral expression.
+   *
+   * @param depth Maximum nesting depth
+   */
+  gen_expr integral_expr(unsigned depth)
+  {
+    if (!depth || chance(leaf_rate))
+      return integral_leaf();
+    auto fits = [](long value) { return std::abs(value) <= long_bound; };
+    switch (
+      pick(
+        {options_.mix[arithmetic], options_.mix[bitwise],
+          options_.mix[function]}
+      )
+    ) {
+      // arithmetic with C++ truncating division
+      case 0: {
+        auto left = integral_expr(depth - 1);
+        auto l = std::get<long>(left.value);
+        if (!uniform(6))
+          return {"-" + wrap(left), -l, false};
+        auto right = integral_expr(depth - 1);
+        auto r = std::get<long>(right.value);
+        switch (uniform(5)) {
+          case 0:
+            return fits(l + r) ? binary(left, "+", right, l + r) : left;
+          case 1:
+            return fits(l - r) ? binary(left, "-", right, l - r) : left;
+          case 2:
+            return fits(l * r) ? binary(left, "*", right, l * r) : left;
+          case 3:
+            return r ? binary(left, "/", right, l / r) : left;
+          default:
+            return r ? binary(left, "%", right, l % r) : left;
+        }
+      }
+      // bitwise operations. only nonnegative values are shifted
+      case 1: {
+        auto left = integral_expr(depth - 1);
+        auto l = std::get<long>(left.value);
+        if (!uniform(6))
+          return fits(~l) ? gen_expr{"~" + wrap(left), ~l, false} : left;
+        switch (uniform(5)) {
+          case 0:
+          case 1:
+          case 2: {
+            auto right = integral_expr(depth - 1);
+            auto r = std::get<long>(right.value);
+            switch (uniform(3)) {
+              case 0:
+                return fits(l & r) ? binary(left, "&", right, l & r) : left;
+              case 1:
+                return fits(l | r) ? binary(left, "|", right, l | r) : left;
+              default:
+                return fits(l ^ r) ? binary(left, "^", right, l ^ r) : left;
+            }
+          }
+          case 3: {
+            auto shift = static_cast<long>(uniform(9));
+            gen_expr right{std::to_string(shift), shift, true};
+            if (l < 0 || !fits(l << shift))
+              return left;
+            return binary(left, "<<", right, l << shift);
+          }
+          default: {
+            auto shift = static_cast<long>(uniform(9));
+            gen_expr right{std::to_string(shift), shift, true};
+            return (l < 0) ? left : binary(left, ">>", right, l >> shift);
+          }
+        }
+      }
+      // integral max + min
+      case 2: {
+        auto left = integral_expr(depth - 1);
+        auto right = integral_expr(depth - 1);
+        auto l = std::get<long>(left.value);
+        auto r = std::get<long>(right.value);
+        auto args = left.text + ", " + right.text;
+        return chance(0.5) ?
+          call("max", args, std::max(l, r)) : call("min", args, std::min(l, r));
+      }
+      default:
+        return integral_leaf();
+    }
+  }
+
+  /**
+   * Return a floating expression.
+   *
+   * @param depth Maximum nesting depth
+   */
+  gen_expr floating_expr(unsigned depth)
+  {
+    if (!depth || chance(leaf_rate))
+      return floating_leaf();
+    auto fits = [](double value)
+    {
+      return std::isfinite(value) && std::abs(value) <= double_bound;
+    };
+    switch (pick({options_.mix[arithmetic], options_.mix[function]})) {
+      // arithmetic with at least one floating operand
+      case 0: {
+        if (!uniform(6)) {
+          auto operand = floating_expr(depth - 1);
+          return {
+            "-" + wrap(operand), -std::get<double>(operand.value), false
+          };
+        }
+        auto left_floating = chance(0.5);
+        auto left = left_floating ?
+          floating_expr(depth - 1) : numeric_expr(depth - 1);
+        auto right = (!left_floating || chance(0.5)) ?
+          floating_expr(depth - 1) : numeric_expr(depth - 1);
+        // operand that is floating for when the operation is skipped
+        const auto& fallback =
+          std::holds_alternative<double>(left.value) ? left : right;
+        auto l = as_double(left.value);
+        auto r = as_double(right.value);
+        double value;
+        const char* op;
+        switch (uniform(4)) {
+          case 0:
+            value = l + r;
+            op = "+";
+            break;
+          case 1:
+            value = l - r;
+            op = "-";
+            break;
+          case 2:
+            value = l * r;
+            op = "*";
+            break;
+          default:
+            if (r == 0.)
+              return fallback;
+            value = l / r;
+            op = "/";
+        }
+        return fits(value) ? binary(left, op, right, value) : fallback;
+      }
+      // built-in functions of integral or floating arguments
+      case 1: {
+        if (!uniform(5)) {
+          auto left = floating_expr(depth - 1);
+          auto right = numeric_expr(depth - 1);
+          if (chance(0.5))
+            std::swap(left, right);
+          auto l = as_double(left.value);
+          auto r = as_double(right.value);
+          auto args = left.text + ", " + right.text;
+          return chance(0.5) ?
+            call("max", args, std::max(l, r)) :
+            call("min", args, std::min(l, r));
+        }
+        auto arg = numeric_expr(depth - 1);
+        auto x = as_double(arg.value);
+        auto sine = [&] { return call("sin", arg.text, std::sin(x)); };
+        switch (uniform(8)) {
+          case 0:
+            return (std::abs(x) <= 20.) ?
+              call("exp", arg.text, std::exp(x)) : sine();
+          case 1:
+            return (x > 0.) ? call("log", arg.text, std::log(x)) : sine();
+          case 2:
+            return (x > 0.) ? call("log2", arg.text, std::log2(x)) : sine();
+          case 3:
+            return (x > 0.) ? call("log10", arg.text, std::log10(x)) : sine();
+          case 4:
+            return (x >= 0.) ? call("sqrt", arg.text, std::sqrt(x)) : sine();
+          case 5:
+            return call("cos", arg.text, std::cos(x));
+          case 6:
+            return fits(std::tan(x)) ?
+              call("tan", arg.text, std::tan(x)) : sine();
+          default:
+            return sine();
+        }
+      }
+      default:
+        return floating_leaf();
+    }
+  }
+
+  /**
+   * Return an integral or floating expression.
+   *
+   * @param depth Maximum nesting depth
+   */
+  gen_expr numeric_expr(unsigned depth)
+  {
+    return chance(0.5) ? integral_expr(depth) : floating_expr(depth);
+  }
+
+  /**
+   * Return an expression of a random type.
+   *
+   * @param depth Maximum nesting depth
+   */
+  gen_expr any_expr(unsigned depth)
+  {
+    switch (uniform(3)) {
+      case 0:
+        return boolean_expr(depth);
+      case 1:
+        return integral_expr(depth);
+      default:
+        return floating_expr(depth);
+    }
+  }
+
+  /**
+   * Set the value of a variable, updating the variables by type.
+   *
+   * @param index Variable index
+   * @param value New value
+   */
+  void set_variable(std::size_t index, gen_value value)
+  {
+    // remove from the list for the old type if the type changes
+    auto listed = defined_[index];
+    if (listed && vars_[index].index() != value.index()) {
+      auto& old_list = by_type_[vars_[index].index()];
+      auto slot = slots_[index];
+      old_list[slot] = old_list.back();
+      slots_[old_list[slot]] = slot;
+      old_list.pop_back();
+      listed = false;
+    }
+    if (!listed) {
+      auto& new_list = by_type_[value.index()];
+      slots_[index] = new_list.size();
+      new_list.push_back(index);
+    }
+    vars_[index] = std::move(value);
+    defined_[index] = true;
+  }
+
+  /**
+   * Write an assignment to a variable.
+   *
+   * Once defined, a numeric variable may be updated with a compound
+   * assignment, which promotes as the corresponding binary operation would.
+   *
+   * @param index Variable index
+   * @returns `true` on success, `false` on write error
+   */
+  bool assign(std::size_t index)
+  {
+    auto name = "v" + std::to_string(index);
+    // compound assignment of a numeric variable
+    if (
+      defined_[index] &&
+      !std::holds_alternative<bool>(vars_[index]) &&
+      chance(0.5)
+    ) {
+      gen_expr var{name, vars_[index], true};
+      auto expr = numeric_expr(options_.depth);
+      gen_value value;
+      const char* op = nullptr;
+      // integral result
+      if (
+        std::holds_alternative<long>(var.value) &&
+        std::holds_alternative<long>(expr.value)
+      ) {
+        auto l = std::get<long>(var.value);
+        auto r = std::get<long>(expr.value);
+        auto fits = [](long v) { return std::abs(v) <= long_bound; };
+        switch (uniform(4)) {
+          case 0:
+            op = fits(l + r) ? "+=" : nullptr;
+            value = l + r;
+            break;
+          case 1:
+            op = fits(l - r) ? "-=" : nullptr;
+            value = l - r;
+            break;
+          case 2:
+            op = fits(l * r) ? "*=" : nullptr;
+            value = l * r;
+            break;
+          default:
+            op = r ? "/=" : nullptr;
+            value = r ? l / r : 0L;
+        }
+      }
+      // floating result
+      else {
+        auto l = as_double(var.value);
+        auto r = as_double(expr.value);
+        double v;
+        switch (uniform(4)) {
+          case 0:
+            v = l + r;
+            op = "+=";
+            break;
+          case 1:
+            v = l - r;
+            op = "-=";
+            break;
+          case 2:
+            v = l * r;
+            op = "*=";
+            break;
+          default:
+            v = (r != 0.) ? l / r : 0.;
+            op = (r != 0.) ? "/=" : nullptr;
+        }
+        if (!std::isfinite(v) || std::abs(v) > double_bound)
+          op = nullptr;
+        value = v;
+      }
+      if (op) {
+        text_ += name + " " + op + " " + expr.text + ";\n";
+        set_variable(index, std::move(value));
+        return flush();
+      }
+    }
+    // otherwise plain assignment, possibly changing the type
+    auto expr = any_expr(options_.depth);
+    text_ += name + " = " + expr.text + ";\n";
+    set_variable(index, std::move(expr.value));
+    return flush();
+  }
+
+  /**
+   * Write a statement printing a result with its expected result comment.
+   *
+   * @returns `true` on success, `false` on write error
+   */
+  bool print()
+  {
+    gen_expr expr;
+    switch (pick(
+      {options_.mix[arithmetic], options_.mix[bitwise], options_.mix[boolean],
+        options_.mix[function]}
+    )) {
+      case arithmetic:
+        expr = numeric_expr(options_.depth);
+        break;
+      case bitwise:
+        expr = integral_expr(options_.depth);
+        break;
+      case boolean:
+        expr = boolean_expr(options_.depth);
+        break;
+      default:
+        expr = floating_expr(options_.depth);
+    }
+    text_ += "# <";
+    text_ += type_name(expr.value);
+    text_ += "> ";
+    append_value(text_, expr.value);
+    text_ += "\n" + expr.text + ";\n";
+    return flush();
+  }
+};
+
+/**
+ * Parse an unsigned integral option value.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param name Option name used in error messages
+ * @param value Option value
+ * @param out Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+template <typename T>
+bool parse_unsigned(std::string_view name, std::string_view value, T& out)
+{
+  auto last = value.data() + value.size();
+  auto [end, ec] = std::from_chars(value.data(), last, out);
+  if (value.empty() || ec != std::errc{} || end != last) {
+    std::cerr << progname << ": " << name <<
+      " requires a nonnegative integer, got '" << value << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse a probability or tolerance option value.
+ *
+ * @param name Option name used in error messages
+ * @param value Option value
+ * @param max Maximum allowed value
+ * @param out Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_fraction(
+  std::string_view name, const std::string& value, double max, double& out)
+{
+  char* end;
+  errno = 0;
+  auto x = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end || errno == ERANGE || !(x >= 0. && x <= max)) {
+    std::cerr << progname << ": " << name << " requires a number in [0, " <<
+      max << "], got '" << value << "'" << std::endl;
+    return false;
+  }
+  out = x;
+  return true;
+}
+
+/**
+ * Parse the operation mix option value.
+ *
+ * @param value Option value, four comma-separated nonnegative integers
+ * @param options Generator settings to update
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_mix(std::string_view value, gen_options& options)
+{
+  for (std::size_t i = 0; i < options.mix.size(); i++) {
+    auto comma = value.find(',');
+    // must have exactly 4 values
+    if ((i + 1 < options.mix.size()) == (comma == value.npos)) {
+      std::cerr << progname << ": --mix requires 4 comma-separated weights" <<
+        std::endl;
+      return false;
+    }
+    if (!parse_unsigned("--mix", value.substr(0, comma), options.mix[i]))
+      return false;
+    value.remove_prefix((comma == value.npos) ? value.size() : comma + 1);
+  }
+  return true;
+}
+
+/**
+ * Parsed expected result or output line.
+ */
+struct result_line {
+  std::string_view type;   // type name
+  std::string_view value;  // value text
+};
+
+/**
+ * Parse a result written by pdcalc as `<type> value`.
+ *
+ * The value ends at the first blank or comma. The `<error>` written for a
+ * failed statement by pdcalc --keep-going is a result with an empty value.
+ *
+ * @param line Line, with any trailing text after the value ignored
+ * @param result Result to write to on success
+ * @returns `true` on success, `false` if the line is not a result
+ */
+bool parse_result(std::string_view line, result_line& result)
+{
+  if (line.empty() || line[0] != '<')
+    return false;
+  auto close = line.find('>');
+  if (close == line.npos)
+    return false;
+  result.type = line.substr(1, close - 1);
+  if (result.type == "error") {
+    result.value = line.substr(close + 1, 0);
+    return close + 1 == line.size() ||
+      std::string_view{" \t\r,"}.find(line[close + 1]) != line.npos;
+  }
+  if (close + 1 >= line.size() || line[close + 1] != ' ')
+    return false;
+  if (result.type != "bool" && result.type != "long" && result.type != "double")
+    return false;
+  auto value = line.substr(close + 2);
+  result.value = value.substr(0, value.find_first_of(" \t\r,"));
+  return !result.value.empty();
+}
+
+/**
+ * Parse the expected results in a comment line.
+ *
+ * A line can have more than one expected result separated by commas, e.g.
+ * `# <long> 5, <double> 13.377`, for lines with more than one statement.
+ *
+ * @param line Program line
+ * @param results Vector to write the results to, cleared first
+ */
+void parse_expected(std::string_view line, std::vector<result_line>& results)
+{
+  results.clear();
+  auto start = line.find_first_not_of(" \t");
+  if (start == line.npos || line.substr(start, 2) != "# ")
+    return;
+  line.remove_prefix(start + 2);
+  result_line result;
+  while (parse_result(line, result)) {
+    results.push_back(result);
+    // rest of the line must start with ", <" for another result
+    line.remove_prefix(
+      static_cast<std::size_t>(result.value.data() - line.data()) +
+      result.value.size()
+    );
+    if (line.substr(0, 3) != ", <")
+      break;
+    line.remove_prefix(2);
+  }
+}
+
+/**
+ * Return `true` if an actual result matches the expected result.
+ *
+ * @param expected Expected result
+ * @param actual Actual result
+ * @param rtol Relative tolerance for doubles
+ */
+bool result_matches(
+  const result_line& expected, const result_line& actual, double rtol)
+{
+  if (expected.type != actual.type)
+    return false;
+  if (expected.type != "double")
+    return expected.value == actual.value;
+  // strtod also accepts inf and nan as written by pdcalc
+  auto x = std::strtod(std::string{expected.value}.c_str(), nullptr);
+  auto y = std::strtod(std::string{actual.value}.c_str(), nullptr);
+  if (x == y || (std::isnan(x) && std::isnan(y)))
+    return true;
+  return std::abs(x - y) <= rtol * std::max(std::abs(x), std::abs(y));
+}
+
+/**
+ * Check pdcalc output against the expected results in a program.
+ *
+ * Lines of the program of the form `# <type> value`, possibly indented and
+ * possibly followed by more text or more comma-separated results, give the
+ * expected results in order, and each line of the output must be the
+ * corresponding result.
+ *
+ * @param options Checker settings
+ * @returns `EXIT_SUCCESS` if all results match, `EXIT_FAILURE` otherwise
+ */
+int check(const check_options& options)
+{
+  std::ifstream program{options.program};
+  if (!program) {
+    std::cerr << progname << ": Error opening " << options.program << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto use_stdin = options.output.empty() || options.output == "-";
+  std::ifstream output_file;
+  if (!use_stdin) {
+    output_file.open(options.output);
+    if (!output_file) {
+      std::cerr << progname << ": Error opening " << options.output <<
+        std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::istream& output = use_stdin ? std::cin : output_file;
+  const std::string output_name = use_stdin ? "stdin" : options.output;
+  // line numbers + number of results + number of mismatches
+  std::uint64_t program_line_no = 0;
+  std::uint64_t output_line_no = 0;
+  std::uint64_t n_results = 0;
+  std::uint64_t n_mismatches = 0;
+  // only the first few mismatches are reported
+  constexpr std::uint64_t max_reported = 10;
+  std::string program_line;
+  std::string output_line;
+  std::vector<result_line> expected_results;
+  while (std::getline(program, program_line)) {
+    program_line_no++;
+    // expected result comments
+    parse_expected(program_line, expected_results);
+    for (const auto& expected : expected_results) {
+      n_results++;
+      // corresponding output line
+      if (!std::getline(output, output_line)) {
+        std::cerr << progname << ": " << output_name << " ended after " <<
+          output_line_no << " results, expected <" << expected.type << "> " <<
+          expected.value << " from " << options.program << ":" <<
+          program_line_no << std::endl;
+        return EXIT_FAILURE;
+      }
+      output_line_no++;
+      result_line actual;
+      if (
+        !parse_result(output_line, actual) ||
+        !result_matches(expected, actual, options.rtol)
+      ) {
+        if (n_mismatches++ < max_reported)
+          std::cerr << progname << ": " << options.program << ":" <<
+            program_line_no << ": expected <" << expected.type << "> " <<
+            expected.value << ", got '" << output_line << "' on " <<
+            output_name << ":" << output_line_no << std::endl;
+      }
+    }
+  }
+  if (program.bad()) {
+    std::cerr << progname << ": Error reading " << options.program << std::endl;
+    return EXIT_FAILURE;
+  }
+  // all output must have been expected
+  if (std::getline(output, output_line)) {
+    std::cerr << progname << ": " << output_name << " has more than the " <<
+      n_results << " expected results" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (n_mismatches) {
+    std::cerr << progname << ": " << n_mismatches << " of " << n_results <<
+      " results do not match" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << progname << ": " << n_results << " results match" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  gen_options gen;
+  check_options checker;
+  auto checking = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg{argv[i]};
+    // help option
+    if (arg == "-h" || arg == "--help") {
+      std::cout << program_usage << std::endl;
+      return EXIT_SUCCESS;
+    }
+    // generator options
+    else if (arg.substr(0, 7) == "--seed=") {
+      if (!parse_unsigned("--seed", std::string_view{arg}.substr(7), gen.seed))
+        return EXIT_FAILURE;
+    }
+    else if (arg == "-n") {
+      if (i + 1 >= argc) {
+        std::cerr << progname << ": -n requires an argument" << std::endl;
+        return EXIT_FAILURE;
+      }
+      if (!parse_unsigned("-n", argv[++i], gen.n_statements))
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 13) == "--statements=") {
+      if (
+        !parse_unsigned(
+          "--statements", std::string_view{arg}.substr(13), gen.n_statements
+        )
+      )
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 6) == "--mix=") {
+      if (!parse_mix(std::string_view{arg}.substr(6), gen))
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 8) == "--depth=") {
+      if (
+        !parse_unsigned("--depth", std::string_view{arg}.substr(8), gen.depth)
+      )
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 7) == "--vars=") {
+      if (
+        !parse_unsigned("--vars", std::string_view{arg}.substr(7), gen.n_vars)
+      )
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 9) == "--rebind=") {
+      if (!parse_fraction("--rebind", arg.substr(9), 1., gen.rebind))
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 11) == "--comments=") {
+      if (!parse_fraction("--comments", arg.substr(11), 1., gen.comments))
+        return EXIT_FAILURE;
+    }
+    // checker options
+    else if (arg.substr(0, 8) == "--check=") {
+      checker.program = arg.substr(8);
+      checking = true;
+    }
+    else if (arg.substr(0, 7) == "--rtol=") {
+      if (!parse_fraction("--rtol", arg.substr(7), 1., checker.rtol))
+        return EXIT_FAILURE;
+    }
+    // output to check. "-" is stdin
+    else if (
+      checking && checker.output.empty() && (arg == "-" || arg[0] != '-')
+    )
+      checker.output = arg;
+    // unknown option
+    else {
+      std::cerr << "Error: Unknown option '" << arg << "'. Try " << progname <<
+        " --help for usage." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (checking)
+    return check(checker);
+  return generator{gen}() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,673 @@
+/**
+ * @file pdcalc_loadgen.cc
+ * @author Derek Huang
+ * @brief Main source file for the pdcalc server load generator and client
+ * @copyright MIT License
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "calc_frame.hh"
+
+namespace {
+
+// program name + program usage
+const std::string progname{"pdcalc_loadgen"};
+const std::string program_usage{
+  "Usage: " + progname + " [-h] [--socket=PATH] [--spawn=PDCALC [-j N]]\n"
+  "       [--clients=N[,N...]] [--requests=N] [--program=FILE]\n"
+  "       [-- SERVER_OPTION...]\n"
+  "       " + progname + " [--socket=PATH] [--spawn=PDCALC] FILE...\n"
+  "       [-- SERVER_OPTION...]\n"
+  "\n"
+  "Measures the throughput and latency of a pdcalc --serve server, or sends\n"
+  "programs to it and writes the results to stdout.\n"
+  "\n"
+  "For each client count, that many clients connect at once and each sends\n"
+  "the same program as a request the given number of times, waiting for the\n"
+  "reply to each before sending the next. The requests per second and the\n"
+  "50th and 99th percentile request latencies over all clients are reported\n"
+  "for each client count. Any error reply is a failure.\n"
+  "\n"
+  "If FILE arguments are given, each FILE is instead sent as a request in\n"
+  "order on one connection, so later files see the symbols of earlier ones,\n"
+  "as with pdcalc FILE.... Sending stops at the first error reply.\n"
+  "\n"
+  "Options:\n"
+  "  -h, --help          Print this usage\n"
+  "\n"
+  "  --socket=PATH       Server socket path. Required unless --spawn is\n"
+  "                      given, where it defaults to a path in the temp\n"
+  "                      directory.\n"
+  "  --spawn=PDCALC      Start PDCALC --serve on the socket before connecting\n"
+  "                      and stop it with SIGTERM when done. Stopping it must\n"
+  "                      succeed.\n"
+  "  -j N, --jobs=N      Number of server event loop threads with --spawn.\n"
+  "                      Default 1.\n"
+  "  -- SERVER_OPTION...\n"
+  "                      Pass the remaining arguments to PDCALC --serve with\n"
+  "                      --spawn, e.g. -- --lexer=simd.\n"
+  "  --clients=N[,N...]  Comma-separated client counts. Default 1,2,4,8.\n"
+  "  --requests=N        Requests sent by each client for each client count.\n"
+  "                      Default 1000.\n"
+  "  --program=FILE      Send the text of FILE in each request instead of the\n"
+  "                      default program of a few statements."
+};
+
+/**
+ * Program sent in each request by default.
+ *
+ * Every statement assigns from constants so that all replies are the same.
+ */
+constexpr std::string_view default_program{
+  "x = 3 + 2; y = 1.3 * (9.29 + 1);\n"
+  "z = (x * y - 111 + 2.111) / 4.5;\n"
+  "x * y + z;\n"
+  "sqrt(z * z) > 1 && x != 4;\n"
+};
+
+/**
+ * Load generator settings.
+ */
+struct loadgen_options {
+  std::string socket;                         // server socket path
+  std::string spawn;                          // pdcalc to start, if any
+  unsigned n_jobs = 1;                        // server threads with spawn
+  std::vector<unsigned> clients{1, 2, 4, 8};  // client counts
+  std::uint64_t n_requests = 1000;            // requests per client
+  std::string program{default_program};       // request text
+  std::vector<std::string> files;             // files to send instead
+  std::vector<std::string> server_args;       // extra spawn arguments
+};
+
+/**
+ * Parse an unsigned integral option value.
+ *
+ * @tparam T Unsigned integral type
+ *
+ * @param name Option name used in error messages
+ * @param value Option value
+ * @param out Value to write to on success
+ * @returns `true` on success, `false` otherwise
+ */
+template <typename T>
+bool parse_unsigned(std::string_view name, std::string_view value, T& out)
+{
+  auto last = value.data() + value.size();
+  auto [end, ec] = std::from_chars(value.data(), last, out);
+  if (value.empty() || ec != std::errc{} || end != last) {
+    std::cerr << progname << ": " << name <<
+      " requires a nonnegative integer, got '" << value << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse the comma-separated client counts.
+ *
+ * @param value Option value
+ * @param options Load generator settings to update
+ * @returns `true` on success, `false` otherwise
+ */
+bool parse_clients(std::string_view value, loadgen_options& options)
+{
+  options.clients.clear();
+  while (true) {
+    auto comma = value.find(',');
+    unsigned n_clients;
+    if (!parse_unsigned("--clients", value.substr(0, comma), n_clients))
+      return false;
+    if (!n_clients) {
+      std::cerr << progname << ": --clients counts must be positive" <<
+        std::endl;
+      return false;
+    }
+    options.clients.push_back(n_clients);
+    if (comma == value.npos)
+      return true;
+    value.remove_prefix(comma + 1);
+  }
+}
+
+/**
+ * Read a file into a string.
+ *
+ * @param path File path
+ * @param text String to write the contents to on success
+ * @returns `true` on success, `false` otherwise
+ */
+bool read_file(const std::string& path, std::string& text)
+{
+  std::ifstream stream{path, std::ios::binary};
+  if (!stream) {
+    std::cerr << progname << ": Error opening " << path << std::endl;
+    return false;
+  }
+  std::ostringstream contents;
+  contents << stream.rdbuf();
+  text = contents.str();
+  return true;
+}
+
+/**
+ * Blocking connection to a pdcalc server.
+ */
+class connection {
+public:
+  /**
+   * Default ctor.
+   *
+   * Not connected.
+   */
+  connection() noexcept = default;
+
+  /**
+   * Dtor.
+   *
+   * Closes the connection.
+   */
+  ~connection()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  /**
+   * Deleted copy ctor.
+   */
+  connection(const connection&) = delete;
+
+  /**
+   * Deleted copy assignment operator.
+   */
+  connection& operator=(const connection&) = delete;
+
+  /**
+   * Connect to the server.
+   *
+   * @param path Server socket path
+   * @returns `true` on success, `false` on failure with `errno` set
+   */
+  bool connect(const std::string& path) noexcept
+  {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+      errno = ENAMETOOLONG;
+      return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+      return false;
+    if (
+      ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof address)
+    ) {
+      auto error = errno;
+      ::close(fd_);
+      fd_ = -1;
+      errno = error;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Send a request and wait for its reply.
+   *
+   * @param text Program text
+   * @param reply String to write the reply payload to
+   * @returns Reply kind, empty if the connection failed
+   */
+  std::optional<pdcalc::calc_frame_kind>
+  request(std::string_view text, std::string& reply)
+  {
+    request_.clear();
+    pdcalc::calc_frame_append(request_, pdcalc::calc_frame_kind::eval, text);
+    if (!write(request_.data(), request_.size()))
+      return {};
+    char header[pdcalc::calc_frame_header_size];
+    if (!read(header, sizeof header))
+      return {};
+    auto [kind, size] = pdcalc::calc_frame_decode(header);
+    reply.resize(size);
+    if (!read(reply.data(), size))
+      return {};
+    return kind;
+  }
+
+private:
+  int fd_ = -1;
+  std::string request_;
+
+  /**
+   * Write all the given bytes.
+   *
+   * @param data Bytes to write
+   * @param size Number of bytes
+   * @returns `true` on success, `false` on failure
+   */
+  bool write(const char* data, std::size_t size) noexcept
+  {
+    while (size) {
+      auto n_sent = ::send(fd_, data, size, MSG_NOSIGNAL);
+      if (n_sent < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n_sent;
+      size -= static_cast<std::size_t>(n_sent);
+    }
+    return true;
+  }
+
+  /**
+   * Read exactly the given number of bytes.
+   *
+   * @param data Buffer to read into
+   * @param size Number of bytes
+   * @returns `true` on success, `false` on failure or end of stream
+   */
+  bool read(char* data, std::size_t size) noexcept
+  {
+    while (size) {
+      auto n_read = ::recv(fd_, data, size, 0);
+      if (n_read < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      if (!n_read)
+        return false;
+      data += n_read;
+      size -= static_cast<std::size_t>(n_read);
+    }
+    return true;
+  }
+};
+
+/**
+ * pdcalc server started as a child process.
+ */
+class spawned_server {
+public:
+  /**
+   * Ctor.
+   *
+   * Starts the server and waits for it to accept connections.
+   *
+   * @param options Load generator settings
+   */
+  explicit spawned_server(const loadgen_options& options)
+  {
+    auto serve_arg = "--serve=" + options.socket;
+    auto jobs_arg = "--jobs=" + std::to_string(options.n_jobs);
+    std::vector<const char*> argv{
+      options.spawn.c_str(), serve_arg.c_str(), jobs_arg.c_str()
+    };
+    for (const auto& arg : options.server_args)
+      argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+    pid_ = ::fork();
+    if (pid_ < 0) {
+      std::cerr << progname << ": Error starting " << options.spawn << ": " <<
+        std::strerror(errno) << std::endl;
+      return;
+    }
+    if (!pid_) {
+      ::execv(argv[0], const_cast<char* const*>(argv.data()));
+      ::_exit(127);
+    }
+    // poll until a connection succeeds or the server exits
+    for (int i = 0; i < 1000; i++) {
+      int status;
+      if (::waitpid(pid_, &status, WNOHANG) == pid_) {
+        std::cerr << progname << ": " << options.spawn <<
+          " exited before accepting connections" << std::endl;
+        pid_ = -1;
+        return;
+      }
+      if (connection{}.connect(options.socket)) {
+        ready_ = true;
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    std::cerr << progname << ": " << options.spawn <<
+      " did not accept connections" << std::endl;
+  }
+
+  /**
+   * Dtor.
+   *
+   * Stops the server if it was not already stopped.
+   */
+  ~spawned_server() { stop(); }
+
+  /**
+   * Deleted copy ctor.
+   */
+  spawned_server(const spawned_server&) = delete;
+
+  /**
+   * Deleted copy assignment operator.
+   */
+  spawned_server& operator=(const spawned_server&) = delete;
+
+  /**
+   * Return `true` if the server is accepting connections.
+   */
+  bool ready() const noexcept { return ready_; }
+
+  /**
+   * Stop the server with `SIGTERM` and wait for it to exit.
+   *
+   * @returns `true` if the server exited successfully
+   */
+  bool stop() noexcept
+  {
+    if (pid_ < 0)
+      return false;
+    ::kill(pid_, SIGTERM);
+    int status;
+    while (::waitpid(pid_, &status, 0) < 0 && errno == EINTR)
+      ;
+    pid_ = -1;
+    ready_ = false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+  }
+
+private:
+  pid_t pid_ = -1;
+  bool ready_ = false;
+};
+
+/**
+ * Send each file as a request on one connection and write the results.
+ *
+ * @param options Load generator settings
+ * @returns `EXIT_SUCCESS` if all requests succeed, `EXIT_FAILURE` otherwise
+ */
+int send_files(const loadgen_options& options)
+{
+  connection conn;
+  if (!conn.connect(options.socket)) {
+    std::cerr << progname << ": Error connecting to " << options.socket <<
+      ": " << std::strerror(errno) << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::string text;
+  std::string reply;
+  for (const auto& file : options.files) {
+    if (!read_file(file, text))
+      return EXIT_FAILURE;
+    auto kind = conn.request(text, reply);
+    if (kind == pdcalc::calc_frame_kind::output) {
+      std::cout << reply << std::flush;
+      continue;
+    }
+    if (kind != pdcalc::calc_frame_kind::error) {
+      std::cerr << progname << ": Connection to " << options.socket <<
+        " failed" << std::endl;
+      return EXIT_FAILURE;
+    }
+    // error message is the last line, after the results before the error
+    std::string_view results{reply};
+    results.remove_suffix(!results.empty());
+    results = results.substr(0, results.rfind('\n') + 1);
+    std::cout << results << std::flush;
+    std::cerr << progname << ": " << reply.substr(results.size()) <<
+      std::flush;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Result of one load level.
+ */
+struct level_result {
+  double seconds;                       // wall time for all requests
+  std::vector<std::uint64_t> latencies;  // request latencies in ns
+  std::uint64_t n_errors;               // error replies + failed requests
+};
+
+/**
+ * Run one load level with the given number of concurrent clients.
+ *
+ * All clients connect before any sends a request so that connection setup
+ * is not part of the measured time.
+ *
+ * @param options Load generator settings
+ * @param n_clients Number of clients
+ */
+level_result run_level(const loadgen_options& options, unsigned n_clients)
+{
+  using clock = std::chrono::steady_clock;
+  std::vector<std::vector<std::uint64_t>> latencies(n_clients);
+  std::atomic<std::uint64_t> n_errors{0};
+  std::atomic<unsigned> n_connected{0};
+  std::atomic<bool> start{false};
+  auto client = [&](unsigned index)
+  {
+    connection conn;
+    auto connected = conn.connect(options.socket);
+    n_connected++;
+    while (!start)
+      std::this_thread::yield();
+    if (!connected) {
+      n_errors += options.n_requests;
+      return;
+    }
+    auto& times = latencies[index];
+    times.reserve(options.n_requests);
+    std::string reply;
+    for (std::uint64_t i = 0; i < options.n_requests; i++) {
+      auto begin = clock::now();
+      auto kind = conn.request(options.program, reply);
+      auto end = clock::now();
+      // the rest of the requests are lost if the connection failed
+      if (!kind) {
+        n_errors += options.n_requests - i;
+        return;
+      }
+      if (*kind != pdcalc::calc_frame_kind::output)
+        n_errors++;
+      times.push_back(
+        static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            end - begin
+          ).count()
+        )
+      );
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < n_clients; i++)
+    threads.emplace_back(client, i);
+  while (n_connected < n_clients)
+    std::this_thread::yield();
+  auto begin = clock::now();
+  start = true;
+  for (auto& thread : threads)
+    thread.join();
+  auto end = clock::now();
+  level_result result{
+    std::chrono::duration<double>{end - begin}.count(), {}, n_errors
+  };
+  for (const auto& times : latencies)
+    result.latencies.insert(
+      result.latencies.end(), times.begin(), times.end()
+    );
+  std::sort(result.latencies.begin(), result.latencies.end());
+  return result;
+}
+
+/**
+ * Return a latency percentile in microseconds using the nearest rank.
+ *
+ * @param latencies Sorted nonempty latencies in nanoseconds
+ * @param percent Percentile in (0, 100]
+ */
+double percentile(const std::vector<std::uint64_t>& latencies, double percent)
+{
+  auto rank = static_cast<std::size_t>(
+    percent / 100 * static_cast<double>(latencies.size()) + 0.999999
+  );
+  auto index = std::min(std::max(rank, std::size_t{1}), latencies.size()) - 1;
+  return static_cast<double>(latencies[index]) / 1000;
+}
+
+/**
+ * Run all load levels and write the throughput and latency of each.
+ *
+ * @param options Load generator settings
+ * @returns `EXIT_SUCCESS` if all requests succeed, `EXIT_FAILURE` otherwise
+ */
+int run_load(const loadgen_options& options)
+{
+  std::cout << progname << ": " << options.n_requests << " requests of " <<
+    options.program.size() << " bytes per client to " << options.socket <<
+    "\n" << std::setw(8) << "clients" << std::setw(12) << "requests" <<
+    std::setw(12) << "req/s" << std::setw(12) << "p50 (us)" <<
+    std::setw(12) << "p99 (us)" << std::setw(10) << "errors" << std::endl;
+  std::uint64_t n_errors = 0;
+  for (auto n_clients : options.clients) {
+    auto result = run_level(options, n_clients);
+    auto n_done = result.latencies.size();
+    std::cout << std::setw(8) << n_clients << std::setw(12) << n_done <<
+      std::fixed << std::setprecision(1) << std::setw(12) <<
+      (result.seconds > 0 ? static_cast<double>(n_done) / result.seconds : 0.);
+    if (n_done)
+      std::cout << std::setw(12) << percentile(result.latencies, 50) <<
+        std::setw(12) << percentile(result.latencies, 99);
+    else
+      std::cout << std::setw(12) << "-" << std::setw(12) << "-";
+    std::cout << std::setw(10) << result.n_errors << std::defaultfloat <<
+      std::endl;
+    n_errors += result.n_errors;
+  }
+  if (n_errors) {
+    std::cerr << progname << ": " << n_errors << " requests failed" <<
+      std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  loadgen_options options;
+  std::string program_file;
+  for (int i = 1; i < argc; i++) {
+    std::string arg{argv[i]};
+    // help option
+    if (arg == "-h" || arg == "--help") {
+      std::cout << program_usage << std::endl;
+      return EXIT_SUCCESS;
+    }
+    // server options
+    else if (arg.substr(0, 9) == "--socket=")
+      options.socket = arg.substr(9);
+    else if (arg.substr(0, 8) == "--spawn=")
+      options.spawn = arg.substr(8);
+    else if (arg == "-j") {
+      if (i + 1 >= argc) {
+        std::cerr << progname << ": -j requires an argument" << std::endl;
+        return EXIT_FAILURE;
+      }
+      if (!parse_unsigned("-j", argv[++i], options.n_jobs))
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 7) == "--jobs=") {
+      auto value = std::string_view{arg}.substr(7);
+      if (!parse_unsigned("--jobs", value, options.n_jobs))
+        return EXIT_FAILURE;
+    }
+    // load options
+    else if (arg.substr(0, 10) == "--clients=") {
+      if (!parse_clients(std::string_view{arg}.substr(10), options))
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 11) == "--requests=") {
+      if (
+        !parse_unsigned(
+          "--requests", std::string_view{arg}.substr(11), options.n_requests
+        )
+      )
+        return EXIT_FAILURE;
+    }
+    else if (arg.substr(0, 10) == "--program=")
+      program_file = arg.substr(10);
+    // remaining arguments are server options
+    else if (arg == "--") {
+      options.server_args.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    // files to send
+    else if (arg.size() && arg[0] != '-')
+      options.files.push_back(arg);
+    // unknown option
+    else {
+      std::cerr << "Error: Unknown option '" << arg << "'. Try " << progname <<
+        " --help for usage." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (!program_file.empty() && !read_file(program_file, options.program))
+    return EXIT_FAILURE;
+  // socket path is required unless we start the server ourselves
+  if (options.socket.empty()) {
+    if (options.spawn.empty()) {
+      std::cerr << progname << ": --socket is required without --spawn" <<
+        std::endl;
+      return EXIT_FAILURE;
+    }
+    options.socket = (
+      std::filesystem::temp_directory_path() /
+      (progname + "." + std::to_string(::getpid()) + ".sock")
+    ).string();
+  }
+  if (options.spawn.empty())
+    return options.files.empty() ? run_load(options) : send_files(options);
+  spawned_server server{options};
+  if (!server.ready())
+    return EXIT_FAILURE;
+  auto status = options.files.empty() ? run_load(options) : send_files(options);
+  if (!server.stop()) {
+    std::cerr << progname << ": " << options.spawn <<
+      " did not shut down cleanly" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return status;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file pdcalc_read.cc
+ * @author Derek Huang
+ * @brief Main source file for the pdcalc binary result reader
+ * @copyright MIT License
+ */
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif  // defined(_WIN32)
+
+#include "pdcalc/calc_binary_format.hh"
+
+namespace {
+
+// program name + program usage
+const std::string progname{"pdcalc_read"};
+const std::string program_usage{
+  "Usage: " + progname + " [-h] [--shortest] [--locations] [FILE...]\n"
+  "\n"
+  "Converts the binary output of pdcalc --output-format=binary to the text\n"
+  "output pdcalc would have written, e.g. <long> 5, and writes it to stdout.\n"
+  "\n"
+  "Each FILE is read in order, or stdin if there are none or FILE is -. The\n"
+  "record layout is described in pdcalc/calc_binary_format.hh.\n"
+  "\n"
+  "Options:\n"
+  "  -h, --help          Print this usage\n"
+  "\n"
+  "  --shortest          Write each double with the fewest digits that read\n"
+  "                      back as the same value, as pdcalc --shortest does,\n"
+  "                      instead of with 6 significant digits.\n"
+  "  --locations         Prefix each result with the line and the statement\n"
+  "                      index of the statement in its input, e.g.\n"
+  "                      3:1: <long> 5. Requires output written with pdcalc\n"
+  "                      --output-locations."
+};
+
+/**
+ * Reader settings.
+ */
+struct read_options {
+  bool shortest = false;           // shortest round-trip doubles
+  bool locations = false;          // prefix results with their location
+  std::vector<std::string> files;  // binary outputs, "-" for stdin
+};
+
+/**
+ * Append a value formatted with `std::to_chars` to a buffer.
+ *
+ * @tparam F Callable taking `(char* first, char* last)` and returning the
+ *  `std::to_chars_result` from formatting the value into `[first, last)`
+ *
+ * @param buffer Buffer to append to
+ * @param format Callable formatting the value
+ */
+template <typename F>
+void append_chars(std::string& buffer, F format)
+{
+  // large enough for any 64-bit integer or double with 6 or 17 digits
+  char chars[64];
+  auto [ptr, ec] = format(chars, chars + sizeof chars);
+  if (ec == std::errc{})
+    buffer.append(chars, static_cast<std::size_t>(ptr - chars));
+}
+
+/**
+ * Append the text line of a record to a buffer.
+ *
+ * @param buffer Buffer to append to
+ * @param record Record
+ * @param options Reader settings
+ */
+void append_record(
+  std::string& buffer,
+  const pdcalc::calc_binary_record& record,
+  const read_options& options)
+{
+  if (options.locations) {
+    append_chars(
+      buffer,
+      [&record](char* first, char* last)
+      {
+        return std::to_chars(first, last, record.line);
+      }
+    );
+    buffer += ':';
+    append_chars(
+      buffer,
+      [&record](char* first, char* last)
+      {
+        return std::to_chars(first, last, record.statement);
+      }
+    );
+    buffer += ": ";
+  }
+  switch (record.tag) {
+    case pdcalc::calc_binary_tag::bool_value:
+      buffer += record.bits ? "<bool> true" : "<bool> false";
+      break;
+    case pdcalc::calc_binary_tag::long_value:
+      buffer += "<long> ";
+      append_chars(
+        buffer,
+        [&record](char* first, char* last)
+        {
+          return std::to_chars(
+            first, last, static_cast<std::int64_t>(record.bits)
+          );
+        }
+      );
+      break;
+    case pdcalc::calc_binary_tag::double_value:
+      buffer += "<double> ";
+      append_chars(
+        buffer,
+        [&record, &options](char* first, char* last)
+        {
+          auto value = pdcalc::calc_binary_double(record.bits);
+          // same formats as pdcalc with default stream precision
+          if (options.shortest)
+            return std::to_chars(first, last, value);
+          return std::to_chars(
+            first, last, value, std::chars_format::general, 6
+          );
+        }
+      );
+      break;
+    case pdcalc::calc_binary_tag::error:
+      buffer += "<error>";
+      break;
+  }
+  buffer += '\n';
+}
+
+/**
+ * Convert a binary output to text and write it to stdout.
+ *
+ * The whole output is read and validated before any text is written.
+ *
+ * @param file Binary output path, "-" for stdin
+ * @param options Reader settings
+ * @returns `true` on success, `false` on failure
+ */
+bool read_file(const std::string& file, const read_options& options)
+{
+  // read whole contents
+  auto use_stdin = file == "-";
+  const std::string name = use_stdin ? "stdin" : file;
+  std::ifstream in;
+  if (!use_stdin) {
+    in.open(file, std::ios::binary);
+    if (!in) {
+      std::cerr << progname << ": Error opening " << file << std::endl;
+      return false;
+    }
+  }
+  std::ostringstream contents;
+  contents << (use_stdin ? std::cin.rdbuf() : in.rdbuf());
+  auto data = contents.str();
+  // check header
+  auto header = pdcalc::calc_binary_peek(data);
+  if (!header) {
+    std::cerr << progname << ": " << name << " is not pdcalc binary output" <<
+      std::endl;
+    return false;
+  }
+  if (header->version != pdcalc::calc_binary_version) {
+    std::cerr << progname << ": " << name << " has unsupported version " <<
+      header->version << std::endl;
+    return false;
+  }
+  if (header->flags & ~pdcalc::calc_binary_locations) {
+    std::cerr << progname << ": " << name << " has unsupported flags " <<
+      header->flags << std::endl;
+    return false;
+  }
+  if (options.locations && !(header->flags & pdcalc::calc_binary_locations)) {
+    std::cerr << progname << ": " << name << " has no statement locations" <<
+      std::endl;
+    return false;
+  }
+  auto record_size = pdcalc::calc_binary_record_size(header->flags);
+  auto records_size = data.size() - pdcalc::calc_binary_header_size;
+  if (records_size % record_size) {
+    std::cerr << progname << ": " << name << " is truncated" << std::endl;
+    return false;
+  }
+  // convert records
+  std::string text;
+  for (
+    auto offset = pdcalc::calc_binary_header_size;
+    offset < data.size();
+    offset += record_size
+  ) {
+    auto record =
+      pdcalc::calc_binary_decode(data.data() + offset, header->flags);
+    if (record.tag > pdcalc::calc_binary_tag::error) {
+      std::cerr << progname << ": " << name << " has a record with unknown " <<
+        "tag " << static_cast<unsigned>(record.tag) << " at offset " <<
+        offset << std::endl;
+      return false;
+    }
+    append_record(text, record, options);
+  }
+  std::cout << text << std::flush;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  read_options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg{argv[i]};
+    // help option
+    if (arg == "-h" || arg == "--help") {
+      std::cout << program_usage << std::endl;
+      return EXIT_SUCCESS;
+    }
+    else if (arg == "--shortest")
+      options.shortest = true;
+    else if (arg == "--locations")
+      options.locations = true;
+    // binary output to read. "-" is stdin
+    else if (arg == "-" || (arg.size() && arg[0] != '-'))
+      options.files.push_back(arg);
+    // unknown option
+    else {
+      std::cerr << "Error: Unknown option '" << arg << "'. Try " << progname <<
+        " --help for usage." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (options.files.empty())
+    options.files.emplace_back("-");
+#if defined(_WIN32)
+  // stdin must not translate CRLF line endings in binary output
+  _setmode(_fileno(stdin), _O_BINARY);
+#endif  // defined(_WIN32)
+  for (const auto& file : options.files) {
+    if (!read_file(file, options))
+      return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
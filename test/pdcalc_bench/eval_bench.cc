@@ -0,0 +1,193 @@
+/**
+ * @file eval_bench.cc
+ * @author Derek Huang
+ * @brief calc_parser.hh statement evaluation backend benchmarks
+ * @copyright MIT License
+ */
+
+#include <cstdint>
+#include <ostream>
+
+#include <benchmark/benchmark.h>
+
+#include "pdcalc/calc_parser.hh"
+#include "sample_workload.hh"
+
+namespace {
+
+using pdcalc::bench::sample_workload;
+
+/**
+ * Benchmark parsing and evaluating the workload with the given backend.
+ *
+ * Output is discarded so that only lexing, parsing, and evaluation are timed.
+ *
+ * @param state Benchmark state
+ * @param backend Evaluation backend
+ */
+void parse_workload(benchmark::State& state, pdcalc::calc_backend backend)
+{
+  const auto& text = sample_workload();
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.backend(backend);
+  for (auto _ : state) {
+    if (!parser(pdcalc::calc_source{text, "workload"})) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * text.size())
+  );
+}
+
+/**
+ * Benchmark evaluating the compiled workload with the given backend.
+ *
+ * The workload is compiled once so only statement evaluation is timed. For the
+ * VM backend the bytecode is compiled on the first run, before timing starts.
+ *
+ * @param state Benchmark state
+ * @param backend Evaluation backend
+ */
+void run_workload(benchmark::State& state, pdcalc::calc_backend backend)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.backend(backend);
+  if (
+    !parser.compile(pdcalc::calc_source{sample_workload(), "workload"}) ||
+    !parser.run()
+  ) {
+    state.SkipWithError(parser.last_error().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    if (!parser.run()) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+}
+
+/**
+ * Benchmark evaluating a single compiled formula with the given backend.
+ *
+ * This measures the per-evaluation cost of each backend without the
+ * statement output overhead, as the formula result is assigned to a symbol.
+ *
+ * @param state Benchmark state
+ * @param backend Evaluation backend
+ */
+void run_formula(benchmark::State& state, pdcalc::calc_backend backend)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.backend(backend);
+  parser.add_symbol("a", 0.5).add_symbol("b", 3L).add_symbol("c", 1.25);
+  if (
+    !parser.compile(
+      pdcalc::calc_source{
+        "y = (a * b + c) * (a - c / (b + 1)) + max(a, c) - "
+        "((b << 2) % 7) * sqrt(c);",
+        "formula"
+      }
+    ) ||
+    !parser.run()
+  ) {
+    state.SkipWithError(parser.last_error().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    if (!parser.run()) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Benchmark parsing the workload with tree-walking evaluation.
+ */
+void TreeParse(benchmark::State& state)
+{
+  parse_workload(state, pdcalc::calc_backend::tree);
+}
+
+/**
+ * Benchmark parsing the workload with register VM evaluation.
+ */
+void VmParse(benchmark::State& state)
+{
+  parse_workload(state, pdcalc::calc_backend::vm);
+}
+
+/**
+ * Benchmark running the compiled workload with tree-walking evaluation.
+ */
+void TreeRun(benchmark::State& state)
+{
+  run_workload(state, pdcalc::calc_backend::tree);
+}
+
+/**
+ * Benchmark running the compiled workload on the register VM.
+ */
+void VmRun(benchmark::State& state)
+{
+  run_workload(state, pdcalc::calc_backend::vm);
+}
+
+/**
+ * Benchmark parsing the workload with native code evaluation.
+ */
+void JitParse(benchmark::State& state)
+{
+  parse_workload(state, pdcalc::calc_backend::jit);
+}
+
+/**
+ * Benchmark running the compiled workload as native code.
+ */
+void JitRun(benchmark::State& state)
+{
+  run_workload(state, pdcalc::calc_backend::jit);
+}
+
+/**
+ * Benchmark evaluating a formula with tree-walking evaluation.
+ */
+void TreeFormula(benchmark::State& state)
+{
+  run_formula(state, pdcalc::calc_backend::tree);
+}
+
+/**
+ * Benchmark evaluating a formula on the register VM.
+ */
+void VmFormula(benchmark::State& state)
+{
+  run_formula(state, pdcalc::calc_backend::vm);
+}
+
+/**
+ * Benchmark evaluating a formula as native code.
+ */
+void JitFormula(benchmark::State& state)
+{
+  run_formula(state, pdcalc::calc_backend::jit);
+}
+
+}  // namespace
+
+BENCHMARK(TreeParse)->Unit(benchmark::kMillisecond);
+BENCHMARK(VmParse)->Unit(benchmark::kMillisecond);
+BENCHMARK(TreeRun)->Unit(benchmark::kMillisecond);
+BENCHMARK(VmRun)->Unit(benchmark::kMillisecond);
+BENCHMARK(JitParse)->Unit(benchmark::kMillisecond);
+BENCHMARK(JitRun)->Unit(benchmark::kMillisecond);
+BENCHMARK(TreeFormula);
+BENCHMARK(VmFormula);
+BENCHMARK(JitFormula);
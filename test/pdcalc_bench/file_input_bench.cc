@@ -0,0 +1,269 @@
+/**
+ * @file file_input_bench.cc
+ * @author Derek Huang
+ * @brief calc_parser.hh and pdcalc CLI file input throughput benchmarks
+ * @copyright MIT License
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <random>
+#include <string>
+#include <system_error>
+
+#include <benchmark/benchmark.h>
+
+#include "pdcalc/calc_parser.hh"
+#include "sample_workload.hh"
+
+#ifndef PDCALC_BENCH_CLI
+#define PDCALC_BENCH_CLI ""
+#endif  // PDCALC_BENCH_CLI
+
+namespace {
+
+/**
+ * Large generated input file that is removed on destruction.
+ *
+ * The default file size in MiB can be set with the `PDCALC_BENCH_INPUT_MB`
+ * environment variable and defaults to 16 MiB.
+ */
+class generated_input {
+public:
+  /**
+   * Ctor.
+   *
+   * Writes the default input file to the temporary directory.
+   */
+  generated_input() : path_{temp_path()}
+  {
+    // target size in bytes
+    std::size_t target_size = 16;
+    if (auto env_size = std::getenv("PDCALC_BENCH_INPUT_MB"))
+      if (auto value = std::strtoul(env_size, nullptr, 10); value)
+        target_size = value;
+    target_size <<= 20;
+    // statement block that is repeated until target size is reached. the
+    // assignments make subsequent blocks depend on the previous blocks
+    const std::string block{
+      "# generated input block\n"
+      "x = 3 + 2; y = 1.3 * (9.29 + 1);\n"
+      "z = (x * y - 111 + 2.111) / 4.5;\n"
+      "!!((2 + 3 - 19) == (-13 - 1)) && !(3 != 2);\n"
+      "x = x % 7 + (12 << 2) - (x >> 1);\n"
+      "y = y / 3.5 + z * 0.25 - 1.2;\n"
+      "x * y + z;\n"
+    };
+    std::ofstream stream{path_, std::ios::binary};
+    for (size_ = 0; size_ < target_size; size_ += block.size())
+      stream << block;
+    n_statements_ =
+      (size_ / block.size()) * pdcalc::bench::count_statements(block);
+  }
+
+  /**
+   * Ctor.
+   *
+   * Writes the given text as the input file to the temporary directory.
+   *
+   * @param text Input text
+   */
+  explicit generated_input(const std::string& text)
+    : path_{temp_path()},
+      size_{text.size()},
+      n_statements_{pdcalc::bench::count_statements(text)}
+  {
+    std::ofstream{path_, std::ios::binary} << text;
+  }
+
+  /**
+   * Dtor.
+   *
+   * Removes the input file, ignoring any errors.
+   */
+  ~generated_input()
+  {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+
+  /**
+   * Return the input file path.
+   */
+  const auto& path() const noexcept { return path_; }
+
+  /**
+   * Return the input file size in bytes.
+   */
+  auto size() const noexcept { return size_; }
+
+  /**
+   * Return the number of statements in the input file.
+   */
+  auto n_statements() const noexcept { return n_statements_; }
+
+private:
+  std::filesystem::path path_;
+  std::size_t size_;
+  std::size_t n_statements_;
+
+  /**
+   * Return a new input file path in the temporary directory.
+   */
+  static std::filesystem::path temp_path()
+  {
+    return std::filesystem::temp_directory_path() / (
+      "pdcalc_bench_input." + std::to_string(std::random_device{}()) + ".in"
+    );
+  }
+};
+
+/**
+ * Return the shared generated input, creating it on first use.
+ */
+const generated_input& bench_input()
+{
+  static const generated_input input;
+  return input;
+}
+
+/**
+ * Return the shared input of the repeated samples, creating it on first use.
+ */
+const generated_input& sample_input()
+{
+  static const generated_input input{pdcalc::bench::sample_workload()};
+  return input;
+}
+
+/**
+ * Set the byte and statement throughput for a benchmark over an input file.
+ *
+ * @param state Benchmark state
+ * @param input Input file parsed on each iteration
+ */
+void set_throughput(benchmark::State& state, const generated_input& input)
+{
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * input.size())
+  );
+  state.SetItemsProcessed(
+    static_cast<std::int64_t>(state.iterations() * input.n_statements())
+  );
+}
+
+/**
+ * Benchmark parsing an input file with the given input mode and lexer.
+ *
+ * Output is discarded so that only lexing, parsing, and evaluation are timed.
+ *
+ * @param state Benchmark state
+ * @param input Input file
+ * @param mode Input mode
+ * @param lexer Lexer to use
+ */
+void parse_file(
+  benchmark::State& state,
+  const generated_input& input,
+  pdcalc::calc_input_mode mode,
+  pdcalc::calc_lexer lexer = pdcalc::calc_lexer::flex)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.input_mode(mode).lexer(lexer);
+  for (auto _ : state) {
+    if (!parser(input.path())) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  set_throughput(state, input);
+}
+
+/**
+ * Benchmark parsing the generated input read through stdio.
+ */
+void StdioFileInput(benchmark::State& state)
+{
+  parse_file(state, bench_input(), pdcalc::calc_input_mode::stdio);
+}
+
+/**
+ * Benchmark parsing the generated input scanned from a memory mapping.
+ */
+void MmapFileInput(benchmark::State& state)
+{
+  parse_file(state, bench_input(), pdcalc::calc_input_mode::mmap);
+}
+
+/**
+ * Benchmark parsing the repeated samples read through stdio.
+ */
+void StdioSampleFile(benchmark::State& state)
+{
+  parse_file(state, sample_input(), pdcalc::calc_input_mode::stdio);
+}
+
+/**
+ * Benchmark parsing the repeated samples scanned from a memory mapping.
+ */
+void MmapSampleFile(benchmark::State& state)
+{
+  parse_file(state, sample_input(), pdcalc::calc_input_mode::mmap);
+}
+
+/**
+ * Benchmark parsing the mapped repeated samples with the SIMD scanner.
+ */
+void SimdSampleFile(benchmark::State& state)
+{
+  parse_file(
+    state,
+    sample_input(),
+    pdcalc::calc_input_mode::mmap,
+    pdcalc::calc_lexer::simd
+  );
+}
+
+/**
+ * Benchmark running the pdcalc CLI on the repeated samples.
+ *
+ * Each iteration starts a new process with stdout discarded, so this includes
+ * process startup and output formatting on top of parsing the file. As the
+ * work is done in the child process, wall time is used.
+ */
+void CliSampleFile(benchmark::State& state)
+{
+  if (!std::strlen(PDCALC_BENCH_CLI)) {
+    state.SkipWithError("pdcalc CLI path not defined");
+    return;
+  }
+  const auto& input = sample_input();
+  const auto command = "\"" PDCALC_BENCH_CLI "\" \"" + input.path().string() +
+#if defined(_WIN32)
+    "\" > NUL";
+#else
+    "\" > /dev/null";
+#endif  // !defined(_WIN32)
+  for (auto _ : state) {
+    if (std::system(command.c_str())) {
+      state.SkipWithError(("Command failed: " + command).c_str());
+      break;
+    }
+  }
+  set_throughput(state, input);
+}
+
+}  // namespace
+
+BENCHMARK(StdioFileInput)->Unit(benchmark::kMillisecond);
+BENCHMARK(MmapFileInput)->Unit(benchmark::kMillisecond);
+BENCHMARK(StdioSampleFile)->Unit(benchmark::kMillisecond);
+BENCHMARK(MmapSampleFile)->Unit(benchmark::kMillisecond);
+BENCHMARK(SimdSampleFile)->Unit(benchmark::kMillisecond);
+BENCHMARK(CliSampleFile)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,305 @@
+/**
+ * @file lexer_bench.cc
+ * @author Derek Huang
+ * @brief calc_parser.hh lexing benchmarks
+ * @copyright MIT License
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "pdcalc/calc_parser.hh"
+#include "sample_workload.hh"
+
+namespace {
+
+/**
+ * Number of literals in each generated input.
+ */
+constexpr std::size_t n_literals = 1 << 16;
+
+/**
+ * Kind of numeric literals in a generated input.
+ */
+enum class literal_kind {
+  // integers of up to 6 digits, handled by the short integer fast path
+  short_integral,
+  // integers of 18 to 19 digits, converted with std::from_chars
+  long_integral,
+  // decimals with up to 6 digits on each side of the point
+  floating
+};
+
+/**
+ * Return a literal-dense input of `n_literals` literal statements.
+ *
+ * Each statement is a single literal, possibly negative, with some statements
+ * adding two literals, so almost all of the input is literals. The input is
+ * the same on every call for a given kind.
+ *
+ * @param kind Kind of literals to generate
+ */
+std::string literal_input(literal_kind kind)
+{
+  std::mt19937_64 rng{static_cast<std::uint64_t>(kind) + 1};
+  std::uniform_int_distribution<long> short_dist{0, 999999};
+  std::uniform_int_distribution<long> long_dist{
+    100000000000000000L, 999999999999999999L
+  };
+  // literal text for the next value
+  auto next_literal = [&]() -> std::string
+  {
+    switch (kind) {
+      case literal_kind::short_integral:
+        return std::to_string(short_dist(rng));
+      case literal_kind::long_integral:
+        return std::to_string(long_dist(rng) * (1 + rng() % 9));
+      default:
+        return std::to_string(short_dist(rng)) + "." +
+          std::to_string(short_dist(rng));
+    }
+  };
+  std::string text;
+  for (std::size_t i = 0; i < n_literals; i++) {
+    // leading - is part of the literal
+    if (i % 3 == 0)
+      text += '-';
+    text += next_literal();
+    // every fourth statement adds another literal
+    if (i % 4 == 0) {
+      text += " + ";
+      text += next_literal();
+      i++;
+    }
+    text += ";\n";
+  }
+  return text;
+}
+
+/**
+ * Benchmark compiling a literal-dense input without evaluating it.
+ *
+ * Optimization is disabled so that the time is dominated by lexing.
+ *
+ * @param state Benchmark state
+ * @param kind Kind of literals to generate
+ */
+void compile_literals(benchmark::State& state, literal_kind kind)
+{
+  const auto text = literal_input(kind);
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.optimize(false);
+  for (auto _ : state) {
+    if (!parser.compile(pdcalc::calc_source{text, "literals"})) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * text.size())
+  );
+  state.SetItemsProcessed(
+    static_cast<std::int64_t>(state.iterations() * n_literals)
+  );
+}
+
+/**
+ * Benchmark lexing short integral literals.
+ */
+void ShortIntegralLiterals(benchmark::State& state)
+{
+  compile_literals(state, literal_kind::short_integral);
+}
+
+/**
+ * Benchmark lexing long integral literals.
+ */
+void LongIntegralLiterals(benchmark::State& state)
+{
+  compile_literals(state, literal_kind::long_integral);
+}
+
+/**
+ * Benchmark lexing floating literals.
+ */
+void FloatingLiterals(benchmark::State& state)
+{
+  compile_literals(state, literal_kind::floating);
+}
+
+/**
+ * Return the sample workload with every line turned into a comment.
+ *
+ * The parser only receives the end of input token, so compiling this input
+ * measures lexing alone, which here is mostly skipping comments and newlines.
+ */
+const std::string& commented_workload()
+{
+  static const std::string workload = []
+  {
+    const auto& text = pdcalc::bench::sample_workload();
+    std::string commented;
+    commented.reserve(text.size() + text.size() / 8);
+    auto line_start = true;
+    for (auto c : text) {
+      if (line_start && c != '#' && c != '\n')
+        commented += "# ";
+      commented += c;
+      line_start = (c == '\n');
+    }
+    return commented;
+  }();
+  return workload;
+}
+
+/**
+ * Benchmark compiling an input without evaluating it using the given lexer.
+ *
+ * Optimization is disabled so that the time is dominated by lexing and
+ * parsing. Bytes and statements per second are reported.
+ *
+ * @param state Benchmark state
+ * @param lexer Lexer to use
+ * @param text Input text
+ */
+void compile_input(
+  benchmark::State& state, pdcalc::calc_lexer lexer, const std::string& text)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.lexer(lexer).optimize(false);
+  for (auto _ : state) {
+    if (!parser.compile(pdcalc::calc_source{text, "workload"})) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * text.size())
+  );
+  state.SetItemsProcessed(
+    static_cast<std::int64_t>(
+      state.iterations() * pdcalc::bench::count_statements(text)
+    )
+  );
+}
+
+/**
+ * Benchmark lexing the commented sample workload with the Flex lexer.
+ */
+void FlexCommentLexing(benchmark::State& state)
+{
+  compile_input(state, pdcalc::calc_lexer::flex, commented_workload());
+}
+
+/**
+ * Benchmark lexing the commented sample workload with the SIMD scanner.
+ */
+void SimdCommentLexing(benchmark::State& state)
+{
+  compile_input(state, pdcalc::calc_lexer::simd, commented_workload());
+}
+
+/**
+ * Token visitor counting the tokens read before the end of input.
+ */
+class token_counter : public pdcalc::calc_token_visitor {
+public:
+  void visit(const pdcalc::calc_token& token) override
+  {
+    n_tokens_ += (token.kind != 0);
+  }
+
+  /**
+   * Return the number of tokens counted.
+   */
+  auto n_tokens() const noexcept { return n_tokens_; }
+
+private:
+  std::size_t n_tokens_{};
+};
+
+/**
+ * Benchmark reading the tokens of an input without parsing it.
+ *
+ * Unlike the commented workload, this times each kind of token the lexer
+ * reads, without any parser time. Bytes and tokens per second are reported.
+ *
+ * @param state Benchmark state
+ * @param lexer Lexer to use
+ * @param text Input text
+ */
+void lex_input(
+  benchmark::State& state, pdcalc::calc_lexer lexer, const std::string& text)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parser.lexer(lexer);
+  token_counter counter;
+  for (auto _ : state) {
+    if (!parser.lex(pdcalc::calc_source{text, "workload"}, counter)) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * text.size())
+  );
+  state.counters["tokens_per_second"] = benchmark::Counter(
+    static_cast<double>(counter.n_tokens()), benchmark::Counter::kIsRate
+  );
+}
+
+/**
+ * Benchmark lexing the sample workload with the Flex lexer.
+ */
+void FlexSampleLexing(benchmark::State& state)
+{
+  lex_input(state, pdcalc::calc_lexer::flex, pdcalc::bench::sample_workload());
+}
+
+/**
+ * Benchmark lexing the sample workload with the SIMD scanner.
+ */
+void SimdSampleLexing(benchmark::State& state)
+{
+  lex_input(state, pdcalc::calc_lexer::simd, pdcalc::bench::sample_workload());
+}
+
+/**
+ * Benchmark compiling the sample workload with the Flex lexer.
+ */
+void FlexSampleCompile(benchmark::State& state)
+{
+  compile_input(
+    state, pdcalc::calc_lexer::flex, pdcalc::bench::sample_workload()
+  );
+}
+
+/**
+ * Benchmark compiling the sample workload with the SIMD scanner.
+ */
+void SimdSampleCompile(benchmark::State& state)
+{
+  compile_input(
+    state, pdcalc::calc_lexer::simd, pdcalc::bench::sample_workload()
+  );
+}
+
+}  // namespace
+
+BENCHMARK(ShortIntegralLiterals)->Unit(benchmark::kMillisecond);
+BENCHMARK(LongIntegralLiterals)->Unit(benchmark::kMillisecond);
+BENCHMARK(FloatingLiterals)->Unit(benchmark::kMillisecond);
+BENCHMARK(FlexCommentLexing)->Unit(benchmark::kMillisecond);
+BENCHMARK(SimdCommentLexing)->Unit(benchmark::kMillisecond);
+BENCHMARK(FlexSampleLexing)->Unit(benchmark::kMillisecond);
+BENCHMARK(SimdSampleLexing)->Unit(benchmark::kMillisecond);
+BENCHMARK(FlexSampleCompile)->Unit(benchmark::kMillisecond);
+BENCHMARK(SimdSampleCompile)->Unit(benchmark::kMillisecond);
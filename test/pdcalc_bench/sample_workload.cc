@@ -0,0 +1,72 @@
+/**
+ * @file sample_workload.cc
+ * @author Derek Huang
+ * @brief C++ source for benchmark workloads built from the sample inputs
+ * @copyright MIT License
+ */
+
+#include "sample_workload.hh"
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#ifndef PDCALC_BENCH_DATA_DIR
+#define PDCALC_BENCH_DATA_DIR ""
+#endif  // PDCALC_BENCH_DATA_DIR
+
+namespace pdcalc {
+namespace bench {
+
+const std::string& sample_workload()
+{
+  static const std::string workload = []
+  {
+    // sample input directory
+    std::filesystem::path data_dir{PDCALC_BENCH_DATA_DIR};
+    if (auto env_dir = std::getenv("PDCALC_BENCH_DATA_DIR"))
+      data_dir = env_dir;
+    // number of repetitions
+    std::size_t repeat = 1000;
+    if (auto env_repeat = std::getenv("PDCALC_BENCH_REPEAT"))
+      if (auto value = std::strtoul(env_repeat, nullptr, 10); value)
+        repeat = value;
+    // concatenate samples once + repeat
+    std::string block;
+    for (
+      auto file : {"sample.in.1", "sample.in.2", "sample.in.3", "sample.in.4"}
+    ) {
+      std::ifstream stream{data_dir / file};
+      block.append(std::istreambuf_iterator<char>{stream}, {});
+      block += '\n';
+    }
+    std::string text;
+    text.reserve(block.size() * repeat);
+    for (std::size_t i = 0; i < repeat; i++)
+      text += block;
+    return text;
+  }();
+  return workload;
+}
+
+std::size_t count_statements(std::string_view text) noexcept
+{
+  std::size_t n_statements = 0;
+  auto in_comment = false;
+  for (auto c : text) {
+    if (c == '#')
+      in_comment = true;
+    else if (c == '\n')
+      in_comment = false;
+    else if (c == ';' && !in_comment)
+      n_statements++;
+  }
+  return n_statements;
+}
+
+}  // namespace bench
+}  // namespace pdcalc
@@ -0,0 +1,40 @@
+/**
+ * @file sample_workload.hh
+ * @author Derek Huang
+ * @brief C++ header for benchmark workloads built from the sample inputs
+ * @copyright MIT License
+ */
+
+#ifndef PDCALC_BENCH_SAMPLE_WORKLOAD_HH_
+#define PDCALC_BENCH_SAMPLE_WORKLOAD_HH_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pdcalc {
+namespace bench {
+
+/**
+ * Return the workload of all the sample inputs repeated many times.
+ *
+ * The number of repetitions can be set with the `PDCALC_BENCH_REPEAT`
+ * environment variable and defaults to 1000. Sample inputs are read from the
+ * directory given by the `PDCALC_BENCH_DATA_DIR` environment variable if set
+ * and otherwise from the directory given at compile time.
+ */
+const std::string& sample_workload();
+
+/**
+ * Return the number of statements in the input text.
+ *
+ * This is the number of semicolons outside of line comments.
+ *
+ * @param text Input text
+ */
+std::size_t count_statements(std::string_view text) noexcept;
+
+}  // namespace bench
+}  // namespace pdcalc
+
+#endif  // PDCALC_BENCH_SAMPLE_WORKLOAD_HH_
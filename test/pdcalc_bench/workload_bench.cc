@@ -0,0 +1,250 @@
+/**
+ * @file workload_bench.cc
+ * @author Derek Huang
+ * @brief calc_parser.hh statement workload benchmarks
+ * @copyright MIT License
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "pdcalc/calc_parser.hh"
+#include "sample_workload.hh"
+
+namespace {
+
+/**
+ * Number of statements in each generated workload.
+ */
+constexpr std::size_t n_statements = 1 << 14;
+
+/**
+ * Number of variables used by the assignment workload.
+ */
+constexpr std::size_t n_assign_vars = 16;
+
+/**
+ * Kind of statements in a generated workload.
+ */
+enum class workload_kind {
+  // integer and floating arithmetic with parentheses
+  arithmetic,
+  // comparisons and boolean operators
+  boolean,
+  // plain and compound assignments between a few variables
+  assignment,
+  // nested built-in function calls
+  builtin
+};
+
+/**
+ * Return a workload of `n_statements` statements of the given kind.
+ *
+ * Literals are chosen so that no statement fails, e.g. divisors are nonzero
+ * and built-in function arguments are positive. The workload is the same on
+ * every call for a given kind.
+ *
+ * @param kind Kind of statements to generate
+ */
+std::string generate_workload(workload_kind kind)
+{
+  std::mt19937 rng{static_cast<unsigned>(kind) + 1};
+  std::uniform_int_distribution<int> int_dist{1, 999};
+  std::uniform_int_distribution<std::size_t> var_dist{0, n_assign_vars - 1};
+  // random long literal, floating literal, and assignment variable name
+  auto lit = [&] { return std::to_string(int_dist(rng)); };
+  auto flit = [&] { return lit() + "." + lit(); };
+  auto var = [&] { return "x" + std::to_string(var_dist(rng)); };
+  std::string text;
+  // assignment variables must be defined first
+  if (kind == workload_kind::assignment)
+    for (std::size_t i = 0; i < n_assign_vars; i++)
+      text += "x" + std::to_string(i) + " = " + flit() + ";\n";
+  for (std::size_t i = 0; i < n_statements; i++) {
+    switch (kind) {
+      case workload_kind::arithmetic:
+        text += "(" + lit() + " + " + flit() + ") * " + lit() + " - " + lit() +
+          " % " + lit() + " / (" + flit() + " - " + lit() + ".5);\n";
+        break;
+      case workload_kind::boolean:
+        text += "!(" + lit() + " < " + flit() + ") || (" + lit() + " == " +
+          lit() + " && true) != (" + lit() + " >= " + lit() + ");\n";
+        break;
+      case workload_kind::assignment:
+        if (i % 2)
+          text += var() + " = " + var() + " * 0.5 + " + var() + ";\n";
+        else
+          text += var() + " += " + flit() + ";\n";
+        break;
+      default:
+        text += "max(sqrt(" + flit() + "), log(" + flit() + ")) + sin(" +
+          flit() + ") * cos(" + flit() + ") - min(exp(0." + lit() +
+          "), log10(" + lit() + "));\n";
+    }
+  }
+  return text;
+}
+
+/**
+ * Benchmark parsing and evaluating a text on each iteration.
+ *
+ * Output is discarded so that only lexing, parsing, and evaluation are timed.
+ * Bytes and statements per second are reported.
+ *
+ * @param state Benchmark state
+ * @param parser Parser to use
+ * @param text Input text
+ */
+void parse_text(
+  benchmark::State& state, pdcalc::calc_parser& parser, const std::string& text)
+{
+  for (auto _ : state) {
+    if (!parser(pdcalc::calc_source{text, "workload"})) {
+      state.SkipWithError(parser.last_error().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * text.size())
+  );
+  state.SetItemsProcessed(
+    static_cast<std::int64_t>(
+      state.iterations() * pdcalc::bench::count_statements(text)
+    )
+  );
+}
+
+/**
+ * Benchmark parsing and evaluating a generated workload.
+ *
+ * @param state Benchmark state
+ * @param kind Kind of statements to generate
+ */
+void parse_workload(benchmark::State& state, workload_kind kind)
+{
+  const auto text = generate_workload(kind);
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parse_text(state, parser, text);
+}
+
+/**
+ * Benchmark parsing and evaluating arithmetic statements.
+ */
+void ArithmeticWorkload(benchmark::State& state)
+{
+  parse_workload(state, workload_kind::arithmetic);
+}
+
+/**
+ * Benchmark parsing and evaluating boolean statements.
+ */
+void BooleanWorkload(benchmark::State& state)
+{
+  parse_workload(state, workload_kind::boolean);
+}
+
+/**
+ * Benchmark parsing and evaluating assignment statements.
+ */
+void AssignmentWorkload(benchmark::State& state)
+{
+  parse_workload(state, workload_kind::assignment);
+}
+
+/**
+ * Benchmark parsing and evaluating built-in function calls.
+ */
+void BuiltinWorkload(benchmark::State& state)
+{
+  parse_workload(state, workload_kind::builtin);
+}
+
+/**
+ * Benchmark parsing and evaluating the repeated samples.
+ */
+void SampleWorkload(benchmark::State& state)
+{
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parse_text(state, parser, pdcalc::bench::sample_workload());
+}
+
+/**
+ * Benchmark parsing and evaluating deeply nested statements.
+ *
+ * Each statement nests the given number of parenthesized additions, half of
+ * them on the left and half on the right, so both the parser stack and the
+ * expression depth grow with the nesting depth.
+ *
+ * @param state Benchmark state, with the nesting depth as the first argument
+ */
+void DeepNesting(benchmark::State& state)
+{
+  const auto depth = static_cast<std::size_t>(state.range(0));
+  std::string statement;
+  for (std::size_t i = 0; i < depth / 2; i++)
+    statement += "(1 + ";
+  for (std::size_t i = depth / 2; i < depth; i++)
+    statement += "(";
+  statement += "1";
+  for (std::size_t i = depth / 2; i < depth; i++)
+    statement += " + 1)";
+  for (std::size_t i = 0; i < depth / 2; i++)
+    statement += ")";
+  statement += ";\n";
+  // keep the total input size roughly constant as the depth changes
+  const auto n_repeat = std::max<std::size_t>(n_statements / depth, 1);
+  std::string text;
+  for (std::size_t i = 0; i < n_repeat; i++)
+    text += statement;
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  parse_text(state, parser, text);
+}
+
+/**
+ * Benchmark symbol lookup as the number of defined symbols grows.
+ *
+ * The symbols are defined before timing starts and each statement reads two
+ * random symbols, so only lookup cost should depend on the symbol count.
+ *
+ * @param state Benchmark state, with the symbol count as the first argument
+ */
+void SymbolScaling(benchmark::State& state)
+{
+  const auto n_symbols = static_cast<std::size_t>(state.range(0));
+  std::ostream null_stream{nullptr};
+  pdcalc::calc_parser parser{null_stream};
+  for (std::size_t i = 0; i < n_symbols; i++)
+    parser.add_symbol("v" + std::to_string(i), static_cast<long>(i));
+  std::mt19937 rng{static_cast<unsigned>(n_symbols)};
+  std::uniform_int_distribution<std::size_t> dist{0, n_symbols - 1};
+  auto var = [&] { return "v" + std::to_string(dist(rng)); };
+  std::string text;
+  for (std::size_t i = 0; i < n_statements; i++)
+    text += var() + " + " + var() + " * 2;\n";
+  parse_text(state, parser, text);
+}
+
+}  // namespace
+
+BENCHMARK(ArithmeticWorkload)->Unit(benchmark::kMillisecond);
+BENCHMARK(BooleanWorkload)->Unit(benchmark::kMillisecond);
+BENCHMARK(AssignmentWorkload)->Unit(benchmark::kMillisecond);
+BENCHMARK(BuiltinWorkload)->Unit(benchmark::kMillisecond);
+BENCHMARK(SampleWorkload)->Unit(benchmark::kMillisecond);
+BENCHMARK(DeepNesting)
+  ->RangeMultiplier(4)
+  ->Range(4, 1024)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(SymbolScaling)
+  ->RangeMultiplier(8)
+  ->Range(8, 1 << 15)
+  ->Unit(benchmark::kMillisecond);
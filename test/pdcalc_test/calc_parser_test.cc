@@ -7,10 +7,28 @@
 
 #include "pdcalc/calc_parser.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -24,6 +42,13 @@
 
 namespace {
 
+/**
+ * Sample input files in the test data directory.
+ */
+const char* const sample_files[] = {
+  "sample.in.1", "sample.in.2", "sample.in.3", "sample.in.4"
+};
+
 /**
  * Calc parser base test fixture.
  */
@@ -58,6 +83,36 @@ protected:
       GTEST_SKIP() << skip_reason_;
   }
 
+  /**
+   * Return the output from parsing all the sample files in order.
+   *
+   * @param parser Parser to use, which must write to a `std::stringstream`
+   */
+  static std::string parse_samples(pdcalc::calc_parser& parser)
+  {
+    auto& sink = static_cast<std::stringstream&>(parser.sink());
+    sink.str("");
+    for (auto file : sample_files)
+      EXPECT_TRUE(parser(test_data_dir_ / file)) << parser.last_error();
+    return sink.str();
+  }
+
+  /**
+   * Return the errors of the last parse formatted with their locations.
+   *
+   * @param parser Parser to return the errors of
+   */
+  static auto format_errors(const pdcalc::calc_parser& parser)
+  {
+    std::vector<std::string> errors;
+    for (const auto& error : parser.errors()) {
+      std::stringstream ss;
+      ss << error;
+      errors.push_back(ss.str());
+    }
+    return errors;
+  }
+
   // no-op stream
   static inline std::ostream null_stream{nullptr};
   // absolute path to test data directory
@@ -108,7 +163,2197 @@ TEST_P(CalcParserPureTest, PureParseTest)
 INSTANTIATE_TEST_SUITE_P(
   BaseSuite,
   CalcParserPureTest,
-  ::testing::Values("sample.in.1", "sample.in.2", "sample.in.3", "sample.in.4")
+  ::testing::ValuesIn(sample_files)
 );
 
+/**
+ * Calc parser in-memory input test fixture.
+ */
+class CalcParserSourceTest : public CalcParserTest {
+protected:
+  /**
+   * Return the contents of the given sample file.
+   *
+   * @param file Sample file name
+   */
+  static std::string read_sample(const char* file)
+  {
+    std::ifstream stream{test_data_dir_ / file};
+    return {std::istreambuf_iterator<char>{stream}, {}};
+  }
+
+  /**
+   * Return the output from parsing the given sample file from disk.
+   *
+   * @param file Sample file name
+   */
+  static std::string parse_sample(const char* file)
+  {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    return parser(test_data_dir_ / file) ? sink.str() : parser.last_error();
+  }
+};
+
+/**
+ * Test that parsing in-memory text gives the same output as parsing the file.
+ */
+TEST_F(CalcParserSourceTest, TextTest)
+{
+  for (auto file : sample_files) {
+    auto text = read_sample(file);
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    ASSERT_TRUE(
+      parser(pdcalc::calc_source{text, file})
+    ) << parser.last_error();
+    EXPECT_EQ(parse_sample(file), sink.str()) << "sample: " << file;
+  }
+}
+
+/**
+ * Test that parsing a padded buffer gives the same output as parsing the file.
+ */
+TEST_F(CalcParserSourceTest, BufferTest)
+{
+  for (auto file : sample_files) {
+    auto text = read_sample(file);
+    text.append(pdcalc::calc_parser::buffer_padding, '\0');
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    ASSERT_TRUE(
+      parser.parse_buffer(text.data(), text.size(), file)
+    ) << parser.last_error();
+    EXPECT_EQ(parse_sample(file), sink.str()) << "sample: " << file;
+  }
+}
+
+/**
+ * Test that parsing mapped files gives the same output as using stdio.
+ */
+TEST_F(CalcParserSourceTest, MmapTest)
+{
+  for (auto file : sample_files) {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    parser.input_mode(pdcalc::calc_input_mode::mmap);
+    ASSERT_TRUE(parser(test_data_dir_ / file)) << parser.last_error();
+    EXPECT_EQ(parse_sample(file), sink.str()) << "sample: " << file;
+  }
+}
+
+/**
+ * Test that a missing file is still reported as an error when mapping.
+ */
+TEST_F(CalcParserSourceTest, MmapMissingTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  parser.input_mode(pdcalc::calc_input_mode::mmap);
+  EXPECT_FALSE(parser(test_data_dir_ / "not_a_sample.in"));
+  EXPECT_EQ(0u, parser.last_error().rfind("Error opening", 0));
+}
+
+/**
+ * Test that parsing a buffer without the required padding fails.
+ */
+TEST_F(CalcParserSourceTest, BadBufferTest)
+{
+  std::string text{"1 + 1;"};
+  pdcalc::calc_parser parser{null_stream};
+  EXPECT_FALSE(parser.parse_buffer(text.data(), text.size(), "bad"));
+  EXPECT_NE("", parser.last_error());
+}
+
+/**
+ * Test that parsing a batch of sources shares the symbol table.
+ */
+TEST_F(CalcParserSourceTest, BatchTest)
+{
+  const pdcalc::calc_source sources[] = {
+    {"a = 4;", "first"}, {"b = a * 2.5;", "second"}, {"a + b;", "third"}
+  };
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  ASSERT_TRUE(parser.parse(sources, std::size(sources))) << parser.last_error();
+  EXPECT_EQ("<double> 14\n", sink.str());
+}
+
+/**
+ * Test that the source name is used in the error location.
+ */
+TEST_F(CalcParserSourceTest, ErrorNameTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  EXPECT_FALSE(parser(pdcalc::calc_source{"1;\n2 / 0;", "expr"}));
+  EXPECT_EQ(0u, parser.last_error().rfind("expr:2.", 0)) << parser.last_error();
+}
+
+/**
+ * Test that literals at the limits convert and out-of-range literals fail.
+ */
+TEST_F(CalcParserSourceTest, LiteralTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  constexpr pdcalc::calc_source source{
+    "9223372036854775807; -9223372036854775808; 123456789012345678; -0; "
+    "2.; -0.5; 000012.2500;",
+    "literals"
+  };
+  ASSERT_TRUE(parser(source)) << parser.last_error();
+  EXPECT_EQ(
+    "<long> 9223372036854775807\n<long> -9223372036854775808\n"
+    "<long> 123456789012345678\n<long> 0\n<double> 2\n<double> -0.5\n"
+    "<double> 12.25\n",
+    sink.str()
+  );
+  // out-of-range literals are located errors
+  EXPECT_FALSE(
+    parser(pdcalc::calc_source{"1;\n2 + 9223372036854775808;", "i"})
+  );
+  EXPECT_EQ(
+    "i:2.5-23: Literal '9223372036854775808' is out of range for long",
+    parser.last_error()
+  );
+  const std::string huge(400, '9');
+  EXPECT_FALSE(parser(pdcalc::calc_source{huge + ".0;", "d"}));
+  EXPECT_EQ(
+    "d:1.1-402: Literal '" + huge + ".0' is out of range for double",
+    parser.last_error()
+  );
+}
+
+/**
+ * Calc parser compiled program test fixture.
+ */
+class CalcParserProgramTest : public CalcParserTest {};
+
+/**
+ * Test that running a parsed program gives the same output as parsing.
+ */
+TEST_F(CalcParserProgramTest, RerunTest)
+{
+  for (auto file : sample_files) {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    ASSERT_TRUE(parser(test_data_dir_ / file)) << parser.last_error();
+    auto expected = sink.str();
+    sink.str("");
+    ASSERT_TRUE(parser.run()) << parser.last_error();
+    EXPECT_EQ(expected, sink.str()) << "sample: " << file;
+  }
+}
+
+/**
+ * Test that compiling does not evaluate and that runs see new symbol values.
+ */
+TEST_F(CalcParserProgramTest, CompileRunTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.add_symbol("x", 1L).add_symbol("scale", 0.5);
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{"y = x * 3; y * scale; y > 4;", "expr"})
+  ) << parser.last_error();
+  EXPECT_EQ("", sink.str());
+  EXPECT_FALSE(parser.get_symbol("y"));
+  // run with different values of x
+  for (auto x : {1L, 2L, 3L}) {
+    parser.add_symbol("x", x);
+    ASSERT_TRUE(parser.run()) << parser.last_error();
+  }
+  EXPECT_EQ(
+    "<double> 1.5\n<bool> false\n"
+    "<double> 3\n<bool> true\n"
+    "<double> 4.5\n<bool> true\n",
+    sink.str()
+  );
+  ASSERT_TRUE(parser.get_symbol("y"));
+  EXPECT_EQ(9L, parser.get_symbol("y")->get<long>());
+}
+
+/**
+ * Test that running fails if a symbol changed type since compiling.
+ */
+TEST_F(CalcParserProgramTest, TypeChangeTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("x", 1L);
+  ASSERT_TRUE(parser.compile(pdcalc::calc_source{"x + 1;", "expr"}));
+  parser.add_symbol("x", 1.);
+  EXPECT_FALSE(parser.run());
+  EXPECT_EQ(0u, parser.last_error().rfind("expr:1.1-6: ", 0))
+    << parser.last_error();
+}
+
+/**
+ * Test that rebinding a symbol updates it in place.
+ */
+TEST_F(CalcParserProgramTest, RebindTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("x", 1L);
+  auto sym = parser.get_symbol("x");
+  ASSERT_TRUE(sym);
+  parser.add_symbol("x", 2.);
+  EXPECT_EQ(sym, parser.get_symbol("x"));
+  EXPECT_EQ(2., sym->get<double>());
+  // assignment through a statement also updates in place
+  ASSERT_TRUE(parser(pdcalc::calc_source{"x = x > 1; y = !x;", "expr"}))
+    << parser.last_error();
+  EXPECT_EQ(sym, parser.get_symbol("x"));
+  EXPECT_TRUE(sym->get<bool>());
+  ASSERT_TRUE(parser.get_symbol("y"));
+  EXPECT_FALSE(parser.get_symbol("y")->get<bool>());
+}
+
+/**
+ * Test that boolean inequality is not computed as equality.
+ */
+TEST_F(CalcParserProgramTest, BoolNotEqualTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  ASSERT_TRUE(
+    parser(pdcalc::calc_source{"true != false; true != true;", "expr"})
+  ) << parser.last_error();
+  EXPECT_EQ("<bool> true\n<bool> false\n", sink.str());
+}
+
+/**
+ * Backends compared against the tree-walking evaluator.
+ */
+constexpr pdcalc::calc_backend compiled_backends[] = {
+  pdcalc::calc_backend::vm, pdcalc::calc_backend::jit
+};
+
+/**
+ * Return the output or error from parsing the input with the given backend.
+ *
+ * @tparam Input Input file path or `calc_source`
+ *
+ * @param input Input to parse
+ * @param backend Evaluation backend
+ * @param optimize `true` to optimize statements
+ */
+template <typename Input>
+std::string parse_output(
+  const Input& input, pdcalc::calc_backend backend, bool optimize = true)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.backend(backend).optimize(optimize);
+  return parser(input) ? sink.str() : parser.last_error();
+}
+
+/**
+ * Test that all evaluation backends give the same output on the samples.
+ */
+TEST_F(CalcParserProgramTest, BackendTest)
+{
+  for (auto file : sample_files) {
+    auto expected = parse_output(
+      test_data_dir_ / file, pdcalc::calc_backend::tree
+    );
+    for (auto backend : compiled_backends) {
+      std::stringstream sink;
+      pdcalc::calc_parser parser{sink};
+      parser.backend(backend);
+      ASSERT_TRUE(parser(test_data_dir_ / file)) << parser.last_error();
+      EXPECT_EQ(expected, sink.str()) << "sample: " << file;
+      // rerun the same program with the tree-walking evaluator
+      sink.str("");
+      parser.backend(pdcalc::calc_backend::tree);
+      ASSERT_TRUE(parser.run()) << parser.last_error();
+      EXPECT_EQ(expected, sink.str()) << "sample: " << file;
+    }
+  }
+}
+
+/**
+ * Test that all evaluation backends agree on edge cases of every operation.
+ */
+TEST_F(CalcParserProgramTest, BackendOperationTest)
+{
+  constexpr pdcalc::calc_source source{
+    // integral arithmetic + bitwise operations
+    "a = -7; b = 3; a + b; a - b; a * b; a / b; a % b; -a; ~a;"
+    "a & b; a ^ b; a | b; 1 << b; a >> 1; max(a, b); min(a, b);"
+    // floating arithmetic with promotion, signed zeros, and NaN
+    "x = 2.5; n = sqrt(-1.); x + a; x - 1; x * b; a / x; -x;"
+    "max(-0., 0.); max(0., -0.); min(-0., 0.); min(0., -0.);"
+    "max(n, 1.); max(1., n); min(n, 1.); min(1., n);"
+    "exp(1.); log(x); log2(x); log10(x); sin(x); cos(x); tan(x);"
+    // comparisons, including unordered comparisons
+    "a == b; a != b; a < b; a > b; a <= b; a >= -7;"
+    "x == 2.5; x != 2.5; x < 3; x > 3; x <= 2.5; x >= 2.5;"
+    "n == n; n != n; n < 1.; n > 1.; n <= 1.; n >= 1.;"
+    // logical operations
+    "t = true; f = !t; t && f; t || f; t == f; t != f; !f;"
+    // deep expression needing many registers
+    "((((a + 1) * (b - 2)) - ((a * b) + (b / 2))) * (x - (x / (b + 1))));",
+    "ops"
+  };
+  auto expected = parse_output(source, pdcalc::calc_backend::tree);
+  for (auto backend : compiled_backends)
+    EXPECT_EQ(expected, parse_output(source, backend));
+}
+
+/**
+ * Test that all evaluation backends report the same evaluation errors.
+ */
+TEST_F(CalcParserProgramTest, BackendErrorTest)
+{
+  constexpr const char* inputs[] = {
+    "4 / (1 - 1);",
+    "4 / 0.;",
+    "x = 1.5; x / (2 - 2);",
+    "x = -0.; 1 / x;",
+    "missing + 1;"
+  };
+  for (auto input : inputs) {
+    pdcalc::calc_source source{input, "expr"};
+    auto expected = parse_output(source, pdcalc::calc_backend::tree);
+    EXPECT_EQ(0u, expected.rfind("expr:", 0)) << "input: " << input;
+    for (auto backend : compiled_backends)
+      EXPECT_EQ(expected, parse_output(source, backend)) << "input: " << input;
+  }
+}
+
+/**
+ * Test that promoted operands of a division by zero are reported exactly.
+ */
+TEST_F(CalcParserProgramTest, PromotedErrorTest)
+{
+  // operands above 2^53 are not exact as double and the last one rounds to
+  // 2^63, which is out of range for long
+  const std::pair<const char*, const char*> cases[] = {
+    {
+      "9007199254740993 / 0.;",
+      "9007199254740993 / 0.000000 is division by zero"
+    },
+    {
+      "a = 9223372036854775727; a / 0.;",
+      "9223372036854775727 / 0.000000 is division by zero"
+    },
+    {"b = 1.5; b / (2 - 2);", "1.500000 / 0 is division by zero"}
+  };
+  for (auto [input, message] : cases) {
+    pdcalc::calc_source source{input, "expr"};
+    auto expected = parse_output(source, pdcalc::calc_backend::tree);
+    EXPECT_NE(std::string::npos, expected.find(message)) << expected;
+    for (auto backend : compiled_backends) {
+      EXPECT_EQ(expected, parse_output(source, backend)) << "input: " << input;
+      EXPECT_EQ(expected, parse_output(source, backend, false)) <<
+        "input: " << input;
+    }
+  }
+}
+
+/**
+ * Test that evaluation errors are reported at the failing division.
+ */
+TEST_F(CalcParserProgramTest, ErrorLocationTest)
+{
+  const std::pair<const char*, const char*> cases[] = {
+    // operands of the division are rewritten by the optimizer
+    {"a = 0; 1 + (2 * 3) / (a * 1);", "expr:1.12-28: 6 / 0"},
+    {"a = 4; b = 0;\nc = a + 1;\na /= b;", "expr:3.1-7: 4 / 0"},
+    {"a = 1.5;\n  (a + 1) / (a - a) + 1;", "expr:2.3-19: 2.500000 / 0.000000"}
+  };
+  for (auto [input, message] : cases) {
+    pdcalc::calc_source source{input, "expr"};
+    for (auto optimize : {true, false}) {
+      EXPECT_EQ(
+        0u, parse_output(source, pdcalc::calc_backend::tree, optimize).find(
+          message
+        )
+      ) << "input: " << input;
+      for (auto backend : compiled_backends)
+        EXPECT_EQ(0u, parse_output(source, backend, optimize).find(message)) <<
+          "input: " << input;
+    }
+  }
+}
+
+/**
+ * Test that expressions deeper than the call stack allows are evaluated.
+ */
+TEST_F(CalcParserProgramTest, DeepExpressionTest)
+{
+  constexpr auto n_terms = 200000;
+  // left nesting, and right nesting needing more registers than the VM has
+  std::string left{"1"};
+  std::string right;
+  for (auto i = 1; i < n_terms; i++) {
+    left += "+1";
+    right += "1+(";
+  }
+  left += ';';
+  right += '1' + std::string(n_terms - 1, ')') + ';';
+  constexpr pdcalc::calc_backend backends[] = {
+    pdcalc::calc_backend::tree,
+    pdcalc::calc_backend::vm,
+    pdcalc::calc_backend::jit
+  };
+  for (const auto& text : {left, right}) {
+    for (auto optimize : {false, true}) {
+      for (auto backend : backends) {
+        std::stringstream sink;
+        pdcalc::calc_parser parser{sink};
+        parser.optimize(optimize).backend(backend);
+        ASSERT_TRUE(
+          parser(pdcalc::calc_source{text, "deep"})
+        ) << parser.last_error();
+        EXPECT_EQ("<long> " + std::to_string(n_terms) + "\n", sink.str())
+          << "optimize: " << optimize;
+        // the program can also be written
+        std::stringstream dump;
+        parser.dump_program(dump);
+        auto lines = dump.str();
+        EXPECT_EQ(
+          n_terms - 1,
+          std::count(lines.begin(), lines.begin() + lines.find('\n'), '(')
+        );
+      }
+    }
+  }
+}
+
+/**
+ * Calc parser optimization test fixture.
+ */
+class CalcParserOptimizeTest : public CalcParserTest {
+protected:
+  // all backends, as each backend evaluates optimized expressions
+  static constexpr pdcalc::calc_backend backends[] = {
+    pdcalc::calc_backend::tree,
+    pdcalc::calc_backend::vm,
+    pdcalc::calc_backend::jit
+  };
+
+  /**
+   * Check optimized output matches unoptimized tree-walking output.
+   *
+   * @tparam Input Input file path or `calc_source`
+   *
+   * @param input Input to parse
+   */
+  template <typename Input>
+  void check_output(const Input& input)
+  {
+    auto expected = parse_output(input, pdcalc::calc_backend::tree, false);
+    for (auto backend : backends)
+      EXPECT_EQ(expected, parse_output(input, backend)) <<
+        "backend: " << static_cast<int>(backend);
+  }
+};
+
+/**
+ * Test that optimized samples give the same output.
+ */
+TEST_F(CalcParserOptimizeTest, SampleTest)
+{
+  for (auto file : sample_files) {
+    SCOPED_TRACE(file);
+    check_output(test_data_dir_ / file);
+  }
+}
+
+/**
+ * Test that folded, reduced, and shared expressions give the same output.
+ */
+TEST_F(CalcParserOptimizeTest, RewriteTest)
+{
+  check_output(
+    pdcalc::calc_source{
+      // constant folding, including wrapping and promotions
+      "1 + 2 * 3 - 4; 7 / 2; -7 % 3; 1 << 3; -16 >> 2; ~5; -(3 - 5);"
+      "9223372036854775807 + 1; 2 * 1.5; 1 / 4.; sqrt(2.) * sin(1.);"
+      "max(1, 2) + min(2.5, 1); 1 < 2 == (2. >= 3) || !true;"
+      // strength reduction with signed values, signed zeros, and NaN
+      "a = -7; b = 6; x = -0.; n = sqrt(-1.); t = true; f = false;"
+      "a * 2; 2 * a; x * 2; 2. * n; a * 1; 1. * x; a + 0; 0 + a; x - 0.;"
+      "x - -0.; a / 1; a / 4; b / 4; (a & 7) / 4; (a & 7) % 4; a % 4;"
+      "max(b, 0) / 2; x / 4; n / 0.5; b / -0.25; x / 3.;"
+      "a & -1; a | 0; 0 ^ a; a << 0; a >> 0; t && true; f || false;"
+      "--a; ~~a; !!t; -(-x);"
+      // common subexpressions
+      "sin(x) * cos(x) / tan(1 + x) + sin(x) * cos(x);"
+      "(a + b) * (a + b) - (a + b) / 2; exp(b) > exp(b) == !(b == b);"
+      "x = 2.5; x += x * x; y = log(x) + log(x) * log2(x) - log(x);",
+      "rewrite"
+    }
+  );
+}
+
+/**
+ * Test that optimized statements report the same evaluation errors.
+ */
+TEST_F(CalcParserOptimizeTest, ErrorTest)
+{
+  constexpr const char* inputs[] = {
+    "1 + 4 / (1 - 1);",
+    "4 / (2 - 2.);",
+    "x = 4; x / 0 + 1 / 0;",
+    "x = 4; missing * 0 + x / 0;",
+    "x = 0.; sin(x) / x + sin(x) / x;",
+    "a = 5; b = 0; (a + b) / b * (a + b);"
+  };
+  for (auto input : inputs) {
+    SCOPED_TRACE(input);
+    check_output(pdcalc::calc_source{input, "expr"});
+  }
+}
+
+/**
+ * Test that the program dump shows expressions before and after optimizing.
+ */
+TEST_F(CalcParserOptimizeTest, DumpTest)
+{
+  constexpr pdcalc::calc_source source{
+    "x = 2;\ny = sin(x) * sin(x) + 2 * 3;\nx / 2.;",
+    "expr"
+  };
+  pdcalc::calc_parser parser{null_stream};
+  ASSERT_TRUE(parser(source)) << parser.last_error();
+  std::stringstream dump;
+  parser.dump_program(dump);
+  EXPECT_EQ(
+    "expr:1.1-6: x = 2\n"
+    "expr:2.1-28: "
+    "y = (+ (* (sin (double x)) (sin (double x))) (double (* 2 3)))\n"
+    "  => (+ (* #1=(sin (double x)) #1#) 6.)\n"
+    "expr:3.1-7: print (/ (double x) 2.)\n"
+    "  => (* (double x) 0.5)\n",
+    dump.str()
+  );
+  // unoptimized statements are only written once
+  ASSERT_TRUE(parser.optimize(false)(source)) << parser.last_error();
+  dump.str("");
+  parser.dump_program(dump);
+  EXPECT_EQ(
+    "expr:1.1-6: x = 2\n"
+    "expr:2.1-28: "
+    "y = (+ (* (sin (double x)) (sin (double x))) (double (* 2 3)))\n"
+    "expr:3.1-7: print (/ (double x) 2.)\n",
+    dump.str()
+  );
+}
+
+/**
+ * Calc parser columnar evaluation test fixture.
+ */
+class CalcParserColumnTest : public CalcParserTest {
+protected:
+  // enough rows for several blocks with a partial last block
+  static constexpr std::size_t n_rows = 2500;
+};
+
+/**
+ * Test that a formula is evaluated for each row of the input columns.
+ */
+TEST_F(CalcParserColumnTest, FormulaTest)
+{
+  std::vector<double> a(n_rows);
+  std::vector<long> c(n_rows);
+  for (std::size_t i = 0; i < n_rows; i++) {
+    a[i] = 0.001 * static_cast<double>(i);
+    c[i] = static_cast<long>(i % 7);
+  }
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0.).add_symbol("c", 0L).add_symbol("scale", 2.);
+  ASSERT_TRUE(
+    parser.compile(
+      pdcalc::calc_source{"b = sin(a) * c + scale * cos(a);", "formula"}
+    )
+  ) << parser.last_error();
+  std::vector<double> b(n_rows);
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}, {"c", c.data()}};
+  const pdcalc::calc_output_column outputs[] = {{"b", b.data()}};
+  ASSERT_TRUE(
+    parser.run_columns(inputs, std::size(inputs), outputs, 1, n_rows)
+  ) << parser.last_error();
+  for (std::size_t i = 0; i < n_rows; i++)
+    EXPECT_DOUBLE_EQ(
+      std::sin(a[i]) * static_cast<double>(c[i]) + 2. * std::cos(a[i]), b[i]
+    ) << "row: " << i;
+  // symbols are not modified
+  EXPECT_FALSE(parser.get_symbol("b"));
+}
+
+/**
+ * Test that shared subexpressions of optimized statements are evaluated.
+ */
+TEST_F(CalcParserColumnTest, SharedTest)
+{
+  std::vector<double> a(n_rows);
+  for (std::size_t i = 0; i < n_rows; i++)
+    a[i] = 0.01 * static_cast<double>(i);
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0.);
+  ASSERT_TRUE(
+    parser.compile(
+      pdcalc::calc_source{
+        "s = sin(a); b = s * s + cos(a) * sin(a) * 2; b = b - sin(a) * b;",
+        "shared"
+      }
+    )
+  ) << parser.last_error();
+  std::vector<double> b(n_rows);
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}};
+  const pdcalc::calc_output_column outputs[] = {{"b", b.data()}};
+  ASSERT_TRUE(
+    parser.run_columns(inputs, 1, outputs, 1, n_rows)
+  ) << parser.last_error();
+  for (std::size_t i = 0; i < n_rows; i++) {
+    auto s = std::sin(a[i]);
+    auto expected = s * s + std::cos(a[i]) * s * 2;
+    EXPECT_DOUBLE_EQ(expected - s * expected, b[i]) << "row: " << i;
+  }
+}
+
+/**
+ * Test that columnar evaluation matches evaluating each row with `run`.
+ */
+TEST_F(CalcParserColumnTest, RunTest)
+{
+  // reassignments change types and use the previous values
+  constexpr pdcalc::calc_source source{
+    "x = a * 2 - 1; y = x > 3 && !(x == 7); z = x; x = x / 2.5 + a; "
+    "w = (a << 1) % 5 ^ ~a; z *= 3;",
+    "program"
+  };
+  std::vector<long> a(n_rows);
+  for (std::size_t i = 0; i < n_rows; i++)
+    a[i] = static_cast<long>(i) - 10;
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  ASSERT_TRUE(parser.compile(source)) << parser.last_error();
+  std::vector<double> x(n_rows);
+  auto y = std::make_unique<bool[]>(n_rows);
+  std::vector<long> z(n_rows);
+  std::vector<long> w(n_rows);
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}};
+  const pdcalc::calc_output_column outputs[] = {
+    {"x", x.data()}, {"y", y.get()}, {"z", z.data()}, {"w", w.data()}
+  };
+  ASSERT_TRUE(
+    parser.run_columns(inputs, 1, outputs, std::size(outputs), n_rows)
+  ) << parser.last_error();
+  for (std::size_t i = 0; i < n_rows; i++) {
+    parser.add_symbol("a", a[i]);
+    ASSERT_TRUE(parser.run()) << parser.last_error();
+    EXPECT_EQ(parser.get_symbol("x")->get<double>(), x[i]) << "row: " << i;
+    EXPECT_EQ(parser.get_symbol("y")->get<bool>(), y[i]) << "row: " << i;
+    EXPECT_EQ(parser.get_symbol("z")->get<long>(), z[i]) << "row: " << i;
+    EXPECT_EQ(parser.get_symbol("w")->get<long>(), w[i]) << "row: " << i;
+  }
+}
+
+/**
+ * Test that division by zero reports the statement location and row.
+ */
+TEST_F(CalcParserColumnTest, DivisionErrorTest)
+{
+  std::vector<long> a(n_rows, 1);
+  a[2000] = 0;
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{"b = 1;\nb = 4 / a;", "expr"})
+  ) << parser.last_error();
+  std::vector<long> b(n_rows);
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}};
+  const pdcalc::calc_output_column outputs[] = {{"b", b.data()}};
+  EXPECT_FALSE(parser.run_columns(inputs, 1, outputs, 1, n_rows));
+  EXPECT_EQ(
+    "expr:2.5-9: Row 2000: 4 / 0 is division by zero", parser.last_error()
+  );
+}
+
+/**
+ * Test that promoted operands of a division by zero are reported exactly.
+ */
+TEST_F(CalcParserColumnTest, PromotedErrorTest)
+{
+  std::vector<long> a(n_rows, 9007199254740993L);
+  std::vector<double> x(n_rows, 1.);
+  x[1500] = 0.;
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  parser.add_symbol("x", 0.);
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{"b = a / x;", "expr"})
+  ) << parser.last_error();
+  std::vector<double> b(n_rows);
+  const pdcalc::calc_input_column inputs[] = {
+    {"a", a.data()}, {"x", x.data()}
+  };
+  const pdcalc::calc_output_column outputs[] = {{"b", b.data()}};
+  EXPECT_FALSE(parser.run_columns(inputs, 2, outputs, 1, n_rows));
+  EXPECT_EQ(
+    "expr:1.5-9: Row 1500: 9007199254740993 / 0.000000 is division by zero",
+    parser.last_error()
+  );
+}
+
+/**
+ * Test that binding errors are reported before evaluation.
+ */
+TEST_F(CalcParserColumnTest, BindErrorTest)
+{
+  std::vector<double> a(n_rows);
+  std::vector<long> b(n_rows);
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{"b = a + 1;", "expr"})
+  ) << parser.last_error();
+  // input column type must match the compiled type
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}};
+  const pdcalc::calc_output_column outputs[] = {{"b", b.data()}};
+  EXPECT_FALSE(parser.run_columns(inputs, 1, outputs, 1, n_rows));
+  EXPECT_EQ(
+    "expr:1.1-10: Column 'a' does not have the compiled symbol type",
+    parser.last_error()
+  );
+  // output column type must match the symbol type
+  const pdcalc::calc_output_column bad_outputs[] = {{"b", a.data()}};
+  EXPECT_FALSE(parser.run_columns(nullptr, 0, bad_outputs, 1, n_rows));
+  EXPECT_EQ(
+    "Output column 'b' does not have the symbol type", parser.last_error()
+  );
+  // output column must be a program symbol
+  const pdcalc::calc_output_column missing_outputs[] = {{"c", b.data()}};
+  EXPECT_FALSE(parser.run_columns(nullptr, 0, missing_outputs, 1, n_rows));
+  EXPECT_EQ("Output column 'c' is not a symbol", parser.last_error());
+}
+
+/**
+ * Test that symbol types are those after the program from the last compile.
+ */
+TEST_F(CalcParserColumnTest, SymbolTypeTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L).add_symbol("c", true);
+  ASSERT_TRUE(
+    parser.compile(
+      pdcalc::calc_source{"b = a > 1; b = a / 2.; d = a; d += 1;", "expr"}
+    )
+  ) << parser.last_error();
+  // last assignment determines the type
+  EXPECT_EQ(2U, parser.symbol_type("b"));
+  EXPECT_EQ(1U, parser.symbol_type("d"));
+  // unassigned symbols keep their current type
+  EXPECT_EQ(1U, parser.symbol_type("a"));
+  EXPECT_EQ(0U, parser.symbol_type("c"));
+  EXPECT_EQ(std::variant_npos, parser.symbol_type("e"));
+  // program symbols are not added by compiling
+  EXPECT_FALSE(parser.get_symbol("b"));
+}
+
+/**
+ * Test that the value of a single-expression program is assigned to a symbol.
+ */
+TEST_F(CalcParserColumnTest, AssignResultTest)
+{
+  std::vector<long> a(n_rows);
+  for (std::size_t i = 0; i < n_rows; i++)
+    a[i] = static_cast<long>(i);
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{";\na * 2 - 1;;", "expr"})
+  ) << parser.last_error();
+  ASSERT_TRUE(parser.assign_result("result")) << parser.last_error();
+  EXPECT_EQ(1U, parser.symbol_type("result"));
+  std::vector<long> result(n_rows);
+  const pdcalc::calc_input_column inputs[] = {{"a", a.data()}};
+  const pdcalc::calc_output_column outputs[] = {{"result", result.data()}};
+  ASSERT_TRUE(
+    parser.run_columns(inputs, 1, outputs, 1, n_rows)
+  ) << parser.last_error();
+  for (std::size_t i = 0; i < n_rows; i++)
+    EXPECT_EQ(a[i] * 2 - 1, result[i]) << "row: " << i;
+  // running the program assigns instead of printing
+  std::stringstream sink;
+  pdcalc::calc_parser run_parser{sink};
+  run_parser.add_symbol("a", 4L);
+  ASSERT_TRUE(run_parser.compile(pdcalc::calc_source{"a + 1;", "expr"}));
+  ASSERT_TRUE(run_parser.run()) << run_parser.last_error();
+  EXPECT_EQ("<long> 5\n", sink.str());
+  ASSERT_TRUE(run_parser.assign_result("b"));
+  sink.str("");
+  ASSERT_TRUE(run_parser.run()) << run_parser.last_error();
+  EXPECT_EQ("", sink.str());
+  EXPECT_EQ(5, run_parser.get_symbol("b")->get<long>());
+  // programs that are not a single expression are rejected
+  for (auto text : {"a; a + 1;", "b = a;", "b = a; b + 1;", ""}) {
+    ASSERT_TRUE(
+      parser.compile(pdcalc::calc_source{text, "expr"})
+    ) << parser.last_error();
+    EXPECT_FALSE(parser.assign_result("result")) << text;
+    EXPECT_EQ(
+      "expr: Program is not a single expression", parser.last_error()
+    ) << text;
+  }
+}
+
+/**
+ * Test that reading an identifier before it is assigned is reported.
+ */
+TEST_F(CalcParserColumnTest, UnboundSymbolTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("a", 0L);
+  // unbound identifiers are the unexpected token or right before it
+  for (auto text : {"nosuch + 1;", "a + nosuch;", "b = nosuch;", "nosuch;"}) {
+    EXPECT_FALSE(parser.compile(pdcalc::calc_source{text, "expr"})) << text;
+    EXPECT_EQ("nosuch", parser.unbound_symbol()) << text;
+  }
+  // other syntax errors and assigned identifiers are not unbound
+  for (auto text : {"b = = 1;", "b = 1; b + a +;", "a +;"}) {
+    EXPECT_FALSE(parser.compile(pdcalc::calc_source{text, "expr"})) << text;
+    EXPECT_EQ("", parser.unbound_symbol()) << text;
+  }
+  ASSERT_TRUE(
+    parser.compile(pdcalc::calc_source{"b = a; b + 1;", "expr"})
+  ) << parser.last_error();
+  EXPECT_EQ("", parser.unbound_symbol());
+}
+
+/**
+ * Calc parser memory resource test fixture.
+ */
+class CalcParserMemoryTest : public CalcParserTest {
+protected:
+  /**
+   * Memory resource counting the allocations made through it.
+   */
+  class counting_resource : public std::pmr::memory_resource {
+  public:
+    std::size_t n_allocs{};  // number of allocations
+    std::size_t in_use{};    // bytes currently allocated
+
+  private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+      n_allocs++;
+      in_use += bytes;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(
+      void* p, std::size_t bytes, std::size_t alignment) override
+    {
+      in_use -= bytes;
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override
+    {
+      return this == &other;
+    }
+  };
+};
+
+/**
+ * Test that a parser allocates from its memory resource and frees everything.
+ */
+TEST_F(CalcParserMemoryTest, ResourceTest)
+{
+  std::stringstream expected_sink;
+  pdcalc::calc_parser expected_parser{expected_sink};
+  auto expected = parse_samples(expected_parser);
+  counting_resource resource;
+  {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink, &resource};
+    EXPECT_EQ(&resource, parser.memory_resource());
+    EXPECT_FALSE(parser.arena());
+    EXPECT_EQ(expected, parse_samples(parser));
+    EXPECT_LT(0u, resource.n_allocs);
+  }
+  EXPECT_EQ(0u, resource.in_use);
+}
+
+/**
+ * Test that parsing with a per-parse arena gives the same results.
+ */
+TEST_F(CalcParserMemoryTest, ArenaTest)
+{
+  counting_resource heap_resource;
+  counting_resource arena_resource;
+  {
+    std::stringstream heap_sink;
+    pdcalc::calc_parser heap_parser{heap_sink, &heap_resource};
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink, &arena_resource};
+    parser.arena(true);
+    EXPECT_TRUE(parser.arena());
+    auto expected = parse_samples(heap_parser);
+    // arena is released and reused by each parse
+    for (unsigned i = 0; i < 3; i++)
+      EXPECT_EQ(expected, parse_samples(parser)) << "round " << i;
+    // program allocated from the arena can still be run
+    sink.str("");
+    ASSERT_TRUE(parser.run()) << parser.last_error();
+    heap_sink.str("");
+    ASSERT_TRUE(heap_parser.run()) << heap_parser.last_error();
+    EXPECT_EQ(heap_sink.str(), sink.str());
+    // switching back to the upstream resource works as well
+    parser.arena(false);
+    EXPECT_EQ(expected, parse_samples(parser));
+  }
+  EXPECT_EQ(0u, heap_resource.in_use);
+  EXPECT_EQ(0u, arena_resource.in_use);
+}
+
+/**
+ * Calc parser output test fixture.
+ */
+class CalcParserOutputTest : public CalcParserTest {
+protected:
+  /**
+   * String buffer counting the number of times it is flushed.
+   */
+  class counting_buf : public std::stringbuf {
+  public:
+    unsigned n_syncs{};  // number of flushes
+
+  protected:
+    int sync() override
+    {
+      n_syncs++;
+      return std::stringbuf::sync();
+    }
+  };
+};
+
+/**
+ * Test that results are formatted as if written to the sink with `<<`.
+ */
+TEST_F(CalcParserOutputTest, FormatTest)
+{
+  constexpr pdcalc::calc_source source{
+    "0.1 + 0.2; 0.00001 * 3; 123456789.5; -2.5 * 1000000000000.0 * 10000.0; "
+    "1.0 / 3; 100000.0; "
+    "1000000.0; -0.0; 0.0001; 9223372036854775807; -42; true; false;",
+    "format"
+  };
+  for (auto precision : {6, 1, 10, 17}) {
+    std::stringstream sink;
+    sink.precision(precision);
+    pdcalc::calc_parser parser{sink};
+    ASSERT_TRUE(parser(source)) << parser.last_error();
+    std::stringstream expected;
+    expected.precision(precision);
+    for (auto value : {
+      0.1 + 0.2, 0.00001 * 3, 123456789.5, -2.5 * 1e12 * 1e4, 1.0 / 3,
+      100000.0, 1000000.0, -0.0, 0.0001
+    })
+      expected << "<double> " << value << "\n";
+    expected << "<long> 9223372036854775807\n<long> -42\n" <<
+      "<bool> true\n<bool> false\n";
+    EXPECT_EQ(expected.str(), sink.str()) << "precision: " << precision;
+  }
+}
+
+/**
+ * Test that shortest format doubles read back as the same value.
+ */
+TEST_F(CalcParserOutputTest, ShortestTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  EXPECT_EQ(pdcalc::calc_double_format::general, parser.double_format());
+  parser.double_format(pdcalc::calc_double_format::shortest);
+  constexpr pdcalc::calc_source source{
+    "0.1 + 0.2; 1.0 / 3; 2.5; 1000000000000.0 * 10000000000000.0; 5 / 2.0; 3;",
+    "shortest"
+  };
+  ASSERT_TRUE(parser(source)) << parser.last_error();
+  EXPECT_EQ(
+    "<double> 0.30000000000000004\n"
+    "<double> 0.3333333333333333\n"
+    "<double> 2.5\n"
+    "<double> 1e+25\n"
+    "<double> 2.5\n"
+    "<long> 3\n",
+    sink.str()
+  );
+}
+
+/**
+ * Test that each flush policy writes the same output with fewer flushes.
+ */
+TEST_F(CalcParserOutputTest, FlushTest)
+{
+  std::stringstream expected_sink;
+  pdcalc::calc_parser expected_parser{expected_sink};
+  auto expected = parse_samples(expected_parser);
+  // every result is flushed with the default policy
+  counting_buf statement_buf;
+  std::ostream statement_sink{&statement_buf};
+  pdcalc::calc_parser statement_parser{statement_sink};
+  EXPECT_EQ(
+    pdcalc::calc_flush_policy::statement, statement_parser.flush_policy()
+  );
+  for (auto file : sample_files)
+    ASSERT_TRUE(statement_parser(test_data_dir_ / file));
+  EXPECT_EQ(expected, statement_buf.str());
+  EXPECT_LT(std::size(sample_files), statement_buf.n_syncs);
+  // otherwise only once per parse when the buffer is large enough
+  for (auto policy :
+    {pdcalc::calc_flush_policy::bytes, pdcalc::calc_flush_policy::end}) {
+    counting_buf buf;
+    std::ostream sink{&buf};
+    pdcalc::calc_parser parser{sink};
+    parser.flush_policy(policy);
+    for (auto file : sample_files)
+      ASSERT_TRUE(parser(test_data_dir_ / file));
+    EXPECT_EQ(expected, buf.str());
+    EXPECT_EQ(std::size(sample_files), buf.n_syncs);
+  }
+  // setting the byte count selects the bytes policy
+  counting_buf bytes_buf;
+  std::ostream bytes_sink{&bytes_buf};
+  pdcalc::calc_parser bytes_parser{bytes_sink};
+  bytes_parser.flush_bytes(64);
+  EXPECT_EQ(pdcalc::calc_flush_policy::bytes, bytes_parser.flush_policy());
+  EXPECT_EQ(64u, bytes_parser.flush_bytes());
+  for (auto file : sample_files)
+    ASSERT_TRUE(bytes_parser(test_data_dir_ / file));
+  EXPECT_EQ(expected, bytes_buf.str());
+  EXPECT_LT(std::size(sample_files), bytes_buf.n_syncs);
+  EXPECT_GT(statement_buf.n_syncs, bytes_buf.n_syncs);
+}
+
+/**
+ * Test that results before an error are written whatever the flush policy.
+ */
+TEST_F(CalcParserOutputTest, ErrorFlushTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.flush_policy(pdcalc::calc_flush_policy::end);
+  constexpr pdcalc::calc_source source{"1; 2.5; x = 0; 1 / x;", "error"};
+  EXPECT_FALSE(parser(source));
+  EXPECT_EQ("<long> 1\n<double> 2.5\n", sink.str());
+  // same when the error happens when running the compiled program again
+  sink.str("");
+  EXPECT_FALSE(parser.run());
+  EXPECT_EQ("<long> 1\n<double> 2.5\n", sink.str());
+}
+
+/**
+ * Calc parser lexer equivalence test fixture.
+ */
+class CalcParserLexerTest : public CalcParserSourceTest {
+protected:
+  /**
+   * Return the output, program dump, and any error from parsing a source.
+   *
+   * Since statement and error locations span tokens, lexers that give the
+   * same results for a source produce the same tokens with the same locations
+   * up to the first error.
+   *
+   * @param lexer Lexer to use
+   * @param source Input text and name
+   */
+  static std::string parse_result(
+    pdcalc::calc_lexer lexer, const pdcalc::calc_source& source)
+  {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    parser.lexer(lexer);
+    auto success = parser(source);
+    parser.dump_program(sink);
+    return sink.str() + (success ? "" : parser.last_error());
+  }
+
+  /**
+   * Token visitor writing the kind, value, and location of each token.
+   */
+  class token_writer : public pdcalc::calc_token_visitor {
+  public:
+    void visit(const pdcalc::calc_token& token) override
+    {
+      std::stringstream ss;
+      ss << token.kind << ' ';
+      // exact double values so that any rounding difference is seen
+      std::visit(
+        [&ss](auto value)
+        {
+          if constexpr (!std::is_same_v<decltype(value), std::monostate>)
+            ss << std::hexfloat << value << ' ';
+        },
+        token.value
+      );
+      const auto& loc = token.location;
+      ss << loc.begin_line << '.' << loc.begin_column << '-' <<
+        loc.end_line << '.' << loc.end_column;
+      tokens_.push_back(ss.str());
+    }
+
+    /**
+     * Return the tokens written so far.
+     */
+    auto& tokens() noexcept { return tokens_; }
+
+  private:
+    std::vector<std::string> tokens_;
+  };
+
+  /**
+   * Return each token and any error from lexing a source.
+   *
+   * @param lexer Lexer to use
+   * @param source Input text and name
+   */
+  static std::vector<std::string> lex_result(
+    pdcalc::calc_lexer lexer, const pdcalc::calc_source& source)
+  {
+    token_writer writer;
+    pdcalc::calc_parser parser{null_stream};
+    parser.lexer(lexer);
+    if (!parser.lex(source, writer))
+      writer.tokens().push_back(parser.last_error());
+    return std::move(writer.tokens());
+  }
+
+  /**
+   * Expect that the Flex lexer and hand-written scanner agree on a source.
+   *
+   * Both the parse results and the individual tokens are compared, as a token
+   * with a different value or location need not change the parse result.
+   *
+   * @param source Input text and name
+   */
+  static void expect_equivalent(const pdcalc::calc_source& source)
+  {
+    EXPECT_EQ(
+      parse_result(pdcalc::calc_lexer::flex, source),
+      parse_result(pdcalc::calc_lexer::simd, source)
+    ) << "source: \"" << source.text << "\"";
+    auto expected = lex_result(pdcalc::calc_lexer::flex, source);
+    auto actual = lex_result(pdcalc::calc_lexer::simd, source);
+    for (std::size_t i = 0; i < std::min(expected.size(), actual.size()); i++)
+      EXPECT_EQ(expected[i], actual[i])
+        << "token " << i << " of source: \"" << source.text << "\"";
+    EXPECT_EQ(expected.size(), actual.size())
+      << "source: \"" << source.text << "\"";
+  }
+};
+
+/**
+ * Test that each sample and each prefix of it gives the same results.
+ *
+ * Truncating the samples puts errors and the end of input at every position
+ * within comments, blanks, and tokens.
+ */
+TEST_F(CalcParserLexerTest, SampleTest)
+{
+  EXPECT_EQ(pdcalc::calc_lexer::flex, pdcalc::calc_parser{null_stream}.lexer());
+  for (auto file : sample_files) {
+    auto text = read_sample(file);
+    for (std::size_t size = 0; size <= text.size(); size++)
+      expect_equivalent({std::string_view{text}.substr(0, size), file});
+  }
+}
+
+/**
+ * Test that each input mode gives the same output as the Flex lexer.
+ */
+TEST_F(CalcParserLexerTest, InputTest)
+{
+  for (auto file : sample_files) {
+    auto expected = parse_sample(file);
+    for (auto mode :
+      {pdcalc::calc_input_mode::stdio, pdcalc::calc_input_mode::mmap}) {
+      std::stringstream sink;
+      pdcalc::calc_parser parser{sink};
+      parser.input_mode(mode).lexer(pdcalc::calc_lexer::simd);
+      ASSERT_TRUE(parser(test_data_dir_ / file)) << parser.last_error();
+      EXPECT_EQ(expected, sink.str()) << "sample: " << file;
+    }
+    auto text = read_sample(file);
+    text.append(pdcalc::calc_parser::buffer_padding, '\0');
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    parser.lexer(pdcalc::calc_lexer::simd);
+    ASSERT_TRUE(
+      parser.parse_buffer(text.data(), text.size(), file)
+    ) << parser.last_error();
+    EXPECT_EQ(expected, sink.str()) << "sample: " << file;
+  }
+  // errors opening files and bad buffers are reported the same way
+  pdcalc::calc_parser parser{null_stream};
+  parser.lexer(pdcalc::calc_lexer::simd);
+  EXPECT_FALSE(parser(test_data_dir_ / "not_a_sample.in"));
+  EXPECT_EQ(0u, parser.last_error().rfind("Error opening", 0));
+  std::string text{"1 + 1;"};
+  EXPECT_FALSE(parser.parse_buffer(text.data(), text.size(), "bad"));
+  EXPECT_EQ("Input buffer must end with 2 null bytes", parser.last_error());
+}
+
+/**
+ * Test that tricky inputs give the same results with both lexers.
+ *
+ * Runs of blanks, newlines, and comment text longer than a vector register are
+ * included so that the vector loops and their scalar tails are both used.
+ */
+TEST_F(CalcParserLexerTest, TokenTest)
+{
+  const std::string long_blanks(37, ' ');
+  const std::string long_newlines(70, '\n');
+  const std::string long_comment = "#" + std::string(100, 'c');
+  const std::string sources[] = {
+    // operators, including two-character ones split by blanks
+    "a = 3; a += 2; a -= 1; a *= 4; a /= 2; a;",
+    "1 << 3; 64 >> 2; 1 <= 2; 2 >= 1; 1 == 1; 1 != 2; true && false;",
+    "true || false; !true; ~5; 5 | 2; 5 & 4; 5 ^ 1; 7 % 4; 1 < 2; 2 > 1;",
+    "1 < < 2;", "1 > = 2;", "a = = 1;", "1 & & 1;",
+    // negative literals versus binary minus
+    "3-2; 3 -2; 3 - -2; -3.-2.5; --2; -.5; 1.2.3;",
+    // keywords, function names, and identifiers that start with them
+    "exp(1.); log(2.); log2(8.); log10(100.); sqrt(4.); max(1, 2); min(1, 2);",
+    "sin(0.); cos(0.); tan(0.); truex = 1; false_ = 2; log2x = 3; expo = 4;",
+    "truex + false_ + log2x + expo; _a1 = 5; _a1; A_b = _a1; A_b;",
+    // blanks, tabs, carriage returns, newlines, and comments
+    "\t1\r\n+\t\t2;  # comment ; 3;\n\n\n4\n;#",
+    "# only a comment",
+    "#\n#\n\n1;\r\n#x\r\n",
+    long_blanks + "1" + long_blanks + "+" + long_newlines + "2;" + long_blanks,
+    long_comment + "\n" + long_comment + long_newlines + "1;" + long_comment,
+    long_newlines + long_blanks + "@",
+    // unrecognized tokens, including a null byte
+    "1 + $;", "1;\n  ?", std::string{"1 +\0 2;", 8}, "x = 1 .5;",
+    // literal conversion errors
+    "9223372036854775808;", "-9223372036854775809;", std::string(400, '9'),
+    // syntax and evaluation errors
+    "1 +;", "(1 + 2;", "undefined_name;", "1 / 0;", ";"
+  };
+  for (const auto& text : sources)
+    expect_equivalent({text, "tokens"});
+}
+
+/**
+ * Calc parser performance counter test fixture.
+ */
+class CalcParserStatsTest : public CalcParserSourceTest {
+protected:
+  // source with known counters. the first lookups of x and y are made when
+  // lexing and sqrt(4.) is folded but still counted as a call
+  static constexpr pdcalc::calc_source source_{
+    "x = 2;\ny = sqrt(x) + sqrt(4.);\nmax(x, 3);\ny > 1;\n# c\n", "stats"
+  };
+
+  /**
+   * Expect the counters from parsing `source_` the given number of times.
+   *
+   * @param stats Performance counters
+   * @param n_parses Number of times `source_` was parsed
+   */
+  static void expect_counts(const pdcalc::calc_stats& stats, unsigned n_parses)
+  {
+    constexpr auto b = 0u, l = 1u, d = 2u;
+    EXPECT_EQ(n_parses * source_.text.size(), stats.bytes_read);
+    EXPECT_EQ(n_parses * 27u, stats.tokens);
+    EXPECT_EQ(n_parses * 4u, stats.statements());
+    EXPECT_EQ(n_parses * 1u, stats.prints[b]);
+    EXPECT_EQ(n_parses * 1u, stats.prints[l]);
+    EXPECT_EQ(0u, stats.prints[d]);
+    EXPECT_EQ(0u, stats.assignments[b]);
+    EXPECT_EQ(n_parses * 1u, stats.assignments[l]);
+    EXPECT_EQ(n_parses * 1u, stats.assignments[d]);
+    EXPECT_EQ(n_parses * 5u, stats.symbol_lookups);
+    EXPECT_EQ(n_parses * 2u, stats.symbol_inserts);
+    EXPECT_EQ(n_parses * 2u, stats.calls(pdcalc::calc_builtin::sqrt));
+    EXPECT_EQ(n_parses * 1u, stats.calls(pdcalc::calc_builtin::max));
+    EXPECT_EQ(0u, stats.calls(pdcalc::calc_builtin::min));
+  }
+};
+
+/**
+ * Test that counters are the same with each lexer and backend.
+ */
+TEST_F(CalcParserStatsTest, CountTest)
+{
+  for (auto lexer : {pdcalc::calc_lexer::flex, pdcalc::calc_lexer::simd}) {
+    for (auto backend :
+      {
+        pdcalc::calc_backend::vm,
+        pdcalc::calc_backend::tree,
+        pdcalc::calc_backend::jit
+      }
+    ) {
+      pdcalc::calc_parser parser{null_stream};
+      parser.lexer(lexer).backend(backend).stats(true);
+      ASSERT_TRUE(parser(source_)) << parser.last_error();
+      expect_counts(parser.stats(), 1);
+    }
+  }
+}
+
+/**
+ * Test that nothing is counted unless enabled and counters accumulate.
+ */
+TEST_F(CalcParserStatsTest, AccumulateTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  EXPECT_FALSE(parser.stats_enabled());
+  ASSERT_TRUE(parser(source_)) << parser.last_error();
+  expect_counts(parser.stats(), 0);
+  EXPECT_EQ(0, parser.stats().wall(pdcalc::calc_phase::parse).count());
+  // parsing again accumulates, while disabling keeps the counters
+  parser.stats(true);
+  EXPECT_TRUE(parser.stats_enabled());
+  ASSERT_TRUE(parser(source_)) << parser.last_error();
+  ASSERT_TRUE(parser(source_)) << parser.last_error();
+  parser.stats(false);
+  ASSERT_TRUE(parser(source_)) << parser.last_error();
+  expect_counts(parser.stats(), 2);
+  // counters from another parser can be added
+  auto stats = parser.stats();
+  stats += parser.stats();
+  expect_counts(stats, 4);
+  // running again only looks up and inserts symbols
+  parser.reset_stats().stats(true);
+  expect_counts(parser.stats(), 0);
+  ASSERT_TRUE(parser.run()) << parser.last_error();
+  EXPECT_EQ(0u, parser.stats().tokens);
+  EXPECT_EQ(3u, parser.stats().symbol_lookups);
+  EXPECT_EQ(2u, parser.stats().symbol_inserts);
+}
+
+/**
+ * Test that the phases are timed when parsing a file.
+ *
+ * Short phases can take less than a clock tick, so we only check that some
+ * time was measured in total.
+ */
+TEST_F(CalcParserStatsTest, TimeTest)
+{
+  for (auto lexer : {pdcalc::calc_lexer::flex, pdcalc::calc_lexer::simd}) {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    parser.lexer(lexer).stats(true);
+    ASSERT_TRUE(parser(test_data_dir_ / sample_files[0])) <<
+      parser.last_error();
+    const auto& stats = parser.stats();
+    EXPECT_EQ(read_sample(sample_files[0]).size(), stats.bytes_read);
+    std::chrono::nanoseconds wall{};
+    for (auto phase :
+      {
+        pdcalc::calc_phase::io,
+        pdcalc::calc_phase::lex,
+        pdcalc::calc_phase::parse,
+        pdcalc::calc_phase::eval,
+        pdcalc::calc_phase::output
+      }
+    ) {
+      EXPECT_GE(stats.wall(phase).count(), 0) <<
+        "phase: " << pdcalc::calc_phase_name(phase);
+      EXPECT_GE(stats.cpu(phase).count(), 0) <<
+        "phase: " << pdcalc::calc_phase_name(phase);
+      wall += stats.wall(phase);
+    }
+    EXPECT_GT(wall.count(), 0);
+  }
+}
+
+/**
+ * Calc parser incremental recomputation test fixture.
+ */
+class CalcParserRecomputeTest : public CalcParserTest {
+protected:
+  /**
+   * Return the results as a string of statement indices and values.
+   *
+   * @param results Statement results
+   */
+  static std::string format(const std::vector<pdcalc::calc_result>& results)
+  {
+    std::stringstream ss;
+    for (const auto& result : results) {
+      ss << result.statement << ": ";
+      if (result.name.size())
+        ss << result.name << " = ";
+      std::visit([&ss](auto value) { ss << value; }, result.value);
+      ss << "; ";
+    }
+    return ss.str();
+  }
+
+  /**
+   * Expect the symbols of a parser to match those of running the whole text.
+   *
+   * @param parser Parser with a loaded program
+   * @param text Loaded program text
+   * @param inputs Names of the input symbols, which are copied first
+   * @param outputs Names of the symbols the program assigns
+   */
+  static void expect_full_run(
+    const pdcalc::calc_parser& parser,
+    std::string_view text,
+    std::initializer_list<std::string_view> inputs,
+    std::initializer_list<std::string_view> outputs)
+  {
+    pdcalc::calc_parser full{null_stream};
+    for (auto name : inputs)
+      full.add_symbol(name, parser.get_symbol(name)->value());
+    ASSERT_TRUE(full({text, "full"})) << full.last_error();
+    for (auto name : outputs) {
+      auto expected = full.get_symbol(name);
+      auto actual = parser.get_symbol(name);
+      ASSERT_TRUE(expected && actual) << "symbol: " << name;
+      EXPECT_EQ(expected->value(), actual->value()) << "symbol: " << name;
+    }
+  }
+};
+
+/**
+ * Test that only the statements depending on rebound symbols are evaluated.
+ */
+TEST_F(CalcParserRecomputeTest, DependencyTest)
+{
+  constexpr std::string_view text{
+    "a = x + 1;\nb = y * 2;\nc = a + b;\na > 3;\nz = 7;\nz + c;\n"
+  };
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.add_symbol("x", 1L).add_symbol("y", 2L);
+  std::vector<pdcalc::calc_result> results;
+  ASSERT_TRUE(parser.load({text, "deps"}, results)) << parser.last_error();
+  EXPECT_EQ(
+    "0: a = 2; 1: b = 4; 2: c = 6; 3: 0; 4: z = 7; 5: 13; ", format(results)
+  );
+  // nothing rebound, nothing evaluated
+  results.clear();
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("", format(results));
+  // only statements reading x, a, and c are evaluated
+  parser.add_symbol("x", 5L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("0: a = 6; 2: c = 10; 3: 1; 5: 17; ", format(results));
+  expect_full_run(parser, text, {"x", "y"}, {"a", "b", "c", "z"});
+  // rebinding to the same value only evaluates the statements reading it
+  results.clear();
+  parser.add_symbol("y", 2L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("1: b = 4; ", format(results));
+  // assignments overwrite rebound symbols as running the program would
+  results.clear();
+  parser.add_symbol("z", 100L).add_symbol("unused", 1L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("4: z = 7; ", format(results));
+  EXPECT_EQ(7L, parser.get_symbol("z")->get<long>());
+  expect_full_run(parser, text, {"x", "y"}, {"a", "b", "c", "z"});
+  // nothing is written to the sink
+  EXPECT_EQ("", sink.str());
+}
+
+/**
+ * Test that rebinding an input with another type compiles the program again.
+ */
+TEST_F(CalcParserRecomputeTest, TypeChangeTest)
+{
+  constexpr std::string_view text{"y = x * 2;\ny + 1;\nw = 3;\nw < y;\n"};
+  pdcalc::calc_parser parser{null_stream};
+  parser.add_symbol("x", 1L);
+  std::vector<pdcalc::calc_result> results;
+  ASSERT_TRUE(parser.load({text, "types"}, results)) << parser.last_error();
+  EXPECT_EQ("0: y = 2; 1: 3; 2: w = 3; 3: 0; ", format(results));
+  // y and everything depending on it changes type
+  results.clear();
+  parser.add_symbol("x", 1.75);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("0: y = 3.5; 1: 4.5; 3: 1; ", format(results));
+  EXPECT_EQ(3.5, parser.get_symbol("y")->get<double>());
+  EXPECT_TRUE(std::holds_alternative<double>(results[1].value));
+  expect_full_run(parser, text, {"x"}, {"y", "w"});
+  // and back again
+  results.clear();
+  parser.add_symbol("x", 2L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("0: y = 4; 1: 5; 3: 1; ", format(results));
+  EXPECT_TRUE(std::holds_alternative<long>(results[1].value));
+  expect_full_run(parser, text, {"x"}, {"y", "w"});
+}
+
+/**
+ * Test that errors stop recomputation and that everything is evaluated after.
+ */
+TEST_F(CalcParserRecomputeTest, ErrorTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  std::vector<pdcalc::calc_result> results;
+  EXPECT_FALSE(parser.recompute(results));
+  EXPECT_EQ("No program loaded for recomputation", parser.last_error());
+  constexpr std::string_view text{"a = 12 / x;\nb = x % 5;\nc = 1;\n"};
+  parser.add_symbol("x", 4L);
+  ASSERT_TRUE(parser.load({text, "errors"}, results)) << parser.last_error();
+  EXPECT_EQ("0: a = 3; 1: b = 4; 2: c = 1; ", format(results));
+  // evaluation error stops at the failing statement
+  results.clear();
+  parser.add_symbol("x", 0L);
+  EXPECT_FALSE(parser.recompute(results));
+  EXPECT_NE(parser.last_error().find("errors:1.5-10"), std::string::npos) <<
+    parser.last_error();
+  EXPECT_EQ("", format(results));
+  // all statements are evaluated after an error
+  parser.add_symbol("x", 6L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("0: a = 2; 1: b = 1; 2: c = 1; ", format(results));
+  // program does not compile with a double operand of %
+  results.clear();
+  parser.add_symbol("x", 6.);
+  EXPECT_FALSE(parser.recompute(results));
+  EXPECT_NE(parser.last_error().find("errors:2"), std::string::npos) <<
+    parser.last_error();
+  parser.add_symbol("x", 3L);
+  ASSERT_TRUE(parser.recompute(results)) << parser.last_error();
+  EXPECT_EQ("0: a = 4; 1: b = 3; 2: c = 1; ", format(results));
+  // any other parse discards the loaded program
+  ASSERT_TRUE(parser(pdcalc::calc_source{"1;", "other"})) <<
+    parser.last_error();
+  EXPECT_FALSE(parser.recompute(results));
+}
+
+/**
+ * Calc parser snapshot test fixture.
+ */
+class CalcParserSnapshotTest : public CalcParserTest {
+protected:
+  /**
+   * Remove the snapshot file written by the test.
+   */
+  void TearDown() override
+  {
+    std::filesystem::remove(path_);
+  }
+
+  // snapshot file path unique to the test
+  const std::filesystem::path path_{
+    std::filesystem::temp_directory_path() / (
+      std::string{"pdcalc_"} +
+      ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+      ".snap"
+    )
+  };
+};
+
+/**
+ * Test that restoring a snapshot restores all symbols and the position.
+ */
+TEST_F(CalcParserSnapshotTest, RoundTripTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  constexpr std::string_view text{"a = 1;\nb = -2.5;\nc = a > b;\nd = -a;\n"};
+  ASSERT_TRUE(parser({text, "pre"})) << parser.last_error();
+  EXPECT_EQ(1U, parser.position().input);
+  ASSERT_TRUE(parser.save_snapshot(path_)) << parser.last_error();
+  // existing symbols are kept and the snapshot symbols are added
+  pdcalc::calc_parser restored{null_stream};
+  restored.add_symbol("a", 7.0).add_symbol("e", true);
+  ASSERT_TRUE(restored.restore_snapshot(path_)) << restored.last_error();
+  for (auto name : {"a", "b", "c", "d"})
+    EXPECT_EQ(
+      parser.get_symbol(name)->value(), restored.get_symbol(name)->value()
+    ) << "symbol: " << name;
+  EXPECT_TRUE(restored.get_symbol("e")->get<bool>());
+  EXPECT_EQ(1U, restored.position().input);
+  EXPECT_EQ(1U, restored.position().line);
+  EXPECT_EQ(1U, restored.position().column);
+  // symbol types are taken from the restored values
+  std::stringstream sink;
+  pdcalc::calc_parser typed{sink};
+  ASSERT_TRUE(typed.restore_snapshot(path_)) << typed.last_error();
+  ASSERT_TRUE(typed(pdcalc::calc_source{"a % 2; b * 2; c; d;", "typed"}))
+    << typed.last_error();
+  EXPECT_EQ("<long> 1\n<double> -5\n<bool> true\n<long> -1\n", sink.str());
+}
+
+/**
+ * Test that a run interrupted after a checkpoint resumes where it stopped.
+ */
+TEST_F(CalcParserSnapshotTest, CheckpointTest)
+{
+  constexpr std::string_view text{"x = 2; y = x * 3;\ny + 1;\nz = y / 0;\n"};
+  // the division by zero stops the run after the last checkpoint
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.checkpoint(path_, 2);
+  EXPECT_EQ(path_, parser.checkpoint_path());
+  EXPECT_EQ(2U, parser.checkpoint_interval());
+  ASSERT_FALSE(parser({text, "run"}));
+  EXPECT_EQ("run:3.5-9: 6 / 0 is division by zero", parser.last_error());
+  EXPECT_EQ(2U, parser.position().line);
+  EXPECT_EQ(7U, parser.position().column);
+  EXPECT_EQ("<long> 7\n", sink.str());
+  // the checkpoint is just past the second statement
+  pdcalc::calc_parser resumed{sink};
+  ASSERT_TRUE(resumed.restore_snapshot(path_)) << resumed.last_error();
+  auto position = resumed.position();
+  EXPECT_EQ(0U, position.input);
+  EXPECT_EQ(1U, position.line);
+  EXPECT_EQ(18U, position.column);
+  EXPECT_EQ(6L, resumed.get_symbol("y")->get<long>());
+  EXPECT_FALSE(resumed.get_symbol("z"));
+  // resuming gives the rest of the output and the same error location
+  auto rest = text.substr(pdcalc::calc_position_offset(text, position));
+  EXPECT_EQ("\ny + 1;\nz = y / 0;\n", rest);
+  sink.str("");
+  ASSERT_FALSE(resumed({rest, "run"}));
+  EXPECT_EQ("run:3.5-9: 6 / 0 is division by zero", resumed.last_error());
+  EXPECT_EQ("<long> 7\n", sink.str());
+  // a complete input moves the position to the start of the next one
+  ASSERT_TRUE(resumed(pdcalc::calc_source{"z = y;", "next"}))
+    << resumed.last_error();
+  position = resumed.position();
+  EXPECT_EQ(1U, position.input);
+  EXPECT_EQ(1U, position.line);
+  EXPECT_EQ(1U, position.column);
+}
+
+/**
+ * Test that truncated, corrupt, or missing snapshots are rejected.
+ */
+TEST_F(CalcParserSnapshotTest, CorruptTest)
+{
+  pdcalc::calc_parser parser{null_stream};
+  ASSERT_TRUE(parser(pdcalc::calc_source{"alpha = 1; beta = 2.0;", "pre"}));
+  ASSERT_TRUE(parser.save_snapshot(path_)) << parser.last_error();
+  std::string contents;
+  {
+    std::ifstream in{path_, std::ios::binary};
+    contents.assign(std::istreambuf_iterator<char>{in}, {});
+  }
+  // write contents to the snapshot file and expect restoring to fail
+  auto expect_rejected = [this](std::string_view data, std::string_view error)
+  {
+    {
+      std::ofstream out{path_, std::ios::binary | std::ios::trunc};
+      out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    pdcalc::calc_parser restored{null_stream};
+    EXPECT_FALSE(restored.restore_snapshot(path_));
+    EXPECT_NE(restored.last_error().npos, restored.last_error().find(error))
+      << restored.last_error();
+    EXPECT_FALSE(restored.get_symbol("alpha"));
+  };
+  // truncated
+  expect_rejected(
+    std::string_view{contents}.substr(0, contents.size() - 1),
+    "truncated or corrupt"
+  );
+  // flipped name byte
+  auto corrupt = contents;
+  corrupt[corrupt.size() - 10] ^= 1;
+  expect_rejected(corrupt, "truncated or corrupt");
+  // not a snapshot or empty
+  expect_rejected("a = 1;\n", "is not a pdcalc snapshot");
+  expect_rejected("", "is not a pdcalc snapshot");
+  // missing file
+  std::filesystem::remove(path_);
+  EXPECT_FALSE(parser.restore_snapshot(path_));
+  EXPECT_NE(parser.last_error().npos, parser.last_error().find("opening"));
+}
+
+/**
+ * Calc parser statement cache test fixture.
+ */
+class CalcParserCacheTest : public CalcParserTest {
+protected:
+  /**
+   * Parse a source with a parser and with a fresh uncached parser.
+   *
+   * The output and last error are expected to be the same as those of the
+   * uncached parser, which starts with the same values of the given symbols.
+   *
+   * @param parser Parser to use, writing to `sink_`
+   * @param source Input text and name
+   * @param names Names of the parser symbols the input may read
+   * @returns Parse status
+   */
+  bool parse_same(
+    pdcalc::calc_parser& parser,
+    const pdcalc::calc_source& source,
+    std::initializer_list<std::string_view> names = {})
+  {
+    std::stringstream expected_sink;
+    pdcalc::calc_parser expected{expected_sink};
+    for (auto name : names)
+      if (auto sym = parser.get_symbol(name))
+        expected.add_symbol(name, sym->value());
+    auto expected_status = expected(source);
+    sink_.str("");
+    auto status = parser(source);
+    EXPECT_EQ(expected_status, status);
+    EXPECT_EQ(expected.last_error(), parser.last_error());
+    EXPECT_EQ(expected_sink.str(), sink_.str());
+    return status;
+  }
+
+  std::stringstream sink_;
+};
+
+/**
+ * Test that inputs only differing in layout share an entry.
+ */
+TEST_F(CalcParserCacheTest, HitTest)
+{
+  pdcalc::calc_parser parser{sink_};
+  parser.stats(true).cache_capacity(4);
+  EXPECT_EQ(4U, parser.cache_capacity());
+  parser.add_symbol("d", 1L);
+  constexpr std::string_view text{"a = 1;\nb = a / d; b + 1;"};
+  ASSERT_TRUE(parse_same(parser, {text, "in"}, {"d"})) << parser.last_error();
+  EXPECT_EQ("<long> 2\n", sink_.str());
+  EXPECT_EQ(0U, parser.stats().cache_hits);
+  EXPECT_EQ(1U, parser.stats().cache_misses);
+  // layout and comments do not matter and errors have the input locations.
+  // hits are not lexed
+  auto tokens = parser.stats().tokens;
+  parser.add_symbol("d", 0L);
+  ASSERT_FALSE(
+    parse_same(parser, {"a=1;  # one\n\n b=a/d;b+1;", "in"}, {"d"})
+  );
+  EXPECT_EQ("in:3.4-6: 1 / 0 is division by zero", parser.last_error());
+  EXPECT_EQ(1U, parser.stats().cache_hits);
+  EXPECT_EQ(1U, parser.stats().cache_misses);
+  EXPECT_EQ(tokens, parser.stats().tokens);
+  parser.add_symbol("d", 2L);
+  ASSERT_TRUE(parse_same(parser, {text, "in"}, {"d"})) << parser.last_error();
+  EXPECT_EQ("<long> 1\n", sink_.str());
+  EXPECT_EQ(2U, parser.stats().cache_hits);
+  // the program of a hit can be run again
+  sink_.str("");
+  ASSERT_TRUE(parser.run()) << parser.last_error();
+  EXPECT_EQ("<long> 1\n", sink_.str());
+  // tokens that whitespace separates never share an entry
+  parser.add_symbol("a", 5L);
+  ASSERT_TRUE(parse_same(parser, {"a - 1;", "in"}, {"a"}))
+    << parser.last_error();
+  parse_same(parser, {"a -1;", "in"}, {"a"});
+  EXPECT_EQ(2U, parser.stats().cache_hits);
+  EXPECT_EQ(3U, parser.stats().cache_misses);
+  parse_same(parser, {"a-1;", "in"}, {"a"});
+}
+
+/**
+ * Test that entries are not used once a symbol they read changes type.
+ */
+TEST_F(CalcParserCacheTest, TypeChangeTest)
+{
+  pdcalc::calc_parser parser{sink_};
+  parser.stats(true).cache_capacity(4);
+  parser.add_symbol("x", 3L);
+  constexpr pdcalc::calc_source source{"y = x % 2; y;", "in"};
+  ASSERT_TRUE(parse_same(parser, source, {"x"})) << parser.last_error();
+  EXPECT_EQ("<long> 1\n", sink_.str());
+  // x is now a double, which % does not take, so the entry is not used
+  parser.add_symbol("x", 3.);
+  ASSERT_FALSE(parse_same(parser, source, {"x"}));
+  parser.add_symbol("x", 4L);
+  ASSERT_TRUE(parse_same(parser, source, {"x"})) << parser.last_error();
+  EXPECT_EQ("<long> 0\n", sink_.str());
+  EXPECT_EQ(1U, parser.stats().cache_hits);
+  EXPECT_EQ(2U, parser.stats().cache_misses);
+  // symbols assigned before they are read do not invalidate entries
+  parser.add_symbol("y", true);
+  ASSERT_TRUE(parse_same(parser, source, {"x"})) << parser.last_error();
+  EXPECT_EQ(2U, parser.stats().cache_hits);
+  // changing the optimization setting empties the cache
+  parser.optimize(false);
+  ASSERT_TRUE(parse_same(parser, source, {"x"})) << parser.last_error();
+  EXPECT_EQ(3U, parser.stats().cache_misses);
+}
+
+/**
+ * Test that the least recently used entry is evicted.
+ */
+TEST_F(CalcParserCacheTest, EvictTest)
+{
+  pdcalc::calc_parser parser{sink_};
+  parser.stats(true).cache_capacity(2);
+  for (auto text : {"1;", "2;", "1;", "3;", "1;", "2;"})
+    ASSERT_TRUE(parse_same(parser, {text, "in"})) << parser.last_error();
+  // only the second and third 1 are hits, as 3 evicted 2 and 2 evicted 3
+  EXPECT_EQ(2U, parser.stats().cache_hits);
+  EXPECT_EQ(4U, parser.stats().cache_misses);
+  // shrinking evicts the least recently used entry, 1
+  parser.cache_capacity(1);
+  ASSERT_TRUE(parse_same(parser, {"2;", "in"})) << parser.last_error();
+  ASSERT_TRUE(parse_same(parser, {"1;", "in"})) << parser.last_error();
+  EXPECT_EQ(3U, parser.stats().cache_hits);
+  EXPECT_EQ(5U, parser.stats().cache_misses);
+  // a zero capacity disables caching
+  parser.cache_capacity(0);
+  ASSERT_TRUE(parse_same(parser, {"1;", "in"})) << parser.last_error();
+  EXPECT_EQ(3U, parser.stats().cache_hits);
+  EXPECT_EQ(5U, parser.stats().cache_misses);
+}
+
+/**
+ * Calc parser error recovery test fixture.
+ */
+class CalcParserKeepGoingTest : public CalcParserTest {
+protected:
+  // statements with a syntax error, a lexer error, and evaluation errors
+  static constexpr std::string_view text_{
+    "a = 1; a + 2;\nb = a +;\nc = 2 $ 3 $;\na / 0;\nd = a * 4; d;\n"
+    "b * 2; e = a / 0; e + 1;\nd > a;\n"
+  };
+};
+
+/**
+ * Test that all statements after failed ones are evaluated with each lexer.
+ */
+TEST_F(CalcParserKeepGoingTest, RecoverTest)
+{
+  for (auto lexer : {pdcalc::calc_lexer::flex, pdcalc::calc_lexer::simd}) {
+    std::stringstream sink;
+    pdcalc::calc_parser parser{sink};
+    parser.lexer(lexer).keep_going(true);
+    EXPECT_TRUE(parser.keep_going());
+    EXPECT_FALSE(parser({text_, "in"}));
+    EXPECT_EQ(
+      "<long> 3\n<error>\n<error>\n<error>\n<long> 4\n<error>\n<error>\n"
+        "<error>\n<bool> true\n",
+      sink.str()
+    );
+    const std::vector<std::string> errors{
+      "in:2.8: syntax error, unexpected ;",
+      "in:3.7: Unrecognized token '$'",
+      "in:4.1-5: 1 / 0 is division by zero",
+      "in:6.3: syntax error, unexpected *, expecting =",
+      "in:6.12-16: 1 / 0 is division by zero",
+      "in:6.21: syntax error, unexpected +, expecting ="
+    };
+    EXPECT_EQ(errors, format_errors(parser));
+    EXPECT_EQ(errors.back(), parser.last_error());
+    // locations and messages are also available separately
+    const auto& error = parser.errors()[4];
+    EXPECT_EQ("in", error.location.input);
+    EXPECT_EQ(6U, error.location.begin_line);
+    EXPECT_EQ(12U, error.location.begin_column);
+    EXPECT_EQ(6U, error.location.end_line);
+    EXPECT_EQ(17U, error.location.end_column);
+    EXPECT_EQ("1 / 0 is division by zero", error.message);
+    EXPECT_EQ(4L, parser.get_symbol("d")->get<long>());
+    EXPECT_FALSE(parser.get_symbol("e"));
+    // the input was completed and errors are only kept for the last parse
+    EXPECT_EQ(1U, parser.position().input);
+    EXPECT_TRUE(parser(pdcalc::calc_source{"d;", "next"}))
+      << parser.last_error();
+    EXPECT_TRUE(parser.errors().empty());
+    // an unterminated last statement is an error too
+    EXPECT_FALSE(parser(pdcalc::calc_source{"1 +", "last"}));
+    ASSERT_EQ(1U, parser.errors().size());
+    EXPECT_EQ("last:1.4: syntax error, unexpected end of file",
+      parser.last_error());
+  }
+}
+
+/**
+ * Test that the first error stops the parse by default.
+ */
+TEST_F(CalcParserKeepGoingTest, StopTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  EXPECT_FALSE(parser.keep_going());
+  EXPECT_FALSE(parser({text_, "in"}));
+  EXPECT_EQ("<long> 3\n", sink.str());
+  EXPECT_EQ("in:2.8: syntax error, unexpected ;", parser.last_error());
+  EXPECT_TRUE(parser.errors().empty());
+  EXPECT_FALSE(parser.get_symbol("d"));
+  // the first error in a statement is kept, not one found while skipping it
+  EXPECT_FALSE(parser(pdcalc::calc_source{"1 + * $;", "in"}));
+  EXPECT_EQ("in:1.5: syntax error, unexpected *", parser.last_error());
+}
+
+/**
+ * Test that statements of a cached input that fail to evaluate are skipped.
+ */
+TEST_F(CalcParserKeepGoingTest, CacheTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.keep_going(true).cache_capacity(1).stats(true);
+  parser.add_symbol("x", 6L).add_symbol("y", 2L);
+  constexpr pdcalc::calc_source source{"a = x / y; a + 1; x;", "in"};
+  ASSERT_TRUE(parser(source)) << parser.last_error();
+  EXPECT_EQ("<long> 4\n<long> 6\n", sink.str());
+  // a keeps its value, so the rest of the input is compiled again
+  sink.str("");
+  parser.add_symbol("y", 0L);
+  parser.add_symbol("a", 1.);
+  EXPECT_FALSE(parser(source));
+  EXPECT_EQ(1U, parser.stats().cache_hits);
+  EXPECT_EQ("<error>\n<double> 2\n<long> 6\n", sink.str());
+  ASSERT_EQ(1U, parser.errors().size());
+  EXPECT_EQ("in:1.5-9: 6 / 0 is division by zero", parser.last_error());
+}
+
+/**
+ * Test that a symbol keeps the type of its value after a failed assignment.
+ */
+TEST_F(CalcParserKeepGoingTest, AssignTest)
+{
+  std::stringstream sink;
+  pdcalc::calc_parser parser{sink};
+  parser.keep_going(true);
+  EXPECT_FALSE(parser(pdcalc::calc_source{"x = 1.5; x = 1 / 0; x + 1;", "in"}));
+  EXPECT_EQ("<error>\n<double> 2.5\n", sink.str());
+  ASSERT_EQ(1U, parser.errors().size());
+  // an undefined symbol is still undefined
+  sink.str("");
+  EXPECT_FALSE(parser(pdcalc::calc_source{"y = 1 / 0; y;", "in"}));
+  EXPECT_EQ("<error>\n<error>\n", sink.str());
+  ASSERT_EQ(2U, parser.errors().size());
+  EXPECT_EQ("in:1.13: syntax error, unexpected ;, expecting =",
+    format_errors(parser).back());
+}
+
+/**
+ * Calc parser result visitor test fixture.
+ */
+class CalcParserVisitorTest : public CalcParserTest {
+protected:
+  /**
+   * Visitor recording every result and error it receives.
+   */
+  class recording_visitor : public pdcalc::calc_result_visitor {
+  public:
+    /**
+     * Recorded result.
+     */
+    struct result {
+      std::size_t statement;
+      std::string input;
+      std::uint32_t begin_line;
+      std::uint32_t begin_column;
+      std::uint32_t end_line;
+      std::uint32_t end_column;
+      pdcalc::calc_symbol::value_type value;
+
+      bool operator==(const result& other) const
+      {
+        return statement == other.statement && input == other.input &&
+          begin_line == other.begin_line &&
+          begin_column == other.begin_column &&
+          end_line == other.end_line && end_column == other.end_column &&
+          value == other.value;
+      }
+    };
+
+    void visit(
+      std::size_t statement,
+      const pdcalc::calc_location& location,
+      const pdcalc::calc_symbol::value_type& value) override
+    {
+      results.push_back(
+        {
+          statement,
+          std::string{location.input},
+          location.begin_line,
+          location.begin_column,
+          location.end_line,
+          location.end_column,
+          value
+        }
+      );
+    }
+
+    /**
+     * Recorded error, with the location formatted before the message.
+     */
+    struct error {
+      std::size_t statement;
+      std::string message;
+
+      bool operator==(const error& other) const
+      {
+        return statement == other.statement && message == other.message;
+      }
+    };
+
+    void visit_error(
+      std::size_t statement,
+      const pdcalc::calc_location& location,
+      std::string_view message) override
+    {
+      std::stringstream stream;
+      stream << location << ": " << message;
+      errors.push_back({statement, stream.str()});
+    }
+
+    void flush() override { n_flushes++; }
+
+    std::vector<result> results;
+    std::vector<error> errors;
+    std::size_t n_flushes{};
+  };
+};
+
+/**
+ * Test that exact results and their locations are passed with each backend.
+ */
+TEST_F(CalcParserVisitorTest, ResultTest)
+{
+  using result = recording_visitor::result;
+  // 0.1 + 0.2 is not exactly 0.3 and would be rounded by the text output
+  const std::vector<result> expected{
+    {2, "in", 2, 14, 2, 16, 0.1 + 0.2},
+    {3, "in", 3, 3, 3, 9, false}
+  };
+  for (auto lexer : {pdcalc::calc_lexer::flex, pdcalc::calc_lexer::simd}) {
+    for (
+      auto backend : {
+        pdcalc::calc_backend::vm,
+        pdcalc::calc_backend::tree,
+        pdcalc::calc_backend::jit
+      }
+    ) {
+      std::stringstream sink;
+      recording_visitor visitor;
+      pdcalc::calc_parser parser{sink};
+      parser.lexer(lexer).backend(backend).visitor(&visitor);
+      EXPECT_EQ(&visitor, &parser.visitor());
+      constexpr pdcalc::calc_source source{
+        "a = 0.1;\nb = a + 0.2; b;\n  a > b;", "in"
+      };
+      ASSERT_TRUE(parser(source)) << parser.last_error();
+      EXPECT_EQ(expected, visitor.results);
+      EXPECT_TRUE(visitor.errors.empty());
+      EXPECT_EQ(1U, visitor.n_flushes);
+      EXPECT_TRUE(sink.str().empty());
+    }
+  }
+}
+
+/**
+ * Test that errors of failed statements are passed when continuing.
+ */
+TEST_F(CalcParserVisitorTest, ErrorTest)
+{
+  std::stringstream sink;
+  recording_visitor visitor;
+  pdcalc::calc_parser parser{sink};
+  parser.keep_going(true).visitor(&visitor);
+  EXPECT_FALSE(parser(pdcalc::calc_source{"1 / 0; 2 +; 3;", "in"}));
+  using error = recording_visitor::error;
+  const std::vector<error> errors{
+    {0, "in:1.1-5: 1 / 0 is division by zero"},
+    {1, "in:1.11: syntax error, unexpected ;"}
+  };
+  EXPECT_EQ(errors, visitor.errors);
+  const std::vector<std::string> messages{
+    errors[0].message,
+    errors[1].message
+  };
+  EXPECT_EQ(messages, format_errors(parser));
+  // statements with syntax errors are not part of the program, so the failed
+  // statement has the index of the statement after it
+  ASSERT_EQ(1U, visitor.results.size());
+  EXPECT_EQ(1U, visitor.results.front().statement);
+  EXPECT_EQ(3L, std::get<long>(visitor.results.front().value));
+  EXPECT_TRUE(sink.str().empty());
+}
+
+/**
+ * Test that clearing the visitor writes results to the sink again.
+ */
+TEST_F(CalcParserVisitorTest, RestoreTest)
+{
+  std::stringstream sink;
+  recording_visitor visitor;
+  pdcalc::calc_parser parser{sink};
+  ASSERT_TRUE(parser(pdcalc::calc_source{"1;", "in"})) << parser.last_error();
+  parser.visitor(&visitor);
+  EXPECT_EQ("<long> 1\n", sink.str());
+  ASSERT_TRUE(parser(pdcalc::calc_source{"2;", "in"})) << parser.last_error();
+  EXPECT_EQ(1U, visitor.results.size());
+  parser.visitor(nullptr);
+  EXPECT_NE(&visitor, &parser.visitor());
+  ASSERT_TRUE(parser(pdcalc::calc_source{"3;", "in"})) << parser.last_error();
+  EXPECT_EQ("<long> 1\n<long> 3\n", sink.str());
+  EXPECT_EQ(1U, visitor.results.size());
+}
+
+/**
+ * Calc parser concurrency test fixture.
+ */
+class CalcParserConcurrentTest : public CalcParserTest {
+protected:
+  // number of threads, each with its own parser
+  static constexpr unsigned n_threads_ = 8;
+  // number of times each thread parses all the sample files
+  static constexpr unsigned n_rounds_ = 16;
+
+  /**
+   * Parse all the sample files in order with the given parser.
+   *
+   * @param parser Parser to use
+   * @returns Empty string on success, last error on failure
+   */
+  static std::string parse_samples(pdcalc::calc_parser& parser)
+  {
+    for (auto file : sample_files)
+      if (!parser(test_data_dir_ / file))
+        return parser.last_error();
+    return {};
+  }
+};
+
+/**
+ * Test that independent parsers on separate threads produce the same results.
+ *
+ * Each thread owns a parser that repeatedly parses all the sample files, with
+ * the output compared against the output of a single sequential parse.
+ */
+TEST_F(CalcParserConcurrentTest, StressTest)
+{
+  // expected output from sequential parse
+  std::stringstream expected_stream;
+  pdcalc::calc_parser expected_parser{expected_stream};
+  ASSERT_EQ("", parse_samples(expected_parser));
+  const auto expected = expected_stream.str();
+  // per-thread number of matching rounds and first error, if any
+  std::vector<unsigned> n_matches(n_threads_);
+  std::vector<std::string> errors(n_threads_);
+  // launch threads. each has its own sink and parser
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < n_threads_; i++)
+    threads.emplace_back(
+      [i, &expected, &n_matches, &errors]
+      {
+        std::stringstream sink;
+        pdcalc::calc_parser parser{sink};
+        for (unsigned j = 0; j < n_rounds_; j++) {
+          // stop on first error
+          if (auto error = parse_samples(parser); error.size()) {
+            errors[i] = error;
+            return;
+          }
+          // check output + reset sink for next round
+          n_matches[i] += (sink.str() == expected);
+          sink.str("");
+        }
+      }
+    );
+  for (auto& thread : threads)
+    thread.join();
+  // check results for each thread
+  for (unsigned i = 0; i < n_threads_; i++) {
+    EXPECT_EQ("", errors[i]) << "thread " << i << " failed";
+    EXPECT_EQ(n_rounds_, n_matches[i]) << "thread " << i << " output mismatch";
+  }
+}
+
 }  // namespace